@@ -2,6 +2,7 @@
 
 import socket
 import select
+import struct
 import sys
 import array as arr
 import argparse
@@ -17,6 +18,14 @@ level_print = ("TRACE", "DEBUG", "INFO", "ERROR", "NONE")
 
 SOCKET_TIMEOUT = 30
 
+# header of a binary GETDATA spectrum, struct getdata_header of the server
+GETDATA_MAGIC = 0x43455053
+GETDATA_HEADER = struct.Struct('<IHHIfdd')
+GETDATA_TYPES = { 0: 'f', 1: 'h' }
+
+# trial transmissions of a txTune, TX_TUNE_MAX_TRIALS of the server
+TX_TUNE_TRIALS = 12
+
 client_verbose_level = 0
 client_debug_level = 2
 
@@ -26,11 +35,29 @@ HELP_DESCRIPTION = 'Call apptest server to execute a command\n\n'   +\
         'disconnectRFE      \n'                                     +\
         'startCW            \t --freq (1000)  --span --power-level (3) \n' +\
         'stopGen            \n'                                     +\
-        'startSweep         \t --freq --power-level --steps (20) -- step-width (1000) --waitMS (10000) \n' +\
+        'startSweep         \t --freq --power-level --steps (20) -- step-width (1000) --waitMS (10000) --timed ("OFF") --rendered ("OFF") \n' +\
         'stopSweep          \n'                                     +\
+        'sweepStats         \n'                                     +\
+        'txStats            \n'                                     +\
+        'txTune             \t --freq --sample-rate --trial-ms (500) \n' +\
+        'playFile           \t --freq --sample-rate (32000000) --power-level --file --loop ("ON") --record-block-size (0) \n' +\
+        'digitalSweep       \t --freq --span --power-level --dsweep-mode ("STEPPED") --offsets (-5000,5000) --steps --dwell-us (100) --timed ("OFF") \n' +\
+        'multiTone          \t --freq --span --power-level --phases ("NEWMAN") --tones (-1000,0,1000) --comb (0) --spacing (100) \n' +\
+        'modulate           \t --freq --span --power-level --modulation ("QPSK") --mod-tone (1000) --am-depth (50) --fm-deviation (5000) --symbol-rate (1000000) --sps (4) --rolloff (0.35) --prbs (15) \n' +\
+        'impair             \t --snr ("OFF") --freq-offset (0) --phase-noise (0) --iq-gain (0) --iq-phase (0) \n' +\
+        'dualTone           \t --freq --span --power-level --a1 ("1000") --a2 ("1000:0:90") \n' +\
         'peakSearch         \t --freq --span (20)           \n'      +\
-        'getData            \t --freq --span (20)           \n'      +\
+        'getData            \t --freq --span (20) --binary ("OFF") --data-type ("F32") --points (512) \n' +\
+        'runSeq             \t --seq ("FREQ=500:5500:500 POWER=0:9 OFFSET=4 SETTLE=3000", run in the server, a row per step) \n' +\
         'setServerDebug     \t --debug-level ("ERROR")      \n'     +\
+        'setGapPolicy       \t --gap-policy ("DISCARD")     \n'     +\
+        'setTrigger         \t --trigger-dbfs (OFF) --pretrigger (4096) --trigger-timeout (1000) \n' +\
+        'setGain            \t --gain ("AUTORANGE" or gain index) \n' +\
+        'setIqCorr          \t --iq-corr ("ON" or "OFF")    \n'     +\
+        'iqCorr             \n'                                     +\
+        'setPacked          \t --packed ("ON" or "OFF")     \n'     +\
+        'captureStats       \n'                                     +\
+        'batch              \t --file (one server command per line, sent at once) \n' +\
         'setRFEVerbose      \t --verbose-level (5)          \n'     +\
         'setClientVerbose   \t --verbose-level              \n' 
 
@@ -67,18 +94,61 @@ class TestApp():
     def sendCommand(self, message):
         debug_print(TRACE, 'sending: ', message)
 
-        self.sock.sendall(message.encode())
+        # the server runs a command once it has its newline
+        self.sock.sendall((message.strip() + "\n").encode())
 
     def receiveData(self):
         debug_print(TRACE, "receiveData")
 
-        try:
-            data = self.sock.recv(200010)
+        # a response ends with a newline, it may take several reads and a read
+        # may hold the next response as well
+        while b"\n" not in self.rxbuf:
+            try:
+                data = self.sock.recv(200010)
+
+            except socket.timeout:
+                raise Exception("Client timed out waiting for a response")
+
+            if len(data) == 0:
+                break
+            self.rxbuf += data
+
+        line, sep, self.rxbuf = self.rxbuf.partition(b"\n")
+        return line.decode()
+
+    def receiveBytes(self, length):
+        debug_print(TRACE, "receiveBytes")
+
+        # binary data that follows a response line
+        while len(self.rxbuf) < length:
+            try:
+                data = self.sock.recv(max(length - len(self.rxbuf), 65536))
+
+            except socket.timeout:
+                raise Exception("Client timed out waiting for a response")
+
+            if len(data) == 0:
+                raise Exception("Server closed the connection in the middle of a response")
+            self.rxbuf += data
+
+        data = self.rxbuf[:length]
+        self.rxbuf = self.rxbuf[length:]
+        return data
+
+    def sendBatch(self, commands):
+        debug_print(TRACE, "sendBatch")
 
-        except socket.timeout:
-            raise Exception("Client timed out waiting for a response")
+        # every command in one send, the server runs them in order and sends
+        # the responses back together
+        commands = [c.strip() for c in commands if len(c.strip()) > 0]
+        debug_print(DEBUG, commands)
+        self.sock.sendall(("\n".join(commands) + "\n").encode())
 
-        return data.decode()
+        responses = []
+        for c in commands:
+            responses.append(self.receiveResponse())
+
+        return responses
 
     def receiveResponse(self):
         debug_print(TRACE, "receiveResponse")
@@ -119,9 +189,134 @@ class TestApp():
         resp, resplist = self.receiveResponse()
         return resp
 
-    def sendStartSweep(self, start_freq, power_level, steps, step_width, waitMS, span ):
+    def sendStartSweep(self, start_freq, power_level, steps, step_width, waitMS, span, timed=False):
         debug_print(TRACE, "startSweep")
         cmd = "STARTSWEEP" + " " + str(start_freq) + " " + str(power_level) + " " + str(steps) + " " + str(step_width) + " " +  str(waitMS) + " " + str(span)
+        if timed:
+            # steps scheduled on the TX timestamp
+            cmd += " TIMED"
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+
+    def sendStartRenderedSweep(self, start_freq, power_level, steps, step_width, waitMS, span):
+        debug_print(TRACE, "startRenderedSweep")
+        cmd = "STARTSWEEP" + " " + str(start_freq) + " " + str(power_level) + " " + str(steps) + " " + str(step_width) + " " +  str(waitMS) + " " + str(span) + " RENDERED"
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # bytes of the blocks, render time in usec, largest step offset error in Hz,
+        # 1 if the blocks were kept from the last start of the same sweep
+        info = {}
+        for name, conv in (("bytes", int), ("render_usec", int), ("max_error_hz", float),
+                           ("reused", int)):
+            if len(resplist) == 0:
+                break
+            info[name] = conv(resplist.pop(0))
+
+        return resp, info
+
+
+    def sendDigitalSweep(self, freq, span, power_level, mode, offsets, steps, dwell_us, timed=False):
+        debug_print(TRACE, "digitalSweep")
+
+        # offsets in kHz: start,stop for STEPPED and CHIRP, the frequencies for LIST
+        cmd = "DSWEEP " + str(freq) + " " + str(span) + " " + str(power_level) + " " + mode.upper()
+        if mode.upper() == "STEPPED":
+            cmd += " " + str(offsets[0]) + " " + str(offsets[1]) + " " + str(steps) + " " + str(dwell_us)
+        elif mode.upper() == "CHIRP":
+            cmd += " " + str(offsets[0]) + " " + str(offsets[1]) + " " + str(dwell_us)
+        else:
+            cmd += " " + str(dwell_us) + " " + " ".join(str(offset) for offset in offsets)
+        if timed:
+            # blocks stamped with the TX timestamp
+            cmd += " TIMED"
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def sendMultiTone(self, freq, span, power_level, phases, tones, comb, spacing):
+        debug_print(TRACE, "multiTone")
+
+        # tones are "kHz[:dB[:deg]]" strings, or comb tones spaced by spacing kHz
+        cmd = "MULTITONE " + str(freq) + " " + str(span) + " " + str(power_level) + " " + phases.upper()
+        if comb > 0:
+            cmd += " COMB " + str(comb) + " " + str(spacing)
+        else:
+            cmd += " " + " ".join(tones)
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # crest factor in dB, samples in the looped period, largest tone offset error in Hz
+        info = {}
+        for name, conv in (("crest_db", float), ("period", int), ("max_error_hz", float)):
+            if len(resplist) == 0:
+                break
+            info[name] = conv(resplist.pop(0))
+
+        return resp, info
+
+    def sendModulate(self, freq, span, power_level, modulation, tone, am_depth, fm_deviation,
+                     symbol_rate, sps, rolloff, prbs):
+        debug_print(TRACE, "modulate")
+
+        # AM takes the tone in Hz and the depth in %, FM the tone and the deviation in Hz,
+        # BPSK, QPSK and QAM16 the symbol rate, samples per symbol, rolloff and PRBS order
+        cmd = "MODULATE " + str(freq) + " " + str(span) + " " + str(power_level) + " " + modulation.upper()
+        if modulation.upper() == "AM":
+            cmd += " " + str(tone) + " " + str(am_depth)
+        elif modulation.upper() == "FM":
+            cmd += " " + str(tone) + " " + str(fm_deviation)
+        else:
+            cmd += " " + str(symbol_rate) + " " + str(sps) + " " + str(rolloff) + " " + str(prbs)
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def sendImpair(self, snr, freq_offset, phase_noise, iq_gain, iq_phase):
+        debug_print(TRACE, "impair")
+
+        # SNR in dB or OFF, offset in Hz, phase noise in degrees rms, I/Q gain in dB and
+        # phase in degrees, applied to the signal that is streaming
+        cmd = "IMPAIR " + str(snr) + " " + str(freq_offset) + " " + str(phase_noise) + " " + \
+              str(iq_gain) + " " + str(iq_phase)
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # the response carries how much the signal was reduced to fit the noise in dB
+        resp, resplist = self.receiveResponse()
+        backoff = float(resplist[0]) if (resp == "SUCCESS" and len(resplist) > 0) else 0
+        return resp, backoff
+
+    def sendDualTone(self, freq, span, power_level, a1, a2):
+        debug_print(TRACE, "dualtone")
+
+        # a1 and a2 are "kHz[:dB[:deg]]" strings, the phase of A2 relative to A1 is
+        # the difference of the two phases when the offsets are the same
+        cmd = "DUALTONE " + str(freq) + " " + str(span) + " " + str(power_level) + " " + \
+              a1 + " " + a2
 
         debug_print(DEBUG, cmd)
         self.sendCommand(cmd)
@@ -130,6 +325,19 @@ class TestApp():
         resp, resplist = self.receiveResponse()
         return resp
 
+    def sendPlayFile(self, freq, sample_rate, power_level, path, loop, record_block_size):
+        debug_print(TRACE, "playFile")
+
+        # the path is on the server, record_block_size is 0 for a raw int16 I/Q file
+        cmd = "PLAYFILE " + str(freq) + " " + str(sample_rate) + " " + str(power_level) + " " + \
+              path + " " + ("LOOP" if loop else "ONCE") + " " + str(record_block_size)
+
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
 
     def sendStopSweep(self):
         debug_print(TRACE, "stopSweep")
@@ -140,6 +348,79 @@ class TestApp():
         resp, resplist = self.receiveResponse()
         return resp
 
+    def sendSweepStats(self):
+        debug_print(TRACE, "sendSweepStats")
+
+        cmd = "SWEEPSTATS "
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # steps, retune min/avg/max usec, dwell min/avg/max usec, current frequency MHz,
+        # then for timed sweeps the start timestamp, the scheduled step in samples and usec,
+        # the min/max start error in samples and the late blocks
+        stats = {}
+        for name, conv in (("steps", int), ("retune_min", int), ("retune_avg", int), 
+                           ("retune_max", int), ("dwell_min", int), ("dwell_avg", int), 
+                           ("dwell_max", int), ("freq", int), ("timed", int), 
+                           ("start_timestamp", int), ("step_samples", int), 
+                           ("step_usec", float), ("start_error_min", int), 
+                           ("start_error_max", int), ("late_blocks", int)):
+            if len(resplist) == 0:
+                break
+            stats[name] = conv(resplist.pop(0))
+
+        return resp, stats
+
+    def sendTxStats(self):
+        debug_print(TRACE, "sendTxStats")
+
+        cmd = "TXSTATS "
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # blocks sent and completed, queue depth now/avg/max, queue full and empty counts,
+        # underruns, completion errors
+        stats = {}
+        for name in ("sent", "completed", "depth", "depth_avg", "depth_max",
+                     "queue_full", "queue_empty", "underruns", "errors"):
+            if len(resplist) == 0:
+                break
+            stats[name] = int(resplist.pop(0))
+
+        return resp, stats
+
+    def sendTxTune(self, freq, sample_rate, trial_ms):
+        debug_print(TRACE, "sendTxTune")
+
+        cmd = "TXTUNE " + str(freq) + " " + str(sample_rate) + " " + str(trial_ms)
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # every trial runs before the response, allow twice their length
+        self.sock.settimeout(SOCKET_TIMEOUT + (2 * TX_TUNE_TRIALS * trial_ms) / 1000)
+        try:
+            resp, resplist = self.receiveResponse()
+        finally:
+            self.sock.settimeout(SOCKET_TIMEOUT)
+
+        # the kept block size and threads, then block size:threads:underruns:CPU %:start usec
+        # of each trial
+        best = {}
+        trials = []
+        if resp == "SUCCESS" and len(resplist) >= 2:
+            best = {"block_size": int(resplist.pop(0)), "threads": int(resplist.pop(0))}
+            for trial in resplist:
+                fields = trial.split(':')
+                trials.append({"block_size": int(fields[0]), "threads": int(fields[1]),
+                               "underruns": int(fields[2]), "cpu_pct": float(fields[3]),
+                               "start_usec": int(fields[4])})
+
+        return resp, best, trials
+
     def sendPeakSearch(self, freq, span):
         debug_print(TRACE, "sendPeakSearch")
 
@@ -150,6 +431,10 @@ class TestApp():
         #wait for a response
         resp, resplist = self.receiveResponse()
 
+        # the trigger didn't fire so there is no peak
+        if resp == "NOTRIGGER":
+            return resp, 0.0, -300.0
+
         ret_freq = float(resplist.pop(0))
         power = float(resplist.pop(0))
 
@@ -158,16 +443,68 @@ class TestApp():
 
         return resp, ret_freq, power
 
-    def sendGetData(self, freq, span):
+    def sendRunSeq(self, seq, on_row=None):
+        debug_print(TRACE, "sendRunSeq")
+
+        cmd = "RUNSEQ " + seq
+        debug_print(DEBUG, cmd)
+        self.sendCommand(cmd)
+
+        # a row comes once a step has settled, been searched and had its time
+        # off, allow that much more than a response between rows
+        step_ms = 1000
+        off_ms = 0
+        for field in seq.split():
+            name, sep, value = field.partition("=")
+            if name.upper() == "SETTLE":
+                step_ms = int(value)
+            elif name.upper() == "OFF":
+                off_ms = int(value)
+        self.sock.settimeout(SOCKET_TIMEOUT + (step_ms + off_ms) / 1000)
+
+        # ROW <step> <tx MHz> <power level> then <peak Hz> <peak dB> PASS|FAIL,
+        # NOTRIGGER FAIL, or DONE when the peak is not searched
+        rows = []
+        try:
+            while True:
+                resp, resplist = self.receiveResponse()
+                if resp != "ROW":
+                    break
+                row = {"step": int(resplist[0]), "freq": int(resplist[1]),
+                       "power_level": int(resplist[2])}
+                if len(resplist) == 6:
+                    row["peak_freq"] = int(resplist[3])
+                    row["peak_power"] = int(resplist[4])
+                row["result"] = resplist[-1]
+                rows.append(row)
+                if on_row is not None:
+                    on_row(row)
+        finally:
+            self.sock.settimeout(SOCKET_TIMEOUT)
+
+        # the rows, the steps that failed and the msec of the sequence
+        summary = {}
+        if resp == "SUCCESS" and len(resplist) >= 3:
+            summary = {"rows": int(resplist[0]), "failed": int(resplist[1]),
+                       "msec": int(resplist[2])}
+
+        return resp, rows, summary
+
+    def sendGetData(self, freq, span, binary=False, data_type="F32", points=512):
         debug_print(TRACE, "sendGetData")
 
         cmd = "GETDATA " + str(freq) + " " + str(span);
+        if binary:
+            cmd += " BINARY " + data_type.upper() + " " + str(points)
 
         self.sendCommand(cmd)
 
         #wait for a response
         resp, resplist = self.receiveResponse()
 
+        if binary:
+            return self.receiveSpectrum(resp, resplist)
+
 #        print(resplist)
        
         array_len = len(resplist)/2
@@ -186,6 +523,31 @@ class TestApp():
 
         return resp, freq_array, power_array
 
+    def receiveSpectrum(self, resp, resplist):
+        debug_print(TRACE, "receiveSpectrum")
+
+        freq_array = arr.array('f',[])
+        power_array = arr.array('f',[])
+        if resp != "SUCCESS" or len(resplist) == 0:
+            return resp, freq_array, power_array
+
+        # the header and the packed values follow the line with their length
+        data = self.receiveBytes(int(resplist[0]))
+        magic, header_bytes, data_type, count, scale, start_freq_hz, bin_width_hz = \
+            GETDATA_HEADER.unpack_from(data)
+        if magic != GETDATA_MAGIC or data_type not in GETDATA_TYPES:
+            raise Exception("Server sent a spectrum that does not parse")
+
+        values = arr.array(GETDATA_TYPES[data_type])
+        values.frombytes(data[header_bytes:header_bytes + count * values.itemsize])
+
+        # in MHz and dB like the text response
+        for i in range(count):
+            freq_array.append((start_freq_hz + i * bin_width_hz) / 1000000)
+            power_array.append(values[i] * scale)
+
+        return resp, freq_array, power_array
+
     def setServerDebug(self, new_debug_level):
         debug_print(TRACE, "setServerDebug")
 
@@ -196,6 +558,97 @@ class TestApp():
         resp, resplist = self.receiveResponse()
         return resp
 
+    def setGapPolicy(self, gap_policy):
+        debug_print(TRACE, "setGapPolicy")
+
+        cmd = "SETGAPPOLICY " + str(gap_policy)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def setTrigger(self, threshold_dbfs, pretrigger, timeout_ms):
+        debug_print(TRACE, "setTrigger")
+
+        if str(threshold_dbfs).upper() == "OFF":
+            cmd = "SETTRIGGER OFF"
+        else:
+            cmd = "SETTRIGGER " + str(threshold_dbfs) + " " + str(pretrigger) + " " + str(timeout_ms)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def setGain(self, gain):
+        debug_print(TRACE, "setGain")
+
+        cmd = "SETGAIN " + str(gain)
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def setIqCorr(self, iq_corr):
+        debug_print(TRACE, "setIqCorr")
+
+        cmd = "SETIQCORR " + iq_corr
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def setPacked(self, packed):
+        debug_print(TRACE, "setPacked")
+
+        cmd = "SETPACKED " + packed
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+        return resp
+
+    def sendIqCorr(self):
+        debug_print(TRACE, "sendIqCorr")
+
+        cmd = "IQCORR "
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # dc offset of I and Q, Q gain correction, I removed from Q
+        corr = {}
+        for name in ("dc_i", "dc_q", "gain", "cross"):
+            if len(resplist) == 0:
+                break
+            corr[name] = float(resplist.pop(0))
+
+        return resp, corr
+
+    def sendCaptureStats(self):
+        debug_print(TRACE, "sendCaptureStats")
+
+        cmd = "CAPTURESTATS "
+        self.sendCommand(cmd)
+
+        # wait for a response
+        resp, resplist = self.receiveResponse()
+
+        # blocks received, dropped, gaps, overruns, restarts, first/last rf timestamp,
+        # clipped samples, gain index, autorange iterations
+        stats = {}
+        for name in ("received", "dropped", "gaps", "overruns", "restarts", "first_ts", "last_ts",
+                     "clipped", "gain", "iterations"):
+            if len(resplist) == 0:
+                break
+            stats[name] = int(resplist.pop(0))
+
+        return resp, stats
+
     def setRFEVerbose(self, verbose_level):
         debug_print(TRACE, "setRFEVerbose")
 
@@ -244,6 +697,7 @@ class TestApp():
 
         # Create a TCP/IP socket
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.rxbuf = b""
     
 
         # Connect the socket to the port where the server is listening
@@ -286,29 +740,132 @@ def processCommand(rcvd_cmd):
            print("StopGen: ", resp)
 
     elif cmd == "startsweep":
-       resp = test.sendStartSweep(args.freq, args.power_level, args.steps, args.step_width, args.waitMS, args.span)
+       if args.rendered.upper() == "ON":
+           resp, info = test.sendStartRenderedSweep(args.freq, args.power_level, args.steps, args.step_width,
+                                                    args.waitMS, args.span)
+           if client_verbose_level > 1:
+               print("StartSweep: ", resp, info)
+       else:
+           resp = test.sendStartSweep(args.freq, args.power_level, args.steps, args.step_width, args.waitMS, args.span,
+                                      args.timed.upper() == "ON")
+           if client_verbose_level > 1:
+               print("StartSweep: ", resp)
+
+    elif cmd == "digitalsweep":
+       offsets = [int(offset) for offset in args.offsets.split(',')]
+       resp = test.sendDigitalSweep(args.freq, args.span, args.power_level, args.dsweep_mode, offsets, args.steps, args.dwell_us,
+                                    args.timed.upper() == "ON")
        if client_verbose_level > 1:
-           print("StartSweep: ", resp)
+           print("DigitalSweep: ", resp)
+
+    elif cmd == "multitone":
+       resp, info = test.sendMultiTone(args.freq, args.span, args.power_level, args.phases,
+                                       args.tones.split(','), args.comb, args.spacing)
+       print("MultiTone: Status: ", resp, info)
+
+    elif cmd == "modulate":
+       resp = test.sendModulate(args.freq, args.span, args.power_level, args.modulation,
+                                args.mod_tone, args.am_depth, args.fm_deviation,
+                                args.symbol_rate, args.sps, args.rolloff, args.prbs)
+       if client_verbose_level > 1:
+           print("Modulate: ", resp)
+
+    elif cmd == "impair":
+       resp, backoff = test.sendImpair(args.snr, args.freq_offset, args.phase_noise,
+                                       args.iq_gain, args.iq_phase)
+       print("Impair: Status: ", resp, "Backoff dB: ", backoff)
+
+    elif cmd == "dualtone":
+       resp = test.sendDualTone(args.freq, args.span, args.power_level, args.a1, args.a2)
+       if client_verbose_level > 1:
+           print("DualTone: ", resp)
+
+    elif cmd == "playfile":
+       resp = test.sendPlayFile(args.freq, args.sample_rate, args.power_level, args.file,
+                                args.loop.upper() == "ON", args.record_block_size)
+       if client_verbose_level > 1:
+           print("PlayFile: ", resp)
 
     elif cmd == "stopsweep":
        resp = test.sendStopSweep()
        if client_verbose_level > 1:
            print("StopSweep: ", resp)
 
+    elif cmd == "sweepstats":
+       resp, stats = test.sendSweepStats()
+       print("SweepStats: Status: ", resp, stats)
+
+    elif cmd == "txstats":
+       resp, stats = test.sendTxStats()
+       print("TxStats: Status: ", resp, stats)
+
+    elif cmd == "txtune":
+       resp, best, trials = test.sendTxTune(args.freq, args.sample_rate, args.trial_ms)
+       print("TxTune: Status: ", resp, best)
+       for trial in trials:
+           print("    ", trial)
+
     elif cmd == "peaksearch":
        resp, freq, power = test.sendPeakSearch(args.freq, args.span) 
        print("PeakSearch: Status: ", resp, "Frequency: ", freq,"Power: ", power)
 
     elif cmd == "getdata":
-       resp, data = test.sendGetData(args.freq, args.span) 
+       resp, freq_array, power_array = test.sendGetData(args.freq, args.span, args.binary.upper() == "ON",
+                                                        args.data_type, args.points)
        if client_verbose_level > 1:
-           print("PeakSearch: Status: ", resp)
+           print("GetData: Status: ", resp, len(power_array), "points")
 
     elif cmd == "setserverdebug":
        resp = test.setServerDebug(args.debug_level)
        if client_verbose_level < 1:
            print("setServerDebug: ", resp)
 
+    elif cmd == "setgappolicy":
+       resp = test.setGapPolicy(args.gap_policy)
+       if client_verbose_level > 1:
+           print("setGapPolicy: ", resp)
+
+    elif cmd == "settrigger":
+       resp = test.setTrigger(args.trigger_dbfs, args.pretrigger, args.trigger_timeout)
+       if client_verbose_level > 1:
+           print("setTrigger: ", resp)
+
+    elif cmd == "setgain":
+       resp = test.setGain(args.gain)
+       if client_verbose_level > 1:
+           print("setGain: ", resp)
+
+    elif cmd == "setiqcorr":
+       resp = test.setIqCorr(args.iq_corr)
+       if client_verbose_level > 1:
+           print("setIqCorr: ", resp)
+
+    elif cmd == "setpacked":
+       resp = test.setPacked(args.packed)
+       if client_verbose_level > 1:
+           print("setPacked: ", resp)
+
+    elif cmd == "iqcorr":
+       resp, corr = test.sendIqCorr()
+       print("IqCorr: Status: ", resp, corr)
+
+    elif cmd == "capturestats":
+       resp, stats = test.sendCaptureStats()
+       print("CaptureStats: Status: ", resp, stats)
+
+    elif cmd == "runseq":
+       resp, rows, summary = test.sendRunSeq(args.seq,
+               lambda row: print("RunSeq: ", " ".join(str(v) for v in row.values())))
+       print("RunSeq: Status: ", resp, summary)
+       if resp != "SUCCESS" or summary["failed"] > 0:
+           sys.exit(1)
+
+    elif cmd == "batch":
+       with open(args.file) as f:
+           responses = test.sendBatch(f.readlines())
+       for resp, resplist in responses:
+           print("Batch: ", resp, " ".join(resplist))
+
     elif cmd == "setrfeverbose":
        resp = test.setRFEVerbose(args.verbose_level)
        if client_verbose_level > 1:
@@ -339,10 +896,50 @@ def main(argv=None):
     parser.add_argument('--steps', type=int, default=20, help='Sweep number of steps')
     parser.add_argument('--step-width', type=int, default=1000, help='Sweep step width in Khz')
     parser.add_argument('--waitMS', type=int, default=1000, help='Sweep MS to wait after each change')
+    parser.add_argument('--timed', type=str, default='OFF', help='Schedule sweep steps on the TX timestamp ON or OFF')
+    parser.add_argument('--rendered', type=str, default='OFF', help='Render the sweep within the span once and loop it ON or OFF')
+    parser.add_argument('--dsweep-mode', type=str, default='STEPPED', help='Digital sweep STEPPED, CHIRP or LIST')
+    parser.add_argument('--offsets', type=str, default='-5000,5000', help='Digital sweep start,stop offsets in kHz, or the list of offsets')
+    parser.add_argument('--dwell-us', type=int, default=100, help='Digital sweep usec per step, or per chirp')
+    parser.add_argument('--phases', type=str, default='NEWMAN', help='Multi-tone phases NEWMAN, ZERO or USER')
+    parser.add_argument('--tones', type=str, default='-1000,0,1000', help='Multi-tone offsets in kHz, each optionally :dB and :degrees')
+    parser.add_argument('--comb', type=int, default=0, help='Number of equally spaced multi-tone tones, 0 to use --tones')
+    parser.add_argument('--spacing', type=float, default=100, help='Multi-tone comb spacing in kHz')
+    parser.add_argument('--modulation', type=str, default='QPSK', help='Modulation AM, FM, BPSK, QPSK or QAM16')
+    parser.add_argument('--mod-tone', type=int, default=1000, help='AM or FM modulating tone in Hz')
+    parser.add_argument('--am-depth', type=float, default=50, help='AM depth in percent')
+    parser.add_argument('--fm-deviation', type=int, default=5000, help='FM peak deviation in Hz')
+    parser.add_argument('--symbol-rate', type=int, default=1000000, help='BPSK, QPSK or QAM16 symbols per second')
+    parser.add_argument('--sps', type=int, default=4, help='Samples per symbol, 2 to 16')
+    parser.add_argument('--rolloff', type=float, default=0.35, help='Root raised cosine rolloff, 0.05 to 1')
+    parser.add_argument('--prbs', type=int, default=15, help='PRBS order of the symbols, 7, 9, 15, 23 or 31')
+    parser.add_argument('--snr', type=str, default='OFF', help='SNR of the added noise in dB or OFF')
+    parser.add_argument('--freq-offset', type=int, default=0, help='Frequency offset added to the signal in Hz')
+    parser.add_argument('--phase-noise', type=float, default=0, help='Phase noise added to the signal in degrees rms')
+    parser.add_argument('--iq-gain', type=float, default=0, help='I/Q gain imbalance added to the signal in dB')
+    parser.add_argument('--iq-phase', type=float, default=0, help='I/Q phase imbalance added to the signal in degrees')
+    parser.add_argument('--a1', type=str, default='1000', help='Dual tone of A1 as offset kHz, optionally :dB and :degrees')
+    parser.add_argument('--a2', type=str, default='1000:0:90', help='Dual tone of A2 as offset kHz, optionally :dB and :degrees')
+    parser.add_argument('--file', type=str, default='tx_samples.bin', help='IQ file on the server to play, or the commands of a batch')
+    parser.add_argument('--sample-rate', type=int, default=32000000, help='Sample rate of the played file or to tune TX for in Hz')
+    parser.add_argument('--trial-ms', type=int, default=500, help='Length of each txTune trial transmission in ms')
+    parser.add_argument('--loop', type=str, default='ON', help='Loop the played file ON or OFF')
+    parser.add_argument('--record-block-size', type=int, default=0, help='Words per block of a file of TX block records, 0 for raw I/Q')
     parser.add_argument('--span', type=int, default=20, help='span of Peaksearch in Mhz')
+    parser.add_argument('--binary', type=str, default='OFF', help='Get the spectrum as packed binary values ON or OFF')
+    parser.add_argument('--data-type', type=str, default='F32', help='Binary spectrum values F32 or I16')
+    parser.add_argument('--points', type=int, default=512, help='Points of a binary spectrum, a power of 2 up to 65536')
+    parser.add_argument('--seq', type=str, default='FREQ=500:5500:500 POWER=0:9 OFFSET=4 SETTLE=3000', help='Test sequence of runSeq, FREQ=first:last:step [POWER=first:last:step] [OFFSET=MHz] [SPAN=MHz] [SETTLE=ms] [OFF=ms] [PEAK=ON|OFF] [MIN=dB] [MAX=dB] [TOL=kHz]')
     parser.add_argument('--start-freq', type=int, default=980, help='start freq of Peaksearch in Mhz')
     parser.add_argument('--stop-freq', type=int, default=1020, help='stop freq of Peaksearch in Mhz')
     parser.add_argument('--debug-level', type=str, default='TRACE', help='Debug level to set locally or at server')
+    parser.add_argument('--gap-policy', type=str, default='DISCARD', help='What a capture does with dropped blocks DISCARD, ZEROFILL or REPORT')
+    parser.add_argument('--trigger-dbfs', type=str, default='OFF', help='Capture trigger threshold in dBFS or OFF')
+    parser.add_argument('--pretrigger', type=int, default=4096, help='Samples kept from before the trigger')
+    parser.add_argument('--trigger-timeout', type=int, default=1000, help='MS to wait for the trigger')
+    parser.add_argument('--gain', type=str, default='10', help='RX gain index or AUTORANGE')
+    parser.add_argument('--iq-corr', type=str, default='ON', help='Software DC and IQ imbalance correction ON or OFF')
+    parser.add_argument('--packed', type=str, default='ON', help='Capture packed 12 bit samples ON or OFF')
     parser.add_argument('--server-address', type=str, default='127.0.0.1', help='Address of the server')
     parser.add_argument('--tcp-port', type=int, default=10000, help='tcp port of the server')
 
@@ -0,0 +1,1954 @@
+/**
+ * @file dsp_kernels.c
+ *
+ * 
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+
+/***** INCLUDES *****/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#if (defined __SSE2__)
+#include <emmintrin.h>
+#define DSP_USE_SSE2
+#elif (defined __ARM_NEON) || (defined __ARM_NEON__)
+#include <arm_neon.h>
+#define DSP_USE_NEON
+#endif
+
+#include "dsp_kernels.h"
+
+/* the phase is centered in its quadrant and converted to radians */
+#define NCO_QUARTER             (1u << 30)
+#define NCO_EIGHTH              (1u << 29)
+#define NCO_RADIANS_PER_STEP    (float)(2.0 * M_PI / 4294967296.0)
+
+/* nco_tone_add() rotates the tone this many vectors between exact phases */
+#define NCO_ROTATE_VECTORS      16
+
+/* minimax coefficients for sin and cos over [-pi/4, pi/4] */
+#define NCO_SIN_C1              (-1.6666654611e-1f)
+#define NCO_SIN_C2              (8.3321608736e-3f)
+#define NCO_SIN_C3              (-1.9515295891e-4f)
+#define NCO_COS_C1              (4.166664568298827e-2f)
+#define NCO_COS_C2              (-1.388731625493765e-3f)
+#define NCO_COS_C3              (2.443315711809948e-5f)
+
+/* logf() of the Cephes library, for the Box-Muller radius */
+#define GAUSS_SQRTHF            0.707106781186547524f
+#define GAUSS_LOG_P0            7.0376836292e-2f
+#define GAUSS_LOG_P1            (-1.1514610310e-1f)
+#define GAUSS_LOG_P2            1.1676998740e-1f
+#define GAUSS_LOG_P3            (-1.2420140846e-1f)
+#define GAUSS_LOG_P4            1.4249322787e-1f
+#define GAUSS_LOG_P5            (-1.6668057665e-1f)
+#define GAUSS_LOG_P6            2.0000714765e-1f
+#define GAUSS_LOG_P7            (-2.4999993993e-1f)
+#define GAUSS_LOG_P8            3.3333331174e-1f
+#define GAUSS_LOG_Q1            (-2.12194440e-4f)
+#define GAUSS_LOG_Q2            0.693359375f
+
+/* 23 random bits to a uniform value in (0, 1), never 0 so the log is finite */
+#define GAUSS_UNIFORM_STEP      (1.0f / 8388608.0f)
+
+
+/*****************************************************************************/
+/** Sums I*I + Q*Q over a block.  The per sample power of two full scale 
+ *  int16 values (2^31) does not fit in an int32, so the partial sums are 
+ *  treated as unsigned before they are widened to 64 bits.
+
+    @param p_iq         interleaved I/Q samples
+    @param num_samples  number of I/Q pairs
+    @return sum of the power
+*/
+uint64_t iq_power_sum(const int16_t *p_iq, uint32_t num_samples)
+{
+    uint64_t sum = 0;
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&p_iq[2 * i]);
+
+        /* madd gives I*I + Q*Q for each pair */
+        __m128i p = _mm_madd_epi16(v, v);
+
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, zero));
+    }
+
+    {
+        uint64_t lanes[2];
+
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum = lanes[0] + lanes[1];
+    }
+#elif (defined DSP_USE_NEON)
+    uint64x2_t acc = vdupq_n_u64(0);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        int16x8_t v = vld1q_s16(&p_iq[2 * i]);
+        int32x4_t p = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+
+        p = vmlal_s16(p, vget_high_s16(v), vget_high_s16(v));
+        acc = vpadalq_u32(acc, vreinterpretq_u32_s32(p));
+    }
+
+    sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        int32_t re = p_iq[2 * i];
+        int32_t im = p_iq[2 * i + 1];
+
+        sum += (uint64_t)(re * re) + (uint64_t)(im * im);
+    }
+
+    return sum;
+}
+
+/*****************************************************************************/
+/** Copies the samples and tracks the range in the same pass, so checking for
+ *  clipping costs nothing more than the copy that is already being done.
+
+    @param p_dst        destination
+    @param p_src        interleaved I/Q samples
+    @param num_samples  number of I/Q pairs
+    @param clip_level   magnitude considered clipped
+    @param p_range      accumulated min, max and clip count
+    @return void
+*/
+void iq_copy_range(int16_t *p_dst, const int16_t *p_src, uint32_t num_samples,
+                   int16_t clip_level, struct iq_range *p_range)
+{
+    uint32_t num_values = num_samples * 2;
+    uint32_t i = 0;
+    int16_t min = p_range->min;
+    int16_t max = p_range->max;
+    uint32_t clipped = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128i vmin = _mm_set1_epi16(min);
+    __m128i vmax = _mm_set1_epi16(max);
+    __m128i vhigh = _mm_set1_epi16(clip_level - 1);
+    __m128i vlow = _mm_set1_epi16(-(clip_level - 1));
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&p_src[i]);
+        __m128i clip;
+
+        _mm_storeu_si128((__m128i *)&p_dst[i], v);
+
+        vmin = _mm_min_epi16(vmin, v);
+        vmax = _mm_max_epi16(vmax, v);
+
+        /* each clipped value sets 2 bits in the byte mask */
+        clip = _mm_or_si128(_mm_cmpgt_epi16(v, vhigh), _mm_cmplt_epi16(v, vlow));
+        clipped += __builtin_popcount(_mm_movemask_epi8(clip)) / 2;
+    }
+
+    {
+        int16_t lanes[8];
+        int j;
+
+        _mm_storeu_si128((__m128i *)lanes, vmin);
+        for (j = 0; j < 8; j++)
+        {
+            min = (lanes[j] < min) ? lanes[j] : min;
+        }
+        _mm_storeu_si128((__m128i *)lanes, vmax);
+        for (j = 0; j < 8; j++)
+        {
+            max = (lanes[j] > max) ? lanes[j] : max;
+        }
+    }
+#elif (defined DSP_USE_NEON)
+    int16x8_t vmin = vdupq_n_s16(min);
+    int16x8_t vmax = vdupq_n_s16(max);
+    int16x8_t vclip = vdupq_n_s16(clip_level);
+    uint32x4_t vclipped = vdupq_n_u32(0);
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        int16x8_t v = vld1q_s16(&p_src[i]);
+        uint16x8_t clip;
+
+        vst1q_s16(&p_dst[i], v);
+
+        vmin = vminq_s16(vmin, v);
+        vmax = vmaxq_s16(vmax, v);
+
+        /* saturating abs so -32768 compares as 32767 */
+        clip = vcgeq_s16(vqabsq_s16(v), vclip);
+        vclipped = vpadalq_u16(vclipped, vshrq_n_u16(clip, 15));
+    }
+
+    {
+        int16_t lanes[8];
+        uint32_t counts[4];
+        int j;
+
+        vst1q_s16(lanes, vmin);
+        for (j = 0; j < 8; j++)
+        {
+            min = (lanes[j] < min) ? lanes[j] : min;
+        }
+        vst1q_s16(lanes, vmax);
+        for (j = 0; j < 8; j++)
+        {
+            max = (lanes[j] > max) ? lanes[j] : max;
+        }
+        vst1q_u32(counts, vclipped);
+        clipped = counts[0] + counts[1] + counts[2] + counts[3];
+    }
+#endif
+
+    /* remaining values */
+    for (; i < num_values; i++)
+    {
+        int16_t v = p_src[i];
+
+        p_dst[i] = v;
+        min = (v < min) ? v : min;
+        max = (v > max) ? v : max;
+        if (v >= clip_level || v <= -clip_level)
+        {
+            clipped++;
+        }
+    }
+
+    p_range->min = min;
+    p_range->max = max;
+    p_range->clipped += clipped;
+}
+
+/*****************************************************************************/
+/** Adds a block to the moments.  The 32 bit partial sums are widened to 64 
+ *  bits every iteration so any length is safe.
+
+    @param p_iq         interleaved I/Q samples
+    @param num_samples  number of I/Q pairs
+    @param p_moments    sums to add to
+    @return void
+*/
+void iq_accumulate_moments(const int16_t *p_iq, uint32_t num_samples, struct iq_moments *p_moments)
+{
+    uint32_t i = 0;
+    int64_t sum_i = 0;
+    int64_t sum_q = 0;
+    uint64_t sum_ii = 0;
+    uint64_t sum_qq = 0;
+    int64_t sum_iq = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    __m128i mask_i = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+    __m128i ones_i = _mm_set_epi16(0, 1, 0, 1, 0, 1, 0, 1);
+    __m128i ones_q = _mm_set_epi16(1, 0, 1, 0, 1, 0, 1, 0);
+    __m128i acc_i = zero;
+    __m128i acc_q = zero;
+    __m128i acc_ii = zero;
+    __m128i acc_qq = zero;
+    __m128i acc_iq = zero;
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&p_iq[2 * i]);
+        __m128i vi = _mm_and_si128(v, mask_i);
+        __m128i vq = _mm_andnot_si128(mask_i, v);
+        /* swap I and Q within each pair */
+        __m128i sw = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+        __m128i p;
+
+        /* signed values are sign extended, squares are zero extended */
+        p = _mm_madd_epi16(v, ones_i);
+        acc_i = _mm_add_epi64(acc_i, _mm_unpacklo_epi32(p, _mm_srai_epi32(p, 31)));
+        acc_i = _mm_add_epi64(acc_i, _mm_unpackhi_epi32(p, _mm_srai_epi32(p, 31)));
+
+        p = _mm_madd_epi16(v, ones_q);
+        acc_q = _mm_add_epi64(acc_q, _mm_unpacklo_epi32(p, _mm_srai_epi32(p, 31)));
+        acc_q = _mm_add_epi64(acc_q, _mm_unpackhi_epi32(p, _mm_srai_epi32(p, 31)));
+
+        p = _mm_madd_epi16(vi, vi);
+        acc_ii = _mm_add_epi64(acc_ii, _mm_unpacklo_epi32(p, zero));
+        acc_ii = _mm_add_epi64(acc_ii, _mm_unpackhi_epi32(p, zero));
+
+        p = _mm_madd_epi16(vq, vq);
+        acc_qq = _mm_add_epi64(acc_qq, _mm_unpacklo_epi32(p, zero));
+        acc_qq = _mm_add_epi64(acc_qq, _mm_unpackhi_epi32(p, zero));
+
+        p = _mm_madd_epi16(vi, sw);
+        acc_iq = _mm_add_epi64(acc_iq, _mm_unpacklo_epi32(p, _mm_srai_epi32(p, 31)));
+        acc_iq = _mm_add_epi64(acc_iq, _mm_unpackhi_epi32(p, _mm_srai_epi32(p, 31)));
+    }
+
+    {
+        int64_t lanes[2];
+
+        _mm_storeu_si128((__m128i *)lanes, acc_i);
+        sum_i = lanes[0] + lanes[1];
+        _mm_storeu_si128((__m128i *)lanes, acc_q);
+        sum_q = lanes[0] + lanes[1];
+        _mm_storeu_si128((__m128i *)lanes, acc_ii);
+        sum_ii = (uint64_t)lanes[0] + (uint64_t)lanes[1];
+        _mm_storeu_si128((__m128i *)lanes, acc_qq);
+        sum_qq = (uint64_t)lanes[0] + (uint64_t)lanes[1];
+        _mm_storeu_si128((__m128i *)lanes, acc_iq);
+        sum_iq = lanes[0] + lanes[1];
+    }
+#elif (defined DSP_USE_NEON)
+    int64x2_t acc_i = vdupq_n_s64(0);
+    int64x2_t acc_q = vdupq_n_s64(0);
+    uint64x2_t acc_ii = vdupq_n_u64(0);
+    uint64x2_t acc_qq = vdupq_n_u64(0);
+    int64x2_t acc_iq = vdupq_n_s64(0);
+
+    /* 8 I/Q pairs per iteration, vld2 splits I and Q */
+    for (i = 0; (i + 8) <= num_samples; i += 8)
+    {
+        int16x8x2_t v = vld2q_s16(&p_iq[2 * i]);
+        int16x4_t il = vget_low_s16(v.val[0]);
+        int16x4_t ih = vget_high_s16(v.val[0]);
+        int16x4_t ql = vget_low_s16(v.val[1]);
+        int16x4_t qh = vget_high_s16(v.val[1]);
+
+        acc_i = vpadalq_s32(acc_i, vpaddlq_s16(v.val[0]));
+        acc_q = vpadalq_s32(acc_q, vpaddlq_s16(v.val[1]));
+
+        acc_ii = vpadalq_u32(acc_ii, vreinterpretq_u32_s32(vmull_s16(il, il)));
+        acc_ii = vpadalq_u32(acc_ii, vreinterpretq_u32_s32(vmull_s16(ih, ih)));
+        acc_qq = vpadalq_u32(acc_qq, vreinterpretq_u32_s32(vmull_s16(ql, ql)));
+        acc_qq = vpadalq_u32(acc_qq, vreinterpretq_u32_s32(vmull_s16(qh, qh)));
+
+        acc_iq = vpadalq_s32(acc_iq, vmull_s16(il, ql));
+        acc_iq = vpadalq_s32(acc_iq, vmull_s16(ih, qh));
+    }
+
+    sum_i = vgetq_lane_s64(acc_i, 0) + vgetq_lane_s64(acc_i, 1);
+    sum_q = vgetq_lane_s64(acc_q, 0) + vgetq_lane_s64(acc_q, 1);
+    sum_ii = vgetq_lane_u64(acc_ii, 0) + vgetq_lane_u64(acc_ii, 1);
+    sum_qq = vgetq_lane_u64(acc_qq, 0) + vgetq_lane_u64(acc_qq, 1);
+    sum_iq = vgetq_lane_s64(acc_iq, 0) + vgetq_lane_s64(acc_iq, 1);
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        int32_t re = p_iq[2 * i];
+        int32_t im = p_iq[2 * i + 1];
+
+        sum_i += re;
+        sum_q += im;
+        sum_ii += (uint64_t)(re * re);
+        sum_qq += (uint64_t)(im * im);
+        sum_iq += (int64_t)(re * im);
+    }
+
+    p_moments->sum_i += sum_i;
+    p_moments->sum_q += sum_q;
+    p_moments->sum_ii += sum_ii;
+    p_moments->sum_qq += sum_qq;
+    p_moments->sum_iq += sum_iq;
+    p_moments->count += num_samples;
+}
+
+/*****************************************************************************/
+/** Estimates the correction.  With I as the reference, the part of Q that 
+ *  is correlated with I is removed (phase error) and what is left is scaled 
+ *  to the power of I (gain error).
+
+    @param p_moments    sums accumulated over the capture
+    @param p_corr       the estimated correction
+    @return void
+*/
+void iq_correction_estimate(const struct iq_moments *p_moments, struct iq_correction *p_corr)
+{
+    double n = (double)p_moments->count;
+    double mean_i = 0;
+    double mean_q = 0;
+    double var_i = 0;
+    double var_q = 0;
+    double cov = 0;
+    double var_q_orth = 0;
+    double rho = 0;
+    double gain = 0;
+
+    *p_corr = (struct iq_correction) IQ_CORRECTION_INITIALIZER;
+
+    if (p_moments->count == 0)
+    {
+        return;
+    }
+
+    mean_i = p_moments->sum_i / n;
+    mean_q = p_moments->sum_q / n;
+    var_i = (p_moments->sum_ii / n) - (mean_i * mean_i);
+    var_q = (p_moments->sum_qq / n) - (mean_q * mean_q);
+    cov = (p_moments->sum_iq / n) - (mean_i * mean_q);
+
+    p_corr->dc_i = (float)mean_i;
+    p_corr->dc_q = (float)mean_q;
+
+    if (var_i <= 0)
+    {
+        return;
+    }
+
+    rho = cov / var_i;
+    var_q_orth = var_q - (cov * rho);
+    if (var_q_orth <= 0)
+    {
+        return;
+    }
+
+    gain = sqrt(var_i / var_q_orth);
+    p_corr->gain_qq = (float)gain;
+    p_corr->cross_qi = (float)(-rho * gain);
+}
+
+/*****************************************************************************/
+/** Converts int16 I/Q to float with the correction and scale folded into 
+ *  one multiply-add per value.
+
+    @param p_dst        interleaved float I/Q
+    @param p_src        interleaved int16 I/Q
+    @param num_samples  number of I/Q pairs
+    @param scale        applied to every output value
+    @param p_corr       correction to apply
+    @return void
+*/
+void iq_to_float_corrected(float *p_dst, const int16_t *p_src, uint32_t num_samples, 
+                           float scale, const struct iq_correction *p_corr)
+{
+    uint32_t i = 0;
+    float ii = scale;
+    float qq = scale * p_corr->gain_qq;
+    float qi = scale * p_corr->cross_qi;
+
+#if (defined DSP_USE_SSE2)
+    __m128 dc = _mm_set_ps(p_corr->dc_q, p_corr->dc_i, p_corr->dc_q, p_corr->dc_i);
+    __m128 m_direct = _mm_set_ps(qq, ii, qq, ii);
+    __m128 m_cross = _mm_set_ps(qi, 0.0f, qi, 0.0f);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&p_src[2 * i]);
+        /* sign extend to 32 bits by placing each value in the upper half */
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        __m128 sw;
+
+        lo = _mm_sub_ps(lo, dc);
+        sw = _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1));
+        lo = _mm_add_ps(_mm_mul_ps(lo, m_direct), _mm_mul_ps(sw, m_cross));
+        _mm_storeu_ps(&p_dst[2 * i], lo);
+
+        hi = _mm_sub_ps(hi, dc);
+        sw = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 3, 0, 1));
+        hi = _mm_add_ps(_mm_mul_ps(hi, m_direct), _mm_mul_ps(sw, m_cross));
+        _mm_storeu_ps(&p_dst[2 * i + 4], hi);
+    }
+#elif (defined DSP_USE_NEON)
+    float32x4_t dc_i = vdupq_n_f32(p_corr->dc_i);
+    float32x4_t dc_q = vdupq_n_f32(p_corr->dc_q);
+
+    /* 4 I/Q pairs per iteration, vld2/vst2 split and merge I and Q */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        int16x4x2_t v = vld2_s16(&p_src[2 * i]);
+        float32x4_t fi = vsubq_f32(vcvtq_f32_s32(vmovl_s16(v.val[0])), dc_i);
+        float32x4_t fq = vsubq_f32(vcvtq_f32_s32(vmovl_s16(v.val[1])), dc_q);
+        float32x4x2_t out;
+
+        out.val[0] = vmulq_n_f32(fi, ii);
+        out.val[1] = vmlaq_n_f32(vmulq_n_f32(fq, qq), fi, qi);
+        vst2q_f32(&p_dst[2 * i], out);
+    }
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float fi = p_src[2 * i] - p_corr->dc_i;
+        float fq = p_src[2 * i + 1] - p_corr->dc_q;
+
+        p_dst[2 * i] = fi * ii;
+        p_dst[2 * i + 1] = (fq * qq) + (fi * qi);
+    }
+}
+
+/*****************************************************************************/
+/** Unpacks up to one group of 3 packed words, 4 I/Q pairs.
+
+    @param p_dst        interleaved int16 I/Q
+    @param p_src        the 3 packed words
+    @param num_samples  number of I/Q pairs to unpack, at most 4
+    @return void
+*/
+static void unpack12_group(int16_t *p_dst, const uint32_t *p_src, uint32_t num_samples)
+{
+    uint32_t w0 = p_src[0];
+    uint32_t w1 = (num_samples > 1) ? p_src[1] : 0;
+    uint32_t w2 = (num_samples > 2) ? p_src[2] : 0;
+    int16_t fields[8];
+    uint32_t i;
+
+    /* shifting the field to the top and back down sign extends it */
+    fields[0] = (int16_t)((int32_t)w0 >> 20);
+    fields[1] = (int16_t)((int32_t)(w0 << 12) >> 20);
+    fields[2] = (int16_t)(((int32_t)(w0 << 24) >> 20) | (w1 >> 28));
+    fields[3] = (int16_t)((int32_t)(w1 << 4) >> 20);
+    fields[4] = (int16_t)((int32_t)(w1 << 16) >> 20);
+    fields[5] = (int16_t)(((int32_t)(w1 << 28) >> 20) | (w2 >> 24));
+    fields[6] = (int16_t)((int32_t)(w2 << 8) >> 20);
+    fields[7] = (int16_t)((int32_t)(w2 << 20) >> 20);
+
+    for (i = 0; i < (2 * num_samples); i++)
+    {
+        p_dst[i] = fields[i];
+    }
+}
+
+/*****************************************************************************/
+/** Unpacks 12 bit I/Q.  4 groups of 3 words are handled per iteration: the 
+ *  words are split so each vector holds the same word of the 4 groups, the 
+ *  fields are extracted with shifts, and the I/Q pairs of each group are 
+ *  transposed back into sample order.
+
+    @param p_dst        interleaved int16 I/Q
+    @param p_src        packed words
+    @param num_samples  number of I/Q pairs to unpack
+    @return void
+*/
+void iq_unpack12(int16_t *p_dst, const uint32_t *p_src, uint32_t num_samples)
+{
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128i mask = _mm_set1_epi32(0xFFFF);
+
+    for (i = 0; (i + 16) <= num_samples; i += 16)
+    {
+        const uint32_t *p_words = &p_src[(i / 4) * 3];
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)&p_words[0]));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)&p_words[4]));
+        __m128 c = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)&p_words[8]));
+        __m128 t;
+        __m128i w0, w1, w2;
+        __m128i f_i, f_q;
+        __m128 p0, p1, p2, p3;
+
+        /* a = g0w0 g0w1 g0w2 g1w0, b = g1w1 g1w2 g2w0 g2w1, c = g2w2 g3w0 g3w1 g3w2 */
+        t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+        w0 = _mm_castps_si128(_mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0)));
+        w1 = _mm_castps_si128(_mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                             _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                                             _MM_SHUFFLE(2, 0, 2, 0)));
+        w2 = _mm_castps_si128(_mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, 
+                                             _MM_SHUFFLE(3, 0, 2, 0)));
+
+        /* each pair becomes one 32 bit value, I in the low half */
+        f_i = _mm_srai_epi32(w0, 20);
+        f_q = _mm_srai_epi32(_mm_slli_epi32(w0, 12), 20);
+        p0 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(f_i, mask), _mm_slli_epi32(f_q, 16)));
+
+        f_i = _mm_or_si128(_mm_srai_epi32(_mm_slli_epi32(w0, 24), 20), _mm_srli_epi32(w1, 28));
+        f_q = _mm_srai_epi32(_mm_slli_epi32(w1, 4), 20);
+        p1 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(f_i, mask), _mm_slli_epi32(f_q, 16)));
+
+        f_i = _mm_srai_epi32(_mm_slli_epi32(w1, 16), 20);
+        f_q = _mm_or_si128(_mm_srai_epi32(_mm_slli_epi32(w1, 28), 20), _mm_srli_epi32(w2, 24));
+        p2 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(f_i, mask), _mm_slli_epi32(f_q, 16)));
+
+        f_i = _mm_srai_epi32(_mm_slli_epi32(w2, 8), 20);
+        f_q = _mm_srai_epi32(_mm_slli_epi32(w2, 20), 20);
+        p3 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(f_i, mask), _mm_slli_epi32(f_q, 16)));
+
+        /* rows become groups */
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        _mm_storeu_ps((float *)&p_dst[2 * i], p0);
+        _mm_storeu_ps((float *)&p_dst[2 * i + 8], p1);
+        _mm_storeu_ps((float *)&p_dst[2 * i + 16], p2);
+        _mm_storeu_ps((float *)&p_dst[2 * i + 24], p3);
+    }
+#elif (defined DSP_USE_NEON)
+    uint32x4_t mask = vdupq_n_u32(0xFFFF);
+
+    for (i = 0; (i + 16) <= num_samples; i += 16)
+    {
+        /* vld3 puts the same word of 4 groups in each vector */
+        uint32x4x3_t w = vld3q_u32(&p_src[(i / 4) * 3]);
+        uint32x4x4_t p;
+        uint32x4_t f_i, f_q;
+
+        f_i = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(w.val[0]), 20));
+        f_q = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[0], 12)), 20));
+        p.val[0] = vorrq_u32(vandq_u32(f_i, mask), vshlq_n_u32(f_q, 16));
+
+        f_i = vorrq_u32(vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[0], 24)), 20)),
+                        vshrq_n_u32(w.val[1], 28));
+        f_q = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[1], 4)), 20));
+        p.val[1] = vorrq_u32(vandq_u32(f_i, mask), vshlq_n_u32(f_q, 16));
+
+        f_i = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[1], 16)), 20));
+        f_q = vorrq_u32(vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[1], 28)), 20)),
+                        vshrq_n_u32(w.val[2], 24));
+        p.val[2] = vorrq_u32(vandq_u32(f_i, mask), vshlq_n_u32(f_q, 16));
+
+        f_i = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[2], 8)), 20));
+        f_q = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(w.val[2], 20)), 20));
+        p.val[3] = vorrq_u32(vandq_u32(f_i, mask), vshlq_n_u32(f_q, 16));
+
+        /* vst4 interleaves the pairs back into sample order */
+        vst4q_u32((uint32_t *)&p_dst[2 * i], p);
+    }
+#endif
+
+    /* remaining groups */
+    for (; i < num_samples; i += 4)
+    {
+        uint32_t count = ((num_samples - i) < 4) ? (num_samples - i) : 4;
+
+        unpack12_group(&p_dst[2 * i], &p_src[(i / 4) * 3], count);
+    }
+}
+
+/*****************************************************************************/
+/** Converts a frequency to a phase increment.
+
+    @param freq         tone frequency in Hz
+    @param sample_rate  sample rate in Hz
+    @return phase increment per sample
+*/
+uint32_t nco_phase_inc(double freq, double sample_rate)
+{
+    /* negative frequencies wrap to the top of the range */
+    return (uint32_t)(int64_t)llround((freq / sample_rate) * 4294967296.0);
+}
+
+#if (defined DSP_USE_SSE2)
+/*****************************************************************************/
+/** cos and sin of 4 NCO phases, see nco_sincos()
+
+    @param ph           the phases
+    @param p_re         cos of the phases
+    @param p_im         sin of the phases
+    @return void
+*/
+static inline void nco_sincos_sse2(__m128i ph, __m128 *p_re, __m128 *p_im)
+{
+    __m128i one = _mm_set1_epi32(1);
+    __m128i two = _mm_set1_epi32(2);
+    __m128i sign = _mm_set1_epi32((int32_t)0x80000000);
+    __m128i centered = _mm_add_epi32(ph, _mm_set1_epi32(NCO_EIGHTH));
+    __m128i quad = _mm_srli_epi32(centered, 30);
+    __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(centered, 
+                        _mm_set1_epi32(NCO_QUARTER - 1)), _mm_set1_epi32(NCO_EIGHTH))), 
+                        _mm_set1_ps(NCO_RADIANS_PER_STEP));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 s, c, swap, re, im;
+
+    s = _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(NCO_SIN_C3)), _mm_set1_ps(NCO_SIN_C2));
+    s = _mm_add_ps(_mm_mul_ps(x2, s), _mm_set1_ps(NCO_SIN_C1));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(x2, x), s), x);
+
+    c = _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(NCO_COS_C3)), _mm_set1_ps(NCO_COS_C2));
+    c = _mm_add_ps(_mm_mul_ps(x2, c), _mm_set1_ps(NCO_COS_C1));
+    c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(x2, x2), c), 
+                   _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, _mm_set1_ps(0.5f))));
+
+    /* odd quadrants swap cos and sin, quadrants 1 and 2 negate cos, 2 and 3 negate sin */
+    swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quad, one), one));
+    re = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    im = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    *p_re = _mm_xor_ps(re, _mm_castsi128_ps(_mm_and_si128(sign, 
+                _mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(quad, one), two), two))));
+    *p_im = _mm_xor_ps(im, _mm_castsi128_ps(_mm_and_si128(sign, 
+                _mm_cmpeq_epi32(_mm_and_si128(quad, two), two))));
+}
+#elif (defined DSP_USE_NEON)
+/*****************************************************************************/
+/** cos and sin of 4 NCO phases, see nco_sincos()
+
+    @param ph           the phases
+    @param p_re         cos of the phases
+    @param p_im         sin of the phases
+    @return void
+*/
+static inline void nco_sincos_neon(uint32x4_t ph, float32x4_t *p_re, float32x4_t *p_im)
+{
+    uint32x4_t eighth = vdupq_n_u32(NCO_EIGHTH);
+    uint32x4_t one = vdupq_n_u32(1);
+    uint32x4_t two = vdupq_n_u32(2);
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t centered = vaddq_u32(ph, eighth);
+    uint32x4_t quad = vshrq_n_u32(centered, 30);
+    float32x4_t x = vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(
+                        vsubq_u32(vandq_u32(centered, vdupq_n_u32(NCO_QUARTER - 1)), eighth))), 
+                        NCO_RADIANS_PER_STEP);
+    float32x4_t x2 = vmulq_f32(x, x);
+    float32x4_t s, c, re, im;
+    uint32x4_t swap;
+
+    s = vmlaq_n_f32(vdupq_n_f32(NCO_SIN_C2), x2, NCO_SIN_C3);
+    s = vmlaq_f32(vdupq_n_f32(NCO_SIN_C1), x2, s);
+    s = vmlaq_f32(x, vmulq_f32(x2, x), s);
+
+    c = vmlaq_n_f32(vdupq_n_f32(NCO_COS_C2), x2, NCO_COS_C3);
+    c = vmlaq_f32(vdupq_n_f32(NCO_COS_C1), x2, c);
+    c = vmlaq_f32(vmlsq_n_f32(vdupq_n_f32(1.0f), x2, 0.5f), vmulq_f32(x2, x2), c);
+
+    /* odd quadrants swap cos and sin, quadrants 1 and 2 negate cos, 2 and 3 negate sin */
+    swap = vceqq_u32(vandq_u32(quad, one), one);
+    re = vbslq_f32(swap, s, c);
+    im = vbslq_f32(swap, c, s);
+    *p_re = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(re), 
+                vandq_u32(sign, vceqq_u32(vandq_u32(vaddq_u32(quad, one), two), two))));
+    *p_im = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(im), 
+                vandq_u32(sign, vceqq_u32(vandq_u32(quad, two), two))));
+}
+#endif
+
+/*****************************************************************************/
+/** cos and sin of an NCO phase.  The phase is split into a quadrant and an 
+ *  angle within +/- pi/4, the angle is evaluated with short polynomials, and 
+ *  the quadrant swaps and negates the results.
+
+    @param phase        the phase, the full 32 bit range is one cycle
+    @param p_re         cos of the phase
+    @param p_im         sin of the phase
+    @return void
+*/
+static inline void nco_sincos(uint32_t phase, float *p_re, float *p_im)
+{
+    uint32_t centered = phase + NCO_EIGHTH;
+    uint32_t quad = centered >> 30;
+    float x = (float)(int32_t)((centered & (NCO_QUARTER - 1)) - NCO_EIGHTH) * NCO_RADIANS_PER_STEP;
+    float x2 = x * x;
+    float s = x + (x2 * x) * (NCO_SIN_C1 + x2 * (NCO_SIN_C2 + x2 * NCO_SIN_C3));
+    float c = (1.0f - 0.5f * x2) + (x2 * x2) * (NCO_COS_C1 + x2 * (NCO_COS_C2 + x2 * NCO_COS_C3));
+    float re = (quad & 1) ? s : c;
+    float im = (quad & 1) ? c : s;
+
+    *p_re = ((quad + 1) & 2) ? -re : re;
+    *p_im = (quad & 2) ? -im : im;
+}
+
+/*****************************************************************************/
+/** Generates a tone with nco_sincos() 4 samples at a time.
+
+    @param p_iq         interleaved I/Q
+    @param num_samples  number of I/Q pairs
+    @param p_phase      phase of the first sample, updated for the next call
+    @param phase_inc    phase increment per sample
+    @param amplitude    peak amplitude
+    @return void
+*/
+void nco_tone(int16_t *p_iq, uint32_t num_samples, uint32_t *p_phase, uint32_t phase_inc, 
+              float amplitude)
+{
+    uint32_t i = 0;
+    uint32_t phase = *p_phase;
+
+#if (defined DSP_USE_SSE2)
+    __m128i ph = _mm_set_epi32((int32_t)(phase + 3 * phase_inc), (int32_t)(phase + 2 * phase_inc), 
+                               (int32_t)(phase + phase_inc), (int32_t)phase);
+    __m128i step = _mm_set1_epi32((int32_t)(phase_inc * 4));
+    __m128 amp = _mm_set1_ps(amplitude);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128 re, im;
+        __m128i i32, q32;
+
+        nco_sincos_sse2(ph, &re, &im);
+
+        /* round, interleave and saturate to int16 */
+        i32 = _mm_cvtps_epi32(_mm_mul_ps(re, amp));
+        q32 = _mm_cvtps_epi32(_mm_mul_ps(im, amp));
+        _mm_storeu_si128((__m128i *)&p_iq[2 * i], 
+                         _mm_packs_epi32(_mm_unpacklo_epi32(i32, q32), _mm_unpackhi_epi32(i32, q32)));
+
+        ph = _mm_add_epi32(ph, step);
+    }
+    phase += i * phase_inc;
+#elif (defined DSP_USE_NEON)
+    uint32_t first[4] = { phase, phase + phase_inc, phase + 2 * phase_inc, phase + 3 * phase_inc };
+    uint32x4_t ph = vld1q_u32(first);
+    uint32x4_t step = vdupq_n_u32(phase_inc * 4);
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        float32x4_t re, im;
+        int16x4x2_t out;
+
+        nco_sincos_neon(ph, &re, &im);
+
+        /* round away from zero, saturate to int16 and interleave */
+        re = vmulq_n_f32(re, amplitude);
+        im = vmulq_n_f32(im, amplitude);
+        re = vaddq_f32(re, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(re)))));
+        im = vaddq_f32(im, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(im)))));
+        out.val[0] = vqmovn_s32(vcvtq_s32_f32(re));
+        out.val[1] = vqmovn_s32(vcvtq_s32_f32(im));
+        vst2_s16(&p_iq[2 * i], out);
+
+        ph = vaddq_u32(ph, step);
+    }
+    phase += i * phase_inc;
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float re, im;
+        long val;
+
+        nco_sincos(phase, &re, &im);
+
+        val = lrintf(re * amplitude);
+        p_iq[2 * i] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+        val = lrintf(im * amplitude);
+        p_iq[2 * i + 1] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+
+        phase += phase_inc;
+    }
+
+    *p_phase = phase;
+}
+
+/*****************************************************************************/
+/** Generates two tones with nco_sincos(), 4 samples of each per iteration so
+ *  the two channels of a block are written in one pass.
+
+    @param p_iq_a       interleaved I/Q of the first channel
+    @param p_iq_b       interleaved I/Q of the second channel
+    @param num_samples  number of I/Q pairs of each
+    @param p_a          first tone, phase updated for the next call
+    @param p_b          second tone, phase updated for the next call
+    @return void
+*/
+void nco_tone_dual(int16_t *p_iq_a, int16_t *p_iq_b, uint32_t num_samples, 
+                   struct nco_channel *p_a, struct nco_channel *p_b)
+{
+    uint32_t i = 0;
+    uint32_t inc_a = p_a->phase_inc;
+    uint32_t inc_b = p_b->phase_inc;
+
+#if (defined DSP_USE_SSE2)
+    uint32_t phase_a = p_a->phase;
+    uint32_t phase_b = p_b->phase;
+    __m128i ph_a = _mm_set_epi32((int32_t)(phase_a + 3 * inc_a), (int32_t)(phase_a + 2 * inc_a), 
+                                 (int32_t)(phase_a + inc_a), (int32_t)phase_a);
+    __m128i ph_b = _mm_set_epi32((int32_t)(phase_b + 3 * inc_b), (int32_t)(phase_b + 2 * inc_b), 
+                                 (int32_t)(phase_b + inc_b), (int32_t)phase_b);
+    __m128i step_a = _mm_set1_epi32((int32_t)(inc_a * 4));
+    __m128i step_b = _mm_set1_epi32((int32_t)(inc_b * 4));
+    __m128 amp_a = _mm_set1_ps(p_a->amplitude);
+    __m128 amp_b = _mm_set1_ps(p_b->amplitude);
+
+    /* 4 I/Q pairs of each channel per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128 re_a, im_a, re_b, im_b;
+        __m128i i32, q32;
+
+        nco_sincos_sse2(ph_a, &re_a, &im_a);
+        nco_sincos_sse2(ph_b, &re_b, &im_b);
+
+        /* round, interleave and saturate to int16 */
+        i32 = _mm_cvtps_epi32(_mm_mul_ps(re_a, amp_a));
+        q32 = _mm_cvtps_epi32(_mm_mul_ps(im_a, amp_a));
+        _mm_storeu_si128((__m128i *)&p_iq_a[2 * i], 
+                         _mm_packs_epi32(_mm_unpacklo_epi32(i32, q32), _mm_unpackhi_epi32(i32, q32)));
+        i32 = _mm_cvtps_epi32(_mm_mul_ps(re_b, amp_b));
+        q32 = _mm_cvtps_epi32(_mm_mul_ps(im_b, amp_b));
+        _mm_storeu_si128((__m128i *)&p_iq_b[2 * i], 
+                         _mm_packs_epi32(_mm_unpacklo_epi32(i32, q32), _mm_unpackhi_epi32(i32, q32)));
+
+        ph_a = _mm_add_epi32(ph_a, step_a);
+        ph_b = _mm_add_epi32(ph_b, step_b);
+    }
+    p_a->phase += i * inc_a;
+    p_b->phase += i * inc_b;
+#elif (defined DSP_USE_NEON)
+    uint32_t phase_a = p_a->phase;
+    uint32_t phase_b = p_b->phase;
+    uint32_t first_a[4] = { phase_a, phase_a + inc_a, phase_a + 2 * inc_a, phase_a + 3 * inc_a };
+    uint32_t first_b[4] = { phase_b, phase_b + inc_b, phase_b + 2 * inc_b, phase_b + 3 * inc_b };
+    uint32x4_t ph_a = vld1q_u32(first_a);
+    uint32x4_t ph_b = vld1q_u32(first_b);
+    uint32x4_t step_a = vdupq_n_u32(inc_a * 4);
+    uint32x4_t step_b = vdupq_n_u32(inc_b * 4);
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+
+    /* 4 I/Q pairs of each channel per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        float32x4_t re_a, im_a, re_b, im_b;
+        int16x4x2_t out;
+
+        nco_sincos_neon(ph_a, &re_a, &im_a);
+        nco_sincos_neon(ph_b, &re_b, &im_b);
+
+        /* round away from zero, saturate to int16 and interleave */
+        re_a = vmulq_n_f32(re_a, p_a->amplitude);
+        im_a = vmulq_n_f32(im_a, p_a->amplitude);
+        re_a = vaddq_f32(re_a, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(re_a)))));
+        im_a = vaddq_f32(im_a, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(im_a)))));
+        out.val[0] = vqmovn_s32(vcvtq_s32_f32(re_a));
+        out.val[1] = vqmovn_s32(vcvtq_s32_f32(im_a));
+        vst2_s16(&p_iq_a[2 * i], out);
+
+        re_b = vmulq_n_f32(re_b, p_b->amplitude);
+        im_b = vmulq_n_f32(im_b, p_b->amplitude);
+        re_b = vaddq_f32(re_b, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(re_b)))));
+        im_b = vaddq_f32(im_b, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(im_b)))));
+        out.val[0] = vqmovn_s32(vcvtq_s32_f32(re_b));
+        out.val[1] = vqmovn_s32(vcvtq_s32_f32(im_b));
+        vst2_s16(&p_iq_b[2 * i], out);
+
+        ph_a = vaddq_u32(ph_a, step_a);
+        ph_b = vaddq_u32(ph_b, step_b);
+    }
+    p_a->phase += i * inc_a;
+    p_b->phase += i * inc_b;
+#endif
+
+    /* remaining samples */
+    if (i < num_samples)
+    {
+        nco_tone(&p_iq_a[2 * i], num_samples - i, &p_a->phase, inc_a, p_a->amplitude);
+        nco_tone(&p_iq_b[2 * i], num_samples - i, &p_b->phase, inc_b, p_b->amplitude);
+    }
+}
+
+/*****************************************************************************/
+/** Adds a tone to a float accumulator.  Rather than evaluating the 
+ *  polynomials for every sample, the 4 samples of a vector are rotated by 4 
+ *  phase steps with one complex multiply, and the vector is set from the 
+ *  exact phase every NCO_ROTATE_VECTORS so rounding in the rotation does not
+ *  build up.  The error compared to nco_sincos() stays far below the 
+ *  rounding to int16.
+
+    @param p_acc        interleaved float I/Q
+    @param num_samples  number of I/Q pairs
+    @param p_phase      phase of the first sample, updated for the next call
+    @param phase_inc    phase increment per sample
+    @param amplitude    peak amplitude
+    @return void
+*/
+void nco_tone_add(float *p_acc, uint32_t num_samples, uint32_t *p_phase, uint32_t phase_inc, 
+                  float amplitude)
+{
+    uint32_t i = 0;
+    uint32_t phase = *p_phase;
+
+#if (defined DSP_USE_SSE2)
+    __m128i ph = _mm_set_epi32((int32_t)(phase + 3 * phase_inc), (int32_t)(phase + 2 * phase_inc), 
+                               (int32_t)(phase + phase_inc), (int32_t)phase);
+    __m128i step = _mm_set1_epi32((int32_t)(phase_inc * 4));
+    __m128 amp = _mm_set1_ps(amplitude);
+    __m128 rot_re, rot_im;
+    __m128 re = _mm_setzero_ps();
+    __m128 im = _mm_setzero_ps();
+    uint32_t n = 0;
+
+    {
+        float c, s;
+
+        nco_sincos(phase_inc * 4, &c, &s);
+        rot_re = _mm_set1_ps(c);
+        rot_im = _mm_set1_ps(s);
+    }
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128 t;
+
+        if (n == 0)
+        {
+            nco_sincos_sse2(ph, &re, &im);
+            re = _mm_mul_ps(re, amp);
+            im = _mm_mul_ps(im, amp);
+            n = NCO_ROTATE_VECTORS;
+        }
+
+        _mm_storeu_ps(&p_acc[2 * i], _mm_add_ps(_mm_loadu_ps(&p_acc[2 * i]), 
+                      _mm_unpacklo_ps(re, im)));
+        _mm_storeu_ps(&p_acc[2 * i + 4], _mm_add_ps(_mm_loadu_ps(&p_acc[2 * i + 4]), 
+                      _mm_unpackhi_ps(re, im)));
+
+        t = _mm_sub_ps(_mm_mul_ps(re, rot_re), _mm_mul_ps(im, rot_im));
+        im = _mm_add_ps(_mm_mul_ps(re, rot_im), _mm_mul_ps(im, rot_re));
+        re = t;
+
+        ph = _mm_add_epi32(ph, step);
+        n--;
+    }
+    phase += i * phase_inc;
+#elif (defined DSP_USE_NEON)
+    uint32_t first[4] = { phase, phase + phase_inc, phase + 2 * phase_inc, phase + 3 * phase_inc };
+    uint32x4_t ph = vld1q_u32(first);
+    uint32x4_t step = vdupq_n_u32(phase_inc * 4);
+    float32x4_t re = vdupq_n_f32(0.0f);
+    float32x4_t im = vdupq_n_f32(0.0f);
+    float rot_re, rot_im;
+    uint32_t n = 0;
+
+    nco_sincos(phase_inc * 4, &rot_re, &rot_im);
+
+    /* 4 I/Q pairs per iteration, vld2/vst2 split and merge I and Q */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        float32x4x2_t acc = vld2q_f32(&p_acc[2 * i]);
+        float32x4_t t;
+
+        if (n == 0)
+        {
+            nco_sincos_neon(ph, &re, &im);
+            re = vmulq_n_f32(re, amplitude);
+            im = vmulq_n_f32(im, amplitude);
+            n = NCO_ROTATE_VECTORS;
+        }
+
+        acc.val[0] = vaddq_f32(acc.val[0], re);
+        acc.val[1] = vaddq_f32(acc.val[1], im);
+        vst2q_f32(&p_acc[2 * i], acc);
+
+        t = vmlsq_n_f32(vmulq_n_f32(re, rot_re), im, rot_im);
+        im = vmlaq_n_f32(vmulq_n_f32(im, rot_re), re, rot_im);
+        re = t;
+
+        ph = vaddq_u32(ph, step);
+        n--;
+    }
+    phase += i * phase_inc;
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float re, im;
+
+        nco_sincos(phase, &re, &im);
+        p_acc[2 * i] += re * amplitude;
+        p_acc[2 * i + 1] += im * amplitude;
+
+        phase += phase_inc;
+    }
+
+    *p_phase = phase;
+}
+
+/*****************************************************************************/
+/** Converts phases to I/Q with nco_sincos(), nco_tone() with the phase of 
+ *  every sample given rather than accumulated.
+
+    @param p_iq         interleaved I/Q
+    @param p_phase      phase of each sample
+    @param num_samples  number of I/Q pairs
+    @param amplitude    peak amplitude
+    @return void
+*/
+void nco_phase_iq(int16_t *p_iq, const uint32_t *p_phase, uint32_t num_samples, float amplitude)
+{
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128 amp = _mm_set1_ps(amplitude);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128 re, im;
+        __m128i i32, q32;
+
+        nco_sincos_sse2(_mm_loadu_si128((const __m128i *)&p_phase[i]), &re, &im);
+
+        /* round, interleave and saturate to int16 */
+        i32 = _mm_cvtps_epi32(_mm_mul_ps(re, amp));
+        q32 = _mm_cvtps_epi32(_mm_mul_ps(im, amp));
+        _mm_storeu_si128((__m128i *)&p_iq[2 * i], 
+                         _mm_packs_epi32(_mm_unpacklo_epi32(i32, q32), _mm_unpackhi_epi32(i32, q32)));
+    }
+#elif (defined DSP_USE_NEON)
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        float32x4_t re, im;
+        int16x4x2_t out;
+
+        nco_sincos_neon(vld1q_u32(&p_phase[i]), &re, &im);
+
+        /* round away from zero, saturate to int16 and interleave */
+        re = vmulq_n_f32(re, amplitude);
+        im = vmulq_n_f32(im, amplitude);
+        re = vaddq_f32(re, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(re)))));
+        im = vaddq_f32(im, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(im)))));
+        out.val[0] = vqmovn_s32(vcvtq_s32_f32(re));
+        out.val[1] = vqmovn_s32(vcvtq_s32_f32(im));
+        vst2_s16(&p_iq[2 * i], out);
+    }
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float re, im;
+        long val;
+
+        nco_sincos(p_phase[i], &re, &im);
+
+        val = lrintf(re * amplitude);
+        p_iq[2 * i] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+        val = lrintf(im * amplitude);
+        p_iq[2 * i + 1] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+    }
+}
+
+/*****************************************************************************/
+/** Polyphase interpolation.  The taps are stored with the phases of one tap
+ *  next to each other, so 4 phases are one vector of taps multiplied by the 
+ *  same input sample, no horizontal sums are needed.  The phases left over 
+ *  are done 2 at a time as I/Q of 2 phases, and an odd last phase as I/Q of
+ *  2 input samples.
+
+    @param p_out        interleaved float I/Q
+    @param p_x          interleaved float I/Q with num_taps - 1 samples of history
+    @param num_in       number of new input samples
+    @param p_coef       num_taps rows of num_phases taps
+    @param num_taps     taps per phase
+    @param num_phases   interpolation factor
+    @return void
+*/
+void fir_interp(float *p_out, const float *p_x, uint32_t num_in, const float *p_coef, 
+                uint32_t num_taps, uint32_t num_phases)
+{
+    uint32_t n = 0;
+    uint32_t first = 0;     // first phase left to the scalar loop
+    uint32_t p, j;
+
+#if (defined DSP_USE_SSE2)
+    for (n = 0; n < num_in; n++)
+    {
+        const float *p_win = &p_x[2 * n];
+        float *p_dst = &p_out[2 * n * num_phases];
+
+        /* 4 phases per iteration */
+        for (p = 0; (p + 4) <= num_phases; p += 4)
+        {
+            __m128 acc_i = _mm_setzero_ps();
+            __m128 acc_q = _mm_setzero_ps();
+
+            for (j = 0; j < num_taps; j++)
+            {
+                __m128 c = _mm_loadu_ps(&p_coef[j * num_phases + p]);
+
+                acc_i = _mm_add_ps(acc_i, _mm_mul_ps(c, _mm_set1_ps(p_win[2 * j])));
+                acc_q = _mm_add_ps(acc_q, _mm_mul_ps(c, _mm_set1_ps(p_win[2 * j + 1])));
+            }
+
+            _mm_storeu_ps(&p_dst[2 * p], _mm_unpacklo_ps(acc_i, acc_q));
+            _mm_storeu_ps(&p_dst[2 * p + 4], _mm_unpackhi_ps(acc_i, acc_q));
+        }
+
+        /* then 2 phases, the taps of each phase against I and Q */
+        for (; (p + 2) <= num_phases; p += 2)
+        {
+            /* odd and even taps are summed apart, one chain of adds would 
+               wait on the add latency */
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+
+            for (j = 0; j < num_taps; j++)
+            {
+                __m128 c = _mm_castpd_ps(_mm_load_sd((const double *)&p_coef[j * num_phases + p]));
+                __m128 x = _mm_castpd_ps(_mm_load1_pd((const double *)&p_win[2 * j]));
+                __m128 prod = _mm_mul_ps(_mm_unpacklo_ps(c, c), x);
+
+                if ((j & 1) == 0)
+                {
+                    acc0 = _mm_add_ps(acc0, prod);
+                }
+                else
+                {
+                    acc1 = _mm_add_ps(acc1, prod);
+                }
+            }
+
+            _mm_storeu_ps(&p_dst[2 * p], _mm_add_ps(acc0, acc1));
+        }
+    }
+
+    /* an odd last phase, one tap against I/Q of 2 input samples */
+    first = num_phases & ~1u;
+    n = num_in;
+    if (first < num_phases)
+    {
+        for (n = 0; (n + 2) <= num_in; n += 2)
+        {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+
+            for (j = 0; j < num_taps; j++)
+            {
+                __m128 prod = _mm_mul_ps(_mm_set1_ps(p_coef[j * num_phases + first]), 
+                                         _mm_loadu_ps(&p_x[2 * (n + j)]));
+
+                if ((j & 1) == 0)
+                {
+                    acc0 = _mm_add_ps(acc0, prod);
+                }
+                else
+                {
+                    acc1 = _mm_add_ps(acc1, prod);
+                }
+            }
+
+            acc0 = _mm_add_ps(acc0, acc1);
+            _mm_storel_pi((__m64 *)&p_out[2 * (n * num_phases + first)], acc0);
+            _mm_storeh_pi((__m64 *)&p_out[2 * ((n + 1) * num_phases + first)], acc0);
+        }
+    }
+#elif (defined DSP_USE_NEON)
+    for (n = 0; n < num_in; n++)
+    {
+        const float *p_win = &p_x[2 * n];
+        float *p_dst = &p_out[2 * n * num_phases];
+
+        /* 4 phases per iteration, vst2 interleaves I and Q */
+        for (p = 0; (p + 4) <= num_phases; p += 4)
+        {
+            float32x4x2_t acc;
+
+            acc.val[0] = vdupq_n_f32(0.0f);
+            acc.val[1] = vdupq_n_f32(0.0f);
+            for (j = 0; j < num_taps; j++)
+            {
+                float32x4_t c = vld1q_f32(&p_coef[j * num_phases + p]);
+
+                acc.val[0] = vmlaq_n_f32(acc.val[0], c, p_win[2 * j]);
+                acc.val[1] = vmlaq_n_f32(acc.val[1], c, p_win[2 * j + 1]);
+            }
+
+            vst2q_f32(&p_dst[2 * p], acc);
+        }
+
+        /* then 2 phases, the taps of each phase against I and Q */
+        for (; (p + 2) <= num_phases; p += 2)
+        {
+            /* odd and even taps are summed apart, as for SSE2 */
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+            for (j = 0; j < num_taps; j++)
+            {
+                float32x2_t c = vld1_f32(&p_coef[j * num_phases + p]);
+                float32x2_t x = vld1_f32(&p_win[2 * j]);
+                float32x4_t cc = vcombine_f32(vdup_lane_f32(c, 0), vdup_lane_f32(c, 1));
+
+                if ((j & 1) == 0)
+                {
+                    acc0 = vmlaq_f32(acc0, cc, vcombine_f32(x, x));
+                }
+                else
+                {
+                    acc1 = vmlaq_f32(acc1, cc, vcombine_f32(x, x));
+                }
+            }
+
+            vst1q_f32(&p_dst[2 * p], vaddq_f32(acc0, acc1));
+        }
+    }
+
+    /* an odd last phase, one tap against I/Q of 2 input samples */
+    first = num_phases & ~1u;
+    n = num_in;
+    if (first < num_phases)
+    {
+        for (n = 0; (n + 2) <= num_in; n += 2)
+        {
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+            for (j = 0; j < num_taps; j++)
+            {
+                float32x4_t x = vld1q_f32(&p_x[2 * (n + j)]);
+
+                if ((j & 1) == 0)
+                {
+                    acc0 = vmlaq_n_f32(acc0, x, p_coef[j * num_phases + first]);
+                }
+                else
+                {
+                    acc1 = vmlaq_n_f32(acc1, x, p_coef[j * num_phases + first]);
+                }
+            }
+
+            acc0 = vaddq_f32(acc0, acc1);
+            vst1_f32(&p_out[2 * (n * num_phases + first)], vget_low_f32(acc0));
+            vst1_f32(&p_out[2 * ((n + 1) * num_phases + first)], vget_high_f32(acc0));
+        }
+    }
+#endif
+
+    /* every phase without SIMD, otherwise the odd last phase of an odd 
+       number of input samples */
+    for (; n < num_in; n++)
+    {
+        const float *p_win = &p_x[2 * n];
+        float *p_dst = &p_out[2 * n * num_phases];
+
+        for (p = first; p < num_phases; p++)
+        {
+            float acc_i = 0.0f;
+            float acc_q = 0.0f;
+
+            for (j = 0; j < num_taps; j++)
+            {
+                acc_i += p_coef[j * num_phases + p] * p_win[2 * j];
+                acc_q += p_coef[j * num_phases + p] * p_win[2 * j + 1];
+            }
+
+            p_dst[2 * p] = acc_i;
+            p_dst[2 * p + 1] = acc_q;
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Tracks the peaks and the power of float I/Q.  The power is summed in 
+ *  float per block and added to the double total, plenty for a crest factor.
+
+    @param p_iq         interleaved float I/Q
+    @param num_samples  number of I/Q pairs
+    @param p_range      accumulated peaks and power
+    @return void
+*/
+void iq_float_range(const float *p_iq, uint32_t num_samples, struct iq_float_range *p_range)
+{
+    uint32_t i = 0;
+    float max_abs = p_range->max_abs;
+    float max_power = p_range->max_power;
+    float sum = 0.0f;
+
+#if (defined DSP_USE_SSE2)
+    __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vmax_abs = _mm_setzero_ps();
+    __m128 vmax_power = _mm_setzero_ps();
+    __m128 vsum = _mm_setzero_ps();
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(&p_iq[2 * i]);
+        __m128 b = _mm_loadu_ps(&p_iq[2 * i + 4]);
+        __m128 sq_a = _mm_mul_ps(a, a);
+        __m128 sq_b = _mm_mul_ps(b, b);
+        /* I*I + Q*Q of the 4 pairs */
+        __m128 p = _mm_add_ps(_mm_shuffle_ps(sq_a, sq_b, _MM_SHUFFLE(2, 0, 2, 0)), 
+                              _mm_shuffle_ps(sq_a, sq_b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        vmax_abs = _mm_max_ps(vmax_abs, _mm_max_ps(_mm_and_ps(a, abs_mask), 
+                                                   _mm_and_ps(b, abs_mask)));
+        vmax_power = _mm_max_ps(vmax_power, p);
+        vsum = _mm_add_ps(vsum, p);
+    }
+
+    {
+        float lanes[4];
+        int j;
+
+        _mm_storeu_ps(lanes, vmax_abs);
+        for (j = 0; j < 4; j++)
+        {
+            max_abs = (lanes[j] > max_abs) ? lanes[j] : max_abs;
+        }
+        _mm_storeu_ps(lanes, vmax_power);
+        for (j = 0; j < 4; j++)
+        {
+            max_power = (lanes[j] > max_power) ? lanes[j] : max_power;
+        }
+        _mm_storeu_ps(lanes, vsum);
+        sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#elif (defined DSP_USE_NEON)
+    float32x4_t vmax_abs = vdupq_n_f32(0.0f);
+    float32x4_t vmax_power = vdupq_n_f32(0.0f);
+    float32x4_t vsum = vdupq_n_f32(0.0f);
+
+    /* 4 I/Q pairs per iteration, vld2 splits I and Q */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        float32x4x2_t v = vld2q_f32(&p_iq[2 * i]);
+        float32x4_t p = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+
+        vmax_abs = vmaxq_f32(vmax_abs, vmaxq_f32(vabsq_f32(v.val[0]), vabsq_f32(v.val[1])));
+        vmax_power = vmaxq_f32(vmax_power, p);
+        vsum = vaddq_f32(vsum, p);
+    }
+
+    {
+        float lanes[4];
+        int j;
+
+        vst1q_f32(lanes, vmax_abs);
+        for (j = 0; j < 4; j++)
+        {
+            max_abs = (lanes[j] > max_abs) ? lanes[j] : max_abs;
+        }
+        vst1q_f32(lanes, vmax_power);
+        for (j = 0; j < 4; j++)
+        {
+            max_power = (lanes[j] > max_power) ? lanes[j] : max_power;
+        }
+        vst1q_f32(lanes, vsum);
+        sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float re = p_iq[2 * i];
+        float im = p_iq[2 * i + 1];
+        float p = (re * re) + (im * im);
+
+        max_abs = (fabsf(re) > max_abs) ? fabsf(re) : max_abs;
+        max_abs = (fabsf(im) > max_abs) ? fabsf(im) : max_abs;
+        max_power = (p > max_power) ? p : max_power;
+        sum += p;
+    }
+
+    p_range->max_abs = max_abs;
+    p_range->max_power = max_power;
+    p_range->power_sum += sum;
+    p_range->count += num_samples;
+}
+
+/*****************************************************************************/
+/** Scales and converts float I/Q to int16, 8 values at a time.
+
+    @param p_dst        interleaved int16 I/Q
+    @param p_src        interleaved float I/Q
+    @param num_samples  number of I/Q pairs
+    @param scale        applied to every value
+    @return void
+*/
+void iq_float_to_int16(int16_t *p_dst, const float *p_src, uint32_t num_samples, float scale)
+{
+    uint32_t num_values = num_samples * 2;
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128 vscale = _mm_set1_ps(scale);
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&p_src[i]), vscale));
+        __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(&p_src[i + 4]), vscale));
+
+        _mm_storeu_si128((__m128i *)&p_dst[i], _mm_packs_epi32(lo, hi));
+    }
+#elif (defined DSP_USE_NEON)
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        float32x4_t lo = vmulq_n_f32(vld1q_f32(&p_src[i]), scale);
+        float32x4_t hi = vmulq_n_f32(vld1q_f32(&p_src[i + 4]), scale);
+
+        /* round away from zero and saturate to int16 */
+        lo = vaddq_f32(lo, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(lo)))));
+        hi = vaddq_f32(hi, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(hi)))));
+        vst1q_s16(&p_dst[i], vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)), 
+                                          vqmovn_s32(vcvtq_s32_f32(hi))));
+    }
+#endif
+
+    /* remaining values */
+    for (; i < num_values; i++)
+    {
+        long val = lrintf(p_src[i] * scale);
+
+        p_dst[i] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+    }
+}
+
+/*****************************************************************************/
+/** One step of the xoshiro128+ generator of a lane
+
+    @param p_rng        the generators
+    @param lane         generator to step
+    @return the next value, the upper bits are the random ones
+*/
+static inline uint32_t gauss_next(struct gauss_rng *p_rng, uint32_t lane)
+{
+    uint32_t result = p_rng->s[0][lane] + p_rng->s[3][lane];
+    uint32_t t = p_rng->s[1][lane] << 9;
+
+    p_rng->s[2][lane] ^= p_rng->s[0][lane];
+    p_rng->s[3][lane] ^= p_rng->s[1][lane];
+    p_rng->s[1][lane] ^= p_rng->s[2][lane];
+    p_rng->s[0][lane] ^= p_rng->s[3][lane];
+    p_rng->s[2][lane] ^= t;
+    p_rng->s[3][lane] = (p_rng->s[3][lane] << 11) | (p_rng->s[3][lane] >> 21);
+
+    return result;
+}
+
+#if (defined DSP_USE_SSE2)
+/*****************************************************************************/
+/** One step of the 4 xoshiro128+ generators, see gauss_next()
+
+    @param s            state words of the 4 lanes
+    @return the next values
+*/
+static inline __m128i gauss_next_sse2(__m128i *s)
+{
+    __m128i result = _mm_add_epi32(s[0], s[3]);
+    __m128i t = _mm_slli_epi32(s[1], 9);
+
+    s[2] = _mm_xor_si128(s[2], s[0]);
+    s[3] = _mm_xor_si128(s[3], s[1]);
+    s[1] = _mm_xor_si128(s[1], s[2]);
+    s[0] = _mm_xor_si128(s[0], s[3]);
+    s[2] = _mm_xor_si128(s[2], t);
+    s[3] = _mm_or_si128(_mm_slli_epi32(s[3], 11), _mm_srli_epi32(s[3], 21));
+
+    return result;
+}
+
+/*****************************************************************************/
+/** Natural log of 4 positive values.  The value is split into an exponent 
+ *  and a mantissa within sqrt(1/2) .. sqrt(2), whose log is a polynomial.
+
+    @param x            the values
+    @return log of the values
+*/
+static inline __m128 gauss_log_sse2(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), 
+                                             _mm_set1_epi32(0x3F000000)));
+    __m128 small = _mm_cmplt_ps(m, _mm_set1_ps(GAUSS_SQRTHF));
+    __m128 z, y;
+
+    /* m in 0.5 .. 1, below sqrt(1/2) it is doubled */
+    e = _mm_sub_ps(e, _mm_and_ps(small, one));
+    m = _mm_add_ps(_mm_sub_ps(m, one), _mm_and_ps(small, m));
+    z = _mm_mul_ps(m, m);
+
+    y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(GAUSS_LOG_P0), m), _mm_set1_ps(GAUSS_LOG_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P5));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P6));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P7));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(GAUSS_LOG_P8));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(GAUSS_LOG_Q1)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(GAUSS_LOG_Q2)));
+}
+#elif (defined DSP_USE_NEON)
+/*****************************************************************************/
+/** One step of the 4 xoshiro128+ generators, see gauss_next()
+
+    @param s            state words of the 4 lanes
+    @return the next values
+*/
+static inline uint32x4_t gauss_next_neon(uint32x4_t *s)
+{
+    uint32x4_t result = vaddq_u32(s[0], s[3]);
+    uint32x4_t t = vshlq_n_u32(s[1], 9);
+
+    s[2] = veorq_u32(s[2], s[0]);
+    s[3] = veorq_u32(s[3], s[1]);
+    s[1] = veorq_u32(s[1], s[2]);
+    s[0] = veorq_u32(s[0], s[3]);
+    s[2] = veorq_u32(s[2], t);
+    s[3] = vsriq_n_u32(vshlq_n_u32(s[3], 11), s[3], 21);
+
+    return result;
+}
+
+/*****************************************************************************/
+/** Natural log of 4 positive values, see gauss_log_sse2()
+
+    @param x            the values
+    @return log of the values
+*/
+static inline float32x4_t gauss_log_neon(float32x4_t x)
+{
+    uint32x4_t bits = vreinterpretq_u32_f32(x);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), 
+                                            vdupq_n_s32(126)));
+    float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), 
+                                                    vdupq_n_u32(0x3F000000)));
+    uint32x4_t small = vcltq_f32(m, vdupq_n_f32(GAUSS_SQRTHF));
+    float32x4_t z, y;
+
+    /* m in 0.5 .. 1, below sqrt(1/2) it is doubled */
+    e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(small, vreinterpretq_u32_f32(one))));
+    m = vaddq_f32(vsubq_f32(m, one), vreinterpretq_f32_u32(vandq_u32(small, 
+                                                        vreinterpretq_u32_f32(m))));
+    z = vmulq_f32(m, m);
+
+    y = vmlaq_n_f32(vdupq_n_f32(GAUSS_LOG_P1), m, GAUSS_LOG_P0);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P2), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P3), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P4), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P5), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P6), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P7), y, m);
+    y = vmlaq_f32(vdupq_n_f32(GAUSS_LOG_P8), y, m);
+    y = vmulq_f32(vmulq_f32(y, m), z);
+
+    y = vmlaq_n_f32(y, e, GAUSS_LOG_Q1);
+    y = vmlsq_n_f32(y, z, 0.5f);
+
+    return vmlaq_n_f32(vaddq_f32(m, y), e, GAUSS_LOG_Q2);
+}
+
+/*****************************************************************************/
+/** Square root of 4 positive values from the reciprocal square root 
+ *  estimate, ARMv7 has no vector square root
+
+    @param x            the values, greater than 0
+    @return square root of the values
+*/
+static inline float32x4_t gauss_sqrt_neon(float32x4_t x)
+{
+    float32x4_t r = vrsqrteq_f32(x);
+
+    /* 2 Newton steps are full float precision */
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(x, r), r));
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(x, r), r));
+
+    return vmulq_f32(x, r);
+}
+#endif
+
+/*****************************************************************************/
+/** Seeds the 4 generators from one value with splitmix64, which gives well
+ *  mixed states that are never all zero
+
+    @param p_rng        the generators
+    @param seed         any value
+    @return void
+*/
+void gauss_rng_seed(struct gauss_rng *p_rng, uint64_t seed)
+{
+    uint32_t w, lane;
+
+    for (w = 0; w < 4; w++)
+    {
+        for (lane = 0; lane < 4; lane += 2)
+        {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+
+            p_rng->s[w][lane] = (uint32_t)z;
+            p_rng->s[w][lane + 1] = (uint32_t)(z >> 32);
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Gaussian values by the Box-Muller transform, 8 at a time from the 4 
+ *  generators.  The radius sqrt(-2 log(u)) comes from 23 bits of one value
+ *  and the angle is the next value used as an NCO phase, so the cos and sin
+ *  are the same polynomials as the tones.  u is never below 2^-24, which 
+ *  cuts the tails at 5.8 sigma.
+
+    @param p_out        gaussian values
+    @param num_values   number of values
+    @param sigma        standard deviation
+    @param p_rng        the generators
+    @return void
+*/
+void gauss_fill(float *p_out, uint32_t num_values, float sigma, struct gauss_rng *p_rng)
+{
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128i s[4];
+    __m128 vsigma = _mm_set1_ps(sigma);
+    uint32_t w;
+
+    for (w = 0; w < 4; w++)
+    {
+        s[w] = _mm_loadu_si128((const __m128i *)p_rng->s[w]);
+    }
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        __m128 u = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(gauss_next_sse2(s), 9)), 
+                                         _mm_set1_ps(GAUSS_UNIFORM_STEP)), 
+                              _mm_set1_ps(GAUSS_UNIFORM_STEP / 2));
+        __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_mul_ps(gauss_log_sse2(u), _mm_set1_ps(-2.0f))), 
+                              vsigma);
+        __m128 re, im;
+
+        nco_sincos_sse2(gauss_next_sse2(s), &re, &im);
+
+        _mm_storeu_ps(&p_out[i], _mm_mul_ps(r, re));
+        _mm_storeu_ps(&p_out[i + 4], _mm_mul_ps(r, im));
+    }
+
+    for (w = 0; w < 4; w++)
+    {
+        _mm_storeu_si128((__m128i *)p_rng->s[w], s[w]);
+    }
+#elif (defined DSP_USE_NEON)
+    uint32x4_t s[4];
+    uint32_t w;
+
+    for (w = 0; w < 4; w++)
+    {
+        s[w] = vld1q_u32(p_rng->s[w]);
+    }
+
+    /* 8 values per iteration */
+    for (i = 0; (i + 8) <= num_values; i += 8)
+    {
+        float32x4_t u = vmlaq_n_f32(vdupq_n_f32(GAUSS_UNIFORM_STEP / 2), 
+                                    vcvtq_f32_u32(vshrq_n_u32(gauss_next_neon(s), 9)), 
+                                    GAUSS_UNIFORM_STEP);
+        float32x4_t r = vmulq_n_f32(gauss_sqrt_neon(vmulq_n_f32(gauss_log_neon(u), -2.0f)), 
+                                    sigma);
+        float32x4_t re, im;
+
+        nco_sincos_neon(gauss_next_neon(s), &re, &im);
+
+        vst1q_f32(&p_out[i], vmulq_f32(r, re));
+        vst1q_f32(&p_out[i + 4], vmulq_f32(r, im));
+    }
+
+    for (w = 0; w < 4; w++)
+    {
+        vst1q_u32(p_rng->s[w], s[w]);
+    }
+#endif
+
+    /* remaining values, from the first generator */
+    for (; i < num_values; i += 2)
+    {
+        float u = ((float)(gauss_next(p_rng, 0) >> 9) * GAUSS_UNIFORM_STEP) + 
+            (GAUSS_UNIFORM_STEP / 2);
+        float r = sqrtf(-2.0f * logf(u)) * sigma;
+        float re, im;
+
+        nco_sincos(gauss_next(p_rng, 0), &re, &im);
+
+        p_out[i] = r * re;
+        if ((i + 1) < num_values)
+        {
+            p_out[i + 1] = r * im;
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Impairs I/Q in place, the inverse of iq_to_float_corrected().  The 
+ *  imbalance is applied first, then the rotation by the phase of each 
+ *  sample and then the noise is added.
+
+    @param p_iq         interleaved I/Q, replaced by the impaired samples
+    @param num_samples  number of I/Q pairs
+    @param gain         applied to the signal, not the noise
+    @param p_imbalance  I/Q imbalance and DC offset
+    @param p_phase      rotation of each sample, NULL for none
+    @param p_noise      interleaved noise added to I/Q, NULL for none
+    @return void
+*/
+void iq_impair(int16_t *p_iq, uint32_t num_samples, float gain, 
+               const struct iq_correction *p_imbalance, const uint32_t *p_phase, 
+               const float *p_noise)
+{
+    float gain_ii = gain;
+    float gain_qq = gain * p_imbalance->gain_qq;
+    float cross_qi = gain * p_imbalance->cross_qi;
+    uint32_t i = 0;
+
+#if (defined DSP_USE_SSE2)
+    __m128 dc_i = _mm_set1_ps(p_imbalance->dc_i);
+    __m128 dc_q = _mm_set1_ps(p_imbalance->dc_q);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&p_iq[2 * i]);
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        __m128 re = _mm_sub_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), dc_i);
+        __m128 im = _mm_sub_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), dc_q);
+
+        im = _mm_add_ps(_mm_mul_ps(im, _mm_set1_ps(gain_qq)), _mm_mul_ps(re, _mm_set1_ps(cross_qi)));
+        re = _mm_mul_ps(re, _mm_set1_ps(gain_ii));
+
+        if (p_phase != NULL)
+        {
+            __m128 c, s, t;
+
+            nco_sincos_sse2(_mm_loadu_si128((const __m128i *)&p_phase[i]), &c, &s);
+            t = _mm_sub_ps(_mm_mul_ps(re, c), _mm_mul_ps(im, s));
+            im = _mm_add_ps(_mm_mul_ps(re, s), _mm_mul_ps(im, c));
+            re = t;
+        }
+
+        lo = _mm_unpacklo_ps(re, im);
+        hi = _mm_unpackhi_ps(re, im);
+        if (p_noise != NULL)
+        {
+            lo = _mm_add_ps(lo, _mm_loadu_ps(&p_noise[2 * i]));
+            hi = _mm_add_ps(hi, _mm_loadu_ps(&p_noise[2 * i + 4]));
+        }
+
+        /* round and saturate to int16 */
+        _mm_storeu_si128((__m128i *)&p_iq[2 * i], 
+                         _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+    }
+#elif (defined DSP_USE_NEON)
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    float32x4_t dc_i = vdupq_n_f32(p_imbalance->dc_i);
+    float32x4_t dc_q = vdupq_n_f32(p_imbalance->dc_q);
+
+    /* 4 I/Q pairs per iteration */
+    for (i = 0; (i + 4) <= num_samples; i += 4)
+    {
+        int16x4x2_t v = vld2_s16(&p_iq[2 * i]);
+        float32x4_t re = vsubq_f32(vcvtq_f32_s32(vmovl_s16(v.val[0])), dc_i);
+        float32x4_t im = vsubq_f32(vcvtq_f32_s32(vmovl_s16(v.val[1])), dc_q);
+
+        im = vmlaq_n_f32(vmulq_n_f32(im, gain_qq), re, cross_qi);
+        re = vmulq_n_f32(re, gain_ii);
+
+        if (p_phase != NULL)
+        {
+            float32x4_t c, s, t;
+
+            nco_sincos_neon(vld1q_u32(&p_phase[i]), &c, &s);
+            t = vmlsq_f32(vmulq_f32(re, c), im, s);
+            im = vmlaq_f32(vmulq_f32(re, s), im, c);
+            re = t;
+        }
+
+        if (p_noise != NULL)
+        {
+            float32x4x2_t noise = vld2q_f32(&p_noise[2 * i]);
+
+            re = vaddq_f32(re, noise.val[0]);
+            im = vaddq_f32(im, noise.val[1]);
+        }
+
+        /* round away from zero, saturate to int16 and interleave */
+        re = vaddq_f32(re, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(re)))));
+        im = vaddq_f32(im, vreinterpretq_f32_u32(vorrq_u32(half, 
+                    vandq_u32(sign, vreinterpretq_u32_f32(im)))));
+        v.val[0] = vqmovn_s32(vcvtq_s32_f32(re));
+        v.val[1] = vqmovn_s32(vcvtq_s32_f32(im));
+        vst2_s16(&p_iq[2 * i], v);
+    }
+#endif
+
+    /* remaining samples */
+    for (; i < num_samples; i++)
+    {
+        float re = p_iq[2 * i] - p_imbalance->dc_i;
+        float im = p_iq[2 * i + 1] - p_imbalance->dc_q;
+        long val;
+
+        im = (im * gain_qq) + (re * cross_qi);
+        re = re * gain_ii;
+
+        if (p_phase != NULL)
+        {
+            float c, s, t;
+
+            nco_sincos(p_phase[i], &c, &s);
+            t = (re * c) - (im * s);
+            im = (re * s) + (im * c);
+            re = t;
+        }
+
+        if (p_noise != NULL)
+        {
+            re += p_noise[2 * i];
+            im += p_noise[2 * i + 1];
+        }
+
+        val = lrintf(re);
+        p_iq[2 * i] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+        val = lrintf(im);
+        p_iq[2 * i + 1] = (int16_t)((val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val);
+    }
+}
+
+const char *dsp_kernels_cstr(void)
+{
+#if (defined DSP_USE_SSE2)
+    return "sse2";
+#elif (defined DSP_USE_NEON)
+    return "neon";
+#else
+    return "generic";
+#endif
+}
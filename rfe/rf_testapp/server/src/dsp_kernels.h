@@ -0,0 +1,452 @@
+/**
+ * @file dsp_kernels.h
+ *
+ * @brief
+ * Sample processing kernels shared by the signal analyzer and generator.
+ * Each kernel has an SSE2 (x86_64), NEON (ARM) and plain C implementation,
+ * the one used is selected at compile time.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+#ifndef __DSP_KERNELS_H__
+#define __DSP_KERNELS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* running min / max / clip count of the samples passed through iq_copy_range() */
+struct iq_range
+{
+    int16_t             min;                    // smallest I or Q value seen
+    int16_t             max;                    // largest I or Q value seen
+    uint32_t            clipped;                // I or Q values at or beyond the clip level
+};
+
+#define IQ_RANGE_INITIALIZER                                \
+{                                                           \
+    .min                    = INT16_MAX,                    \
+    .max                    = INT16_MIN,                    \
+    .clipped                = 0,                            \
+}                                                           \
+
+/* running sums used to estimate the DC offset and the I/Q imbalance */
+struct iq_moments
+{
+    int64_t             sum_i;                  // sum of I
+    int64_t             sum_q;                  // sum of Q
+    uint64_t            sum_ii;                 // sum of I*I
+    uint64_t            sum_qq;                 // sum of Q*Q
+    int64_t             sum_iq;                 // sum of I*Q
+    uint64_t            count;                  // number of I/Q pairs
+};
+
+#define IQ_MOMENTS_INITIALIZER                              \
+{                                                           \
+    .sum_i                  = 0,                            \
+    .sum_q                  = 0,                            \
+    .sum_ii                 = 0,                            \
+    .sum_qq                 = 0,                            \
+    .sum_iq                 = 0,                            \
+    .count                  = 0,                            \
+}                                                           \
+
+/* I' = (I - dc_i)
+ * Q' = (Q - dc_q) * gain_qq + (I - dc_i) * cross_qi 
+ * the initializer is no correction 
+ */
+struct iq_correction
+{
+    float               dc_i;                   // DC offset of I
+    float               dc_q;                   // DC offset of Q
+    float               gain_qq;                // Q amplitude correction
+    float               cross_qi;               // amount of I removed from Q (phase correction)
+};
+
+#define IQ_CORRECTION_INITIALIZER                           \
+{                                                           \
+    .dc_i                   = 0.0f,                         \
+    .dc_q                   = 0.0f,                         \
+    .gain_qq                = 1.0f,                         \
+    .cross_qi               = 0.0f,                         \
+}                                                           \
+
+/* peak and power of float I/Q passed through iq_float_range() */
+struct iq_float_range
+{
+    float               max_abs;                // largest magnitude of I or Q
+    float               max_power;              // largest I*I + Q*Q
+    double              power_sum;              // sum of I*I + Q*Q
+    uint64_t            count;                  // number of I/Q pairs
+};
+
+#define IQ_FLOAT_RANGE_INITIALIZER                          \
+{                                                           \
+    .max_abs                = 0.0f,                         \
+    .max_power              = 0.0f,                         \
+    .power_sum              = 0.0,                          \
+    .count                  = 0,                            \
+}                                                           \
+
+/* 4 xoshiro128+ generators, one per vector lane, set up by gauss_rng_seed() */
+struct gauss_rng
+{
+    uint32_t            s[4][4];                // state word, then lane
+};
+
+#define GAUSS_RNG_INITIALIZER                               \
+{                                                           \
+    .s                      = { { 0 } },                    \
+}                                                           \
+
+/* one of the two tones of nco_tone_dual() */
+struct nco_channel
+{
+    uint32_t            phase;                  // of the next sample
+    uint32_t            phase_inc;              // from nco_phase_inc()
+    float               amplitude;              // peak of I and Q
+};
+
+#define NCO_CHANNEL_INITIALIZER                             \
+{                                                           \
+    .phase                  = 0,                            \
+    .phase_inc              = 0,                            \
+    .amplitude              = 0.0f,                         \
+}                                                           \
+
+
+/*****************************************************************************/
+/** @brief
+    Copies a block of interleaved int16 I/Q samples while tracking the min, 
+    max and the number of values at or beyond +/- clip_level
+
+    @param[out]     p_dst:          destination of the samples
+    @param[in]      p_src:          interleaved I/Q samples
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in]      clip_level:     magnitude considered clipped
+    @param[in/out]  p_range:        updated with the min, max and clip count
+
+    @return         void
+
+    @note   p_range accumulates, so it must be set to IQ_RANGE_INITIALIZER 
+            before the first block of a capture.  p_dst may be p_src to only
+            track the range of samples already in place.
+*/
+extern void iq_copy_range(                      int16_t *p_dst,
+                                                const int16_t *p_src,
+                                                uint32_t num_samples,
+                                                int16_t clip_level,
+                                                struct iq_range *p_range);
+
+/*****************************************************************************/
+/** @brief
+    Sums the power (I*I + Q*Q) of a block of interleaved int16 I/Q samples
+
+    @param[in]      p_iq:           interleaved I/Q samples
+    @param[in]      num_samples:    number of I/Q pairs
+
+    @return         the sum of I*I + Q*Q over all the samples
+*/
+extern uint64_t iq_power_sum(                   const int16_t *p_iq,
+                                                uint32_t num_samples);
+
+/*****************************************************************************/
+/** @brief
+    Adds a block of interleaved int16 I/Q samples to the running moments
+
+    @param[in]      p_iq:           interleaved I/Q samples
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in/out]  p_moments:      sums to add to
+
+    @return         void
+*/
+extern void iq_accumulate_moments(              const int16_t *p_iq,
+                                                uint32_t num_samples,
+                                                struct iq_moments *p_moments);
+
+/*****************************************************************************/
+/** @brief
+    Estimates the DC offset and gain / phase imbalance from the moments.
+    Q is made orthogonal to I and scaled to the same power (Gram-Schmidt).
+
+    @param[in]      p_moments:      sums accumulated over the capture
+    @param[out]     p_corr:         the correction, no imbalance correction if 
+                                    the moments are degenerate
+
+    @return         void
+*/
+extern void iq_correction_estimate(             const struct iq_moments *p_moments,
+                                                struct iq_correction *p_corr);
+
+/*****************************************************************************/
+/** @brief
+    Converts interleaved int16 I/Q to interleaved float, applying the DC and
+    I/Q imbalance correction in the same pass
+
+    @param[out]     p_dst:          interleaved float I/Q
+    @param[in]      p_src:          interleaved int16 I/Q
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in]      scale:          applied to every output value
+    @param[in]      p_corr:         correction to apply
+
+    @return         void
+*/
+extern void iq_to_float_corrected(              float *p_dst,
+                                                const int16_t *p_src,
+                                                uint32_t num_samples,
+                                                float scale,
+                                                const struct iq_correction *p_corr);
+
+/*****************************************************************************/
+/** @brief
+    Unpacks 12 bit packed I/Q samples into interleaved int16 I/Q.  Every 3 
+    32 bit words hold 4 I/Q pairs as 8 consecutive 12 bit fields, starting at 
+    the most significant bit of the first word.  The fields keep the order 
+    they were received in, so the output is in the same I/Q (or Q/I) order 
+    as an unpacked capture.
+
+    @param[out]     p_dst:          interleaved int16 I/Q, sign extended
+    @param[in]      p_src:          packed words
+    @param[in]      num_samples:    number of I/Q pairs to unpack
+
+    @return         void
+*/
+extern void iq_unpack12(                        int16_t *p_dst,
+                                                const uint32_t *p_src,
+                                                uint32_t num_samples);
+
+/*****************************************************************************/
+/** @brief
+    Converts a frequency to the phase increment of the NCO, the full 32 bit
+    range of the phase is one cycle
+
+    @param[in]      freq:           tone frequency in Hz, negative is allowed
+    @param[in]      sample_rate:    sample rate in Hz
+
+    @return         phase increment per sample
+*/
+extern uint32_t nco_phase_inc(                  double freq,
+                                                double sample_rate);
+
+/*****************************************************************************/
+/** @brief
+    Generates a complex tone into interleaved int16 I/Q with a phase 
+    accumulator NCO.  Every sample is calculated from the accumulated phase 
+    so there is no drift however many samples are generated, and the phase 
+    continues from one call to the next.
+
+    @param[out]     p_iq:           interleaved I/Q, I is cos and Q is sin
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in/out]  p_phase:        phase of the first sample, updated to the 
+                                    phase of the next sample
+    @param[in]      phase_inc:      from nco_phase_inc()
+    @param[in]      amplitude:      peak amplitude of I and Q
+
+    @return         void
+
+    @note   The error compared to cos() and sin() in double precision is 
+            below 1 LSB for amplitudes up to 32767.
+*/
+extern void nco_tone(                           int16_t *p_iq,
+                                                uint32_t num_samples,
+                                                uint32_t *p_phase,
+                                                uint32_t phase_inc,
+                                                float amplitude);
+
+/*****************************************************************************/
+/** @brief
+    Generates the tones of two channels in one pass with the same NCO as 
+    nco_tone(), for transmitting on both handles of a card
+
+    @param[out]     p_iq_a:         interleaved I/Q of the first channel
+    @param[out]     p_iq_b:         interleaved I/Q of the second channel
+    @param[in]      num_samples:    number of I/Q pairs of each channel
+    @param[in/out]  p_a:            tone of the first channel, the phase is
+                                    updated to the phase of the next sample
+    @param[in/out]  p_b:            tone of the second channel, the phase is
+                                    updated to the phase of the next sample
+
+    @return         void
+
+    @note   Both phases advance sample by sample from the same start, so two
+            tones of the same frequency keep the difference of their start 
+            phases exactly for as long as they run.
+*/
+extern void nco_tone_dual(                      int16_t *p_iq_a,
+                                                int16_t *p_iq_b,
+                                                uint32_t num_samples,
+                                                struct nco_channel *p_a,
+                                                struct nco_channel *p_b);
+
+/*****************************************************************************/
+/** @brief
+    Adds a complex tone to interleaved float I/Q with the same NCO as 
+    nco_tone(), used to sum many tones before they are scaled to int16
+
+    @param[in/out]  p_acc:          interleaved float I/Q to add the tone to
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in/out]  p_phase:        phase of the first sample, updated to the 
+                                    phase of the next sample
+    @param[in]      phase_inc:      from nco_phase_inc()
+    @param[in]      amplitude:      peak amplitude of I and Q
+
+    @return         void
+*/
+extern void nco_tone_add(                       float *p_acc,
+                                                uint32_t num_samples,
+                                                uint32_t *p_phase,
+                                                uint32_t phase_inc,
+                                                float amplitude);
+
+/*****************************************************************************/
+/** @brief
+    Converts a phase per sample to interleaved int16 I/Q, the phases of an FM
+    signal or of a tone with phase noise
+
+    @param[out]     p_iq:           interleaved I/Q, I is cos and Q is sin
+    @param[in]      p_phase:        phase of each sample, the full 32 bit range
+                                    is one cycle
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in]      amplitude:      peak amplitude of I and Q
+
+    @return         void
+*/
+extern void nco_phase_iq(                       int16_t *p_iq,
+                                                const uint32_t *p_phase,
+                                                uint32_t num_samples,
+                                                float amplitude);
+
+/*****************************************************************************/
+/** @brief
+    Polyphase interpolating FIR with real taps on complex samples.  Each 
+    input sample gives num_phases output samples:
+
+    out[n * num_phases + p] = sum(j = 0 .. num_taps - 1) 
+                                  x[n + j] * coef[j * num_phases + p]
+
+    so for a prototype filter h of num_taps * num_phases taps, 
+    coef[j * num_phases + p] = h[p + (num_taps - 1 - j) * num_phases].
+
+    @param[out]     p_out:          interleaved float I/Q, num_in * num_phases
+    @param[in]      p_x:            interleaved float I/Q, the num_taps - 1 
+                                    previous samples followed by num_in new ones
+    @param[in]      num_in:         number of new input samples
+    @param[in]      p_coef:         num_taps rows of num_phases taps
+    @param[in]      num_taps:       taps per phase
+    @param[in]      num_phases:     interpolation factor
+
+    @return         void
+
+    @note   Phases are calculated 4 and then 2 at a time, the last phase of
+            an odd interpolation factor for 2 input samples at a time.
+*/
+extern void fir_interp(                         float *p_out,
+                                                const float *p_x,
+                                                uint32_t num_in,
+                                                const float *p_coef,
+                                                uint32_t num_taps,
+                                                uint32_t num_phases);
+
+/*****************************************************************************/
+/** @brief
+    Adds a block of interleaved float I/Q to the running peak and power
+
+    @param[in]      p_iq:           interleaved float I/Q
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in/out]  p_range:        updated with the peaks and the power
+
+    @return         void
+
+    @note   p_range accumulates, so it must be set to 
+            IQ_FLOAT_RANGE_INITIALIZER before the first block
+*/
+extern void iq_float_range(                     const float *p_iq,
+                                                uint32_t num_samples,
+                                                struct iq_float_range *p_range);
+
+/*****************************************************************************/
+/** @brief
+    Scales interleaved float I/Q and converts it to int16, rounding to the 
+    nearest value and saturating
+
+    @param[out]     p_dst:          interleaved int16 I/Q
+    @param[in]      p_src:          interleaved float I/Q
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in]      scale:          applied to every value
+
+    @return         void
+*/
+extern void iq_float_to_int16(                  int16_t *p_dst,
+                                                const float *p_src,
+                                                uint32_t num_samples,
+                                                float scale);
+
+/*****************************************************************************/
+/** @brief
+    Seeds the Gaussian generators, the same seed gives the same values
+
+    @param[out]     p_rng:          the generators
+    @param[in]      seed:           any value
+
+    @return         void
+*/
+extern void gauss_rng_seed(                     struct gauss_rng *p_rng,
+                                                uint64_t seed);
+
+/*****************************************************************************/
+/** @brief
+    Fills a buffer with independent Gaussian values of zero mean
+
+    @param[out]     p_out:          the values
+    @param[in]      num_values:     number of values
+    @param[in]      sigma:          standard deviation
+    @param[in/out]  p_rng:          the generators, seeded with gauss_rng_seed()
+
+    @return         void
+
+    @note   The tails are cut at 5.8 sigma, well beyond what a 16 bit sample
+            of the noise can show.
+*/
+extern void gauss_fill(                         float *p_out,
+                                                uint32_t num_values,
+                                                float sigma,
+                                                struct gauss_rng *p_rng);
+
+/*****************************************************************************/
+/** @brief
+    Impairs a block of interleaved int16 I/Q in place:
+
+    I' = (I - dc_i) * gain
+    Q' = ((Q - dc_q) * gain_qq + (I - dc_i) * cross_qi) * gain
+
+    then rotates I'/Q' by the phase of each sample, adds the noise, rounds 
+    and saturates.
+
+    @param[in/out]  p_iq:           interleaved I/Q samples
+    @param[in]      num_samples:    number of I/Q pairs
+    @param[in]      gain:           applied to the signal, not the noise
+    @param[in]      p_imbalance:    I/Q imbalance and DC offset, 
+                                    IQ_CORRECTION_INITIALIZER for none
+    @param[in]      p_phase:        NCO phase of each sample, NULL for none
+    @param[in]      p_noise:        interleaved noise, NULL for none
+
+    @return         void
+*/
+extern void iq_impair(                          int16_t *p_iq,
+                                                uint32_t num_samples,
+                                                float gain,
+                                                const struct iq_correction *p_imbalance,
+                                                const uint32_t *p_phase,
+                                                const float *p_noise);
+
+/*****************************************************************************/
+/** @brief
+    Returns the name of the kernel implementation compiled in
+
+    @return         "sse2", "neon" or "generic"
+*/
+extern const char *dsp_kernels_cstr(            void);
+
+#endif
@@ -0,0 +1,499 @@
+/**
+ * @file rt_profile.c
+ *
+ * @brief
+ * Real-time profile of the signal threads, see rt_profile.h.
+ *
+ * A thread takes its role itself, rt_thread_create() starts it through
+ * rt_thread_start() which sets the affinity and the scheduling of the
+ * calling thread and locks the top of its stack before the thread function
+ * runs.  Only the memory mapped at startup is locked with mlockall(), locking
+ * future mappings as well would lock the whole of a mapped IQ file, so the
+ * sample buffers are locked one by one with rt_lock_buffer().
+ *
+ * The latency test sleeps to an absolute time every RT_LATENCY_PERIOD_USEC
+ * in each role and takes how late the thread woke up.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+/* CPU_SET(), the affinity calls and pthread_getattr_np() are GNU extensions */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/***** INCLUDES *****/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "sidekiq_api.h"
+#include "rt_profile.h"
+#include "arg_parser.h"
+#include "utils_common.h"
+
+/* the top of the stack of a thread of the profile that is locked */
+#define RT_STACK_LOCK_BYTES     (64 * 1024)
+
+/* the period of the timer in the latency test */
+#define RT_LATENCY_PERIOD_USEC  1000
+
+/* the thread function and the role passed to rt_thread_start() */
+struct rt_start
+{
+    rt_thread_t         role;
+    void                *(*fn)(void *);
+    void                *p_arg;
+};
+
+/* the latency test of a role */
+struct rt_latency_test
+{
+    uint32_t            wakeups;
+    struct rt_latency   result;
+};
+
+/***** GLOBAL DATA *****/
+
+static struct rt_profile g_rt_profile = RT_PROFILE_INITIALIZER;
+static struct rt_latency g_rt_latency[rt_thread_end] =
+{
+    RT_LATENCY_INITIALIZER, RT_LATENCY_INITIALIZER, RT_LATENCY_INITIALIZER
+};
+
+/* a step that is not allowed is only reported once */
+static bool g_sched_warned = false;
+static bool g_lock_warned = false;
+
+static const char *rt_thread_cstr(rt_thread_t role)
+{
+    const char *p_role =
+        (role == rt_thread_tx)  ? "TX" :
+        (role == rt_thread_rx)  ? "RX" :
+        (role == rt_thread_dsp) ? "DSP" :
+        "unknown";
+
+    return p_role;
+}
+
+/*****************************************************************************/
+/** Logs a warning the first time a step is refused
+
+    @param p_warned     set once warned
+    @param p_what       what was refused
+    @param err          the error
+    @return: void
+*/
+static void warn_once(bool *p_warned, const char *p_what, int err)
+{
+    if (__atomic_exchange_n(p_warned, true, __ATOMIC_RELAXED) == false)
+    {
+        log_warn("unable to %s (%s), continuing without it", p_what, strerror(err));
+    }
+}
+
+/*****************************************************************************/
+/** Checks if a role is pinned or real-time
+
+    @param role         the role
+    @return: true if the profile changes how the role runs
+*/
+static bool role_is_set(rt_thread_t role)
+{
+    return (g_rt_profile.cpu[role] != RT_CPU_ANY) ||
+           (g_rt_profile.priority[role] != RT_PRIORITY_NONE);
+}
+
+/*****************************************************************************/
+/** Pins the calling thread and sets its scheduling for a role
+
+    @param role         the role
+    @return: void
+*/
+static void apply_role(rt_thread_t role)
+{
+    int ret;
+
+    if (g_rt_profile.cpu[role] != RT_CPU_ANY)
+    {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(g_rt_profile.cpu[role], &cpus);
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ret != 0)
+        {
+            log_warn("unable to pin the %s thread to cpu %" PRIi32 " (%s)",
+                    rt_thread_cstr(role), g_rt_profile.cpu[role], strerror(ret));
+        }
+    }
+
+    if (g_rt_profile.priority[role] != RT_PRIORITY_NONE)
+    {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = g_rt_profile.priority[role];
+        ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0)
+        {
+            warn_once(&g_sched_warned, "run the signal threads SCHED_FIFO", ret);
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Locks the top of the stack of the calling thread, the part a thread of
+ *  the profile uses
+
+    @return: void
+*/
+static void lock_stack(void)
+{
+    pthread_attr_t attr;
+    void *p_stack = NULL;
+    size_t size = 0;
+
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+    {
+        return;
+    }
+
+    if ((pthread_attr_getstack(&attr, &p_stack, &size) == 0) && (size != 0))
+    {
+        size_t len = (size < RT_STACK_LOCK_BYTES) ? size : RT_STACK_LOCK_BYTES;
+
+        /* the stack grows down from p_stack + size */
+        rt_lock_buffer((uint8_t *)p_stack + size - len, len);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static void *rt_thread_start(void *params)
+{
+    struct rt_start start = *(struct rt_start *)params;
+
+    free(params);
+
+    apply_role(start.role);
+    lock_stack();
+
+    return start.fn(start.p_arg);
+}
+
+static uint64_t ts_to_usec(const struct timespec *p_ts)
+{
+    return ((uint64_t)p_ts->tv_sec * 1000000) + (p_ts->tv_nsec / 1000);
+}
+
+/*****************************************************************************/
+/** Sleeps to an absolute time every RT_LATENCY_PERIOD_USEC and takes how
+ *  late each wakeup is
+
+    @param params       the latency test
+    @return: NULL
+*/
+static void *latency_thread(void *params)
+{
+    struct rt_latency_test *p_test = params;
+    struct rt_latency *p_result = &p_test->result;
+    struct timespec next, now;
+    uint64_t sum = 0;
+    uint32_t i;
+
+    p_result->min_usec = UINT32_MAX;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; i < p_test->wakeups; i++)
+    {
+        uint64_t late;
+
+        next.tv_nsec += RT_LATENCY_PERIOD_USEC * 1000;
+        if (next.tv_nsec >= 1000000000)
+        {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        late = ts_to_usec(&now) - ts_to_usec(&next);
+        late = (late > UINT32_MAX) ? UINT32_MAX : late;
+        p_result->min_usec = (late < p_result->min_usec) ? (uint32_t)late : p_result->min_usec;
+        p_result->max_usec = (late > p_result->max_usec) ? (uint32_t)late : p_result->max_usec;
+        sum += late;
+    }
+
+    p_result->samples = p_test->wakeups;
+    p_result->avg_usec = (p_test->wakeups != 0) ? (uint32_t)(sum / p_test->wakeups) : 0;
+    if (p_test->wakeups == 0)
+    {
+        p_result->min_usec = 0;
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+/** Runs the latency test in a role
+
+    @param role         the role
+    @return: void
+*/
+static void measure_latency(rt_thread_t role)
+{
+    struct rt_latency_test test;
+    pthread_t thread;
+    int ret;
+
+    memset(&test, 0, sizeof(test));
+    test.wakeups = (g_rt_profile.latency_ms * 1000) / RT_LATENCY_PERIOD_USEC;
+
+    ret = rt_thread_create(&thread, role, latency_thread, &test);
+    if (ret != 0)
+    {
+        log_warn("unable to start the %s latency test (status %d)", rt_thread_cstr(role), ret);
+        return;
+    }
+    pthread_join(thread, NULL);
+
+    g_rt_latency[role] = test.result;
+    log_info("%s thread (cpu %" PRIi32 ", priority %" PRIi32 ") wakeup latency min %" PRIu32
+            " avg %" PRIu32 " max %" PRIu32 " usec over %" PRIu32 " wakeups",
+            rt_thread_cstr(role), g_rt_profile.cpu[role], g_rt_profile.priority[role],
+            test.result.min_usec, test.result.avg_usec, test.result.max_usec,
+            test.result.samples);
+}
+
+/*****************************************************************************/
+/** Parses the cores of the roles from a list of "TX,RX,DSP"
+
+    @param p_list       the list
+    @param p_profile    cpu[] of each role
+    @return: status
+*/
+int32_t rt_profile_parse_cpus(                  const char *p_list,
+                                                struct rt_profile *p_profile)
+{
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *p_pos = p_list;
+    uint32_t role;
+
+    for (role = 0; role < rt_thread_end; role++)
+    {
+        char *p_end = NULL;
+        long cpu = RT_CPU_ANY;
+
+        if ((*p_pos != ',') && (*p_pos != '\0'))
+        {
+            cpu = strtol(p_pos, &p_end, 10);
+            if ((p_end == p_pos) || ((*p_end != ',') && (*p_end != '\0')))
+            {
+                return -EINVAL;
+            }
+            if ((cpu >= num_cpus) || (cpu >= CPU_SETSIZE))
+            {
+                log_error("cpu %ld of the %s thread is not online", cpu,
+                        rt_thread_cstr((rt_thread_t)role));
+                return -EINVAL;
+            }
+            p_pos = p_end;
+        }
+        p_profile->cpu[role] = (cpu < 0) ? RT_CPU_ANY : (int32_t)cpu;
+
+        if (*p_pos == ',')
+        {
+            p_pos++;
+        }
+    }
+
+    return (*p_pos == '\0') ? 0 : -EINVAL;
+}
+
+/*****************************************************************************/
+/** Takes the profile, locks the memory and measures the latency of the roles
+
+    @param p_profile    the profile
+    @return: status
+*/
+int32_t rt_profile_init(                        const struct rt_profile *p_profile)
+{
+    int32_t max_priority = sched_get_priority_max(SCHED_FIFO);
+    int32_t min_priority = sched_get_priority_min(SCHED_FIFO);
+    uint32_t role;
+
+    g_rt_profile = *p_profile;
+
+    for (role = 0; role < rt_thread_end; role++)
+    {
+        int32_t *p_priority = &g_rt_profile.priority[role];
+
+        if (*p_priority != RT_PRIORITY_NONE)
+        {
+            *p_priority = (*p_priority > max_priority) ? max_priority :
+                          (*p_priority < min_priority) ? min_priority : *p_priority;
+        }
+    }
+
+    if (g_rt_profile.lock_memory == true)
+    {
+        /* the code, the libraries and what is allocated so far */
+        if (mlockall(MCL_CURRENT) != 0)
+        {
+            warn_once(&g_lock_warned, "lock the memory of the process", errno);
+        }
+        else
+        {
+            log_info("memory of the process locked");
+        }
+    }
+
+    if (g_rt_profile.latency_ms != 0)
+    {
+        for (role = 0; role < rt_thread_end; role++)
+        {
+            if (role_is_set((rt_thread_t)role) || (role == rt_thread_tx))
+            {
+                measure_latency((rt_thread_t)role);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** The latency measured at startup for a role
+
+    @param role         the role
+    @param p_latency    the latency
+    @return: void
+*/
+void rt_profile_latency(                        rt_thread_t role,
+                                                struct rt_latency *p_latency)
+{
+    *p_latency = g_rt_latency[role];
+}
+
+/*****************************************************************************/
+/** Starts a thread in a role
+
+    @param p_thread     the thread
+    @param role         the role
+    @param fn           the thread function
+    @param p_arg        passed to fn
+    @return: status
+*/
+int32_t rt_thread_create(                       pthread_t *p_thread,
+                                                rt_thread_t role,
+                                                void *(*fn)(void *),
+                                                void *p_arg)
+{
+    struct rt_start *p_start = malloc(sizeof(*p_start));
+    int ret;
+
+    if (p_start == NULL)
+    {
+        return ENOMEM;
+    }
+    p_start->role = role;
+    p_start->fn = fn;
+    p_start->p_arg = p_arg;
+
+    ret = pthread_create(p_thread, NULL, rt_thread_start, p_start);
+    if (ret != 0)
+    {
+        free(p_start);
+    }
+
+    return ret;
+}
+
+/*****************************************************************************/
+/** Moves the calling thread into a role
+
+    @param role         the role
+    @param p_state      how the thread ran before
+    @return: void
+*/
+void rt_thread_enter(                           rt_thread_t role,
+                                                struct rt_thread_state *p_state)
+{
+    p_state->saved = false;
+    if (role_is_set(role) == false)
+    {
+        return;
+    }
+
+    if ((pthread_getschedparam(pthread_self(), &p_state->policy, &p_state->param) == 0) &&
+        (pthread_getaffinity_np(pthread_self(), sizeof(p_state->cpus), &p_state->cpus) == 0))
+    {
+        p_state->saved = true;
+        apply_role(role);
+    }
+}
+
+/*****************************************************************************/
+/** Returns the calling thread to how it ran before rt_thread_enter()
+
+    @param p_state      from rt_thread_enter()
+    @return: void
+*/
+void rt_thread_leave(                           const struct rt_thread_state *p_state)
+{
+    if (p_state->saved == false)
+    {
+        return;
+    }
+
+    pthread_setschedparam(pthread_self(), p_state->policy, &p_state->param);
+    pthread_setaffinity_np(pthread_self(), sizeof(p_state->cpus), &p_state->cpus);
+}
+
+/*****************************************************************************/
+/** Locks a sample buffer and faults in its pages
+
+    @param p_buf        the buffer
+    @param len          its length in bytes
+    @return: void
+*/
+void rt_lock_buffer(                            void *p_buf,
+                                                size_t len)
+{
+    static size_t page_size = 0;
+    volatile uint8_t *p_byte = p_buf;
+    size_t offset;
+
+    if ((g_rt_profile.lock_memory == false) || (p_buf == NULL) || (len == 0))
+    {
+        return;
+    }
+
+    if (page_size == 0)
+    {
+        page_size = (size_t)sysconf(_SC_PAGESIZE);
+    }
+
+    /* mlock() faults the pages in, touching them also does when it is refused */
+    if (mlock(p_buf, len) != 0)
+    {
+        warn_once(&g_lock_warned, "lock the sample buffers", errno);
+    }
+
+    for (offset = 0; offset < len; offset += page_size)
+    {
+        p_byte[offset] = p_byte[offset];
+    }
+    p_byte[len - 1] = p_byte[len - 1];
+}
@@ -0,0 +1,189 @@
+/**
+ * @file rt_profile.h
+ *
+ * @brief
+ * Real-time profile of the signal threads.  The thread that feeds the TX
+ * queue, the loop that reads RX blocks and the generator thread that fills
+ * the streamed blocks can each be pinned to a core and run SCHED_FIFO, the
+ * memory of the process is locked and the sample buffers are locked and
+ * faulted in before they are used, so a page fault or a lower priority
+ * task does not delay a block.
+ *
+ * Every step falls back to the default when it is not allowed, without
+ * CAP_SYS_NICE or CAP_IPC_LOCK the threads run as before and a warning is
+ * logged once.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+#ifndef __RT_PROFILE_H__
+#define __RT_PROFILE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* the roles a thread of the profile takes */
+typedef enum
+{
+    rt_thread_tx = 0,       // sends blocks to the TX queue, tone and sweep threads
+    rt_thread_rx,           // receives blocks, the capture loop of get_data()
+    rt_thread_dsp,          // generates the blocks of a streamed signal
+    rt_thread_end,
+} rt_thread_t;
+
+/* no core or no real-time priority for a role */
+#define RT_CPU_ANY          (-1)
+#define RT_PRIORITY_NONE    0
+
+/* the real-time profile, see rt_profile_init() */
+struct rt_profile
+{
+    int32_t             cpu[rt_thread_end];         // core of each role, or RT_CPU_ANY
+    int32_t             priority[rt_thread_end];    // SCHED_FIFO priority, or RT_PRIORITY_NONE
+    bool                lock_memory;                // lock the process memory and the buffers
+    uint32_t            latency_ms;                 // length of the startup latency test, 0 for none
+};
+
+#define RT_PROFILE_INITIALIZER                                          \
+{                                                                       \
+    .cpu                    = { RT_CPU_ANY, RT_CPU_ANY, RT_CPU_ANY },   \
+    .priority               = { RT_PRIORITY_NONE, RT_PRIORITY_NONE,     \
+                                RT_PRIORITY_NONE },                     \
+    .lock_memory            = false,                                    \
+    .latency_ms             = 0,                                        \
+}                                                                       \
+
+/* wakeup latency of a role measured by rt_profile_init() */
+struct rt_latency
+{
+    uint32_t            samples;                    // timer wakeups measured
+    uint32_t            min_usec;
+    uint32_t            avg_usec;
+    uint32_t            max_usec;
+};
+
+#define RT_LATENCY_INITIALIZER                                          \
+{                                                                       \
+    .samples                = 0,                                        \
+    .min_usec               = 0,                                        \
+    .avg_usec               = 0,                                        \
+    .max_usec               = 0,                                        \
+}                                                                       \
+
+/* how a thread ran before rt_thread_enter() */
+struct rt_thread_state
+{
+    bool                saved;
+    int                 policy;
+    struct sched_param  param;
+    cpu_set_t           cpus;
+};
+
+#define RT_THREAD_STATE_INITIALIZER                                     \
+{                                                                       \
+    .saved                  = false,                                    \
+}                                                                       \
+
+
+/*****************************************************************************/
+/** @brief
+    Parses the cores of the roles from a list of "TX,RX,DSP", an empty or
+    negative entry leaves that role on any core
+
+    @param[in]      p_list:         the list, such as "2,3,1" or ",3"
+    @param[out]     p_profile:      cpu[] of each role
+
+    @return         0 on success, -EINVAL if the list does not parse or a core
+                    is not online
+*/
+extern int32_t rt_profile_parse_cpus(           const char *p_list,
+                                                struct rt_profile *p_profile);
+
+/*****************************************************************************/
+/** @brief
+    Takes the profile, locks the memory of the process and measures the
+    wakeup latency of the TX role and of each other role that is pinned or
+    real-time
+
+    @param[in]      p_profile:      the profile
+
+    @return         0, a step that is not allowed is logged and skipped
+
+    @note   Called once at startup before any thread of the profile is started.
+*/
+extern int32_t rt_profile_init(                 const struct rt_profile *p_profile);
+
+/*****************************************************************************/
+/** @brief
+    The latency measured at startup for a role
+
+    @param[in]      role:           the role
+    @param[out]     p_latency:      the latency, all 0 if it was not measured
+
+    @return         void
+*/
+extern void rt_profile_latency(                 rt_thread_t role,
+                                                struct rt_latency *p_latency);
+
+/*****************************************************************************/
+/** @brief
+    Starts a thread in a role, the thread pins itself and takes the priority
+    of the role before fn is called
+
+    @param[out]     p_thread:       the thread
+    @param[in]      role:           the role
+    @param[in]      fn:             the thread function
+    @param[in]      p_arg:          passed to fn
+
+    @return         0 on success, else the error of pthread_create()
+*/
+extern int32_t rt_thread_create(                pthread_t *p_thread,
+                                                rt_thread_t role,
+                                                void *(*fn)(void *),
+                                                void *p_arg);
+
+/*****************************************************************************/
+/** @brief
+    Moves the calling thread into a role for a while, such as a capture
+
+    @param[in]      role:           the role
+    @param[out]     p_state:        how the thread ran before
+
+    @return         void
+*/
+extern void rt_thread_enter(                    rt_thread_t role,
+                                                struct rt_thread_state *p_state);
+
+/*****************************************************************************/
+/** @brief
+    Returns the calling thread to how it ran before rt_thread_enter()
+
+    @param[in]      p_state:        from rt_thread_enter()
+
+    @return         void
+*/
+extern void rt_thread_leave(                    const struct rt_thread_state *p_state);
+
+/*****************************************************************************/
+/** @brief
+    Locks a sample buffer and faults in its pages when the profile locks
+    memory, does nothing otherwise
+
+    @param[in]      p_buf:          the buffer
+    @param[in]      len:            its length in bytes
+
+    @return         void
+
+    @note   The contents are kept.  The buffer stays locked until it is freed,
+            buffers of this size are mapped by malloc on their own so the
+            lock goes with the mapping.
+*/
+extern void rt_lock_buffer(                     void *p_buf,
+                                                size_t len);
+
+#endif
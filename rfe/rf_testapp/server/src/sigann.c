@@ -29,6 +29,8 @@
 #include "sidekiq_api.h"
 #include "sigann.h"
 #include "nsfft.h"
+#include "dsp_kernels.h"
+#include "rt_profile.h"
 
 #include "arg_parser.h"
 #include "utils_common.h"
@@ -36,9 +38,78 @@
 
 #define FFT_LEN 65536
 
+/* the number of times a capture will be restarted because of dropped blocks */
+#define MAX_CAPTURE_RESTARTS    10
+
+/* power of a full scale 12 bit sample, used as the 0 dBFS reference */
+#define FULL_SCALE_POWER        (2047.0 * 2047.0)
+
+/* a 12 bit I or Q value at or beyond this is treated as clipped */
+#define CLIP_LEVEL              2040
+
+/* a capture whose largest I or Q value is below this is underranged (about -30 dBFS) */
+#define UNDERRANGE_LEVEL        64
+
+/* the maximum number of captures autorange makes before settling on a gain */
+#define MAX_AUTORANGE_ITERATIONS 8
+
+/* the chosen gain is remembered for each band of this width */
+#define GAIN_BAND_MHZ           100
+#define NUM_GAIN_BANDS          ((6000 / GAIN_BAND_MHZ) + 1)
+
+/* gain used in fixed mode and as the starting point for an unknown band */
+#define DEFAULT_FIXED_GAIN      10
+
+/* the most history that can be kept before a trigger */
+#define MAX_PRETRIGGER_SAMPLES  (FFT_LEN / 2)
+
+/* number of (frequency, gain) settings the I/Q correction is remembered for */
+#define IQ_CORR_CACHE_SIZE      32
+
+/* sample scale to +/- 1.0 */
+#define SAMPLE_SCALE            (1.0f / 2047)
+
+/* history of the blocks received while waiting for the trigger */
+struct pretrigger_ring
+{
+    int16_t                     *p_data;    // interleaved I/Q samples
+    uint32_t                    size;       // capacity in I/Q pairs
+    uint32_t                    write_idx;  // where the next sample is placed
+    uint32_t                    fill;       // number of valid samples
+};
+
+#define PRETRIGGER_RING_INITIALIZER                         \
+{                                                           \
+    .p_data                 = NULL,                         \
+    .size                   = 0,                            \
+    .write_idx              = 0,                            \
+    .fill                   = 0,                            \
+}                                                           \
+
+/* an I/Q correction estimated at one (frequency, gain) setting */
+struct iq_corr_entry
+{
+    bool                        valid;
+    uint64_t                    freq;       // RX LO frequency in Hz
+    uint8_t                     gain;       // RX gain index
+    uint32_t                    last_used;  // age for least recently used replacement
+    struct iq_correction        corr;
+};
+
 extern volatile sig_atomic_t g_running;
+extern bool g_tone_thread_running;
 bool g_rx_running = false;
-uint32_t    num_blocks_to_acquire = FFT_LEN / (SKIQ_MAX_RX_BLOCK_SIZE_IN_WORDS - SKIQ_RX_HEADER_SIZE_IN_WORDS) + 1;
+rx_gap_policy_t g_gap_policy = rx_gap_policy_discard;
+struct rx_capture_stats g_capture_stats = RX_CAPTURE_STATS_INITIALIZER;
+struct rx_trigger_config g_trigger_config = RX_TRIGGER_CONFIG_INITIALIZER;
+rx_gain_range_mode_t g_gain_range_mode = rx_gain_range_fixed;
+uint8_t g_fixed_gain = DEFAULT_FIXED_GAIN;
+int16_t g_band_gain[NUM_GAIN_BANDS] = INIT_ARRAY(NUM_GAIN_BANDS, -1);
+bool g_rx_packed = false;
+bool g_iq_corr_enabled = false;
+struct iq_correction g_iq_corr = IQ_CORRECTION_INITIALIZER;
+struct iq_corr_entry g_iq_corr_cache[IQ_CORR_CACHE_SIZE];
+uint32_t g_iq_corr_age = 0;
 int16_t     *data_ptr;
 bool        skiq_initialized;
 int         logging_num = 0; //gives logging_handler a way to print out multiple lines of logs
@@ -89,10 +160,11 @@ void fftshift(double *data, int count)
  * 
     @param p_rconfig: the main radio config pointer
     @param p_rx_rconfig: the RX radio config pointer
+    @param num_points: points of the arrays, a power of 2 up to FFT_LEN
     @return void
 */
 void fft_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconfig, 
-        double *data_freq_array, double *data_power_array) 
+        uint32_t num_points, double *data_freq_array, double *data_power_array) 
 {
     double      freq_array[FFT_LEN] = INIT_ARRAY(FFT_LEN, 0);
     double      power_array[FFT_LEN] = INIT_ARRAY(FFT_LEN, 0); 
@@ -104,12 +176,8 @@ void fft_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconf
 
     log_trace("fft_data");
 
-    /* copy data into a float array for nsftt */
-    for (i = 0; i < FFT_LEN; i += 1)
-    {
-        nsfft_in[2 * i] = (float) tmp_ptr[2*i] / 2047;
-        nsfft_in[2* i + 1] = (float) tmp_ptr[2*i + 1] / 2047;
-    }
+    /* copy data into a float array for nsftt, correcting it on the way */
+    iq_to_float_corrected(nsfft_in, tmp_ptr, FFT_LEN, SAMPLE_SCALE, &g_iq_corr);
 
     complex double s1[FFT_LEN];
 
@@ -144,13 +212,13 @@ void fft_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconf
     }
 
 
-    uint32_t pointsPerFreqBin = FFT_LEN / SWEEPPOINTS;
+    uint32_t pointsPerFreqBin = FFT_LEN / num_points;
     double freq_temp = 0;
 
     log_debug("pointsPerFreqBin %d", pointsPerFreqBin);
     
     /* determine the max power in bins that go into one power bin */
-    for(i = 0; i < SWEEPPOINTS; i++)
+    for(i = 0; i < num_points; i++)
     {
         /* get max value for each frequency bin */
         double  powermax_tmp = -300;
@@ -192,12 +260,8 @@ void calc_fft(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconf
 
     log_trace("calc_fft");
 
-    /* copy data into a float array for nsftt */
-    for (i = 0; i < FFT_LEN; i += 1)
-    {
-        nsfft_in[2 * i] = (float) tmp_ptr[2*i] / 2047;
-        nsfft_in[2* i + 1] = (float) tmp_ptr[2*i + 1] / 2047;
-    }
+    /* copy data into a float array for nsftt, correcting it on the way */
+    iq_to_float_corrected(nsfft_in, tmp_ptr, FFT_LEN, SAMPLE_SCALE, &g_iq_corr);
 
     complex double s1[FFT_LEN];
 
@@ -256,8 +320,168 @@ void calc_fft(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconf
 }
 
 
+/******************************************************************************/
+/** Places the newest samples of a block into the pre-trigger history ring,
+ *  overwriting the oldest ones once the ring is full
+ * 
+    @param p_ring: the ring
+    @param p_iq: interleaved I/Q samples
+    @param num_samples: number of I/Q pairs
+    @return void
+*/
+static void pretrigger_push(struct pretrigger_ring *p_ring, const int16_t *p_iq, uint32_t num_samples)
+{
+    uint32_t first = 0;
+
+    if (p_ring->size == 0)
+    {
+        return;
+    }
+
+    /* only the newest samples can fit */
+    if (num_samples > p_ring->size)
+    {
+        p_iq += (num_samples - p_ring->size) * 2;
+        num_samples = p_ring->size;
+    }
+
+    /* copy up to the end of the ring then wrap around */
+    first = p_ring->size - p_ring->write_idx;
+    if (first > num_samples)
+    {
+        first = num_samples;
+    }
+    memcpy(&p_ring->p_data[p_ring->write_idx * 2], p_iq, first * 2 * sizeof(int16_t));
+    memcpy(p_ring->p_data, &p_iq[first * 2], (num_samples - first) * 2 * sizeof(int16_t));
+
+    p_ring->write_idx = (p_ring->write_idx + num_samples) % p_ring->size;
+    p_ring->fill += num_samples;
+    if (p_ring->fill > p_ring->size)
+    {
+        p_ring->fill = p_ring->size;
+    }
+}
+
+/******************************************************************************/
+/** Copies the pre-trigger history, oldest sample first, and empties the ring
+ * 
+    @param p_ring: the ring
+    @param p_dst: where to place the interleaved I/Q samples
+    @return the number of I/Q pairs copied
+*/
+static uint32_t pretrigger_drain(struct pretrigger_ring *p_ring, int16_t *p_dst)
+{
+    uint32_t fill = p_ring->fill;
+    uint32_t read_idx = 0;
+    uint32_t first = 0;
+
+    if (fill == 0)
+    {
+        return 0;
+    }
+
+    read_idx = (p_ring->write_idx + p_ring->size - fill) % p_ring->size;
+    first = p_ring->size - read_idx;
+    if (first > fill)
+    {
+        first = fill;
+    }
+    memcpy(p_dst, &p_ring->p_data[read_idx * 2], first * 2 * sizeof(int16_t));
+    memcpy(&p_dst[first * 2], p_ring->p_data, (fill - first) * 2 * sizeof(int16_t));
+
+    p_ring->fill = 0;
+    p_ring->write_idx = 0;
+
+    return fill;
+}
+
+/******************************************************************************/
+/** Selects the I/Q correction for a capture.  If the correction is off the 
+ *  samples are only scaled, otherwise a remembered correction for the same 
+ *  frequency and gain is used.
+ * 
+    @param freq: RX LO frequency in Hz
+    @param gain: RX gain index
+    @return true if nothing needs to be estimated from the capture
+*/
+static bool iq_corr_lookup(uint64_t freq, uint8_t gain)
+{
+    int i;
+
+    g_iq_corr = (struct iq_correction) IQ_CORRECTION_INITIALIZER;
+
+    if (g_iq_corr_enabled == false)
+    {
+        return true;
+    }
+
+    for (i = 0; i < IQ_CORR_CACHE_SIZE; i++)
+    {
+        if ((g_iq_corr_cache[i].valid == true) && (g_iq_corr_cache[i].freq == freq) &&
+            (g_iq_corr_cache[i].gain == gain))
+        {
+            g_iq_corr_cache[i].last_used = ++g_iq_corr_age;
+            g_iq_corr = g_iq_corr_cache[i].corr;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/******************************************************************************/
+/** Estimates the I/Q correction from the moments accumulated during a 
+ *  capture, makes it the current one and remembers it, replacing the least 
+ *  recently used entry when the cache is full.
+ * 
+    @param freq: RX LO frequency in Hz
+    @param gain: RX gain index
+    @param p_moments: sums accumulated over the capture
+    @return void
+*/
+static void iq_corr_store(uint64_t freq, uint8_t gain, const struct iq_moments *p_moments)
+{
+    int i;
+    int slot = 0;
+
+    iq_correction_estimate(p_moments, &g_iq_corr);
+
+    for (i = 0; i < IQ_CORR_CACHE_SIZE; i++)
+    {
+        if (g_iq_corr_cache[i].valid == false)
+        {
+            slot = i;
+            break;
+        }
+        if (g_iq_corr_cache[i].last_used < g_iq_corr_cache[slot].last_used)
+        {
+            slot = i;
+        }
+    }
+
+    g_iq_corr_cache[slot].valid = true;
+    g_iq_corr_cache[slot].freq = freq;
+    g_iq_corr_cache[slot].gain = gain;
+    g_iq_corr_cache[slot].last_used = ++g_iq_corr_age;
+    g_iq_corr_cache[slot].corr = g_iq_corr;
+
+    log_debug("I/Q correction at %" PRIu64 " Hz gain %" PRIu8 ": dc %.2f/%.2f gain %.4f "
+            "cross %.4f", freq, gain, g_iq_corr.dc_i, g_iq_corr.dc_q, g_iq_corr.gain_qq, 
+            g_iq_corr.cross_qi);
+}
+
 /******************************************************************************/
 /** Gets data from the card
+ *
+ *  The RF timestamp in each block header is checked against the timestamp
+ *  expected from the previous block.  If it is later, blocks were dropped
+ *  and the capture is handled according to g_gap_policy.  If it went back
+ *  the capture starts over, nothing is counted as dropped or zero filled.
+ *
+ *  If the energy trigger is enabled the blocks are only kept in a pre-trigger 
+ *  history until one has a mean power over the threshold.  The capture then 
+ *  starts with the history followed by the triggering block.  If nothing 
+ *  triggers within the timeout -ETIMEDOUT is returned and nothing is captured.
  * 
     @param p_rconfig: the main radio config pointer
     @param p_rx_rconfig: the RX radio config pointer
@@ -271,16 +495,58 @@ int32_t get_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rc
     uint8_t card = 0;
     skiq_rx_hdl_t hdl = skiq_rx_hdl_end;
     skiq_rx_hdl_t rcvd_hdl = skiq_rx_hdl_end;
-    uint32_t curr_block = 0;
     uint32_t data_len   = 0;
     skiq_rx_block_t* p_rx_block = NULL;
-    int16_t *running_ptr = data_ptr;
+    uint32_t num_samples = 0;
+    uint64_t next_rf_timestamp = 0;
+    bool first_block = true;
+    bool triggered = true;
+    struct pretrigger_ring ring = PRETRIGGER_RING_INITIALIZER;
+    double threshold_power = 0;
+    uint64_t arm_rf_timestamp = 0;
+    uint64_t timeout_samples = 0;
+    struct iq_range range = IQ_RANGE_INITIALIZER;
+    struct iq_moments moments = IQ_MOMENTS_INITIALIZER;
+    bool estimate = false;
+    int16_t *p_unpacked = NULL;
+    uint32_t unpacked_size = 0;
+    struct rt_thread_state rt_state = RT_THREAD_STATE_INITIALIZER;
 
     log_trace("get_data");
 
     card = p_rconfig->cards[0];
     hdl = p_rx_rconfig->handles[card][0];
 
+    g_capture_stats = (struct rx_capture_stats) RX_CAPTURE_STATS_INITIALIZER;
+
+    /* only estimate the correction if this setting hasn't been seen before */
+    estimate = !iq_corr_lookup(p_rx_rconfig->freq, p_rx_rconfig->gain);
+
+    if (g_trigger_config.enabled == true)
+    {
+        triggered = false;
+
+        /* mean power per sample that a block must reach */
+        threshold_power = FULL_SCALE_POWER * pow(10.0, g_trigger_config.threshold_dbfs / 10.0);
+        timeout_samples = ((uint64_t)g_trigger_config.timeout_ms * p_rconfig->sample_rate) / 1000;
+
+        ring.size = g_trigger_config.pretrigger_samples;
+        if (ring.size != 0)
+        {
+            ring.p_data = malloc(ring.size * 2 * sizeof(int16_t));
+            if (ring.p_data == NULL)
+            {
+                log_error("Error: didn't successfully allocate %" PRIu64 " bytes to hold"
+                        " pre-trigger samples ", (uint64_t)(ring.size * 2 * sizeof(int16_t)));
+                return -1;
+            }
+            rt_lock_buffer(ring.p_data, ring.size * 2 * sizeof(int16_t));
+        }
+        log_debug("trigger armed threshold %" PRIi32 " dBFS, pretrigger %" PRIu32 
+                ", timeout %" PRIu64 " samples", g_trigger_config.threshold_dbfs, 
+                ring.size, timeout_samples);
+    }
+
     /*
         Tell the receiver to start streaming samples to the host; these samples will be read
         into this program in the loop below
@@ -290,11 +556,15 @@ int32_t get_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rc
     {
         log_error("Error: failed to starting streaming samples, status %" PRIi32 " ",
             status);
+        free(ring.p_data);
         return status ;
     }
 
-    /* loop getting blocks */
-    while( (curr_block < num_blocks_to_acquire) && (g_running==true) )
+    /* the capture loop runs in the RX role of the real-time profile */
+    rt_thread_enter(rt_thread_rx, &rt_state);
+
+    /* loop getting blocks until the capture buffer is full */
+    while( (num_samples < FFT_LEN) && (g_running==true) )
     {
         /* Receive a packet of sample data, data_len is in bytes */
         status = skiq_receive(card, &rcvd_hdl, &p_rx_block, &data_len);
@@ -310,28 +580,196 @@ int32_t get_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rc
             {
                 /* watch out for bytes, ints or words */
                 int16_t *tmp_ptr = (int16_t *) p_rx_block->data;
-                uint32_t tmp_len = data_len - SKIQ_RX_HEADER_SIZE_IN_BYTES;
+                uint32_t block_samples = (data_len - SKIQ_RX_HEADER_SIZE_IN_BYTES) / 4;
+                uint32_t copy_samples = 0;
+
+                if (p_rconfig->packed == true)
+                {
+                    /* 3 words hold 4 samples */
+                    block_samples = (block_samples * 4) / 3;
+                }
 
-                /* determine how much data (bytes) we already have placed into the buffer */
-                uint32_t diff = running_ptr - data_ptr;
+                /* the RF timestamp counts samples, so the next block should start 
+                 * exactly block_samples after this one */
+                if ((first_block == false) && (p_rx_block->rf_timestamp != next_rf_timestamp))
+                {
+                    /* a timestamp that went back, such as a reset of the counter, 
+                     * says nothing of how much was lost */
+                    bool backwards = (p_rx_block->rf_timestamp < next_rf_timestamp);
+                    uint64_t missing = 0;
+
+                    g_capture_stats.gaps++;
+                    if (backwards == true)
+                    {
+                        log_warn("RF timestamp went back, expected %" PRIu64 " received %" 
+                                PRIu64 "", next_rf_timestamp, p_rx_block->rf_timestamp);
+                    }
+                    else
+                    {
+                        missing = p_rx_block->rf_timestamp - next_rf_timestamp;
+                        g_capture_stats.blocks_dropped += ROUND_UP(missing, block_samples);
+
+                        log_warn("RF timestamp gap, expected %" PRIu64 " received %" PRIu64 
+                                " (%" PRIu64 " samples missing)", 
+                                next_rf_timestamp, p_rx_block->rf_timestamp, missing);
+                    }
+
+                    if (triggered == false)
+                    {
+                        /* the history is no longer contiguous with what comes next */
+                        ring.fill = 0;
+                        ring.write_idx = 0;
+                        if (backwards == true)
+                        {
+                            /* the timeout can only count from here */
+                            arm_rf_timestamp = p_rx_block->rf_timestamp;
+                        }
+                    }
+                    else if ((backwards == true) || (g_gap_policy == rx_gap_policy_discard))
+                    {
+                        g_capture_stats.restarts++;
+                        if (g_capture_stats.restarts > MAX_CAPTURE_RESTARTS)
+                        {
+                            log_error("Error: capture restarted %" PRIu32 " times, giving up",
+                                    MAX_CAPTURE_RESTARTS);
+                            status = -EIO;
+                            break;
+                        }
+
+                        /* start over with this block as the first one, a triggered 
+                         * capture waits for a new crossing with its own history */
+                        num_samples = 0;
+                        first_block = true;
+                        triggered = (g_trigger_config.enabled == false);
+                        ring.fill = 0;
+                        ring.write_idx = 0;
+                        range = (struct iq_range) IQ_RANGE_INITIALIZER;
+                        moments = (struct iq_moments) IQ_MOMENTS_INITIALIZER;
+                        g_capture_stats.overload = false;
+                    }
+                    else if (g_gap_policy == rx_gap_policy_zero_fill)
+                    {
+                        /* insert zeros for the missing samples so the spacing is kept */
+                        uint32_t fill = FFT_LEN - num_samples;
+
+                        if (missing < fill)
+                        {
+                            fill = (uint32_t)missing;
+                        }
+                        memset(&data_ptr[num_samples * 2], 0, fill * 2 * sizeof(int16_t));
+                        num_samples += fill;
+                    }
+                }
+
+                if (first_block == true)
+                {
+                    g_capture_stats.first_rf_timestamp = p_rx_block->rf_timestamp;
+                    g_capture_stats.first_sys_timestamp = p_rx_block->sys_timestamp;
+                    arm_rf_timestamp = p_rx_block->rf_timestamp;
+                    first_block = false;
+                }
+                g_capture_stats.last_rf_timestamp = p_rx_block->rf_timestamp;
+                g_capture_stats.last_sys_timestamp = p_rx_block->sys_timestamp;
+                next_rf_timestamp = p_rx_block->rf_timestamp + block_samples;
+
+                /* unpack so the rest of the capture sees int16 I/Q */
+                if ((p_rconfig->packed == true) && (triggered == true))
+                {
+                    /* straight into the capture, only what fits */
+                    copy_samples = block_samples;
+                    if (copy_samples > (FFT_LEN - num_samples))
+                    {
+                        copy_samples = FFT_LEN - num_samples;
+                    }
+                    tmp_ptr = &data_ptr[num_samples * 2];
+                    iq_unpack12(tmp_ptr, (const uint32_t *)p_rx_block->data, copy_samples);
+                }
+                else if (p_rconfig->packed == true)
+                {
+                    /* the trigger needs the whole block for its power and the history */
+                    if (block_samples > unpacked_size)
+                    {
+                        free(p_unpacked);
+                        p_unpacked = malloc(block_samples * 2 * sizeof(int16_t));
+                        if (p_unpacked == NULL)
+                        {
+                            log_error("Error: didn't successfully allocate %" PRIu64 " bytes to"
+                                    " unpack a block", (uint64_t)(block_samples * 2 * sizeof(int16_t)));
+                            unpacked_size = 0;
+                            status = -ENOMEM;
+                            break;
+                        }
+                        unpacked_size = block_samples;
+                    }
+                    iq_unpack12(p_unpacked, (const uint32_t *)p_rx_block->data, block_samples);
+                    tmp_ptr = p_unpacked;
+                }
+
+                if (triggered == false)
+                {
+                    double power = (double)iq_power_sum(tmp_ptr, block_samples) / block_samples;
+
+                    if (power < threshold_power)
+                    {
+                        /* nothing here, keep it as history and wait for the next block */
+                        pretrigger_push(&ring, tmp_ptr, block_samples);
+
+                        if ((p_rx_block->rf_timestamp - arm_rf_timestamp) > timeout_samples)
+                        {
+                            log_info("no trigger within %" PRIu32 " ms", g_trigger_config.timeout_ms);
+                            status = -ETIMEDOUT;
+                            break;
+                        }
+                        continue;
+                    }
+
+                    log_debug("triggered at %.1f dBFS, rf timestamp %" PRIu64 "", 
+                            10 * log10(power / FULL_SCALE_POWER), p_rx_block->rf_timestamp);
+
+                    /* the capture starts with the history before the trigger */
+                    triggered = true;
+                    num_samples = pretrigger_drain(&ring, data_ptr);
+                    if (estimate == true)
+                    {
+                        iq_accumulate_moments(data_ptr, num_samples, &moments);
+                    }
+                    g_capture_stats.first_rf_timestamp = p_rx_block->rf_timestamp - num_samples;
+                    g_capture_stats.first_sys_timestamp = p_rx_block->sys_timestamp;
+                }
 
                 /* see if we have enough space in the buffer to place the new data */
-                if((diff + (tmp_len / 2)) > (FFT_LEN * 2))
+                copy_samples = block_samples;
+                if (copy_samples > (FFT_LEN - num_samples))
                 {
                     /* we have less than the received amount of space left, only copy till full */
-                    tmp_len = (FFT_LEN * 4) - diff * 2;
+                    copy_samples = FFT_LEN - num_samples;
                 }
                 
-                /* copy the block into our memory */
-                memcpy(running_ptr, tmp_ptr, tmp_len);
+                /* copy the block into our memory, checking for clipping as we go, a
+                 * block unpacked into place is only checked */
+                iq_copy_range(&data_ptr[num_samples * 2], tmp_ptr, copy_samples, 
+                        CLIP_LEVEL, &range);
+                if (estimate == true)
+                {
+                    iq_accumulate_moments(tmp_ptr, copy_samples, &moments);
+                }
+                num_samples += copy_samples;
 
-                /* update the pointer pointing to where we are in the data buffer */
-                running_ptr += tmp_len / 2;
+                if (p_rx_block->overload != 0)
+                {
+                    g_capture_stats.overload = true;
+                }
                
                 /* move on to next block */ 
-                curr_block++;
+                g_capture_stats.blocks_received++;
             }
         }
+        else if ( status == skiq_rx_status_error_overrun )
+        {
+            /* the timestamps of the next block will show how much was lost */
+            g_capture_stats.overruns++;
+            log_warn("RX overrun detected");
+        }
         else if ( status != skiq_rx_status_no_data )
         {
             /*
@@ -346,7 +784,9 @@ int32_t get_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rc
         }
     }
 
-    if(status != 0)
+    rt_thread_leave(&rt_state);
+
+    if(status != 0 && status != skiq_rx_status_no_data)
     {
         log_info("Info: finished with error(s)! status %d ", status);
     }
@@ -358,10 +798,376 @@ int32_t get_data(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rc
         log_warn("Warning: failed to stop streaming (status = %" PRIi32 "); continuing... ",
             tmp_status);
     }
+
+    if (g_capture_stats.gaps != 0 || g_capture_stats.overruns != 0)
+    {
+        log_info("capture had %" PRIu32 " gaps, %" PRIu32 " dropped blocks, %" PRIu32 
+                " overruns, %" PRIu32 " restarts (policy %s)", 
+                g_capture_stats.gaps, g_capture_stats.blocks_dropped, g_capture_stats.overruns,
+                g_capture_stats.restarts, gappolicy_cstr(g_gap_policy));
+    }
+
+    g_capture_stats.min_sample = range.min;
+    g_capture_stats.max_sample = range.max;
+    g_capture_stats.clipped_samples = range.clipped;
+    g_capture_stats.gain = p_rx_rconfig->gain;
+
+    if ((estimate == true) && (num_samples == FFT_LEN))
+    {
+        iq_corr_store(p_rx_rconfig->freq, p_rx_rconfig->gain, &moments);
+    }
+
+    free(ring.p_data);
+    free(p_unpacked);
     logging_num = 0;
+
+    if (status == -EIO || status == -ETIMEDOUT || status == -ENOMEM)
+    {
+        return status;
+    }
     return tmp_status;
 }
 
+/******************************************************************************/
+/** Configures the energy trigger used by get_data()
+ * 
+    @param enabled: true to only capture once the threshold is crossed
+    @param threshold_dbfs: mean block power, in dB relative to full scale
+    @param pretrigger_samples: samples before the trigger kept in the capture
+    @param timeout_ms: how long to wait for the trigger
+    @return status
+*/
+int32_t setTrigger(                             bool enabled,
+                                                int32_t threshold_dbfs,
+                                                uint32_t pretrigger_samples,
+                                                uint32_t timeout_ms)
+{
+    log_trace("in setTrigger");
+
+    if (pretrigger_samples > MAX_PRETRIGGER_SAMPLES || threshold_dbfs > 0)
+    {
+        log_error("invalid trigger parameters threshold %" PRIi32 " pretrigger %" PRIu32,
+                threshold_dbfs, pretrigger_samples);
+        return ERROR_COMMAND_LINE;
+    }
+
+    g_trigger_config.enabled = enabled;
+    g_trigger_config.threshold_dbfs = threshold_dbfs;
+    g_trigger_config.pretrigger_samples = pretrigger_samples;
+    g_trigger_config.timeout_ms = timeout_ms;
+
+    log_info("trigger %s threshold %" PRIi32 " dBFS, pretrigger %" PRIu32 " samples, "
+            "timeout %" PRIu32 " ms", bool_cstr(enabled), threshold_dbfs, 
+            pretrigger_samples, timeout_ms);
+
+    return 0;
+}
+
+/******************************************************************************/
+/** Sets the policy used by get_data() when dropped blocks are detected
+ * 
+    @param policy: the new policy
+    @return status
+*/
+int32_t setGapPolicy(                           rx_gap_policy_t policy)
+{
+    log_trace("in setGapPolicy");
+
+    if (policy >= rx_gap_policy_end)
+    {
+        log_error("invalid gap policy %d", policy);
+        return ERROR_COMMAND_LINE;
+    }
+
+    g_gap_policy = policy;
+    log_info("gap policy set to %s", gappolicy_cstr(policy));
+
+    return 0;
+}
+
+/******************************************************************************/
+/** Returns the counters from the last capture
+ * 
+    @param p_stats: where to place the counters
+    @return void
+*/
+void getCaptureStats(                           struct rx_capture_stats *p_stats)
+{
+    *p_stats = g_capture_stats;
+}
+
+/*****************************************************************************/
+/** @brief 
+    Convert string representation to gap policy constant
+
+*/
+rx_gap_policy_t str2gappolicy( const char *str )
+{
+    return \
+        ( 0 == strcasecmp( str, "DISCARD" ) ) ? rx_gap_policy_discard :
+        ( 0 == strcasecmp( str, "ZEROFILL" ) ) ? rx_gap_policy_zero_fill :
+        ( 0 == strcasecmp( str, "REPORT" ) ) ? rx_gap_policy_report :
+        rx_gap_policy_end;
+}
+
+/******************************************************************************/
+/** @brief 
+    Convert rx_gap_policy_t constant to string representation
+
+*/
+const char * gappolicy_cstr( rx_gap_policy_t policy )
+{
+    return \
+        (policy == rx_gap_policy_discard) ? "DISCARD" :
+        (policy == rx_gap_policy_zero_fill) ? "ZEROFILL" :
+        (policy == rx_gap_policy_report) ? "REPORT" :
+        "unknown";
+}
+
+
+/******************************************************************************/
+/** Sets the gain mode used by peakSearch() and getData()
+ * 
+    @param mode: fixed gain or autorange
+    @param gain: the gain index used in fixed mode
+    @return status
+*/
+int32_t setGainMode(                            rx_gain_range_mode_t mode,
+                                                uint8_t gain)
+{
+    int i;
+
+    log_trace("in setGainMode");
+
+    if (mode >= rx_gain_range_end)
+    {
+        log_error("invalid gain mode %d", mode);
+        return ERROR_COMMAND_LINE;
+    }
+
+    g_gain_range_mode = mode;
+    if (mode == rx_gain_range_fixed)
+    {
+        g_fixed_gain = gain;
+        log_info("gain fixed at index %" PRIu8 "", gain);
+    }
+    else
+    {
+        /* start learning the bands again */
+        for (i = 0; i < NUM_GAIN_BANDS; i++)
+        {
+            g_band_gain[i] = -1;
+        }
+        log_info("gain set to autorange");
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
+/** Turns the software DC offset and I/Q imbalance correction on or off, the
+ *  remembered corrections are forgotten either way
+ * 
+    @param enabled: true to correct the captures
+    @return status
+*/
+int32_t setIqCorrection(                        bool enabled)
+{
+    int i;
+
+    log_trace("in setIqCorrection");
+
+    g_iq_corr_enabled = enabled;
+    g_iq_corr = (struct iq_correction) IQ_CORRECTION_INITIALIZER;
+    for (i = 0; i < IQ_CORR_CACHE_SIZE; i++)
+    {
+        g_iq_corr_cache[i].valid = false;
+    }
+    g_iq_corr_age = 0;
+
+    log_info("I/Q correction %s", enabled ? "on" : "off");
+
+    return 0;
+}
+
+/******************************************************************************/
+/** Returns the I/Q correction applied to the last capture
+ * 
+    @param p_corr: where to copy the correction
+    @return void
+*/
+void getIqCorrection(                           struct iq_correction *p_corr)
+{
+    *p_corr = g_iq_corr;
+}
+
+/******************************************************************************/
+/** Selects packed 12 bit samples for the captures
+ * 
+    @param enabled: true to capture packed samples
+    @return status
+*/
+int32_t setPackedMode(                          bool enabled)
+{
+    log_trace("in setPackedMode");
+
+    g_rx_packed = enabled;
+    log_info("captures use %s samples", enabled ? "packed" : "unpacked");
+
+    return 0;
+}
+
+/******************************************************************************/
+/** Determines whether the next capture is packed.  The pack mode applies to 
+ *  the whole card and the generator's tone blocks are unpacked, so captures 
+ *  are not packed while a tone is being transmitted.
+ * 
+    @return true to capture packed samples
+*/
+static bool rx_packed(void)
+{
+    if ((g_rx_packed == true) && (g_tone_thread_running == true))
+    {
+        log_debug("generator running, capturing unpacked samples");
+        return false;
+    }
+
+    return g_rx_packed;
+}
+
+/******************************************************************************/
+/** Determines the gain index to configure before the first capture at a
+ *  frequency, the gain learned for the band if there is one
+ * 
+    @param center_freq: center frequency in MHz
+    @return the gain index
+*/
+static uint8_t initial_gain(uint64_t center_freq)
+{
+    uint32_t band = center_freq / GAIN_BAND_MHZ;
+
+    if ((g_gain_range_mode == rx_gain_range_auto) && (band < NUM_GAIN_BANDS) &&
+        (g_band_gain[band] >= 0))
+    {
+        return (uint8_t)g_band_gain[band];
+    }
+
+    return g_fixed_gain;
+}
+
+/******************************************************************************/
+/** Captures data, in autorange mode the gain is stepped and the data 
+ *  re-captured until it is neither clipped nor underranged.  The gain is 
+ *  bisected between the card's limits so the iterations are bounded, and the 
+ *  result is cached for the band so the next search normally needs one capture.
+ * 
+    @param p_rconfig: the main radio config pointer
+    @param p_rx_rconfig: the RX radio config pointer
+    @return status
+*/
+static int32_t capture(struct radio_config *p_rconfig, struct rx_radio_config *p_rx_rconfig)
+{
+    int32_t status = 0;
+    uint8_t card = p_rconfig->cards[0];
+    skiq_rx_hdl_t hdl = p_rx_rconfig->handles[card][0];
+    uint32_t band = (p_rx_rconfig->freq / 1000000) / GAIN_BAND_MHZ;
+    uint8_t min = 0;
+    uint8_t max = 0;
+    int32_t low = 0;
+    int32_t high = 0;
+    int32_t gain = p_rx_rconfig->gain;
+    uint32_t iteration = 0;
+
+    if (g_gain_range_mode != rx_gain_range_auto)
+    {
+        return get_data(p_rconfig, p_rx_rconfig);
+    }
+
+    log_trace("skiq_read_rx_gain_index_range");
+    status = skiq_read_rx_gain_index_range(card, hdl, &min, &max);
+    if (status != 0)
+    {
+        log_error("Error: failed to read gain index range (status %" PRIi32 ")", status);
+        return status;
+    }
+    low = min;
+    high = max;
+
+    for (iteration = 1; iteration <= MAX_AUTORANGE_ITERATIONS; iteration++)
+    {
+        int16_t peak = 0;
+
+        if (gain != p_rx_rconfig->gain)
+        {
+            log_trace("skiq_write_rx_gain");
+            status = skiq_write_rx_gain(card, hdl, (uint8_t)gain);
+            if (status != 0)
+            {
+                log_error("Error: failed to set gain index to %" PRIi32 " (status %" PRIi32 ")",
+                        gain, status);
+                return status;
+            }
+            p_rx_rconfig->gain = (uint8_t)gain;
+        }
+
+        status = get_data(p_rconfig, p_rx_rconfig);
+        if (status != 0)
+        {
+            return status;
+        }
+        g_capture_stats.autorange_iterations = iteration;
+
+        peak = (-g_capture_stats.min_sample > g_capture_stats.max_sample) ? 
+            -g_capture_stats.min_sample : g_capture_stats.max_sample;
+
+        log_debug("autorange gain %" PRIi32 " peak %" PRIi16 " clipped %" PRIu32 " overload %s",
+                gain, peak, g_capture_stats.clipped_samples, bool_cstr(g_capture_stats.overload));
+
+        if ((g_capture_stats.clipped_samples != 0) || (g_capture_stats.overload == true))
+        {
+            high = gain - 1;
+        }
+        else if (peak < UNDERRANGE_LEVEL)
+        {
+            low = gain + 1;
+        }
+        else
+        {
+            /* this gain is in range */
+            break;
+        }
+
+        /* keep the last capture if there is no better gain or no more tries */
+        if ((low > high) || (iteration == MAX_AUTORANGE_ITERATIONS))
+        {
+            log_info("autorange could not find an in range gain, using %" PRIi32 "", gain);
+            break;
+        }
+
+        gain = (low + high) / 2;
+    }
+
+    if (band < NUM_GAIN_BANDS)
+    {
+        g_band_gain[band] = p_rx_rconfig->gain;
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** @brief 
+    Convert string representation to gain range mode constant
+
+*/
+rx_gain_range_mode_t str2gainmode( const char *str )
+{
+    return \
+        ( 0 == strcasecmp( str, "FIXED" ) ) ? rx_gain_range_fixed :
+        ( 0 == strcasecmp( str, "AUTORANGE" ) ) ? rx_gain_range_auto :
+        rx_gain_range_end;
+}
+
 
 int32_t peakSearch(                             uint8_t card,
                                                 struct radio_config *p_rconfig,
@@ -388,6 +1194,7 @@ int32_t peakSearch(                             uint8_t card,
     /* make the sample rate 20% larger than the span */
     p_rconfig->sample_rate = span + (span * 0.2);
 
+    p_rconfig->packed = rx_packed();
     status = configure_radio(p_rconfig->cards[0], p_rconfig);
     if (status != 0) 
     {
@@ -397,7 +1204,7 @@ int32_t peakSearch(                             uint8_t card,
     }
 
     p_rx_rconfig->freq = (center_freq * 1000000) ;
-    p_rx_rconfig->gain = 10;
+    p_rx_rconfig->gain = initial_gain(center_freq);
     p_rx_rconfig->gain_manual = true;
 
 
@@ -423,11 +1230,15 @@ int32_t peakSearch(                             uint8_t card,
     }
 
     memset(data_ptr, 0, FFT_LEN * 2 * sizeof(int16_t));
+    rt_lock_buffer(data_ptr, FFT_LEN * 2 * sizeof(int16_t));
 
     /* get the data from the radio */
-    status = get_data(p_rconfig, p_rx_rconfig);
+    status = capture(p_rconfig, p_rx_rconfig);
     if (status != 0)
     {
+        /* nothing worth an FFT was captured */
+        free(data_ptr);
+        data_ptr = NULL;
         return status;
     }
 
@@ -438,6 +1249,9 @@ int32_t peakSearch(                             uint8_t card,
     calc_fft(p_rconfig, p_rx_rconfig, peak_freq, peak_power);
     log_debug("in peakSearch, peak_freq %" PRIu64 ", peakpower %" PRIi32 "", *peak_freq, *peak_power);
 
+    free(data_ptr);
+    data_ptr = NULL;
+
     
 return 0;
 }
@@ -447,6 +1261,7 @@ int32_t getData(                                uint8_t card,
                                                 struct rx_radio_config *p_rx_rconfig ,
                                                 uint64_t center_freq,
                                                 uint32_t span,
+                                                uint32_t num_points,
                                                 double *freq_array,
                                                 double *power_array)
 {
@@ -460,6 +1275,13 @@ int32_t getData(                                uint8_t card,
        return -1; 
     }
 
+    /* each point takes the same number of FFT bins */
+    if ((num_points == 0) || (num_points > FFT_LEN) || ((num_points & (num_points - 1)) != 0))
+    {
+        log_error("Error: %" PRIu32 " points is not a power of 2 up to %d", num_points, FFT_LEN);
+        return -EINVAL;
+    }
+
     /* if nothing has changed then don't reconfigure */
     if (p_rconfig->bandwidth/ 1000000 != span || p_rx_rconfig->freq / 1000000 != center_freq)
     { 
@@ -470,7 +1292,8 @@ int32_t getData(                                uint8_t card,
         /* make the sample rate 20% larger than the span */
         p_rconfig->sample_rate = span + (span * 0.2);
 
-        status = configure_radio(p_rconfig->cards[0], p_rconfig);
+        p_rconfig->packed = rx_packed();
+    status = configure_radio(p_rconfig->cards[0], p_rconfig);
         if (status != 0) 
         {
             log_error("Error: Failed radio configure, card %" 
@@ -479,7 +1302,7 @@ int32_t getData(                                uint8_t card,
         }
 
         p_rx_rconfig->freq = (center_freq * 1000000) ;
-        p_rx_rconfig->gain = 10;
+        p_rx_rconfig->gain = initial_gain(center_freq);
         p_rx_rconfig->gain_manual = true;
 
 
@@ -504,16 +1327,23 @@ int32_t getData(                                uint8_t card,
     }
 
     memset(data_ptr, 0, FFT_LEN * 2 * sizeof(int16_t));
+    rt_lock_buffer(data_ptr, FFT_LEN * 2 * sizeof(int16_t));
 
     /* get the data from the radio */
-    status = get_data(p_rconfig, p_rx_rconfig);
+    status = capture(p_rconfig, p_rx_rconfig);
     if (status != 0)
     {
+        /* nothing worth an FFT was captured */
+        free(data_ptr);
+        data_ptr = NULL;
         return status;
     }
 
     /* calculate the fft from the data */
-    fft_data(p_rconfig, p_rx_rconfig, freq_array, power_array);
+    fft_data(p_rconfig, p_rx_rconfig, num_points, freq_array, power_array);
+
+    free(data_ptr);
+    data_ptr = NULL;
     
 return 0;
 }
@@ -15,10 +15,87 @@
 #include "sidekiq_api.h"
 #include "arg_parser.h"
 #include "utils_common.h"
+#include "dsp_kernels.h"
 
 
 #define SWEEPPOINTS     512
 
+/* most points getData() returns, one per FFT bin */
+#define MAX_SWEEPPOINTS 65536
+
+/* What get_data() does when the RF timestamps show that blocks were dropped */
+typedef enum
+{
+    rx_gap_policy_discard=0,    // throw away what was captured and re-acquire
+    rx_gap_policy_zero_fill,    // insert zeros for the missing samples and continue
+    rx_gap_policy_report,       // keep splicing the data but count the gap
+    rx_gap_policy_end
+} rx_gap_policy_t;
+
+/* How peakSearch() and getData() choose the RX gain */
+typedef enum
+{
+    rx_gain_range_fixed=0,      // always use the configured gain index
+    rx_gain_range_auto,         // step the gain until the capture is not clipped or underranged
+    rx_gain_range_end
+} rx_gain_range_mode_t;
+
+/* Energy trigger, when enabled a capture only starts once a block crosses the threshold */
+struct rx_trigger_config
+{
+    bool                enabled;                // false captures immediately
+    int32_t             threshold_dbfs;         // mean block power that fires the trigger
+    uint32_t            pretrigger_samples;     // history kept from before the trigger
+    uint32_t            timeout_ms;             // how long to wait before giving up
+};
+
+#define RX_TRIGGER_CONFIG_INITIALIZER                       \
+{                                                           \
+    .enabled                = false,                        \
+    .threshold_dbfs         = -40,                          \
+    .pretrigger_samples     = 4096,                         \
+    .timeout_ms             = 1000,                         \
+}                                                           \
+
+/* Counters describing the last capture, reset at the start of every capture */
+struct rx_capture_stats
+{
+    uint32_t            blocks_received;        // blocks copied into the capture buffer
+    uint32_t            blocks_dropped;         // blocks missing according to the RF timestamps
+    uint32_t            gaps;                   // number of discontinuities detected
+    uint32_t            overruns;               // overrun status returned by skiq_receive()
+    uint32_t            restarts;               // times the capture was discarded and restarted
+    uint64_t            first_rf_timestamp;     // RF timestamp of the first sample captured
+    uint64_t            last_rf_timestamp;      // RF timestamp of the last block captured
+    uint64_t            first_sys_timestamp;    // System timestamp of the first sample captured
+    uint64_t            last_sys_timestamp;     // System timestamp of the last block captured
+    int16_t             min_sample;             // smallest I or Q value captured
+    int16_t             max_sample;             // largest I or Q value captured
+    uint32_t            clipped_samples;        // I or Q values at the clip level
+    bool                overload;               // overload flag set in a block header
+    uint8_t             gain;                   // gain index used for the capture
+    uint32_t            autorange_iterations;   // captures made to find the gain
+};
+
+#define RX_CAPTURE_STATS_INITIALIZER                        \
+{                                                           \
+    .blocks_received        = 0,                            \
+    .blocks_dropped         = 0,                            \
+    .gaps                   = 0,                            \
+    .overruns               = 0,                            \
+    .restarts               = 0,                            \
+    .first_rf_timestamp     = 0,                            \
+    .last_rf_timestamp      = 0,                            \
+    .first_sys_timestamp    = 0,                            \
+    .last_sys_timestamp     = 0,                            \
+    .min_sample             = 0,                            \
+    .max_sample             = 0,                            \
+    .clipped_samples        = 0,                            \
+    .overload               = false,                        \
+    .gain                   = 0,                            \
+    .autorange_iterations   = 0,                            \
+}                                                           \
+
 
 /*****************************************************************************/
 /** @brief
@@ -43,24 +120,160 @@ extern int32_t peakSearch(                      uint8_t card,
 
 /*****************************************************************************/
 /** @brief
-    Configures 
+    Captures at a center frequency and span and returns the spectrum as
+    num_points powers, each the largest of the FFT bins it covers
 
-    @param[in]      
-    @param[in/out]  
+    @param[in]      card:           the card
+    @param[in/out]  p_rconfig:      the radio config
+    @param[in/out]  p_rx_rconfig:   the RX radio config
+    @param[in]      center_freq:    in MHz
+    @param[in]      span:           in MHz
+    @param[in]      num_points:     a power of 2 up to MAX_SWEEPPOINTS, 
+                                    SWEEPPOINTS for the usual display
+    @param[out]     freq_array:     num_points frequencies in MHz, of the 
+                                    largest bin of each point
+    @param[out]     power_array:    num_points powers in dB
 
-    @return         
+    @return         0 on success, -EINVAL if num_points is not valid, 
+                    -ETIMEDOUT if the trigger did not fire
 
 
-    @note   
+    @note   Point i covers the span from (center - span / 2) + i * span / 
+            num_points.
 */
 extern int32_t getData(                      uint8_t card,
                                                 struct radio_config *p_rconfig,
                                                 struct rx_radio_config *p_rx_rconfig ,
                                                 uint64_t center_freq,
                                                 uint32_t span,
+                                                uint32_t num_points,
                                                 double* freq_array,
                                                 double* power_array);
 
 
+/*****************************************************************************/
+/** @brief
+    Selects how captures handle RF timestamp discontinuities
+
+    @param[in]      policy:         discard, zero fill or report
+
+    @return         0 on success, ERROR_COMMAND_LINE if the policy is invalid
+*/
+extern int32_t setGapPolicy(                    rx_gap_policy_t policy);
+
+/*****************************************************************************/
+/** @brief
+    Configures the energy trigger used by peakSearch() and getData()
+
+    @param[in]      enabled:            true to wait for the threshold before capturing
+    @param[in]      threshold_dbfs:     mean block power (dB relative to full scale)
+    @param[in]      pretrigger_samples: samples from before the trigger to keep
+    @param[in]      timeout_ms:         how long to wait for the trigger
+
+    @return         0 on success, ERROR_COMMAND_LINE if the parameters are invalid
+
+    @note   When the trigger does not fire within the timeout peakSearch() and
+            getData() return -ETIMEDOUT without calculating an FFT
+*/
+extern int32_t setTrigger(                      bool enabled,
+                                                int32_t threshold_dbfs,
+                                                uint32_t pretrigger_samples,
+                                                uint32_t timeout_ms);
+
+/*****************************************************************************/
+/** @brief
+    Selects how the RX gain is chosen for peakSearch() and getData()
+
+    @param[in]      mode:           fixed or autorange
+    @param[in]      gain:           gain index used in fixed mode
+
+    @return         0 on success, ERROR_COMMAND_LINE if the mode is invalid
+
+    @note   In autorange mode each capture is checked for clipping and for being
+            underranged, and the gain is adjusted and the capture repeated up 
+            to a limited number of times.  The gain found is remembered per 
+            100 MHz band and used as the starting gain for later searches.
+*/
+extern int32_t setGainMode(                     rx_gain_range_mode_t mode,
+                                                uint8_t gain);
+
+/*****************************************************************************/
+/** @brief
+    Selects whether peakSearch() and getData() capture packed 12 bit samples
+
+    @param[in]      enabled:        true to use packed samples
+
+    @return         0 on success
+
+    @note   Packed samples need 25% less transport bandwidth.  They are 
+            unpacked as each block is received.  While the generator is 
+            transmitting the captures stay unpacked, the pack mode is shared 
+            with TX.
+*/
+extern int32_t setPackedMode(                   bool enabled);
+
+/*****************************************************************************/
+/** @brief
+    Turns the software DC offset and I/Q imbalance correction on or off
+
+    @param[in]      enabled:        true to correct captures before the FFT
+
+    @return         0 on success
+
+    @note   The DC offset and the gain / phase imbalance are estimated while 
+            the blocks are received and applied when the samples are converted 
+            for the FFT.  The correction is remembered per RX frequency and 
+            gain index so repeated searches at the same setting do not need 
+            to estimate it again.
+*/
+extern int32_t setIqCorrection(                 bool enabled);
+
+/*****************************************************************************/
+/** @brief
+    Returns the I/Q correction applied to the last capture
+
+    @param[out]     p_corr:         where to copy the correction
+
+    @return         void
+*/
+extern void getIqCorrection(                    struct iq_correction *p_corr);
+
+/*****************************************************************************/
+/** @brief Convert string representation to a gain range mode
+
+    @param[in] *str: "FIXED" or "AUTORANGE" (case insensitive)
+
+    @return    rx_gain_range_mode_t, rx_gain_range_end if not valid
+*/
+extern rx_gain_range_mode_t str2gainmode(       const char *str);
+
+/*****************************************************************************/
+/** @brief
+    Returns the counters collected during the last capture
+
+    @param[out]     p_stats:        where to copy the counters
+
+    @return         void
+*/
+extern void getCaptureStats(                    struct rx_capture_stats *p_stats);
+
+/*****************************************************************************/
+/** @brief Convert string representation to a gap policy
+
+    @param[in] *str: "DISCARD", "ZEROFILL" or "REPORT" (case insensitive)
+
+    @return    rx_gap_policy_t, rx_gap_policy_end if not valid
+*/
+extern rx_gap_policy_t str2gappolicy(           const char *str);
+
+/*****************************************************************************/
+/** @brief Convert a gap policy to its string representation
+
+    @param[in] policy: rx_gap_policy_t
+
+    @return    char*:  string representation, "unknown" if invalid
+*/
+extern const char *gappolicy_cstr(              rx_gap_policy_t policy);
+
 #endif
 
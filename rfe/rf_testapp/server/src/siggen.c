@@ -24,21 +24,137 @@
 
 #include <fcntl.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "sidekiq_api.h"
 #include "siggen.h"
+#include "dsp_kernels.h"
+#include "tx_ring.h"
+#include "tone_cache.h"
+#include "rt_profile.h"
 #include "arg_parser.h"
 #include "utils_common.h"
 
 #define DEFAULT_BLOCK_SIZE   65532
 
+/* words per channel of a dual channel block, A1 then A2 fill one default block */
+#define DUAL_BLOCK_SIZE      (DEFAULT_BLOCK_SIZE / 2)
+
 #define TOTAL_TX_BLOCKS      50
+
+/* tone block sizes that are searched, block sizes are 256 * n - 4 words */
+#define MIN_TONE_BLOCK_SIZE  16380
+#define BLOCK_SIZE_STEP      256
+
+/* how far the generated tone may be from the requested offset */
+#define TONE_OFFSET_TOLERANCE_HZ 100
+
+/* keep enough blocks that several can be queued for transmit at once */
+#define MIN_TONE_BLOCKS      10
+
+/* generated tone buffers that are kept for reuse */
+#define TONE_CACHE_BUDGET    (64 * 1024 * 1024)
+
+/* most memory the blocks of a rendered sweep may take, they are kept */
+#define SWEEP_RENDER_BUDGET  (128 * 1024 * 1024)
 #define DEFAULT_SAMPLE_RATE  20000000
 #define DEFAULT_TONE         1000
 #define NUM_LOOP_DOT         5
 #define MAX_POWER_LEVELS     10
 
+/* the TX LO is placed this far below the requested frequency */
+#define TONE_OFFSET_HZ       1000000
+
+/* longest sleep while waiting for a sweep step, so a stop is noticed */
+#define MAX_SLEEP_SLICE_USEC 100000
+
+/* a timed signal starts this long after it is set up, time to queue its 
+ * first blocks, and a timed step polls the TX timestamp for its last part */
+#define TX_TIMED_LEAD_USEC   100000
+#define TX_TIMED_POLL_USEC   500
+
+/* blocks in the pool of the streaming generator, a power of 2 for the rings */
+#define TX_STREAM_BLOCKS     16
+
+/* longest wait for the transmit queue or a ring, so a stop is noticed */
+#define TX_WAIT_TIMEOUT_USEC 100000
+
+/* the TX bandwidth of a played file is this fraction of its sample rate */
+#define FILE_BANDWIDTH_RATIO 0.8
+
+/* samples generated at one frequency along a chirp */
+#define DSWEEP_CHIRP_SEGMENT 32
+
+/* longest multi-tone period, a longer exact period is fitted to a coarser grid */
+#define MULTITONE_MAX_PERIOD (1u << 20)
+
+/* samples of every tone summed at a time, the float I/Q of a chunk stays in L1 */
+#define MULTITONE_CHUNK      1024
+
+/* root raised cosine length in symbols, which is also the taps per phase */
+#define RRC_SPAN_SYMBOLS     12
+#define MAX_MOD_SPS          16
+
+/* symbols, or AM / FM samples, generated at a time by the modulator */
+#define MOD_CHUNK_SYMBOLS    256
+#define MOD_CHUNK            2048
+#define MOD_STAGE_SAMPLES    (MOD_CHUNK_SYMBOLS * MAX_MOD_SPS)
+
+/* samples impaired at a time, the noise and phases of a chunk stay in L1 */
+#define IMPAIR_CHUNK         1024
+
+/* the phase noise is white noise through a first order low pass with this 
+ * corner, stepped every PHASE_NOISE_STEP samples and interpolated between */
+#define PHASE_NOISE_CORNER_HZ 1000.0
+#define PHASE_NOISE_STEP     16
+
+/* the signal power the noise is set from is averaged over about this many blocks */
+#define IMPAIR_POWER_BLOCKS  16
+
+/* the signal is reduced to leave room for this many sigma of noise */
+#define NOISE_PEAK_SIGMAS    4
+
+/* tuned TX configurations, a line of "<card type>\t<sample rate>\t<block 
+ * size>\t<threads>" for each */
+#ifndef TX_TUNE_FILE
+#   define TX_TUNE_FILE      "txtune.cfg"
+#endif
+#define TX_TUNE_ENTRIES      32
+#define TX_TUNE_TYPE_LEN     32
+#define TX_TUNE_MIN_TRIAL_MS 100
+#define TX_TUNE_MAX_TRIAL_MS 5000
+
+/* the bandwidth of a tuning trial is that of a span at this sample rate */
+#define TX_TUNE_BANDWIDTH_RATIO (1 / 1.2)
+
+
+
+/* A tone buffer that loops without a phase discontinuity.  One period of 
+ * period_blocks blocks holds exactly cycles cycles of the tone.
+ */
+struct tone_plan
+{
+    double                      tone;           // tone offset that is generated, Hz
+    uint32_t                    block_size;     // samples per block
+    uint32_t                    period_blocks;  // blocks in one exact period
+    uint32_t                    num_blocks;     // blocks allocated, whole periods
+    uint64_t                    cycles;         // tone cycles in one period
+};
+
+#define TONE_PLAN_INITIALIZER                               \
+{                                                           \
+  .tone                           = DEFAULT_TONE,           \
+  .block_size                     = DEFAULT_BLOCK_SIZE,     \
+  .period_blocks                  = TOTAL_TX_BLOCKS,        \
+  .num_blocks                     = TOTAL_TX_BLOCKS,        \
+  .cycles                         = 0,                      \
+}                                                           \
 
+/* fills the next num_samples I/Q pairs of a streamed signal, returns false 
+ * once the signal has ended, the rest of that block is zeros */
+typedef bool (*tx_fill_fn_t)(int16_t *p_iq, uint32_t num_samples, void *p_arg);
 
 /* Parameters passed to threads
 */
@@ -51,6 +167,16 @@ struct tone_thread_params
   uint32_t                    tone;
   uint32_t                    sample_rate;
   skiq_tx_hdl_t               hdl;
+  struct tone_plan            plan;
+  bool                        async;      // tx_complete() is called for each block
+  struct tx_dsweep_config     dsweep;     // the digital sweep
+  struct tx_mod_config        mod;        // the modulated signal
+  tx_fill_fn_t                fill;       // generates the signal for tx_stream()
+  void                        *p_fill_arg;
+  bool                        timed;      // tx_stream() stamps the blocks
+  uint64_t                    start_timestamp; // of the first block when timed
+  uint8_t                     channels;   // 2 for blocks of A1 then A2 on hdl
+  skiq_tx_block_t             **p_rendered; // sent by tx_tone() in place of a tone
 };
 
 #define TONE_THREAD_PARAMS_INITIALIZER                           \
@@ -61,9 +187,314 @@ struct tone_thread_params
   .init_complete                  = false,                  \
   .tone                           = DEFAULT_TONE,           \
   .sample_rate                    = DEFAULT_SAMPLE_RATE,    \
-  .hdl                            = skiq_tx_hdl_A1          \
+  .hdl                            = skiq_tx_hdl_A1,         \
+  .plan                           = TONE_PLAN_INITIALIZER,  \
+  .async                          = false,                  \
+  .dsweep                         = TX_DSWEEP_CONFIG_INITIALIZER, \
+  .mod                            = TX_MOD_CONFIG_INITIALIZER, \
+  .fill                           = NULL,                   \
+  .p_fill_arg                     = NULL,                   \
+  .timed                          = false,                  \
+  .start_timestamp                = 0,                      \
+  .channels                       = 1,                      \
+  .p_rendered                     = NULL                    \
+}                                                           \
+
+
+/* position within the digital sweep, the argument of fill_dsweep() */
+struct dsweep_state
+{
+    const struct tx_dsweep_config *p_dsweep;
+    uint32_t                    sample_rate;
+    float                       amplitude;
+    uint32_t                    phase;          // NCO phase of the next sample
+    uint32_t                    index;          // current frequency
+    uint32_t                    num_freqs;      // frequencies before repeating
+    uint64_t                    pos;            // samples generated at this frequency
+    uint64_t                    dwell_samples;  // samples per frequency, or per chirp
+};
+
+#define DSWEEP_STATE_INITIALIZER                            \
+{                                                           \
+  .p_dsweep                       = NULL,                   \
+  .sample_rate                    = DEFAULT_SAMPLE_RATE,    \
+  .amplitude                      = 0,                      \
+  .phase                          = 0,                      \
+  .index                          = 0,                      \
+  .num_freqs                      = 1,                      \
+  .pos                            = 0,                      \
+  .dwell_samples                  = 1                       \
+}                                                           \
+
+struct tx_stream;
+
+/* passed through skiq_transmit() so tx_complete() can return the block */
+struct tx_stream_slot
+{
+    struct tx_stream            *p_stream;
+    uint32_t                    index;
+};
+
+/* block pool of tx_stream().  The generator thread pops free blocks, fills 
+ * them and pushes them to the filled ring, the transmit thread pops those and
+ * sends them, then the block goes back to the free ring, from tx_complete() 
+ * in async mode.  A thread with nothing to do sleeps on a tx_event. */
+struct tx_stream
+{
+    skiq_tx_block_t             *p_blocks[TX_STREAM_BLOCKS];
+    struct tx_stream_slot       slots[TX_STREAM_BLOCKS];
+    struct tx_ring              free;           // blocks ready to be filled
+    struct tx_ring              filled;         // blocks ready to be sent
+    pthread_t                   generator;
+    volatile bool               generating;
+    bool                        ended;          // the last block has been filled
+    uint64_t                    free_waits;     // generator waited for a sent block
+    uint64_t                    filled_waits;   // transmit waited for a filled block
+    uint64_t                    first_sent_usec; // when the first block was accepted
+};
+
+#define TX_STREAM_INITIALIZER                               \
+{                                                           \
+  .p_blocks                       = { NULL },               \
+  .slots                          = { { NULL, 0 } },        \
+  .free                           = TX_RING_INITIALIZER,    \
+  .filled                         = TX_RING_INITIALIZER,    \
+  .generator                      = 0,                      \
+  .generating                     = false,                  \
+  .ended                          = false,                  \
+  .free_waits                     = 0,                      \
+  .filled_waits                   = 0,                      \
+  .first_sent_usec                = 0                       \
+}                                                           \
+
+/* IQ file mapped for startPlayFile().  A raw file is int16 I/Q copied into 
+ * the blocks of tx_stream(), a file of skiq_tx_block_t records is sent from 
+ * the mapping without a copy. */
+struct tx_file
+{
+    int                         fd;
+    uint8_t                     *p_map;
+    uint64_t                    size;           // bytes used, whole samples or records
+    uint64_t                    pos;            // next byte to copy, raw files
+    bool                        loop;
+    uint32_t                    record_size;    // bytes per record, 0 for a raw file
+    uint64_t                    num_records;
+};
+
+#define TX_FILE_INITIALIZER                                 \
+{                                                           \
+  .fd                             = -1,                     \
+  .p_map                          = NULL,                   \
+  .size                           = 0,                      \
+  .pos                            = 0,                      \
+  .loop                           = true,                   \
+  .record_size                    = 0,                      \
+  .num_records                    = 0                       \
+}                                                           \
+
+/* a generated period of I/Q looped by fill_loop() */
+struct tx_loop
+{
+    int16_t                     *p_iq;
+    uint32_t                    num_samples;    // I/Q pairs in one period
+    uint32_t                    pos;            // next sample to copy
+};
+
+#define TX_LOOP_INITIALIZER                                 \
+{                                                           \
+  .p_iq                           = NULL,                   \
+  .num_samples                    = 0,                      \
+  .pos                            = 0                       \
+}                                                           \
+
+/* A sweep rendered into transmit blocks by startRenderedSweep().  One loop 
+ * of the blocks holds the sweep repeats times, the blocks are kept for the 
+ * next start of the same sweep.
+ */
+struct sweep_render
+{
+    uint32_t                    start_freq_MHz;
+    uint32_t                    steps;
+    uint32_t                    freq_step_MHz;
+    uint32_t                    step_time_ms;
+    uint32_t                    sample_rate;
+    uint32_t                    amplitude;
+    uint32_t                    block_size;
+    uint32_t                    num_blocks;
+    uint32_t                    repeats;        // sweeps in one loop of the blocks
+    skiq_tx_block_t             **p_blocks;     // NULL until rendered
+    struct tx_sweep_render_info info;
+};
+
+#define SWEEP_RENDER_INITIALIZER                            \
+{                                                           \
+  .start_freq_MHz                 = 0,                      \
+  .steps                          = 0,                      \
+  .freq_step_MHz                  = 0,                      \
+  .step_time_ms                   = 0,                      \
+  .sample_rate                    = 0,                      \
+  .amplitude                      = 0,                      \
+  .block_size                     = 0,                      \
+  .num_blocks                     = 0,                      \
+  .repeats                        = 1,                      \
+  .p_blocks                       = NULL,                   \
+  .info                           = TX_SWEEP_RENDER_INFO_INITIALIZER, \
+}                                                           \
+
+/* the modulator, the argument of fill_mod().  Samples are generated a chunk
+ * at a time into stage and copied out to the blocks. */
+struct mod_state
+{
+    const struct tx_mod_config  *p_mod;
+    uint32_t                    sample_rate;
+    float                       scale;          // float output to int16
+    uint32_t                    prbs;           // LFSR state
+    uint32_t                    prbs_tap;       // the PRBS is x^order + x^prbs_tap + 1
+    uint32_t                    bits_per_symbol;
+    float                       constellation[16][2];   // I/Q of each group of bits
+    float                       coef[RRC_SPAN_SYMBOLS * MAX_MOD_SPS];   // see fir_interp()
+    float                       symbols[2 * (RRC_SPAN_SYMBOLS - 1 + MOD_CHUNK_SYMBOLS)];
+    float                       out[2 * MOD_STAGE_SAMPLES];
+    uint32_t                    phases[MOD_CHUNK];  // FM carrier phase of each sample
+    int16_t                     stage[2 * MOD_STAGE_SAMPLES];
+    uint32_t                    stage_len;      // I/Q pairs in stage
+    uint32_t                    stage_pos;      // next pair to copy out
+    uint32_t                    tone_phase;     // AM / FM modulating tone
+    uint32_t                    tone_inc;
+    uint32_t                    carrier_phase;  // FM
+    float                       fm_step;        // FM carrier phase step at full deviation
+};
+
+#define MOD_STATE_INITIALIZER                               \
+{                                                           \
+  .p_mod                          = NULL,                   \
+  .sample_rate                    = DEFAULT_SAMPLE_RATE,    \
+  .scale                          = 0,                      \
+  .prbs                           = 0,                      \
+  .prbs_tap                       = 0,                      \
+  .bits_per_symbol                = 1,                      \
+  .constellation                  = { { 0 } },              \
+  .coef                           = { 0 },                  \
+  .symbols                        = { 0 },                  \
+  .out                            = { 0 },                  \
+  .phases                         = { 0 },                  \
+  .stage                          = { 0 },                  \
+  .stage_len                      = 0,                      \
+  .stage_pos                      = 0,                      \
+  .tone_phase                     = 0,                      \
+  .tone_inc                       = 0,                      \
+  .carrier_phase                  = 0,                      \
+  .fm_step                        = 0                       \
+}                                                           \
+
+/* the tones of startDualTone(), the argument of fill_dual() */
+struct dual_state
+{
+    struct nco_channel          a1;
+    struct nco_channel          a2;
+};
+
+#define DUAL_STATE_INITIALIZER                              \
+{                                                           \
+  .a1                             = NCO_CHANNEL_INITIALIZER, \
+  .a2                             = NCO_CHANNEL_INITIALIZER  \
+}                                                           \
+
+/* the TX handles of the command line, kept while startDualTone() has 
+ * switched the card to A1 and A2 */
+struct single_tx_config
+{
+    bool                        saved;          // the card is set up for dual TX
+    bool                        all_chans;
+    uint8_t                     nr_handles;
+    skiq_tx_hdl_t               handles[skiq_rx_hdl_end];
+    skiq_chan_mode_t            chan_mode;      // of the card before dual TX
+};
+
+#define SINGLE_TX_CONFIG_INITIALIZER                        \
+{                                                           \
+  .saved                          = false,                  \
+  .all_chans                      = false,                  \
+  .nr_handles                     = 0,                      \
+  .handles                        = { skiq_tx_hdl_A1 },     \
+  .chan_mode                      = skiq_chan_mode_single   \
+}                                                           \
+
+/* the transmit threads of the command line, kept while a tuned 
+ * configuration is used */
+struct tx_threads_config
+{
+    bool                        saved;
+    uint8_t                     num_threads;
+    skiq_tx_transfer_mode_t     transfer_mode;
+};
+
+#define TX_THREADS_CONFIG_INITIALIZER                       \
+{                                                           \
+  .saved                          = false,                  \
+  .num_threads                    = 1,                      \
+  .transfer_mode                  = skiq_tx_transfer_mode_sync \
 }                                                           \
 
+/* the configuration tuneTx() kept for a card type and sample rate */
+struct tx_tune_entry
+{
+    char                        card_type[TX_TUNE_TYPE_LEN];
+    uint32_t                    sample_rate;
+    uint32_t                    block_size;
+    uint8_t                     num_threads;
+};
+
+/* impairments of the streamed signal, applied by tx_generate() to each 
+ * block.  Only the generator thread uses this, the config is copied from 
+ * g_impair_config when g_impair_seq changes. */
+struct impair_state
+{
+    struct tx_impair_config     config;
+    uint32_t                    seq;            // g_impair_seq of config
+    bool                        active;         // any impairment is on
+    float                       backoff;        // gain of the signal
+    float                       noise_ratio;    // noise sigma of I or Q over the signal rms
+    double                      signal_power;   // average I*I + Q*Q, 0 before the first block
+    struct iq_correction        imbalance;
+    uint32_t                    phase_inc;      // frequency offset
+    float                       pn_a;           // phase noise low pass, pn = a * pn + w
+    float                       pn_sigma;       // sigma of w
+    float                       pn;             // low pass output in radians
+    uint32_t                    seg_phase;      // offset phase at the start of the segment
+    uint32_t                    seg_step;       // phase step within the segment
+    uint32_t                    seg_pos;        // samples of the segment done
+    uint32_t                    pn_start;       // phase noise at the start of the segment
+    uint32_t                    pn_end;         // and at its end
+    struct gauss_rng            rng;
+    float                       noise[2 * IMPAIR_CHUNK];
+    float                       pn_noise[(IMPAIR_CHUNK / PHASE_NOISE_STEP) + 2];
+    uint32_t                    phases[IMPAIR_CHUNK];
+};
+
+#define IMPAIR_STATE_INITIALIZER                            \
+{                                                           \
+  .config                         = TX_IMPAIR_CONFIG_INITIALIZER, \
+  .seq                            = 0,                      \
+  .active                         = false,                  \
+  .backoff                        = 1.0f,                   \
+  .noise_ratio                    = 0,                      \
+  .signal_power                   = 0,                      \
+  .imbalance                      = IQ_CORRECTION_INITIALIZER, \
+  .phase_inc                      = 0,                      \
+  .pn_a                           = 0,                      \
+  .pn_sigma                       = 0,                      \
+  .pn                             = 0,                      \
+  .seg_phase                      = 0,                      \
+  .seg_step                       = 0,                      \
+  .seg_pos                        = PHASE_NOISE_STEP,       \
+  .pn_start                       = 0,                      \
+  .pn_end                         = 0,                      \
+  .rng                            = GAUSS_RNG_INITIALIZER,  \
+  .noise                          = { 0 },                  \
+  .pn_noise                       = { 0 },                  \
+  .phases                         = { 0 },                  \
+}                                                           \
 
 struct sweep_thread_params
 {
@@ -78,6 +509,7 @@ struct sweep_thread_params
     uint32_t freq_step_MHz;
     uint32_t step_time_ms;
     uint32_t span_MHz;
+    bool timed;
 };
 
 #define SWEEP_THREAD_PARAMS_INITIALIZER                     \
@@ -92,7 +524,8 @@ struct sweep_thread_params
   .steps                          = 0,                      \
   .freq_step_MHz                  = 0,                      \
   .step_time_ms                   = 0,                      \
-  .span_MHz                       = 0                       \
+  .span_MHz                       = 0,                      \
+  .timed                          = false                   \
 }                                                           \
 
 /***** GLOBAL DATA *****/
@@ -108,46 +541,105 @@ bool tx_streaming = false;
 skiq_tx_block_t **p_tx_blocks = NULL; /* reference to an array of transmit block references */
 uint32_t block_size = DEFAULT_BLOCK_SIZE;
 uint32_t max_amplitude = 0;
+uint8_t num_tx_channels = 0;
+const char *tx_card_type = "none";
 uint16_t attenuation_max = 0;
 uint16_t attenuation_min = 0;
 
 /* mutex to protect updates to the tx buffer */
 pthread_mutex_t tx_buf_mutex = PTHREAD_MUTEX_INITIALIZER;
-// mutex and condition variable to signal when the tx queue may have room available
-pthread_mutex_t space_avail_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t space_avail_cond = PTHREAD_COND_INITIALIZER;
-uint32_t complete_count=0;
+// signalled when the tx queue may have room available or a block is free to fill
+struct tx_event g_tx_space_event = TX_EVENT_INITIALIZER;
+// signals the transmit thread of tx_stream() that a block has been filled
+struct tx_event g_tx_filled_event = TX_EVENT_INITIALIZER;
+// completed, errors and depth are updated from tx_complete() with atomics
+struct tx_queue_stats g_tx_queue_stats = TX_QUEUE_STATS_INITIALIZER;
+
+/* block pool of tx_stream(), global so the slots given to tx_complete() stay valid */
+struct tx_stream g_tx_stream = TX_STREAM_INITIALIZER;
+struct dsweep_state g_dsweep_state = DSWEEP_STATE_INITIALIZER;
+struct tx_file g_tx_file = TX_FILE_INITIALIZER;
+struct tx_loop g_tx_loop = TX_LOOP_INITIALIZER;
+struct sweep_render g_sweep_render = SWEEP_RENDER_INITIALIZER;
+struct mod_state g_mod_state = MOD_STATE_INITIALIZER;
+struct dual_state g_dual_state = DUAL_STATE_INITIALIZER;
+struct single_tx_config g_single_tx_config = SINGLE_TX_CONFIG_INITIALIZER;
+
+/* tuned configurations, read from TX_TUNE_FILE on first use */
+struct tx_tune_entry g_tx_tune[TX_TUNE_ENTRIES];
+uint32_t g_tx_tune_count = 0;
+bool g_tx_tune_loaded = false;
+bool g_tx_tuning = false;   // tuneTx() sets the threads of each trial itself
+struct tx_threads_config g_cmdline_threads = TX_THREADS_CONFIG_INITIALIZER;
+struct nco_channel g_tune_tone = NCO_CHANNEL_INITIALIZER;
+
+/* set by setTxImpairments(), g_impair_seq is incremented after every change */
+pthread_mutex_t g_impair_mutex = PTHREAD_MUTEX_INITIALIZER;
+struct tx_impair_config g_impair_config = TX_IMPAIR_CONFIG_INITIALIZER;
+uint32_t g_impair_seq = 0;
+struct impair_state g_impair_state = IMPAIR_STATE_INITIALIZER;
+
+struct sweep_stats g_sweep_stats = SWEEP_STATS_INITIALIZER;
+
+/* generated tone buffers kept for reuse */
+static void free_cached_blocks(void *p_blocks, uint32_t num_blocks);
+struct tone_cache g_tone_cache = TONE_CACHE_INITIALIZER(TONE_CACHE_BUDGET, free_cached_blocks);
+
+
+
+/*****************************************************************************/
+/** Returns the monotonic time in microseconds
+
+    @return: time in microseconds
+*/
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
 
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
 
 /*****************************************************************************/
 /** This is the callback function for once the data has completed being sent.
     There is no guarantee that the complete callback will be in the order that
-    the data was sent, this function just increments the completion count and
-    signals the main thread that there is space available to send more packets.
+    the data was sent, this function just counts the completion, returns a
+    streamed block to its pool and signals the transmit thread that there is 
+    space available to send more packets.  It takes no locks, it may be called 
+    from several transmit threads at once.
 
     @param status status of the transmit packet completed
     @param p_block reference to the completed transmit block
-    @param p_user reference to the user data
+    @param p_user reference to the user data, the struct tx_stream_slot of the
+                  block for tx_stream(), otherwise NULL
     @return void
 */
 void tx_complete( int32_t status, skiq_tx_block_t *p_data, void *p_user )
 {
+    // increment the packet completed count
+    uint64_t completed = __atomic_add_fetch(&g_tx_queue_stats.completed, 1, __ATOMIC_RELAXED);
+
     if( status != 0 && status != -2)
     {
-        fprintf(stderr, "Error: packet %" PRIu32 " failed with status %d\n",
-                complete_count, status);
+        __atomic_add_fetch(&g_tx_queue_stats.errors, 1, __ATOMIC_RELAXED);
+        fprintf(stderr, "Error: packet %" PRIu64 " failed with status %d\n",
+                completed, status);
     }
 
-    // increment the packet completed count
-    complete_count++;
+    __atomic_sub_fetch(&g_tx_queue_stats.depth, 1, __ATOMIC_RELAXED);
+
+    if (p_user != NULL)
+    {
+        struct tx_stream_slot *p_slot = p_user;
+
+        /* the block can be filled again */
+        tx_ring_push(&p_slot->p_stream->free, p_slot->index);
+    }
 
     // signal to the other thread that there may be space available now that a
     // packet send has completed
-    pthread_mutex_lock( &space_avail_mutex );
-    pthread_cond_signal(&space_avail_cond);
-    pthread_mutex_unlock( &space_avail_mutex );
-
+    tx_event_signal(&g_tx_space_event);
 }
 
 
@@ -169,6 +661,7 @@ static int32_t get_card_params(int card, skiq_tx_hdl_t hdl, uint32_t *max_amplit
     resolution = param.tx_param[hdl].iq_resolution;
     attenuation_max = param.tx_param[hdl].atten_quarter_db_max;
     attenuation_min = param.tx_param[hdl].atten_quarter_db_min;
+    num_tx_channels = param.rf_param.num_tx_channels;
 
 
     *max_amplitude = (uint32_t)(pow(2.0f, resolution -1 ) / 2.0);
@@ -179,28 +672,100 @@ static int32_t get_card_params(int card, skiq_tx_hdl_t hdl, uint32_t *max_amplit
 
 }
 
+/*****************************************************************************/
+/** Plans a tone buffer that is a whole number of tone cycles long, so looping
+ *  it has no phase discontinuity.  The tone offset may move by up to 
+ *  TONE_OFFSET_TOLERANCE_HZ so that it lands on the frequency grid of the 
+ *  buffer; this is the LCM of the wavelength and the block size with the 
+ *  wavelength allowed to be fractional.  The plan needing the fewest blocks 
+ *  wins, then the one closest to the requested offset, then the largest 
+ *  block size.
+
+    @param tone_offset  requested tone offset in Hz
+    @param sample_rate  sample rate in Hz
+    @param max_block_size largest block size to use
+    @param p_plan       the plan
+    @return: void
+*/
+static void plan_tone(uint32_t tone_offset, uint32_t sample_rate, uint32_t max_block_size,
+                      struct tone_plan *p_plan)
+{
+    uint32_t n = 0;
+    uint32_t size = 0;
+    bool found = false;
+    double best_err = 0;
+
+    for (n = 1; n <= TOTAL_TX_BLOCKS; n++)
+    {
+        uint32_t num_blocks = n * ROUND_UP(MIN_TONE_BLOCKS, n);
+
+        for (size = max_block_size; size >= MIN_TONE_BLOCK_SIZE; size -= BLOCK_SIZE_STEP)
+        {
+            uint64_t period = (uint64_t)n * size;
+            uint64_t cycles = llround(((double)tone_offset * period) / sample_rate);
+            double tone = ((double)cycles * sample_rate) / period;
+            double err = fabs(tone - tone_offset);
+
+            if ((cycles == 0) || (err > TONE_OFFSET_TOLERANCE_HZ))
+            {
+                continue;
+            }
+
+            if ((found == false) || (num_blocks < p_plan->num_blocks) ||
+                ((num_blocks == p_plan->num_blocks) && (err < best_err)))
+            {
+                p_plan->tone = tone;
+                p_plan->block_size = size;
+                p_plan->period_blocks = n;
+                p_plan->num_blocks = num_blocks;
+                p_plan->cycles = cycles;
+                best_err = err;
+                found = true;
+            }
+        }
+    }
+
+    if (found == false)
+    {
+        /* not possible within the tolerance, the loop will have a discontinuity */
+        *p_plan = (struct tone_plan) TONE_PLAN_INITIALIZER;
+        p_plan->tone = tone_offset;
+        p_plan->block_size = max_block_size;
+        log_warn("no phase continuous tone buffer for offset %" PRIu32 " at %" PRIu32 
+                " samples per second", tone_offset, sample_rate);
+        return;
+    }
+
+    log_debug("tone %.1f Hz, %" PRIu64 " cycles in %" PRIu32 " blocks of %" PRIu32 
+            ", %" PRIu32 " blocks allocated", p_plan->tone, p_plan->cycles, 
+            p_plan->period_blocks, p_plan->block_size, p_plan->num_blocks);
+}
+
 /*****************************************************************************/
 /** This function will initialize the TX buffer pool with I/Q values of the
- ** predefined tone
+ ** predefined tone.  Each block starts at its exact phase within the period 
+ ** so rounding in the phase step does not build up across the buffer.
 
-    @param none
+    @param p_plan       the planned tone buffer
+    @param sample_rate  sample rate in Hz
     @return: status
 */
-static int32_t init_tx_buffer(uint32_t tone_offset, uint32_t sample_rate)
+static int32_t init_tx_buffer(const struct tone_plan *p_plan, uint32_t sample_rate)
 {
     int32_t status = 0;
     uint32_t i = 0;
     uint32_t j = 0;
     int16_t * word_ptr;
     uint32_t tot_blocks;
-    uint32_t sample_ctr = 0;
+    uint32_t phase = 0;
+    uint32_t phase_inc = 0;
+    uint64_t period = (uint64_t)p_plan->period_blocks * p_plan->block_size;
 
     log_trace ("init_tx_buffer");
-    log_debug("offset %d, sample_rate %d, max_amplitude %d ", tone_offset, sample_rate, max_amplitude);
-
-    tot_blocks = TOTAL_TX_BLOCKS;
-
+    log_debug("offset %.1f, sample_rate %d, max_amplitude %d ", p_plan->tone, sample_rate, 
+            max_amplitude);
 
+    tot_blocks = p_plan->num_blocks;
 
     // allocate the buffer of block pointers
     p_tx_blocks = calloc( tot_blocks, sizeof( skiq_tx_block_t* ) );
@@ -213,15 +778,15 @@ static int32_t init_tx_buffer(uint32_t tone_offset, uint32_t sample_rate)
         goto finished;
     }
   
-    /* define nu and amplitude for the tone */ 
-    float nu = 2 * M_PI * (float)tone_offset/(float)sample_rate ;
+    /* define the phase step and amplitude for the tone */ 
+    phase_inc = nco_phase_inc(p_plan->tone, sample_rate);
     float A = max_amplitude / M_SQRT2;
 
     /* insert the tone into the I/Q */
     for (i = 0; i < tot_blocks; i++)
     {
         /* allocate a transmit block by number of samples */
-        p_tx_blocks[i] = skiq_tx_block_allocate( block_size );
+        p_tx_blocks[i] = skiq_tx_block_allocate( p_plan->block_size );
 
         if ( p_tx_blocks[i] == NULL )
         {
@@ -229,20 +794,22 @@ static int32_t init_tx_buffer(uint32_t tone_offset, uint32_t sample_rate)
             status = -2;
             goto finished;
         }
+        rt_lock_buffer(p_tx_blocks[i], 
+                sizeof(skiq_tx_block_t) + (p_plan->block_size * sizeof(uint32_t)));
 
         word_ptr = p_tx_blocks[i]->data;
 
-        /* loop through each sample */
-        /* word_ptr is an int16_t array one for I and one for Q per sample */ 
-        for (j = 0; j < block_size; j+= 1)
+        if (p_plan->cycles != 0)
         {
-            /* insert I */
-            word_ptr[2 * j] = (int16_t)(cos(nu * ((1.0 * sample_ctr) )) * A);
+            /* phase of the first sample of the block as a fraction of a cycle */
+            uint64_t offset = ((uint64_t)(i % p_plan->period_blocks) * p_plan->block_size) % period;
+            uint64_t fraction = ((p_plan->cycles % period) * offset) % period;
 
-            /* insert Q */
-            word_ptr[2 * j + 1] = (int16_t)(sin(nu * ((1.0 * sample_ctr) )) * A);
-            sample_ctr++;
+            phase = (uint32_t)((fraction << 32) / period);
         }
+
+        /* word_ptr is an int16_t array one for I and one for Q per sample */ 
+        nco_tone(word_ptr, p_plan->block_size, &phase, phase_inc, A);
     }
 
 finished:
@@ -263,106 +830,337 @@ finished:
 
     return status;
 }
-static void *tx_tone(void *params)
+/*****************************************************************************/
+/** Frees a set of transmit blocks
+
+    @param p_blocks     the blocks
+    @param num_blocks   number of blocks
+    @return: void
+*/
+static void free_tx_blocks(skiq_tx_block_t **p_blocks, uint32_t num_blocks)
 {
-    int status = 0 ;
-    uint32_t curr_block=0;
-    int32_t tmp_status=0;
-    uint32_t errors=0;
-    uint32_t tot_errors=0;
-    uint32_t j = 0;
-    bool tx_streaming = false;
-    uint32_t num_blocks = TOTAL_TX_BLOCKS;
-    uint64_t xmit_ctr = 0;
+    uint32_t i;
+
+    for (i = 0; i < num_blocks; i++)
+    {
+        skiq_tx_block_free(p_blocks[i]);
+    }
+    free(p_blocks);
+}
 
+/*****************************************************************************/
+/** Frees the blocks of a tone buffer evicted from the cache
 
-    struct tone_thread_params *p_tone_thread_params = params;
+    @param p_blocks     the blocks
+    @param num_blocks   number of blocks
+    @return: void
+*/
+static void free_cached_blocks(void *p_blocks, uint32_t num_blocks)
+{
+    log_debug("evicting tone buffer of %" PRIu32 " blocks", num_blocks);
 
-    log_trace("in tx_tone");
+    free_tx_blocks(p_blocks, num_blocks);
+}
+
+/*****************************************************************************/
+/** Gets the tone buffer for the thread into p_tx_blocks, from the cache if 
+ *  the same tone was generated before, otherwise it is generated and cached 
+ *  if it fits in the budget.
+
+    @param p_params     the tone thread parameters
+    @param p_num_blocks set to the number of blocks in p_tx_blocks, the cached
+                        count on a hit
+    @return: status
+*/
+static int32_t acquire_tone_buffer(const struct tone_thread_params *p_params, 
+                                   uint32_t *p_num_blocks)
+{
+    int32_t status = 0;
+    const struct tone_plan *p_plan = &p_params->plan;
+    uint64_t bytes = (uint64_t)p_plan->num_blocks * p_plan->block_size * 2 * sizeof(int16_t);
+    struct tone_cache_key key = TONE_CACHE_KEY_INITIALIZER;
+    void *p_blocks = NULL;
 
+    key.tone_offset = p_params->tone;
+    key.sample_rate = p_params->sample_rate;
+    key.amplitude = max_amplitude;
+    key.block_size = p_plan->block_size;
 
-    // initialize the transmit buffer
-    status = init_tx_buffer(p_tone_thread_params->tone, p_tone_thread_params->sample_rate);
+    if (tone_cache_get(&g_tone_cache, &key, &p_blocks, p_num_blocks) == true)
+    {
+        p_tx_blocks = p_blocks;
+        log_debug("tone buffer offset %" PRIu32 " rate %" PRIu32 " from cache (%" PRIu32 
+                " blocks)", p_params->tone, p_params->sample_rate, *p_num_blocks);
+        return 0;
+    }
+
+    status = init_tx_buffer(p_plan, p_params->sample_rate);
     if (status != 0)
     {
-        goto cleanup;
+        return status;
     }
+    *p_num_blocks = p_plan->num_blocks;
 
-    // enable the Tx streaming
-    status = skiq_start_tx_streaming(p_tone_thread_params->card, p_tone_thread_params->hdl);
-    if ( status != 0 )
+    /* if it is not cached it is freed when the tone stops */
+    (void)tone_cache_put(&g_tone_cache, &key, p_tx_blocks, *p_num_blocks, bytes);
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Gives p_tx_blocks back to the cache, or frees it if it is not cached
+
+    @param num_blocks   number of blocks in p_tx_blocks
+    @return: void
+*/
+static void release_tone_buffer(uint32_t num_blocks)
+{
+    if (p_tx_blocks == NULL)
     {
-        log_error( "Error: unable to start streaming (result code %"
-                PRIi32 ") ", status);
-        goto cleanup;
+        return;
     }
 
-    tx_streaming = true;
+    if (tone_cache_release(&g_tone_cache, p_tx_blocks) == false)
+    {
+        free_tx_blocks(p_tx_blocks, num_blocks);
+    }
+    p_tx_blocks = NULL;
+}
 
-    log_debug("Info: successfully started streaming ");
+/*****************************************************************************/
+/** Frees every cached tone buffer that is not being transmitted
 
-    uint64_t loop_ctr = 0;
-    while (g_tone_thread_running)
+    @return: void
+*/
+void clearToneCache(void)
+{
+    log_trace("in clearToneCache");
+
+    tone_cache_clear(&g_tone_cache);
+}
+
+/*****************************************************************************/
+/** Sends one block, waiting for room while the queue is full.  In async mode
+ *  the block is counted in flight before it is sent since its completion can 
+ *  run before skiq_transmit() returns.
+
+    @param p_params     the tone thread parameters
+    @param p_block      the block to send
+    @param p_user       passed to tx_complete()
+    @return: status, SKIQ_TX_ASYNC_SEND_QUEUE_FULL only if stopped while waiting
+*/
+static int32_t transmit_block(const struct tone_thread_params *p_params, 
+                              skiq_tx_block_t *p_block, void *p_user)
+{
+    struct tx_queue_stats *p_stats = &g_tx_queue_stats;
+    int32_t status = 0;
+
+    do
     {
-        if (loop_ctr % 50 == 0)
+        /* taken before sending so a completion in between is not missed */
+        uint32_t seq = tx_event_prepare(&g_tx_space_event);
+        uint32_t depth = 0;
+
+        if (p_params->async)
         {
-            log_info("Transmitting Tone...");
+            depth = __atomic_add_fetch(&p_stats->depth, 1, __ATOMIC_RELAXED);
         }
-        loop_ctr++;
 
-        // transmit a block at a time
-        while( (curr_block < num_blocks) && (g_tone_thread_running==true) )
+        status = skiq_transmit(p_params->card, p_params->hdl, p_block, p_user);
+        if (status == 0)
         {
-            // transmit the data
-            status = skiq_transmit(p_tone_thread_params->card, p_tone_thread_params->hdl, 
-                    p_tx_blocks[curr_block], NULL );
-            if( status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL )
+            if (p_params->async)
             {
-
-                // if there's no space left to send, wait until there should be space available
-                if( g_tone_thread_running == true )
+                if ((depth == 1) && (p_stats->sent != 0))
+                {
+                    p_stats->queue_empty++;
+                }
+                if (depth > p_stats->max_depth)
                 {
-                    pthread_mutex_lock( &space_avail_mutex );
-                    pthread_cond_wait( &space_avail_cond, &space_avail_mutex );
-                        pthread_mutex_unlock( &space_avail_mutex );
+                    p_stats->max_depth = depth;
                 }
+                p_stats->depth_total += depth;
             }
-            else if ( status != 0 )
+            p_stats->sent++;
+        }
+        else
+        {
+            if (p_params->async)
             {
-                log_error( "Error: failed to transmit data (result code %" PRIi32 ") ", status);
-                goto cleanup;
+                __atomic_sub_fetch(&p_stats->depth, 1, __ATOMIC_RELAXED);
             }
-            curr_block++;
-        }
 
-        // see how many underruns we had 
-        status = skiq_read_tx_num_underruns(p_tone_thread_params->card, 
-                p_tone_thread_params->hdl, &errors);
-        if (status != 0)
-        {
-            log_error( "Error: failed to receive underruns (result code %" PRIi32 ") ", status);
-            goto cleanup;
+            if ((status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL) && (g_tone_thread_running == true))
+            {
+                // if there's no space left to send, wait until there should be space available
+                p_stats->queue_full++;
+                tx_event_wait(&g_tx_space_event, seq, TX_WAIT_TIMEOUT_USEC);
+            }
         }
+    } while ((status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL) && (g_tone_thread_running == true));
 
-        // errors returned are the number since last starting of transmit, so only report
-        // when it has changed
-        if (tot_errors != errors)
-        {
-            log_debug(" Info: total number of tx underruns is %u ", errors);
+    return status;
+}
 
-            /* the FPGA does not clear this so every call will return the last */
-            tot_errors = errors;
-        }
-        
-        /* give some visible indication to the user that we are transmitting */
-        if ( xmit_ctr % NUM_LOOP_DOT == 0)
-        {
-            //log_debug(". ");
-        }
+/*****************************************************************************/
+/** Reads the underrun count and reports it when it changes
 
-        curr_block = 0;
-        xmit_ctr++;
-    }
+    @param p_params     the tone thread parameters
+    @param p_tot_errors the last count read, updated
+    @return: status
+*/
+static int32_t check_underruns(const struct tone_thread_params *p_params, uint32_t *p_tot_errors)
+{
+    int32_t status = 0;
+    uint32_t errors = 0;
+
+    status = skiq_read_tx_num_underruns(p_params->card, p_params->hdl, &errors);
+    if (status != 0)
+    {
+        log_error( "Error: failed to receive underruns (result code %" PRIi32 ") ", status);
+        return status;
+    }
+
+    // errors returned are the number since last starting of transmit, so only report
+    // when it has changed
+    if (*p_tot_errors != errors)
+    {
+        log_debug(" Info: total number of tx underruns is %u ", errors);
+        *p_tot_errors = errors;
+        g_tx_queue_stats.underruns = errors;
+    }
+
+    if (p_params->timed == true)
+    {
+        status = skiq_read_tx_num_late_timestamps(p_params->card, p_params->hdl, &errors);
+        if (status != 0)
+        {
+            log_error( "Error: failed to read late timestamps (result code %" PRIi32 ") ", 
+                    status);
+            return status;
+        }
+        if (g_sweep_stats.late_blocks != errors)
+        {
+            log_warn("%" PRIu32 " blocks were late for their timestamp", errors);
+            g_sweep_stats.late_blocks = errors;
+        }
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Waits for the blocks in flight to complete before a signal that has 
+ *  ended stops streaming, so its last blocks are not cut off
+
+    @param p_params     the tone thread parameters
+    @return: void
+*/
+static void wait_tx_drained(const struct tone_thread_params *p_params)
+{
+    /* a completion that never comes must not hang the thread */
+    uint32_t waits = 1000000 / TX_WAIT_TIMEOUT_USEC;
+
+    while ((p_params->async == true) && (waits-- > 0) && (g_tone_thread_running == true))
+    {
+        uint32_t seq = tx_event_prepare(&g_tx_space_event);
+
+        if (__atomic_load_n(&g_tx_queue_stats.depth, __ATOMIC_RELAXED) == 0)
+        {
+            break;
+        }
+        tx_event_wait(&g_tx_space_event, seq, TX_WAIT_TIMEOUT_USEC);
+    }
+}
+
+static void *tx_tone(void *params)
+{
+    int status = 0 ;
+    uint32_t curr_block=0;
+    int32_t tmp_status=0;
+    uint32_t tot_errors=0;
+    bool tx_streaming = false;
+    uint64_t xmit_ctr = 0;
+
+
+    struct tone_thread_params *p_tone_thread_params = params;
+    uint32_t num_blocks = p_tone_thread_params->plan.num_blocks;
+
+    log_trace("in tx_tone");
+
+
+    // initialize the transmit buffer, a rendered sweep is already in blocks
+    if (p_tone_thread_params->p_rendered != NULL)
+    {
+        p_tx_blocks = p_tone_thread_params->p_rendered;
+    }
+    else
+    {
+        /* a cached buffer is transmitted whole, its count may differ from the plan */
+        status = acquire_tone_buffer(p_tone_thread_params, &num_blocks);
+        if (status != 0)
+        {
+            goto cleanup;
+        }
+    }
+
+    // enable the Tx streaming
+    status = skiq_start_tx_streaming(p_tone_thread_params->card, p_tone_thread_params->hdl);
+    if ( status != 0 )
+    {
+        log_error( "Error: unable to start streaming (result code %"
+                PRIi32 ") ", status);
+        goto cleanup;
+    }
+
+    tx_streaming = true;
+
+    log_debug("Info: successfully started streaming ");
+
+    uint64_t loop_ctr = 0;
+    while (g_tone_thread_running)
+    {
+        if (loop_ctr % 50 == 0)
+        {
+            log_info("Transmitting Tone...");
+        }
+        loop_ctr++;
+
+        // transmit a block at a time
+        while( (curr_block < num_blocks) && (g_tone_thread_running==true) )
+        {
+            // transmit the data, a block is never skipped so the tone stays continuous
+            status = transmit_block(p_tone_thread_params, p_tx_blocks[curr_block], NULL);
+            if( status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL )
+            {
+                /* stopped while waiting for room */
+                status = 0;
+                break;
+            }
+            else if ( status != 0 )
+            {
+                log_error( "Error: failed to transmit data (result code %" PRIi32 ") ", status);
+                goto cleanup;
+            }
+            curr_block++;
+        }
+
+        // see how many underruns we had 
+        status = check_underruns(p_tone_thread_params, &tot_errors);
+        if (status != 0)
+        {
+            goto cleanup;
+        }
+        
+        /* give some visible indication to the user that we are transmitting */
+        if ( xmit_ctr % NUM_LOOP_DOT == 0)
+        {
+            //log_debug(". ");
+        }
+
+        curr_block = 0;
+        xmit_ctr++;
+    }
 
 cleanup:
     // disable streaming, cleanup and shutdown
@@ -380,148 +1178,2865 @@ cleanup:
         tx_streaming = false;
     }
 
-    if (NULL != p_tx_blocks)
+    /* keep the blocks for the next time this tone is needed, a rendered 
+     * sweep keeps its own */
+    if (p_tone_thread_params->p_rendered != NULL)
     {
-
-        for (j = 0; j < num_blocks; j++)
-        {
-            skiq_tx_block_free(p_tx_blocks[j]);
-        }
-
-
-        free(p_tx_blocks);
-
         p_tx_blocks = NULL;
     }
+    else
+    {
+        release_tone_buffer(num_blocks);
+    }
 
 
     return (void *)(intptr_t)status;
 }
 
 
-int32_t startCW(                                uint8_t card,
-                                                struct radio_config *p_rconfig,
-                                                struct tx_radio_config *p_tx_rconfig ,
-                                                uint64_t freq_MHz,
-                                                uint32_t span_MHz,
-                                                uint32_t power_level)
+
+/*****************************************************************************/
+/** Returns the frequency of a stepped or list sweep
+
+    @param p_dsweep     the digital sweep
+    @param index        the step
+    @return: offset from the center frequency in Hz
+*/
+static double dsweep_step_freq(const struct tx_dsweep_config *p_dsweep, uint32_t index)
 {
-    int status = 0;
-    const char * card_type = "none";
-    uint32_t tone_offset = 1000000;
-    skiq_tx_hdl_t hdl = skiq_tx_hdl_A1;
-    uint32_t span;
+    if (p_dsweep->mode == tx_dsweep_list)
+    {
+        return p_dsweep->list_offset_hz[index];
+    }
 
-    log_trace("in startCW");
+    if (p_dsweep->steps < 2)
+    {
+        return p_dsweep->start_offset_hz;
+    }
 
-    /* if the server is not running, exit */
-    if (g_running == 0)
+    return p_dsweep->start_offset_hz + 
+        (((double)p_dsweep->stop_offset_hz - p_dsweep->start_offset_hz) * index / 
+         (p_dsweep->steps - 1));
+}
+
+/*****************************************************************************/
+/** Fills I/Q samples with the next part of the digital sweep.  The NCO phase 
+ *  carries on across frequencies and calls so there are no discontinuities, 
+ *  and the frequency changes exactly dwell_samples after the last change.  
+ *  A chirp is generated in short segments, each at the frequency of the ramp 
+ *  at the middle of the segment.
+
+    @param p_iq         I/Q output
+    @param num_samples  number of I/Q pairs
+    @param p_arg        the struct dsweep_state, updated
+    @return: true, the sweep repeats
+*/
+static bool fill_dsweep(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct dsweep_state *p_state = p_arg;
+    const struct tx_dsweep_config *p_dsweep = p_state->p_dsweep;
+
+    while (num_samples > 0)
     {
-       return -1; 
+        uint64_t left = p_state->dwell_samples - p_state->pos;
+        uint32_t count = (left < num_samples) ? (uint32_t)left : num_samples;
+        double freq;
+
+        if (p_dsweep->mode == tx_dsweep_chirp)
+        {
+            if (count > DSWEEP_CHIRP_SEGMENT)
+            {
+                count = DSWEEP_CHIRP_SEGMENT;
+            }
+            freq = p_dsweep->start_offset_hz + 
+                (((double)p_dsweep->stop_offset_hz - p_dsweep->start_offset_hz) * 
+                 (p_state->pos + (count / 2.0)) / p_state->dwell_samples);
+        }
+        else
+        {
+            freq = dsweep_step_freq(p_dsweep, p_state->index);
+        }
+
+        nco_tone(p_iq, count, &p_state->phase, nco_phase_inc(freq, p_state->sample_rate), 
+                p_state->amplitude);
+        p_iq += 2 * count;
+        num_samples -= count;
+
+        p_state->pos += count;
+        if (p_state->pos == p_state->dwell_samples)
+        {
+            p_state->pos = 0;
+            p_state->index = (p_state->index + 1) % p_state->num_freqs;
+        }
     }
 
-    /* if the tone thread is already running stop it*/
-    if (g_tone_thread_running != 0)
+    return true;
+}
+
+/*****************************************************************************/
+/** Sets up the digital sweep for fill_dsweep()
+
+    @param p_state      the sweep state to set up
+    @param p_dsweep     the digital sweep
+    @param sample_rate  sample rate in Hz
+    @param amplitude    peak amplitude
+    @return: void
+*/
+static void init_dsweep_state(struct dsweep_state *p_state, const struct tx_dsweep_config *p_dsweep,
+                              uint32_t sample_rate, float amplitude)
+{
+    *p_state = (struct dsweep_state) DSWEEP_STATE_INITIALIZER;
+    p_state->p_dsweep = p_dsweep;
+    p_state->sample_rate = sample_rate;
+    p_state->amplitude = amplitude;
+
+    p_state->dwell_samples = (((uint64_t)p_dsweep->dwell_usec * sample_rate) + 500000) / 1000000;
+    if (p_state->dwell_samples == 0)
     {
-        /* get everything to stop */
-        intptr_t thread_status;
+        p_state->dwell_samples = 1;
+    }
+    if (p_dsweep->mode == tx_dsweep_stepped)
+    {
+        p_state->num_freqs = p_dsweep->steps;
+    }
+    else if (p_dsweep->mode == tx_dsweep_list)
+    {
+        p_state->num_freqs = p_dsweep->num_list;
+    }
 
-        g_tone_thread_running = false;
+    log_debug("%s sweep, %" PRIu32 " frequencies, %" PRIu64 " samples each", 
+            dsweepmode_cstr(p_dsweep->mode), p_state->num_freqs, p_state->dwell_samples);
+}
 
-        /* wait till threads done */
-        pthread_join(g_tone_thread_parameters.tone_thread, (void *)&thread_status); 
+/*****************************************************************************/
+/** Frees the block pool and the rings of the streaming generator
+
+    @param p_stream     the block pool
+    @return: void
+*/
+static void free_tx_stream(struct tx_stream *p_stream)
+{
+    uint32_t i;
+
+    for (i = 0; i < TX_STREAM_BLOCKS; i++)
+    {
+        if (p_stream->p_blocks[i] != NULL)
+        {
+            skiq_tx_block_free(p_stream->p_blocks[i]);
+            p_stream->p_blocks[i] = NULL;
+        }
     }
+    tx_ring_free(&p_stream->free);
+    tx_ring_free(&p_stream->filled);
+}
 
-    /* configure card with correct frequency and bandwidth */
-    span = span_MHz * 1000000;
-    p_rconfig->bandwidth = span ;
+/*****************************************************************************/
+/** Allocates the block pool of the streaming generator, every block starts 
+ *  in the free ring
 
-    /* make the sample rate 20% larger than the span */
-    p_rconfig->sample_rate = span + (span * 0.2);
+    @param p_stream     the block pool
+    @param channels     block_size words of each channel per block
+    @return: status
+*/
+static int32_t init_tx_stream(struct tx_stream *p_stream, uint8_t channels)
+{
+    int32_t status = 0;
+    uint32_t i;
 
-    /* get the card into I/Q order mode */
-    p_rconfig->sample_order_iq = skiq_iq_order_iq;
+    *p_stream = (struct tx_stream) TX_STREAM_INITIALIZER;
 
-    status = configure_radio(p_rconfig->cards[0], p_rconfig);
-    if (status != 0) 
+    status = tx_ring_init(&p_stream->free, TX_STREAM_BLOCKS);
+    if (status == 0)
     {
-        log_error( "Error: Failed radio configure, card %" 
-                PRIi32 " status %" PRIi32 "  ", card, status);
-        return status;
+        status = tx_ring_init(&p_stream->filled, TX_STREAM_BLOCKS);
+    }
+    if (status != 0)
+    {
+        log_error( "Error: unable to allocate the transmit rings (status %" PRIi32 ")", status);
+        goto finished;
     }
 
-    /* determine how many bits of resolution the card type has */
-    /* that determines the maximum amplitude of the signal */
-    /* this must be done after skiq_init and before initializing the buffers */
-    status = get_card_params(p_rconfig->cards[0], hdl, &max_amplitude, &card_type);
+    for (i = 0; i < TX_STREAM_BLOCKS; i++)
+    {
+        p_stream->p_blocks[i] = skiq_tx_block_allocate( block_size * channels );
+        if (p_stream->p_blocks[i] == NULL)
+        {
+            log_error( "Error: unable to allocate transmit block data ");
+            status = -ENOMEM;
+            goto finished;
+        }
+        rt_lock_buffer(p_stream->p_blocks[i], 
+                sizeof(skiq_tx_block_t) + (block_size * channels * sizeof(uint32_t)));
+        p_stream->slots[i].p_stream = p_stream;
+        p_stream->slots[i].index = i;
+        tx_ring_push(&p_stream->free, i);
+    }
+
+finished:
     if (status != 0)
     {
-        log_error( "Error: unable to access card parameters (status % " 
-                PRIi32 " ", status); 
-        return status;
+        free_tx_stream(p_stream);
     }
-    /* it would be good to not transmit on the center frequency, so lets drop the 
-     * center frequency to below the desired tone by "tone_offset" amount.
-     * Then generate a tone of tone_offset amount */
-    p_tx_rconfig->freq = (freq_MHz * 1000000) - tone_offset;
-    p_tx_rconfig->block_size_in_words = block_size;
-    log_debug("freq %ld, span %d, tone offset %d ", p_tx_rconfig->freq, span, tone_offset);
 
-    /* convert power to attenuation */
-    int diff = attenuation_max -attenuation_min;
+    return status;
+}
 
-    /* there are 10 different power levels allowed 
-     * So divide the range of the power into 10 levels
-     * Set the attenuation based on the power level sent in */
-    int att_per_level = diff/MAX_POWER_LEVELS;
+/*****************************************************************************/
+/** Gain of the signal with noise added.  The signal peaks near full scale 
+ *  and its rms is at most sqrt(2) times the peak of I or Q, so the noise 
+ *  sigma of I or Q is at most the peak / sqrt(SNR).
 
-    log_debug("att max %d, att min %d, diff %d, dB range %d, att_per_level %d ", 
-            attenuation_max, attenuation_min, diff, diff / 4, att_per_level);
+    @param p_impair     the impairments
+    @return: gain that leaves room for NOISE_PEAK_SIGMAS of the noise
+*/
+static float impair_backoff(const struct tx_impair_config *p_impair)
+{
+    if (p_impair->noise == false)
+    {
+        return 1.0f;
+    }
 
-    /* 0 is the maximum attenuation, so the quietest */
-    p_tx_rconfig->attenuation = attenuation_max + (-att_per_level * power_level);
-   
+    return (float)(1.0 / (1.0 + (NOISE_PEAK_SIGMAS / sqrt(pow(10.0, p_impair->snr_db / 10.0)))));
+}
 
-    status = configure_tx_radio(p_rconfig->cards[0], p_rconfig, p_tx_rconfig);
-    if (status != 0) 
+/*****************************************************************************/
+/** Takes the impairments set by setTxImpairments().  The signal power, the 
+ *  phase noise and the offset phase carry on, so a change while the signal
+ *  runs has no discontinuity other than the one asked for.
+
+    @param p_state      the impairments of the stream
+    @param sample_rate  sample rate in Hz
+    @return: void
+*/
+static void update_impair_state(struct impair_state *p_state, uint32_t sample_rate)
+{
+    const struct tx_impair_config *p_config = &p_state->config;
+    double iq_gain, iq_phase, corner;
+
+    pthread_mutex_lock(&g_impair_mutex);
+    p_state->config = g_impair_config;
+    p_state->seq = __atomic_load_n(&g_impair_seq, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_impair_mutex);
+
+    p_state->active = (p_config->noise == true) || (p_config->freq_offset_hz != 0) || 
+        (p_config->phase_noise_deg != 0) || (p_config->iq_gain_db != 0) || 
+        (p_config->iq_phase_deg != 0);
+    p_state->backoff = impair_backoff(p_config);
+    p_state->noise_ratio = (float)(1.0 / sqrt(2 * pow(10.0, p_config->snr_db / 10.0)));
+
+    /* Q' = G * (sin(phi) * I + cos(phi) * Q) */
+    iq_gain = pow(10.0, p_config->iq_gain_db / 20.0);
+    iq_phase = p_config->iq_phase_deg * M_PI / 180.0;
+    p_state->imbalance = (struct iq_correction) IQ_CORRECTION_INITIALIZER;
+    p_state->imbalance.gain_qq = (float)(iq_gain * cos(iq_phase));
+    p_state->imbalance.cross_qi = (float)(iq_gain * sin(iq_phase));
+
+    p_state->phase_inc = nco_phase_inc(p_config->freq_offset_hz, sample_rate);
+
+    /* the variance of the low pass output is sigma^2 / (1 - a^2) */
+    corner = 2 * M_PI * PHASE_NOISE_CORNER_HZ * PHASE_NOISE_STEP / sample_rate;
+    p_state->pn_a = (float)exp(-corner);
+    p_state->pn_sigma = (float)((p_config->phase_noise_deg * M_PI / 180.0) * 
+                                sqrt(1.0 - (p_state->pn_a * p_state->pn_a)));
+    if (p_config->phase_noise_deg == 0)
     {
-        log_error( "Error: Failed tx_radio configure, card %" 
-                PRIi32 " status %" PRIi32 "  ", card, status);
-        return status;
+        p_state->pn = 0;
     }
 
-    dump_rconfig( p_rconfig, NULL, p_tx_rconfig);
+    log_debug("impairments %s, SNR %.1f dB, offset %" PRIi32 " Hz, phase noise %.2f deg, "
+            "I/Q %.2f dB %.2f deg", p_state->active ? "on" : "off", 
+            p_config->noise ? p_config->snr_db : INFINITY, p_config->freq_offset_hz, 
+            p_config->phase_noise_deg, p_config->iq_gain_db, p_config->iq_phase_deg);
+}
+
+/*****************************************************************************/
+/** Sets up the impairments at the start of a stream
+
+    @param p_state      the impairments of the stream
+    @param sample_rate  sample rate in Hz
+    @return: void
+*/
+static void init_impair_state(struct impair_state *p_state, uint32_t sample_rate)
+{
+    p_state->signal_power = 0;
+    p_state->pn = 0;
+    p_state->seg_phase = 0;
+    p_state->seg_pos = PHASE_NOISE_STEP;
+    p_state->pn_end = 0;
+    gauss_rng_seed(&p_state->rng, now_usec());
+
+    update_impair_state(p_state, sample_rate);
+}
+
+/*****************************************************************************/
+/** Phase of each sample of a chunk from the frequency offset and the phase
+ *  noise.  The phase noise is stepped once a segment of PHASE_NOISE_STEP 
+ *  samples, the phase within a segment is linear between its ends.
+
+    @param p_state      the impairments of the stream
+    @param count        number of samples, at most IMPAIR_CHUNK
+    @return: void
+*/
+static void impair_phases(struct impair_state *p_state, uint32_t count)
+{
+    uint32_t k = 0;
+    uint32_t next = 0;
+    uint32_t i;
+
+    if (p_state->pn_sigma != 0)
+    {
+        gauss_fill(p_state->pn_noise, (count / PHASE_NOISE_STEP) + 2, p_state->pn_sigma, 
+                &p_state->rng);
+    }
+
+    while (k < count)
+    {
+        uint32_t start, num;
+
+        if (p_state->seg_pos == PHASE_NOISE_STEP)
+        {
+            p_state->seg_phase += PHASE_NOISE_STEP * p_state->phase_inc;
+            p_state->pn_start = p_state->pn_end;
+            if (p_state->pn_sigma != 0)
+            {
+                p_state->pn = (p_state->pn_a * p_state->pn) + p_state->pn_noise[next++];
+            }
+            p_state->pn_end = (uint32_t)(int64_t)llrintf(p_state->pn * 
+                                                         (float)(4294967296.0 / (2 * M_PI)));
+            p_state->seg_step = p_state->phase_inc + 
+                (uint32_t)((int32_t)(p_state->pn_end - p_state->pn_start) / PHASE_NOISE_STEP);
+            p_state->seg_pos = 0;
+        }
+
+        start = p_state->seg_phase + p_state->pn_start;
+        num = PHASE_NOISE_STEP - p_state->seg_pos;
+        num = (num < (count - k)) ? num : (count - k);
+        for (i = 0; i < num; i++)
+        {
+            p_state->phases[k + i] = start + ((p_state->seg_pos + i) * p_state->seg_step);
+        }
+        p_state->seg_pos += num;
+        k += num;
+    }
+}
+
+/*****************************************************************************/
+/** Impairs a filled block.  The noise is set from the average signal power
+ *  measured before the impairments.
+
+    @param p_state      the impairments of the stream
+    @param sample_rate  sample rate in Hz
+    @param p_iq         the block
+    @param num_samples  number of I/Q pairs
+    @return: void
+*/
+static void impair_block(struct impair_state *p_state, uint32_t sample_rate, int16_t *p_iq, 
+                         uint32_t num_samples)
+{
+    const struct tx_impair_config *p_config = &p_state->config;
+    bool rotate;
+    float sigma = 0;
+    uint32_t pos;
+
+    if (p_state->seq != __atomic_load_n(&g_impair_seq, __ATOMIC_RELAXED))
+    {
+        update_impair_state(p_state, sample_rate);
+    }
+    if ((p_state->active == false) || (num_samples == 0))
+    {
+        return;
+    }
+
+    if (p_config->noise == true)
+    {
+        double power = (double)iq_power_sum(p_iq, num_samples) / num_samples;
+
+        p_state->signal_power = (p_state->signal_power == 0) ? power : 
+            p_state->signal_power + ((power - p_state->signal_power) / IMPAIR_POWER_BLOCKS);
+        sigma = (float)(p_state->backoff * sqrt(p_state->signal_power) * p_state->noise_ratio);
+    }
+    rotate = (p_config->freq_offset_hz != 0) || (p_config->phase_noise_deg != 0);
+
+    for (pos = 0; pos < num_samples; pos += IMPAIR_CHUNK)
+    {
+        uint32_t count = ((num_samples - pos) < IMPAIR_CHUNK) ? (num_samples - pos) : IMPAIR_CHUNK;
+
+        if (p_config->noise == true)
+        {
+            gauss_fill(p_state->noise, 2 * count, sigma, &p_state->rng);
+        }
+        if (rotate == true)
+        {
+            impair_phases(p_state, count);
+        }
+
+        iq_impair(&p_iq[2 * pos], count, p_state->backoff, &p_state->imbalance, 
+                rotate ? p_state->phases : NULL, p_config->noise ? p_state->noise : NULL);
+    }
+}
+
+/*****************************************************************************/
+/** Generator thread of tx_stream().  Fills free blocks with the signal and 
+ *  passes them to the transmit thread, waiting when all of the blocks are 
+ *  filled or being sent.
+
+    @param params       the tone thread parameters
+    @return: NULL
+*/
+static void *tx_generate(void *params)
+{
+    struct tone_thread_params *p_params = params;
+    struct tx_stream *p_stream = &g_tx_stream;
+    bool ended;
+    uint32_t index;
+
+    log_trace("in tx_generate");
+
+    init_impair_state(&g_impair_state, p_params->sample_rate);
+
+    while (p_stream->generating)
+    {
+        if (tx_ring_pop(&p_stream->free, &index) == false)
+        {
+            uint32_t seq = tx_event_prepare(&g_tx_space_event);
+
+            p_stream->free_waits++;
+            if ((tx_ring_empty(&p_stream->free) == true) && (p_stream->generating == true))
+            {
+                tx_event_wait(&g_tx_space_event, seq, TX_WAIT_TIMEOUT_USEC);
+            }
+            continue;
+        }
+
+        ended = (p_params->fill(p_stream->p_blocks[index]->data, block_size, 
+                    p_params->p_fill_arg) == false);
+
+        /* the impairments are of a single signal */
+        if (p_params->channels == 1)
+        {
+            impair_block(&g_impair_state, p_params->sample_rate, p_stream->p_blocks[index]->data, 
+                    block_size);
+        }
+
+        if (ended == true)
+        {
+            /* the transmit thread stops once this block is sent */
+            tx_ring_push(&p_stream->filled, index);
+            __atomic_store_n(&p_stream->ended, true, __ATOMIC_RELEASE);
+            tx_event_signal(&g_tx_filled_event);
+            break;
+        }
+
+        tx_ring_push(&p_stream->filled, index);
+        tx_event_signal(&g_tx_filled_event);
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+/** Streaming generator.  The signal is produced by p_params->fill in a 
+ *  generator thread into a small pool of blocks while this thread sends them,
+ *  so the signal can be any length without a buffer holding all of it and 
+ *  the memory used is bounded by the pool.  If the signal ends the thread 
+ *  waits for the last block to go out and stops streaming.
+
+    @param params       the tone thread parameters
+    @return: status
+*/
+static void *tx_stream(void *params)
+{
+    int32_t status = 0;
+    int32_t tmp_status = 0;
+    struct tone_thread_params *p_params = params;
+    struct tx_stream *p_stream = &g_tx_stream;
+    bool tx_streaming = false;
+    bool generating = false;
+    bool ended = false;
+    uint32_t tot_errors = 0;
+    uint64_t xmit_ctr = 0;
+    uint64_t timestamp = p_params->start_timestamp;
+    uint32_t index;
+
+    log_trace("in tx_stream");
+
+    status = init_tx_stream(p_stream, p_params->channels);
+    if (status != 0)
+    {
+        goto cleanup;
+    }
+
+    p_stream->generating = true;
+    status = rt_thread_create(&p_stream->generator, rt_thread_dsp, tx_generate, p_params);
+    if (status != 0)
+    {
+        log_error("Error: unable to start the generator (status %" PRIi32 ")", status);
+        p_stream->generating = false;
+        goto cleanup;
+    }
+    generating = true;
+
+    status = skiq_start_tx_streaming(p_params->card, p_params->hdl);
+    if ( status != 0 )
+    {
+        log_error( "Error: unable to start streaming (result code %"
+                PRIi32 ") ", status);
+        goto cleanup;
+    }
+    tx_streaming = true;
+
+    log_info("Transmitting streamed signal...");
+
+    while (g_tone_thread_running)
+    {
+        if (tx_ring_pop(&p_stream->filled, &index) == false)
+        {
+            uint32_t seq = tx_event_prepare(&g_tx_filled_event);
+
+            /* the last block is pushed before ended is set */
+            ended = __atomic_load_n(&p_stream->ended, __ATOMIC_ACQUIRE);
+            if (tx_ring_empty(&p_stream->filled) == true)
+            {
+                if (ended == true)
+                {
+                    break;
+                }
+
+                p_stream->filled_waits++;
+                if (g_tone_thread_running == true)
+                {
+                    tx_event_wait(&g_tx_filled_event, seq, TX_WAIT_TIMEOUT_USEC);
+                }
+            }
+            continue;
+        }
+
+        /* back to back, so each sample goes out at a known timestamp */
+        if (p_params->timed == true)
+        {
+            skiq_tx_set_block_timestamp(p_stream->p_blocks[index], timestamp);
+            timestamp += block_size;
+        }
+
+        /* the signal must not skip blocks, so retry until there is room */
+        status = transmit_block(p_params, p_stream->p_blocks[index], 
+                p_params->async ? &p_stream->slots[index] : NULL);
+
+        if ((p_params->async == false) || (status != 0))
+        {
+            /* sent, or never queued, so it can be filled again */
+            tx_ring_push(&p_stream->free, index);
+            tx_event_signal(&g_tx_space_event);
+        }
+
+        if (status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL)
+        {
+            /* stopped while waiting for room */
+            status = 0;
+            break;
+        }
+        else if (status != 0)
+        {
+            log_error( "Error: failed to transmit data (result code %" PRIi32 ") ", status);
+            goto cleanup;
+        }
+
+        xmit_ctr++;
+        if (xmit_ctr == 1)
+        {
+            p_stream->first_sent_usec = now_usec();
+        }
+        if ((xmit_ctr % TX_STREAM_BLOCKS) == 0)
+        {
+            status = check_underruns(p_params, &tot_errors);
+            if (status != 0)
+            {
+                goto cleanup;
+            }
+        }
+    }
+
+    if (ended == true)
+    {
+        log_info("End of the streamed signal");
+        wait_tx_drained(p_params);
+    }
+
+cleanup:
+    if (generating)
+    {
+        p_stream->generating = false;
+        tx_event_signal(&g_tx_space_event);
+
+        pthread_join(p_stream->generator, NULL);
+    }
+
+    if (tx_streaming)
+    {
+        /* the blocks are not freed until streaming has stopped */
+        tmp_status = skiq_stop_tx_streaming(p_params->card, p_params->hdl);
+        if (tmp_status != 0)
+        {
+            log_error( "Warning: failed to stop tx streaming (result code %" PRIi32 ") ", tmp_status);
+        }
+
+        log_debug("Info: shutting down after %" PRIu64 " blocks, total underruns %" PRIu32 
+                ", generator waited %" PRIu64 " times, transmit waited %" PRIu64 " times", 
+                xmit_ctr, tot_errors, p_stream->free_waits, p_stream->filled_waits);
+    }
+
+    free_tx_stream(p_stream);
+
+    return (void *)(intptr_t)status;
+}
+
+/*****************************************************************************/
+/** Copies the next part of a raw IQ file, from the start again at the end 
+ *  when looping
+
+    @param p_iq         I/Q output
+    @param num_samples  number of I/Q pairs
+    @param p_arg        the struct tx_file
+    @return: false once a file that does not loop has ended
+*/
+static bool fill_file(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct tx_file *p_file = p_arg;
+    uint8_t *p_dst = (uint8_t *)p_iq;
+    uint64_t bytes = (uint64_t)num_samples * 2 * sizeof(int16_t);
+
+    while (bytes > 0)
+    {
+        uint64_t left = p_file->size - p_file->pos;
+        uint64_t count = (left < bytes) ? left : bytes;
+
+        memcpy(p_dst, p_file->p_map + p_file->pos, count);
+        p_dst += count;
+        bytes -= count;
+        p_file->pos += count;
+
+        if (p_file->pos == p_file->size)
+        {
+            if (p_file->loop == false)
+            {
+                memset(p_dst, 0, bytes);
+                return false;
+            }
+            p_file->pos = 0;
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Unmaps and closes the played file
+
+    @param p_file       the file
+    @return: void
+*/
+static void close_tx_file(struct tx_file *p_file)
+{
+    if (p_file->p_map != NULL)
+    {
+        munmap(p_file->p_map, p_file->size);
+    }
+    if (p_file->fd >= 0)
+    {
+        close(p_file->fd);
+    }
+    *p_file = (struct tx_file) TX_FILE_INITIALIZER;
+}
+
+/*****************************************************************************/
+/** Maps an IQ file for playback.  Nothing is read until it is transmitted, 
+ *  the kernel reads ahead as the mapping is walked through.  Records are 
+ *  mapped writable and private since skiq_transmit() fills in the header, the
+ *  file itself is never written.
+
+    @param p_file       the file to set up
+    @param p_path       path of the file
+    @param loop         start again at the end
+    @param record_block_size  words per record for a file of skiq_tx_block_t 
+                        records, 0 for a raw file
+    @return: status
+*/
+static int32_t open_tx_file(struct tx_file *p_file, const char *p_path, bool loop, 
+                            uint32_t record_block_size)
+{
+    int32_t status = 0;
+    struct stat file_stat;
+    uint64_t unit;
+
+    *p_file = (struct tx_file) TX_FILE_INITIALIZER;
+    p_file->loop = loop;
+
+    p_file->fd = open(p_path, O_RDONLY);
+    if ((p_file->fd < 0) || (fstat(p_file->fd, &file_stat) != 0))
+    {
+        status = -errno;
+        log_error("Error: unable to open %s (%s)", p_path, strerror(errno));
+        goto finished;
+    }
+
+    /* whole samples or whole records only */
+    if (record_block_size != 0)
+    {
+        p_file->record_size = sizeof(skiq_tx_block_t) + (record_block_size * sizeof(uint32_t));
+        unit = p_file->record_size;
+    }
+    else
+    {
+        unit = 2 * sizeof(int16_t);
+    }
+    p_file->size = ((uint64_t)file_stat.st_size / unit) * unit;
+    p_file->num_records = (record_block_size != 0) ? (p_file->size / unit) : 0;
+    if (p_file->size == 0)
+    {
+        log_error("Error: %s is shorter than one %s", p_path, 
+                (record_block_size != 0) ? "record" : "sample");
+        status = -EINVAL;
+        goto finished;
+    }
+    if (p_file->size != (uint64_t)file_stat.st_size)
+    {
+        log_warn("%s has %" PRIu64 " bytes past the last whole %s, they are not played",
+                p_path, (uint64_t)file_stat.st_size - p_file->size,
+                (record_block_size != 0) ? "record" : "sample");
+    }
+
+    /* a record must not be queued again before its last send completes */
+    if ((record_block_size != 0) && (loop == true) && 
+        (g_tone_thread_parameters.async == true) && (p_file->num_records < TX_STREAM_BLOCKS))
+    {
+        log_error("Error: a looped file needs at least %d records", TX_STREAM_BLOCKS);
+        status = -EINVAL;
+        goto finished;
+    }
+
+    p_file->p_map = mmap(NULL, p_file->size, 
+            PROT_READ | ((record_block_size != 0) ? PROT_WRITE : 0), MAP_PRIVATE, 
+            p_file->fd, 0);
+    if (p_file->p_map == MAP_FAILED)
+    {
+        p_file->p_map = NULL;
+        status = -errno;
+        log_error("Error: unable to map %s (%s)", p_path, strerror(errno));
+        goto finished;
+    }
+    madvise(p_file->p_map, p_file->size, MADV_SEQUENTIAL);
+
+    log_info("playing %s, %" PRIu64 " bytes, %s, %s", p_path, p_file->size, 
+            (record_block_size != 0) ? "sent in place" : "copied", loop ? "looped" : "once");
+
+finished:
+    if (status != 0)
+    {
+        close_tx_file(p_file);
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Plays a file of skiq_tx_block_t records straight from the mapping, each 
+ *  record is passed to skiq_transmit() in place so nothing is copied here.
+
+    @param params       the tone thread parameters
+    @return: status
+*/
+static void *tx_file_blocks(void *params)
+{
+    int32_t status = 0;
+    int32_t tmp_status = 0;
+    struct tone_thread_params *p_params = params;
+    struct tx_file *p_file = &g_tx_file;
+    bool tx_streaming = false;
+    bool ended = false;
+    uint32_t tot_errors = 0;
+    uint64_t record = 0;
+    uint64_t xmit_ctr = 0;
+
+    log_trace("in tx_file_blocks");
+
+    status = skiq_start_tx_streaming(p_params->card, p_params->hdl);
+    if ( status != 0 )
+    {
+        log_error( "Error: unable to start streaming (result code %"
+                PRIi32 ") ", status);
+        goto cleanup;
+    }
+    tx_streaming = true;
+
+    while (g_tone_thread_running)
+    {
+        skiq_tx_block_t *p_block = 
+            (skiq_tx_block_t *)(p_file->p_map + (record * p_file->record_size));
+
+        status = transmit_block(p_params, p_block, NULL);
+        if (status == SKIQ_TX_ASYNC_SEND_QUEUE_FULL)
+        {
+            /* stopped while waiting for room */
+            status = 0;
+            break;
+        }
+        else if (status != 0)
+        {
+            log_error( "Error: failed to transmit data (result code %" PRIi32 ") ", status);
+            goto cleanup;
+        }
+
+        if (++record == p_file->num_records)
+        {
+            if (p_file->loop == false)
+            {
+                ended = true;
+                break;
+            }
+            record = 0;
+        }
+
+        xmit_ctr++;
+        if ((xmit_ctr % TX_STREAM_BLOCKS) == 0)
+        {
+            status = check_underruns(p_params, &tot_errors);
+            if (status != 0)
+            {
+                goto cleanup;
+            }
+        }
+    }
+
+    if (ended == true)
+    {
+        log_info("End of the played file");
+        wait_tx_drained(p_params);
+    }
+
+cleanup:
+    if (tx_streaming)
+    {
+        /* the mapping is not released until streaming has stopped */
+        tmp_status = skiq_stop_tx_streaming(p_params->card, p_params->hdl);
+        if (tmp_status != 0)
+        {
+            log_error( "Warning: failed to stop tx streaming (result code %" PRIi32 ") ", tmp_status);
+        }
+
+        log_debug("Info: shutting down after %" PRIu64 " records, total underruns %" PRIu32, 
+                xmit_ctr, tot_errors);
+    }
+
+    close_tx_file(p_file);
+
+    return (void *)(intptr_t)status;
+}
+
+/*****************************************************************************/
+/** Streams a raw IQ file through tx_stream() and unmaps it at the end
+
+    @param params       the tone thread parameters
+    @return: status
+*/
+static void *tx_file_stream(void *params)
+{
+    void *p_status = tx_stream(params);
+
+    close_tx_file(&g_tx_file);
+
+    return p_status;
+}
+
+/*****************************************************************************/
+/** Copies the next part of a looped period
+
+    @param p_iq         I/Q output
+    @param num_samples  number of I/Q pairs
+    @param p_arg        the struct tx_loop
+    @return: true, a loop does not end
+*/
+static bool fill_loop(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct tx_loop *p_loop = p_arg;
+
+    while (num_samples > 0)
+    {
+        uint32_t left = p_loop->num_samples - p_loop->pos;
+        uint32_t count = (left < num_samples) ? left : num_samples;
+
+        memcpy(p_iq, &p_loop->p_iq[2 * p_loop->pos], count * 2 * sizeof(int16_t));
+        p_iq += 2 * count;
+        num_samples -= count;
+        p_loop->pos += count;
+
+        if (p_loop->pos == p_loop->num_samples)
+        {
+            p_loop->pos = 0;
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Frees a looped period
+
+    @param p_loop       the loop
+    @return: void
+*/
+static void free_tx_loop(struct tx_loop *p_loop)
+{
+    free(p_loop->p_iq);
+    *p_loop = (struct tx_loop) TX_LOOP_INITIALIZER;
+}
+
+/*****************************************************************************/
+/** tx_stream() of a looped period, the period is freed when it stops
+
+    @param params       the tone thread parameters
+    @return: status
+*/
+static void *tx_loop_stream(void *params)
+{
+    void *p_status = tx_stream(params);
+
+    free_tx_loop(&g_tx_loop);
+
+    return p_status;
+}
+
+/*****************************************************************************/
+/** Checks that the tones can be generated within the span
+
+    @param p_multitone  the tones
+    @param span_MHz     span in MHz
+    @return: 0 if valid, -EINVAL otherwise
+*/
+static int32_t check_multitone(const struct tx_multitone_config *p_multitone, uint32_t span_MHz)
+{
+    int64_t half_span = ((int64_t)span_MHz * 1000000) / 2;
+    uint32_t i;
+
+    if ((p_multitone->num_tones == 0) || (p_multitone->num_tones > MAX_MULTITONE_TONES))
+    {
+        log_error("a multi-tone signal needs 1 to %d tones", MAX_MULTITONE_TONES);
+        return -EINVAL;
+    }
+
+    if ((p_multitone->phase_mode < tx_phase_newman) || (p_multitone->phase_mode >= tx_phase_end))
+    {
+        log_error("invalid multi-tone phase mode %d", p_multitone->phase_mode);
+        return -EINVAL;
+    }
+
+    for (i = 0; i < p_multitone->num_tones; i++)
+    {
+        const struct tx_tone *p_tone = &p_multitone->tones[i];
+
+        if ((p_tone->offset_hz < -half_span) || (p_tone->offset_hz > half_span))
+        {
+            log_error("tone offsets must be within +/- %" PRIi64 " Hz of the center", half_span);
+            return -EINVAL;
+        }
+        if ((isfinite(p_tone->level_db) == 0) || (p_tone->level_db > 0.0f) || 
+            (p_tone->level_db < -100.0f))
+        {
+            log_error("tone levels must be from -100 to 0 dB, not %.1f", p_tone->level_db);
+            return -EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Greatest common divisor
+
+    @param a            first value
+    @param b            second value
+    @return: gcd, a if b is 0
+*/
+static uint64_t gcd_u64(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = a % b;
+
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/*****************************************************************************/
+/** Finds the period of the multi-tone signal and the whole number of cycles 
+ *  of each tone in it.  The exact period is the sample rate over the gcd of 
+ *  the rate and every offset.  If that is too long, the period is made just 
+ *  long enough that no tone moves more than TONE_OFFSET_TOLERANCE_HZ.
+
+    @param p_multitone  the tones
+    @param sample_rate  sample rate in Hz
+    @param p_cycles     cycles of each tone in the period, modulo the period
+    @param p_period     samples in the period
+    @return: largest difference between a tone and its requested offset, Hz
+*/
+static double plan_multitone(const struct tx_multitone_config *p_multitone, uint32_t sample_rate,
+                             uint32_t *p_cycles, uint32_t *p_period)
+{
+    uint64_t g = sample_rate;
+    uint32_t period = 0;
+    bool exact = true;
+    double max_err = 0;
+    uint32_t i;
+
+    for (i = 0; i < p_multitone->num_tones; i++)
+    {
+        g = gcd_u64(g, llabs((long long)p_multitone->tones[i].offset_hz));
+    }
+
+    period = sample_rate / g;
+    exact = (period <= MULTITONE_MAX_PERIOD);
+    if (exact == false)
+    {
+        period = ROUND_UP(sample_rate, 2 * TONE_OFFSET_TOLERANCE_HZ);
+        period = (period > MULTITONE_MAX_PERIOD) ? MULTITONE_MAX_PERIOD : period;
+    }
+
+    for (i = 0; i < p_multitone->num_tones; i++)
+    {
+        double offset = p_multitone->tones[i].offset_hz;
+        int64_t cycles = llround((offset * period) / sample_rate);
+
+        if (exact == false)
+        {
+            double err = fabs(((double)cycles * sample_rate / period) - offset);
+
+            max_err = (err > max_err) ? err : max_err;
+        }
+
+        /* a negative tone is the same phase steps as period - cycles */
+        cycles %= (int64_t)period;
+        p_cycles[i] = (uint32_t)((cycles < 0) ? (cycles + period) : cycles);
+    }
+
+    *p_period = period;
+
+    return max_err;
+}
+
+/*****************************************************************************/
+/** Sets the start phase of each tone.  Newman's phases, pi * k^2 / N, are 
+ *  for equally spaced tones so they are given in frequency order, which 
+ *  keeps the crest factor low for a comb and still spreads the phases of an 
+ *  irregular set of tones.
+
+    @param p_multitone  the tones
+    @param p_phase      NCO phase of each tone at the start of the period
+    @return: void
+*/
+static void multitone_phases(const struct tx_multitone_config *p_multitone, uint32_t *p_phase)
+{
+    uint32_t n = p_multitone->num_tones;
+    uint32_t i, j;
+
+    for (i = 0; i < n; i++)
+    {
+        const struct tx_tone *p_tone = &p_multitone->tones[i];
+        double cycle = 0;
+
+        switch (p_multitone->phase_mode)
+        {
+            case tx_phase_newman:
+            {
+                uint64_t k = 0;
+
+                /* rank by offset, ties by position in the list */
+                for (j = 0; j < n; j++)
+                {
+                    if ((p_multitone->tones[j].offset_hz < p_tone->offset_hz) ||
+                        ((p_multitone->tones[j].offset_hz == p_tone->offset_hz) && (j < i)))
+                    {
+                        k++;
+                    }
+                }
+                /* pi * k^2 / N radians, as a fraction of a cycle */
+                cycle = (double)((k * k) % (2 * n)) / (2.0 * n);
+                break;
+            }
+
+            case tx_phase_user:
+                cycle = p_tone->phase_deg / 360.0;
+                break;
+
+            default:
+                cycle = 0;
+                break;
+        }
+
+        cycle -= floor(cycle);
+        p_phase[i] = (uint32_t)(uint64_t)llround(cycle * 4294967296.0);
+    }
+}
+
+/*****************************************************************************/
+/** Generates one period of the multi-tone signal into p_loop.  The tones are
+ *  summed in float a chunk at a time, all of them over one chunk before the 
+ *  next, so the sum stays in the cache however many tones there are.  Each 
+ *  chunk starts every tone at its exact phase within the period.  The peak 
+ *  of the whole period then sets the scale to int16.
+
+    @param p_multitone  the tones
+    @param sample_rate  sample rate in Hz
+    @param p_loop       the generated period
+    @param p_info       crest factor and period of the signal
+    @return: status
+*/
+static int32_t build_multitone(const struct tx_multitone_config *p_multitone, 
+                               uint32_t sample_rate, struct tx_loop *p_loop, 
+                               struct tx_multitone_info *p_info)
+{
+    uint32_t cycles[MAX_MULTITONE_TONES];
+    uint32_t start_phase[MAX_MULTITONE_TONES];
+    uint32_t phase_inc[MAX_MULTITONE_TONES];
+    float amplitude[MAX_MULTITONE_TONES];
+    struct iq_float_range range = IQ_FLOAT_RANGE_INITIALIZER;
+    uint64_t start = now_usec();
+    uint32_t period = 0;
+    float *p_sum = NULL;
+    uint32_t pos;
+    uint32_t i;
+
+    p_info->max_error_hz = plan_multitone(p_multitone, sample_rate, cycles, &period);
+    multitone_phases(p_multitone, start_phase);
+
+    for (i = 0; i < p_multitone->num_tones; i++)
+    {
+        phase_inc[i] = (uint32_t)((((uint64_t)cycles[i] << 32) + (period / 2)) / period);
+        amplitude[i] = powf(10.0f, p_multitone->tones[i].level_db / 20.0f);
+    }
+
+    p_sum = malloc((size_t)period * 2 * sizeof(float));
+    p_loop->p_iq = malloc((size_t)period * 2 * sizeof(int16_t));
+    if ((p_sum == NULL) || (p_loop->p_iq == NULL))
+    {
+        log_error("unable to allocate a multi-tone period of %" PRIu32 " samples", period);
+        free(p_sum);
+        free_tx_loop(p_loop);
+        return -ENOMEM;
+    }
+    rt_lock_buffer(p_loop->p_iq, (size_t)period * 2 * sizeof(int16_t));
+
+    for (pos = 0; pos < period; pos += MULTITONE_CHUNK)
+    {
+        uint32_t count = ((period - pos) < MULTITONE_CHUNK) ? (period - pos) : MULTITONE_CHUNK;
+        float *p_chunk = &p_sum[2 * pos];
+
+        memset(p_chunk, 0, count * 2 * sizeof(float));
+        for (i = 0; i < p_multitone->num_tones; i++)
+        {
+            /* cycles * pos whole cycles plus a fraction into the period */
+            uint64_t fraction = ((uint64_t)cycles[i] * pos) % period;
+            uint32_t phase = start_phase[i] + (uint32_t)((fraction << 32) / period);
+
+            nco_tone_add(p_chunk, count, &phase, phase_inc[i], amplitude[i]);
+        }
+        iq_float_range(p_chunk, count, &range);
+    }
+
+    /* the largest I or Q value of the period is at full scale */
+    iq_float_to_int16(p_loop->p_iq, p_sum, period, 
+            (range.max_abs > 0.0f) ? (max_amplitude / range.max_abs) : 0.0f);
+    free(p_sum);
+
+    p_loop->num_samples = period;
+    p_loop->pos = 0;
+
+    p_info->period = period;
+    p_info->crest_db = 0;
+    if (range.power_sum > 0)
+    {
+        p_info->crest_db = 10 * log10(range.max_power / (range.power_sum / range.count));
+    }
+    p_info->build_usec = (uint32_t)(now_usec() - start);
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Checks that a modulated signal can be generated within the span
+
+    @param p_mod        the modulation
+    @param span_MHz     span in MHz
+    @return: 0 if valid, -EINVAL otherwise
+*/
+static int32_t check_mod(const struct tx_mod_config *p_mod, uint32_t span_MHz)
+{
+    double span = (double)span_MHz * 1000000;
+
+    switch (p_mod->type)
+    {
+        case tx_mod_am:
+            if ((p_mod->tone_hz == 0) || (p_mod->tone_hz > (span / 2)) ||
+                (p_mod->am_depth < 0.0f) || (p_mod->am_depth > 1.0f))
+            {
+                log_error("AM needs a tone within half the span and a depth from 0 to 1");
+                return -EINVAL;
+            }
+            break;
+
+        case tx_mod_fm:
+            /* Carson's rule */
+            if ((p_mod->tone_hz == 0) || (p_mod->fm_deviation_hz == 0) || 
+                ((2.0 * ((double)p_mod->fm_deviation_hz + p_mod->tone_hz)) > span))
+            {
+                log_error("FM needs a tone and a deviation with 2 * (deviation + tone) "
+                        "within the span");
+                return -EINVAL;
+            }
+            break;
+
+        case tx_mod_bpsk:
+        case tx_mod_qpsk:
+        case tx_mod_qam16:
+            if ((p_mod->sps < 2) || (p_mod->sps > MAX_MOD_SPS) || 
+                (p_mod->rolloff < 0.05f) || (p_mod->rolloff > 1.0f))
+            {
+                log_error("%s needs 2 to %d samples per symbol and a rolloff from 0.05 to 1",
+                        modtype_cstr(p_mod->type), MAX_MOD_SPS);
+                return -EINVAL;
+            }
+            if ((p_mod->symbol_rate == 0) || 
+                ((p_mod->symbol_rate * (1.0 + p_mod->rolloff)) > span))
+            {
+                log_error("the occupied bandwidth of %" PRIu32 " symbols per second must "
+                        "be within the span", p_mod->symbol_rate);
+                return -EINVAL;
+            }
+            if ((p_mod->prbs_order != 7) && (p_mod->prbs_order != 9) && 
+                (p_mod->prbs_order != 15) && (p_mod->prbs_order != 23) && 
+                (p_mod->prbs_order != 31))
+            {
+                log_error("PRBS order %" PRIu32 " is not 7, 9, 15, 23 or 31", p_mod->prbs_order);
+                return -EINVAL;
+            }
+            break;
+
+        default:
+            log_error("invalid modulation %d", p_mod->type);
+            return -EINVAL;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Takes the next bits of the PRBS, a Fibonacci LFSR holding the last order
+ *  bits with the newest one in bit 0.  Every bit is the XOR of the bits order
+ *  and prbs_tap before it, so up to prbs_tap bits only depend on bits already
+ *  in the register and are made with one shift and XOR.
+
+    @param p_state      the modulator
+    @param num_bits     bits to take, at most 32
+    @return: the bits, the first one in the most significant place
+*/
+static uint32_t prbs_bits(struct mod_state *p_state, uint32_t num_bits)
+{
+    uint32_t order = p_state->p_mod->prbs_order;
+    uint32_t tap = p_state->prbs_tap;
+    uint64_t lfsr = p_state->prbs;
+    uint64_t bits = 0;
+
+    while (num_bits > 0)
+    {
+        uint32_t count = (num_bits < tap) ? num_bits : tap;
+        uint64_t next = ((lfsr >> (order - count)) ^ (lfsr >> (tap - count))) & 
+            ((1ull << count) - 1);
+
+        lfsr = ((lfsr << count) | next) & ((1ull << order) - 1);
+        bits = (bits << count) | next;
+        num_bits -= count;
+    }
+    p_state->prbs = (uint32_t)lfsr;
+
+    return (uint32_t)bits;
+}
+
+/*****************************************************************************/
+/** Root raised cosine impulse response
+
+    @param t            time in symbols
+    @param alpha        rolloff
+    @return: the response, 1 - alpha + 4 * alpha / pi at t = 0
+*/
+static double rrc_response(double t, double alpha)
+{
+    double x = 4 * alpha * t;
+
+    if (fabs(t) < 1e-9)
+    {
+        return 1 - alpha + (4 * alpha / M_PI);
+    }
+    if (fabs(fabs(x) - 1) < 1e-9)
+    {
+        return (alpha / M_SQRT2) * (((1 + 2 / M_PI) * sin(M_PI / (4 * alpha))) + 
+                                    ((1 - 2 / M_PI) * cos(M_PI / (4 * alpha))));
+    }
+
+    return (sin(M_PI * t * (1 - alpha)) + (x * cos(M_PI * t * (1 + alpha)))) / 
+        (M_PI * t * (1 - (x * x)));
+}
+
+/*****************************************************************************/
+/** Maps PRBS bits to symbols, a word of bits at a time
+
+    @param p_state      the modulator
+    @param p_sym        interleaved I/Q of the symbols
+    @param num_symbols  a multiple of 32
+    @return: void
+*/
+static void next_symbols(struct mod_state *p_state, float *p_sym, uint32_t num_symbols)
+{
+    uint32_t width = p_state->bits_per_symbol;
+    uint32_t mask = (1u << width) - 1;
+    uint32_t i, k;
+
+    for (i = 0; i < num_symbols; )
+    {
+        uint32_t bits = prbs_bits(p_state, 32);
+
+        for (k = 32; k > 0; k -= width, i++)
+        {
+            const float *p_point = p_state->constellation[(bits >> (k - width)) & mask];
+
+            p_sym[2 * i] = p_point[0];
+            p_sym[2 * i + 1] = p_point[1];
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Generates the next chunk of the modulated signal into stage.  PSK and QAM
+ *  symbols are interpolated by the polyphase filter, the last 
+ *  RRC_SPAN_SYMBOLS - 1 symbols are kept as the history of the next chunk.
+ *  AM adds the tone to a carrier, FM accumulates the carrier phase steps 
+ *  given by the tone.
+
+    @param p_state      the modulator
+    @return: void
+*/
+static void mod_generate(struct mod_state *p_state)
+{
+    const struct tx_mod_config *p_mod = p_state->p_mod;
+    uint32_t history = 2 * (RRC_SPAN_SYMBOLS - 1);
+    uint32_t i;
+
+    switch (p_mod->type)
+    {
+        case tx_mod_am:
+            memset(p_state->out, 0, MOD_CHUNK * 2 * sizeof(float));
+            nco_tone_add(p_state->out, MOD_CHUNK, &p_state->tone_phase, p_state->tone_inc, 
+                    p_mod->am_depth);
+            for (i = 0; i < MOD_CHUNK; i++)
+            {
+                p_state->out[2 * i] += 1.0f;
+                p_state->out[2 * i + 1] = 0.0f;
+            }
+            iq_float_to_int16(p_state->stage, p_state->out, MOD_CHUNK, p_state->scale);
+            p_state->stage_len = MOD_CHUNK;
+            break;
+
+        case tx_mod_fm:
+            /* I of the tone is the carrier phase step of each sample */
+            memset(p_state->out, 0, MOD_CHUNK * 2 * sizeof(float));
+            nco_tone_add(p_state->out, MOD_CHUNK, &p_state->tone_phase, p_state->tone_inc, 
+                    p_state->fm_step);
+            for (i = 0; i < MOD_CHUNK; i++)
+            {
+                p_state->phases[i] = p_state->carrier_phase;
+                p_state->carrier_phase += (uint32_t)(int32_t)lrintf(p_state->out[2 * i]);
+            }
+            nco_phase_iq(p_state->stage, p_state->phases, MOD_CHUNK, p_state->scale);
+            p_state->stage_len = MOD_CHUNK;
+            break;
+
+        default:
+            next_symbols(p_state, &p_state->symbols[history], MOD_CHUNK_SYMBOLS);
+            fir_interp(p_state->out, p_state->symbols, MOD_CHUNK_SYMBOLS, p_state->coef, 
+                    RRC_SPAN_SYMBOLS, p_mod->sps);
+            memmove(p_state->symbols, &p_state->symbols[2 * MOD_CHUNK_SYMBOLS], 
+                    history * sizeof(float));
+
+            p_state->stage_len = MOD_CHUNK_SYMBOLS * p_mod->sps;
+            iq_float_to_int16(p_state->stage, p_state->out, p_state->stage_len, p_state->scale);
+            break;
+    }
+
+    p_state->stage_pos = 0;
+}
+
+/*****************************************************************************/
+/** Copies the next part of the modulated signal
+
+    @param p_iq         I/Q output
+    @param num_samples  number of I/Q pairs
+    @param p_arg        the struct mod_state
+    @return: true, the signal does not end
+*/
+static bool fill_mod(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct mod_state *p_state = p_arg;
+
+    while (num_samples > 0)
+    {
+        uint32_t left = p_state->stage_len - p_state->stage_pos;
+        uint32_t count = (left < num_samples) ? left : num_samples;
+
+        if (left == 0)
+        {
+            mod_generate(p_state);
+            continue;
+        }
+
+        memcpy(p_iq, &p_state->stage[2 * p_state->stage_pos], count * 2 * sizeof(int16_t));
+        p_iq += 2 * count;
+        num_samples -= count;
+        p_state->stage_pos += count;
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Sets up the modulator from the start of the signal.  The RRC filter is 
+ *  designed for the samples per symbol, and the scale is set from the 
+ *  largest output the filter can give, the sum of the magnitude of the taps
+ *  of the worst phase times the largest I or Q of the constellation, so no 
+ *  symbol sequence clips.
+
+    @param p_state      the modulator
+    @param p_mod        the modulation, kept until the signal stops
+    @param sample_rate  sample rate in Hz
+    @param amplitude    largest I or Q value
+    @return: void
+*/
+static void init_mod_state(struct mod_state *p_state, const struct tx_mod_config *p_mod, 
+                           uint32_t sample_rate, float amplitude)
+{
+    uint32_t sps = p_mod->sps;
+    uint32_t p, j;
+
+    p_state->p_mod = p_mod;
+    p_state->sample_rate = sample_rate;
+    p_state->stage_len = 0;
+    p_state->stage_pos = 0;
+    p_state->tone_phase = 0;
+    p_state->tone_inc = nco_phase_inc(p_mod->tone_hz, sample_rate);
+    p_state->carrier_phase = 0;
+
+    switch (p_mod->type)
+    {
+        case tx_mod_am:
+            p_state->scale = amplitude / (1.0f + p_mod->am_depth);
+            break;
+
+        case tx_mod_fm:
+            p_state->scale = amplitude;
+            p_state->fm_step = (float)(((double)p_mod->fm_deviation_hz / sample_rate) * 4294967296.0);
+            break;
+
+        default:
+        {
+            /* Gray coded levels of 2 bits, 00 -3, 01 -1, 11 1, 10 3 */
+            static const float qam16_levels[4] = { -3.0f, -1.0f, 3.0f, 1.0f };
+            double peak = 0;
+            double max_level = (p_mod->type == tx_mod_bpsk) ? 1.0 : 
+                (p_mod->type == tx_mod_qpsk) ? M_SQRT1_2 : (3.0 / sqrt(10.0));
+
+            /* unit average power */
+            p_state->bits_per_symbol = (p_mod->type == tx_mod_bpsk) ? 1 : 
+                (p_mod->type == tx_mod_qpsk) ? 2 : 4;
+            for (p = 0; p < (1u << p_state->bits_per_symbol); p++)
+            {
+                float *p_point = p_state->constellation[p];
+
+                if (p_mod->type == tx_mod_bpsk)
+                {
+                    p_point[0] = (p & 1) ? -1.0f : 1.0f;
+                    p_point[1] = 0.0f;
+                }
+                else if (p_mod->type == tx_mod_qpsk)
+                {
+                    p_point[0] = ((p & 2) ? -1.0f : 1.0f) * (float)M_SQRT1_2;
+                    p_point[1] = ((p & 1) ? -1.0f : 1.0f) * (float)M_SQRT1_2;
+                }
+                else
+                {
+                    p_point[0] = qam16_levels[p >> 2] / sqrtf(10.0f);
+                    p_point[1] = qam16_levels[p & 3] / sqrtf(10.0f);
+                }
+            }
+
+            /* all ones, the PRBS never leaves the all zero state */
+            p_state->prbs = (1u << (p_mod->prbs_order - 1)) | ((1u << (p_mod->prbs_order - 1)) - 1);
+            p_state->prbs_tap = (p_mod->prbs_order == 7) ? 6 : (p_mod->prbs_order == 9) ? 5 : 
+                (p_mod->prbs_order == 15) ? 14 : (p_mod->prbs_order == 23) ? 18 : 28;
+            memset(p_state->symbols, 0, sizeof(p_state->symbols));
+
+            for (p = 0; p < sps; p++)
+            {
+                double sum = 0;
+
+                for (j = 0; j < RRC_SPAN_SYMBOLS; j++)
+                {
+                    /* tap p + (span - 1 - j) * sps of the prototype, centered */
+                    uint32_t tap = p + ((RRC_SPAN_SYMBOLS - 1 - j) * sps);
+                    double t = ((double)tap - ((RRC_SPAN_SYMBOLS * sps) / 2)) / sps;
+                    double h = rrc_response(t, p_mod->rolloff);
+
+                    p_state->coef[(j * sps) + p] = (float)h;
+                    sum += fabs(h);
+                }
+                peak = (sum > peak) ? sum : peak;
+            }
+            p_state->scale = (float)(amplitude / (peak * max_level));
+            break;
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Generates the next samples of both tones of startDualTone() into a dual
+ *  channel block, A1 followed by A2
+
+    @param p_iq         the block, 2 * num_samples I/Q pairs
+    @param num_samples  number of I/Q pairs of each channel
+    @param p_arg        the struct dual_state
+    @return: true, the tones do not end
+*/
+static bool fill_dual(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct dual_state *p_state = p_arg;
+
+    nco_tone_dual(p_iq, &p_iq[2 * num_samples], num_samples, &p_state->a1, &p_state->a2);
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Checks that a tone of startDualTone() is within the span
+
+    @param p_tone       the tone
+    @param span_MHz     span in MHz
+    @return: 0 if valid, -EINVAL otherwise
+*/
+static int32_t check_dual_tone(const struct tx_tone *p_tone, uint32_t span_MHz)
+{
+    int64_t half_span = ((int64_t)span_MHz * 1000000) / 2;
+
+    if ((p_tone->offset_hz < -half_span) || (p_tone->offset_hz > half_span))
+    {
+        log_error("tone offsets must be within +/- %" PRIi64 " Hz of the center", half_span);
+        return -EINVAL;
+    }
+    if ((isfinite(p_tone->level_db) == 0) || (p_tone->level_db > 0.0f) || 
+        (p_tone->level_db < -100.0f))
+    {
+        log_error("tone levels must be from -100 to 0 dB, not %.1f", p_tone->level_db);
+        return -EINVAL;
+    }
+    if (isfinite(p_tone->phase_deg) == 0)
+    {
+        log_error("tone phases must be finite");
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Sets up the NCO of one tone of startDualTone()
+
+    @param p_chan       the NCO
+    @param p_tone       the tone
+    @param sample_rate  sample rate in Hz
+    @return: void
+*/
+static void init_dual_channel(struct nco_channel *p_chan, const struct tx_tone *p_tone, 
+                              uint32_t sample_rate)
+{
+    double turns = fmod(p_tone->phase_deg / 360.0, 1.0);
+
+    turns = (turns < 0) ? (turns + 1.0) : turns;
+
+    p_chan->phase = (uint32_t)llround(turns * 4294967296.0);
+    p_chan->phase_inc = nco_phase_inc(p_tone->offset_hz, sample_rate);
+
+    /* a level of 0 dB is the amplitude of the single tone of startCW() */
+    p_chan->amplitude = (float)((max_amplitude / M_SQRT2) * pow(10.0, p_tone->level_db / 20.0));
+}
+
+/*****************************************************************************/
+/** Stops the running tone and configures the radio for the generator at the
+ *  sample rate and bandwidth, then reads the TX limits of the card
+
+    @param card         card to configure
+    @param p_rconfig    the main radio config pointer
+    @param sample_rate  sample rate in Hz
+    @param bandwidth    bandwidth in Hz
+    @return: status
+*/
+static int32_t configure_generator_rate(uint8_t card, struct radio_config *p_rconfig, 
+                                        uint32_t sample_rate, uint32_t bandwidth)
+{
+    int32_t status = 0;
+
+    /* if the tone thread is already running stop it*/
+    if (g_tone_thread_running != 0)
+    {
+        /* get everything to stop */
+        intptr_t thread_status;
+
+        g_tone_thread_running = false;
+
+        /* wait till threads done */
+        pthread_join(g_tone_thread_parameters.tone_thread, (void *)&thread_status); 
+    }
+
+    /* configure card with correct frequency and bandwidth */
+    p_rconfig->bandwidth = bandwidth;
+    p_rconfig->sample_rate = sample_rate;
+
+    /* get the card into I/Q order mode */
+    p_rconfig->sample_order_iq = skiq_iq_order_iq;
+
+    /* the tone blocks are int16 I/Q */
+    p_rconfig->packed = false;
+
+    status = configure_radio(p_rconfig->cards[0], p_rconfig);
+    if (status != 0) 
+    {
+        log_error( "Error: Failed radio configure, card %" 
+                PRIi32 " status %" PRIi32 "  ", card, status);
+        return status;
+    }
+
+    /* determine how many bits of resolution the card type has */
+    /* that determines the maximum amplitude of the signal */
+    /* this must be done after skiq_init and before initializing the buffers */
+    status = get_card_params(p_rconfig->cards[0], g_tone_thread_parameters.hdl, &max_amplitude, 
+            &tx_card_type);
+    if (status != 0)
+    {
+        log_error( "Error: unable to access card parameters (status % " 
+                PRIi32 " ", status); 
+        return status;
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Configures the radio for the generator over a span
+
+    @param card         card to configure
+    @param p_rconfig    the main radio config pointer
+    @param span_MHz     span in MHz
+    @return: status
+*/
+static int32_t configure_generator_radio(uint8_t card, struct radio_config *p_rconfig, 
+                                         uint32_t span_MHz)
+{
+    uint32_t span = span_MHz * 1000000;
+
+    /* make the sample rate 20% larger than the span */
+    return configure_generator_rate(card, p_rconfig, span + (span * 0.2), span);
+}
+
+/*****************************************************************************/
+/** Stops a running LO sweep, it would retune under the other generators
+
+    @return: void
+*/
+static void stop_sweep_thread(void)
+{
+    if (g_sweep_thread_running != 0)
+    {
+        intptr_t thread_status;
+
+        g_sweep_thread_running = false;
+        pthread_join(g_sweep_thread_parameters.sweep_thread, (void *)&thread_status); 
+    }
+}
+
+/*****************************************************************************/
+/** Switches the TX handles between those of the command line and A1 + A2 in
+ *  dual channel mode.  configure_tx_radio() never leaves dual channel mode, 
+ *  so the mode the card had before is written back here.
+
+    @param p_rconfig    the main radio config pointer
+    @param p_tx_rconfig the TX radio config pointer
+    @param channels     1 for the command line handles, 2 for A1 and A2
+    @return: status
+*/
+static int32_t set_tx_channels(struct radio_config *p_rconfig, 
+                               struct tx_radio_config *p_tx_rconfig, uint8_t channels)
+{
+    struct single_tx_config *p_single = &g_single_tx_config;
+    uint8_t card = p_rconfig->cards[0];
+    int32_t status = 0;
+
+    if ((channels == 2) && (p_single->saved == false))
+    {
+        status = skiq_read_chan_mode(card, &p_single->chan_mode);
+        if (status != 0)
+        {
+            log_error("Error: unable to read the channel mode (status %" PRIi32 ")", status);
+            return status;
+        }
+        p_single->all_chans = p_tx_rconfig->all_chans;
+        p_single->nr_handles = p_tx_rconfig->nr_handles[card];
+        memcpy(p_single->handles, p_tx_rconfig->handles[card], sizeof(p_single->handles));
+        p_single->saved = true;
+
+        p_tx_rconfig->all_chans = false;
+        p_tx_rconfig->handles[card][0] = skiq_tx_hdl_A1;
+        p_tx_rconfig->handles[card][1] = skiq_tx_hdl_A2;
+        p_tx_rconfig->nr_handles[card] = 2;
+        p_tx_rconfig->chan_mode[card] = skiq_chan_mode_dual;
+    }
+    else if ((channels == 1) && (p_single->saved == true))
+    {
+        p_tx_rconfig->all_chans = p_single->all_chans;
+        p_tx_rconfig->nr_handles[card] = p_single->nr_handles;
+        memcpy(p_tx_rconfig->handles[card], p_single->handles, sizeof(p_single->handles));
+        p_tx_rconfig->chan_mode[card] = p_single->chan_mode;
+        p_single->saved = false;
+
+        log_trace("skiq_write_chan_mode");
+        status = skiq_write_chan_mode(card, p_single->chan_mode);
+        if (status != 0)
+        {
+            log_error("Error: unable to restore the channel mode (status %" PRIi32 ")", status);
+            return status;
+        }
+    }
+
+    g_tone_thread_parameters.channels = channels;
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Reads the tuned configurations of TX_TUNE_FILE the first time one is 
+ *  needed.  A missing file has none, lines that do not parse are skipped.
+
+    @return: void
+*/
+static void load_tx_tune(void)
+{
+    FILE *p_file = NULL;
+    char line[128];
+
+    if (g_tx_tune_loaded == true)
+    {
+        return;
+    }
+    g_tx_tune_loaded = true;
+
+    p_file = fopen(TX_TUNE_FILE, "r");
+    if (p_file == NULL)
+    {
+        return;
+    }
+
+    while ((g_tx_tune_count < TX_TUNE_ENTRIES) && (fgets(line, sizeof(line), p_file) != NULL))
+    {
+        struct tx_tune_entry *p_entry = &g_tx_tune[g_tx_tune_count];
+        unsigned int threads = 0;
+
+        /* the field width is TX_TUNE_TYPE_LEN - 1 */
+        if ((sscanf(line, "%31[^\t]\t%" SCNu32 "\t%" SCNu32 "\t%u", p_entry->card_type, 
+                    &p_entry->sample_rate, &p_entry->block_size, &threads) == 4) &&
+            (p_entry->block_size >= MIN_TONE_BLOCK_SIZE) && 
+            (p_entry->block_size <= DEFAULT_BLOCK_SIZE) && 
+            (threads >= 1) && (threads <= UINT8_MAX))
+        {
+            p_entry->num_threads = (uint8_t)threads;
+            g_tx_tune_count++;
+        }
+    }
+    fclose(p_file);
+
+    log_debug("%" PRIu32 " tuned TX configurations read from %s", g_tx_tune_count, TX_TUNE_FILE);
+}
+
+/*****************************************************************************/
+/** Writes the tuned configurations to TX_TUNE_FILE, through a temporary file 
+ *  so a failed write leaves the old one
+
+    @return: status
+*/
+static int32_t save_tx_tune(void)
+{
+    char tmp_path[] = TX_TUNE_FILE ".tmp";
+    FILE *p_file = NULL;
+    int32_t status = 0;
+    uint32_t i;
+
+    p_file = fopen(tmp_path, "w");
+    if (p_file == NULL)
+    {
+        status = -errno;
+        log_error("Error: unable to write %s (errno %d)", tmp_path, errno);
+        return status;
+    }
+
+    for (i = 0; i < g_tx_tune_count; i++)
+    {
+        fprintf(p_file, "%s\t%" PRIu32 "\t%" PRIu32 "\t%u\n", g_tx_tune[i].card_type, 
+                g_tx_tune[i].sample_rate, g_tx_tune[i].block_size, g_tx_tune[i].num_threads);
+    }
+
+    if ((fclose(p_file) != 0) || (rename(tmp_path, TX_TUNE_FILE) != 0))
+    {
+        status = -errno;
+        log_error("Error: unable to save %s (errno %d)", TX_TUNE_FILE, errno);
+        unlink(tmp_path);
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Finds the tuned configuration to use at a sample rate, the one of this 
+ *  card type with the lowest tuned sample rate at or above it.  What keeps 
+ *  up with a higher sample rate keeps up with a lower one.
+
+    @param sample_rate  sample rate in Hz
+    @return: the configuration, NULL if there is none
+*/
+static const struct tx_tune_entry *find_tx_tune(uint32_t sample_rate)
+{
+    const struct tx_tune_entry *p_found = NULL;
+    uint32_t i;
+
+    load_tx_tune();
+
+    for (i = 0; i < g_tx_tune_count; i++)
+    {
+        const struct tx_tune_entry *p_entry = &g_tx_tune[i];
+
+        if ((strcmp(p_entry->card_type, tx_card_type) == 0) && 
+            (p_entry->sample_rate >= sample_rate) &&
+            ((p_found == NULL) || (p_entry->sample_rate < p_found->sample_rate)))
+        {
+            p_found = p_entry;
+        }
+    }
+
+    return p_found;
+}
+
+/*****************************************************************************/
+/** Keeps a tuned configuration, replacing the one of the same card type and
+ *  sample rate, and saves them all
+
+    @param sample_rate  sample rate in Hz
+    @param block_size   words per block
+    @param num_threads  transmit threads
+    @return: status
+*/
+static int32_t keep_tx_tune(uint32_t sample_rate, uint32_t block_size, uint8_t num_threads)
+{
+    struct tx_tune_entry *p_entry = NULL;
+    uint32_t i;
+
+    load_tx_tune();
+
+    for (i = 0; (i < g_tx_tune_count) && (p_entry == NULL); i++)
+    {
+        if ((strcmp(g_tx_tune[i].card_type, tx_card_type) == 0) && 
+            (g_tx_tune[i].sample_rate == sample_rate))
+        {
+            p_entry = &g_tx_tune[i];
+        }
+    }
+    if (p_entry == NULL)
+    {
+        /* a full table loses its last entry */
+        if (g_tx_tune_count < TX_TUNE_ENTRIES)
+        {
+            g_tx_tune_count++;
+        }
+        p_entry = &g_tx_tune[g_tx_tune_count - 1];
+    }
+
+    snprintf(p_entry->card_type, sizeof(p_entry->card_type), "%s", tx_card_type);
+    p_entry->sample_rate = sample_rate;
+    p_entry->block_size = block_size;
+    p_entry->num_threads = num_threads;
+
+    return save_tx_tune();
+}
+
+/*****************************************************************************/
+/** Block size of a generator that can use any, the tuned one or the default
+
+    @param sample_rate  sample rate in Hz
+    @return: words per block
+*/
+static uint32_t tuned_block_size(uint32_t sample_rate)
+{
+    const struct tx_tune_entry *p_entry = find_tx_tune(sample_rate);
+
+    return (p_entry != NULL) ? p_entry->block_size : DEFAULT_BLOCK_SIZE;
+}
+
+/*****************************************************************************/
+/** Sets the transmit threads of the tuned configuration, or those of the 
+ *  command line when there is none.  The command line ones are kept the 
+ *  first time through.
+
+    @param p_tx_rconfig the TX radio config pointer
+    @param sample_rate  sample rate in Hz
+    @return: void
+*/
+static void apply_tx_threads(struct tx_radio_config *p_tx_rconfig, uint32_t sample_rate)
+{
+    struct tx_threads_config *p_cmdline = &g_cmdline_threads;
+    const struct tx_tune_entry *p_entry = NULL;
+
+    if (p_cmdline->saved == false)
+    {
+        p_cmdline->num_threads = p_tx_rconfig->num_threads;
+        p_cmdline->transfer_mode = p_tx_rconfig->transfer_mode;
+        p_cmdline->saved = true;
+    }
+
+    /* the trials set their own */
+    if (g_tx_tuning == true)
+    {
+        return;
+    }
+
+    p_entry = find_tx_tune(sample_rate);
+    if (p_entry != NULL)
+    {
+        p_tx_rconfig->num_threads = p_entry->num_threads;
+        p_tx_rconfig->transfer_mode = (p_entry->num_threads > 1) ? 
+            skiq_tx_transfer_mode_async : skiq_tx_transfer_mode_sync;
+        log_debug("tuned for %" PRIu32 " samples per second, %u threads", 
+                p_entry->sample_rate, p_entry->num_threads);
+    }
+    else
+    {
+        p_tx_rconfig->num_threads = p_cmdline->num_threads;
+        p_tx_rconfig->transfer_mode = p_cmdline->transfer_mode;
+    }
+}
+
+/*****************************************************************************/
+/** Configures the TX side of the generator, the LO, the attenuation for the 
+ *  power level and the block size, and registers the completion callback
+
+    @param card         card to configure
+    @param p_rconfig    the main radio config pointer
+    @param p_tx_rconfig the TX radio config pointer
+    @param lo_freq      TX LO frequency in Hz
+    @param power_level  0 (quietest) to MAX_POWER_LEVELS
+    @param channels     1, or 2 for A1 and A2 in dual channel blocks
+    @return: status
+*/
+static int32_t configure_generator_tx(uint8_t card, struct radio_config *p_rconfig, 
+                                      struct tx_radio_config *p_tx_rconfig, uint64_t lo_freq,
+                                      uint32_t power_level, uint8_t channels)
+{
+    int32_t status = 0;
+
+    status = set_tx_channels(p_rconfig, p_tx_rconfig, channels);
+    if (status != 0)
+    {
+        return status;
+    }
+    apply_tx_threads(p_tx_rconfig, p_rconfig->sample_rate);
+
+    p_tx_rconfig->freq = lo_freq;
+    p_tx_rconfig->block_size_in_words = block_size;
+
+    /* convert power to attenuation */
+    int diff = attenuation_max -attenuation_min;
+
+    /* there are 10 different power levels allowed 
+     * So divide the range of the power into 10 levels
+     * Set the attenuation based on the power level sent in */
+    int att_per_level = diff/MAX_POWER_LEVELS;
+
+    log_debug("att max %d, att min %d, diff %d, dB range %d, att_per_level %d ", 
+            attenuation_max, attenuation_min, diff, diff / 4, att_per_level);
+
+    /* 0 is the maximum attenuation, so the quietest */
+    p_tx_rconfig->attenuation = attenuation_max + (-att_per_level * power_level);
+   
+
+    status = configure_tx_radio(p_rconfig->cards[0], p_rconfig, p_tx_rconfig);
+    if (status != 0) 
+    {
+        log_error( "Error: Failed tx_radio configure, card %" 
+                PRIi32 " status %" PRIi32 "  ", card, status);
+        return status;
+    }
+
+    dump_rconfig( p_rconfig, NULL, p_tx_rconfig);
+
+    g_tone_thread_parameters.async = (p_tx_rconfig->num_threads > 1);
+    g_tone_thread_parameters.timed = false;
+    if (p_tx_rconfig->num_threads > 1)
+    {
+        // register the callback
+        log_trace("skiq_register_tx_complete_callback");
+        status = skiq_register_tx_complete_callback( card, &tx_complete );
+        if( status != 0 )
+        {
+            log_error("Error: unable to register transmit completion callback"
+                    " (status = %" PRIi32 ")", status);
+            return status;
+        }
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Switches the generator to timestamped blocks, after 
+ *  configure_generator_tx() which leaves the data flow mode of the command
+ *  line.  The first block is scheduled TX_TIMED_LEAD_USEC from now.  Late 
+ *  blocks are dropped rather than sent, so a step never starts off schedule.
+
+    @param card         card to transmit on
+    @param sample_rate  sample rate in Hz
+    @return: status
+*/
+static int32_t configure_timed_tx(uint8_t card, uint32_t sample_rate)
+{
+    struct tone_thread_params *p_params = &g_tone_thread_parameters;
+    int32_t status = 0;
+    uint64_t timestamp = 0;
+
+    status = skiq_write_tx_data_flow_mode(card, p_params->hdl, 
+            skiq_tx_with_timestamps_data_flow_mode);
+    if (status == 0)
+    {
+        status = skiq_write_tx_timestamp_base(card, skiq_tx_rf_timestamp);
+    }
+    if (status == 0)
+    {
+        status = skiq_read_curr_tx_timestamp(card, p_params->hdl, &timestamp);
+    }
+    if (status != 0)
+    {
+        log_error("Error: unable to set up timestamped transmit (status %" PRIi32 ")", status);
+        return status;
+    }
+
+    p_params->timed = true;
+    p_params->start_timestamp = timestamp + 
+        (((uint64_t)TX_TIMED_LEAD_USEC * sample_rate) / 1000000);
+    log_debug("timed transmit from timestamp %" PRIu64 ", now %" PRIu64, 
+            p_params->start_timestamp, timestamp);
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Starts the generator thread
+
+    @param card         card to transmit on
+    @param sample_rate  sample rate in Hz
+    @param thread_fn    tx_tone() or tx_stream()
+    @return: status
+*/
+static int32_t start_generator_thread(uint8_t card, uint32_t sample_rate, 
+                                      void *(*thread_fn)(void *))
+{
+    int32_t status = 0;
+
+    g_tone_thread_parameters.card = card;
+    g_tone_thread_parameters.sample_rate = sample_rate;
+    g_tx_queue_stats = (struct tx_queue_stats) TX_QUEUE_STATS_INITIALIZER;
+
+    /* the thread runs until this is cleared */
+    g_tone_thread_running = true;
+
+    status = rt_thread_create( &(g_tone_thread_parameters.tone_thread), 
+              rt_thread_tx, thread_fn, &g_tone_thread_parameters);
+    if( status != 0 )
+    {
+        log_error("Error: unable to start the generator thread (status %" PRIi32 ")", status);
+        g_tone_thread_running = false; // Tell all the threads to terminate
+    }
+
+    return status;
+}
+
+int32_t startCW(                                uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig ,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level)
+{
+    int status = 0;
+    uint32_t tone_offset = TONE_OFFSET_HZ;
+
+    log_trace("in startCW");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    status = configure_generator_radio(card, p_rconfig, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the block size is part of the plan for a loop without discontinuities */
+    plan_tone(tone_offset, p_rconfig->sample_rate, tuned_block_size(p_rconfig->sample_rate), 
+            &g_tone_thread_parameters.plan);
+    block_size = g_tone_thread_parameters.plan.block_size;
+    g_tone_thread_parameters.tone = tone_offset;
+    g_tone_thread_parameters.p_rendered = NULL;
+
+    /* it would be good to not transmit on the center frequency, so lets drop the 
+     * center frequency to below the desired tone by "tone_offset" amount.
+     * Then generate a tone of tone_offset amount */
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, 
+            (freq_MHz * 1000000) - tone_offset, power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+    log_debug("freq %ld, span %d, tone offset %d ", p_tx_rconfig->freq, span_MHz, tone_offset);
+
+    /* start the tx_tone thread */
+    return start_generator_thread(card, p_rconfig->sample_rate, tx_tone);
+}
+
+/*****************************************************************************/
+/** Checks that a digital sweep can be generated within the span
+
+    @param p_dsweep     the digital sweep
+    @param span_MHz     span in MHz
+    @return: 0 if valid, -EINVAL otherwise
+*/
+static int32_t check_dsweep(const struct tx_dsweep_config *p_dsweep, uint32_t span_MHz)
+{
+    int64_t half_span = ((int64_t)span_MHz * 1000000) / 2;
+    int64_t low = p_dsweep->start_offset_hz;
+    int64_t high = p_dsweep->stop_offset_hz;
+    uint32_t i;
+
+    if (p_dsweep->dwell_usec == 0)
+    {
+        log_error("the dwell must be at least 1 usec");
+        return -EINVAL;
+    }
+
+    switch (p_dsweep->mode)
+    {
+        case tx_dsweep_stepped:
+            if (p_dsweep->steps == 0)
+            {
+                log_error("a stepped sweep needs at least 1 step");
+                return -EINVAL;
+            }
+            break;
+
+        case tx_dsweep_chirp:
+            break;
+
+        case tx_dsweep_list:
+            if ((p_dsweep->num_list == 0) || (p_dsweep->num_list > MAX_DSWEEP_LIST))
+            {
+                log_error("a list sweep needs 1 to %d frequencies", MAX_DSWEEP_LIST);
+                return -EINVAL;
+            }
+            low = high = p_dsweep->list_offset_hz[0];
+            for (i = 1; i < p_dsweep->num_list; i++)
+            {
+                low = (p_dsweep->list_offset_hz[i] < low) ? p_dsweep->list_offset_hz[i] : low;
+                high = (p_dsweep->list_offset_hz[i] > high) ? p_dsweep->list_offset_hz[i] : high;
+            }
+            break;
+
+        default:
+            log_error("invalid digital sweep mode %d", p_dsweep->mode);
+            return -EINVAL;
+    }
+
+    if ((low < -half_span) || (low > half_span) || (high < -half_span) || (high > half_span))
+    {
+        log_error("sweep offsets must be within +/- %" PRIi64 " Hz of the center", half_span);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int32_t startDigitalSweep(                      uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_dsweep_config *p_dsweep)
+{
+    int32_t status = 0;
+
+    log_trace("in startDigitalSweep");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    status = check_dsweep(p_dsweep, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    stop_sweep_thread();
+
+    status = configure_generator_radio(card, p_rconfig, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the blocks are refilled as they go, so there is no period to fit */
+    block_size = tuned_block_size(p_rconfig->sample_rate);
+    g_tone_thread_parameters.dsweep = *p_dsweep;
+
+    /* the LO stays at the center, the sweep is all at baseband */
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 
+            power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+    log_debug("freq %" PRIu64 ", span %" PRIu32 ", %s sweep", p_tx_rconfig->freq, span_MHz,
+            dsweepmode_cstr(p_dsweep->mode));
+
+    /* max_amplitude is known once the radio is configured */
+    init_dsweep_state(&g_dsweep_state, &g_tone_thread_parameters.dsweep, p_rconfig->sample_rate,
+            max_amplitude / M_SQRT2);
+    g_tone_thread_parameters.fill = fill_dsweep;
+    g_tone_thread_parameters.p_fill_arg = &g_dsweep_state;
+
+    g_sweep_stats = (struct sweep_stats) SWEEP_STATS_INITIALIZER;
+    if (p_dsweep->timed == true)
+    {
+        status = configure_timed_tx(card, p_rconfig->sample_rate);
+        if (status != 0)
+        {
+            return status;
+        }
+
+        /* the steps are exact, only the dwell is rounded to a sample */
+        g_sweep_stats.timed = true;
+        g_sweep_stats.start_timestamp = g_tone_thread_parameters.start_timestamp;
+        g_sweep_stats.step_samples = g_dsweep_state.dwell_samples;
+        g_sweep_stats.step_usec = (float)((g_dsweep_state.dwell_samples * 1000000.0) / 
+                                          p_rconfig->sample_rate);
+    }
+
+    return start_generator_thread(card, p_rconfig->sample_rate, tx_stream);
+}
+
+int32_t startPlayFile(                          uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t sample_rate,
+                                                uint32_t power_level,
+                                                const char *p_path,
+                                                bool loop,
+                                                uint32_t record_block_size)
+{
+    int32_t status = 0;
+
+    log_trace("in startPlayFile");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    stop_sweep_thread();
+
+    status = configure_generator_rate(card, p_rconfig, sample_rate, 
+            sample_rate * FILE_BANDWIDTH_RATIO);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* records set the block size, raw samples are copied into default blocks */
+    block_size = (record_block_size != 0) ? record_block_size : DEFAULT_BLOCK_SIZE;
+
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 
+            power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the tone thread is stopped so the last file is already closed */
+    status = open_tx_file(&g_tx_file, p_path, loop, record_block_size);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    if (record_block_size != 0)
+    {
+        status = start_generator_thread(card, p_rconfig->sample_rate, tx_file_blocks);
+    }
+    else
+    {
+        g_tone_thread_parameters.fill = fill_file;
+        g_tone_thread_parameters.p_fill_arg = &g_tx_file;
+        status = start_generator_thread(card, p_rconfig->sample_rate, tx_file_stream);
+    }
+    if (status != 0)
+    {
+        close_tx_file(&g_tx_file);
+    }
+
+    return status;
+}
+
+int32_t startMultiTone(                         uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_multitone_config *p_multitone,
+                                                struct tx_multitone_info *p_info)
+{
+    int32_t status = 0;
+
+    log_trace("in startMultiTone");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    status = check_multitone(p_multitone, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    stop_sweep_thread();
+
+    status = configure_generator_radio(card, p_rconfig, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the period is copied into the blocks, so any block size fits */
+    block_size = tuned_block_size(p_rconfig->sample_rate);
+
+    /* the LO stays at the center, the tones are all at baseband */
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 
+            power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* max_amplitude is known once the radio is configured, and the tone 
+     * thread is stopped so the last period is already freed */
+    status = build_multitone(p_multitone, p_rconfig->sample_rate, &g_tx_loop, p_info);
+    if (status != 0)
+    {
+        return status;
+    }
+    log_info("%" PRIu32 " tones, %s phases, crest factor %.2f dB, period %" PRIu32 
+            " samples built in %" PRIu32 " usec", p_multitone->num_tones, 
+            phasemode_cstr(p_multitone->phase_mode), p_info->crest_db, p_info->period, 
+            p_info->build_usec);
+    if (p_info->max_error_hz > 0)
+    {
+        log_warn("tones moved by up to %.1f Hz to fit a period of %" PRIu32 " samples",
+                p_info->max_error_hz, p_info->period);
+    }
+
+    g_tone_thread_parameters.fill = fill_loop;
+    g_tone_thread_parameters.p_fill_arg = &g_tx_loop;
+    status = start_generator_thread(card, p_rconfig->sample_rate, tx_loop_stream);
+    if (status != 0)
+    {
+        free_tx_loop(&g_tx_loop);
+    }
+
+    return status;
+}
+
+int32_t startModulated(                         uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_mod_config *p_mod)
+{
+    int32_t status = 0;
+
+    log_trace("in startModulated");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    status = check_mod(p_mod, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    stop_sweep_thread();
+
+    if ((p_mod->type == tx_mod_am) || (p_mod->type == tx_mod_fm))
+    {
+        status = configure_generator_radio(card, p_rconfig, span_MHz);
+    }
+    else
+    {
+        /* a whole number of samples per symbol, the bandwidth is the occupied one */
+        status = configure_generator_rate(card, p_rconfig, p_mod->symbol_rate * p_mod->sps, 
+                p_mod->symbol_rate * (1.0 + p_mod->rolloff));
+    }
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the blocks are refilled as they go, so there is no period to fit */
+    block_size = tuned_block_size(p_rconfig->sample_rate);
+    g_tone_thread_parameters.mod = *p_mod;
+
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 
+            power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+    log_debug("freq %" PRIu64 ", %s at %" PRIu32 " samples per second", p_tx_rconfig->freq,
+            modtype_cstr(p_mod->type), p_rconfig->sample_rate);
+
+    /* max_amplitude is known once the radio is configured */
+    init_mod_state(&g_mod_state, &g_tone_thread_parameters.mod, p_rconfig->sample_rate,
+            max_amplitude);
+    g_tone_thread_parameters.fill = fill_mod;
+    g_tone_thread_parameters.p_fill_arg = &g_mod_state;
+
+    return start_generator_thread(card, p_rconfig->sample_rate, tx_stream);
+}
+
+int32_t startDualTone(                          uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_dual_config *p_dual)
+{
+    int32_t status = 0;
+
+    log_trace("in startDualTone");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    status = check_dual_tone(&p_dual->a1, span_MHz);
+    if (status == 0)
+    {
+        status = check_dual_tone(&p_dual->a2, span_MHz);
+    }
+    if (status != 0)
+    {
+        return status;
+    }
+
+    stop_sweep_thread();
+
+    status = configure_generator_radio(card, p_rconfig, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the number of channels is known once the card parameters are read */
+    if (num_tx_channels < 2)
+    {
+        log_error("card %" PRIu8 " has %" PRIu8 " TX channels, 2 are needed", card, 
+                num_tx_channels);
+        return -ENOTSUP;
+    }
+
+    /* each block holds block_size samples of A1 followed by those of A2 */
+    block_size = DUAL_BLOCK_SIZE;
+
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 
+            power_level, 2);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* both tones start on the first sample, so the phase between them holds */
+    init_dual_channel(&g_dual_state.a1, &p_dual->a1, p_rconfig->sample_rate);
+    init_dual_channel(&g_dual_state.a2, &p_dual->a2, p_rconfig->sample_rate);
+    log_debug("freq %" PRIu64 ", A1 %" PRIi32 " Hz %.1f dB %.1f deg, A2 %" PRIi32 
+            " Hz %.1f dB %.1f deg", p_tx_rconfig->freq, p_dual->a1.offset_hz, 
+            p_dual->a1.level_db, p_dual->a1.phase_deg, p_dual->a2.offset_hz, 
+            p_dual->a2.level_db, p_dual->a2.phase_deg);
+
+    g_tone_thread_parameters.fill = fill_dual;
+    g_tone_thread_parameters.p_fill_arg = &g_dual_state;
+
+    return start_generator_thread(card, p_rconfig->sample_rate, tx_stream);
+}
+
+/*****************************************************************************/
+/** Generates the tone of a tuning trial
+
+    @param p_iq         I/Q output
+    @param num_samples  number of I/Q pairs
+    @param p_arg        the struct nco_channel of the tone
+    @return: true, the tone does not end
+*/
+static bool fill_tune(int16_t *p_iq, uint32_t num_samples, void *p_arg)
+{
+    struct nco_channel *p_tone = p_arg;
+
+    nco_tone(p_iq, num_samples, &p_tone->phase, p_tone->phase_inc, p_tone->amplitude);
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Streams a tone for one trial of tuneTx() with the block size and threads
+ *  of the trial, and measures it
+
+    @param card         card to transmit on
+    @param p_rconfig    the main radio config pointer
+    @param p_tx_rconfig the TX radio config pointer
+    @param freq_MHz     LO frequency in MHz
+    @param trial_ms     length of the trial
+    @param p_trial      block_size and num_threads in, the measurements out
+    @return: status
+*/
+static int32_t run_tune_trial(uint8_t card, struct radio_config *p_rconfig, 
+                              struct tx_radio_config *p_tx_rconfig, uint64_t freq_MHz,
+                              uint32_t trial_ms, struct tx_tune_trial *p_trial)
+{
+    struct timespec cpu_start, cpu_end;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t first = 0;
+    uint32_t underruns = 0;
+    intptr_t thread_status = 0;
+    int32_t status = 0;
+
+    block_size = p_trial->block_size;
+    p_tx_rconfig->num_threads = p_trial->num_threads;
+    p_tx_rconfig->transfer_mode = (p_trial->num_threads > 1) ? 
+        skiq_tx_transfer_mode_async : skiq_tx_transfer_mode_sync;
+
+    /* the quietest power level, the trial is not meant to be seen */
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, freq_MHz * 1000000, 0, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    g_tune_tone.phase = 0;
+    g_tune_tone.phase_inc = nco_phase_inc(p_rconfig->sample_rate / 8.0, p_rconfig->sample_rate);
+    g_tune_tone.amplitude = max_amplitude / M_SQRT2;
+    g_tone_thread_parameters.fill = fill_tune;
+    g_tone_thread_parameters.p_fill_arg = &g_tune_tone;
+
+    /* the CPU time of the process includes the transmit threads of libsidekiq */
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    start = now_usec();
+
+    status = start_generator_thread(card, p_rconfig->sample_rate, tx_stream);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the thread stops by itself if it fails */
+    end = start + ((uint64_t)trial_ms * 1000);
+    while ((now_usec() < end) && (g_running != 0) && (g_tone_thread_running == true))
+    {
+        usleep(MAX_SLEEP_SLICE_USEC / 10);
+    }
+
+    /* read while streaming, the count restarts with the next trial */
+    status = skiq_read_tx_num_underruns(card, g_tone_thread_parameters.hdl, &underruns);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+    end = now_usec();
+
+    g_tone_thread_running = false;
+    pthread_join(g_tone_thread_parameters.tone_thread, (void *)&thread_status);
+    if (status != 0)
+    {
+        log_error("Error: unable to read the underruns (status %" PRIi32 ")", status);
+        return status;
+    }
+    if (thread_status != 0)
+    {
+        return (int32_t)thread_status;
+    }
+
+    first = g_tx_stream.first_sent_usec;
+    p_trial->underruns = underruns;
+    p_trial->cpu_pct = (float)(((((cpu_end.tv_sec - cpu_start.tv_sec) * 1e9) + 
+                    (cpu_end.tv_nsec - cpu_start.tv_nsec)) / 10.0) / (end - start));
+    p_trial->start_usec = (first != 0) ? (uint32_t)(first - start) : 0;
+    p_trial->sent = g_tx_queue_stats.sent;
+
+    log_info("block size %" PRIu32 ", %u threads: %" PRIu32 " underruns, %.1f%% CPU, "
+            "first block after %" PRIu32 " usec, %" PRIu64 " blocks sent", p_trial->block_size,
+            p_trial->num_threads, p_trial->underruns, p_trial->cpu_pct, p_trial->start_usec, 
+            p_trial->sent);
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Compares two tuning trials, the fewest underruns wins, then the least 
+ *  CPU, then the fastest start.  A trial that sent nothing never wins.
+
+    @param p_a          the trial
+    @param p_b          the best trial so far, NULL if there is none
+    @return: true if p_a is better than p_b
+*/
+static bool tune_trial_better(const struct tx_tune_trial *p_a, const struct tx_tune_trial *p_b)
+{
+    if (p_a->sent == 0)
+    {
+        return false;
+    }
+    if (p_b == NULL)
+    {
+        return true;
+    }
+    if (p_a->underruns != p_b->underruns)
+    {
+        return (p_a->underruns < p_b->underruns);
+    }
+    if (p_a->cpu_pct != p_b->cpu_pct)
+    {
+        return (p_a->cpu_pct < p_b->cpu_pct);
+    }
+
+    return (p_a->start_usec < p_b->start_usec);
+}
+
+int32_t tuneTx(                                 uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t sample_rate,
+                                                uint32_t trial_ms,
+                                                struct tx_tune_result *p_result)
+{
+    /* block sizes are 256 * n - 4 words, all usable by plan_tone() */
+    static const uint32_t block_sizes[] = { MIN_TONE_BLOCK_SIZE, 32764, 49148, DEFAULT_BLOCK_SIZE };
+    static const uint8_t threads[] = { 1, 2, 4 };
+    const struct tx_tune_trial *p_best = NULL;
+    int32_t status = 0;
+    uint32_t b, t;
+
+    log_trace("in tuneTx");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    if ((trial_ms < TX_TUNE_MIN_TRIAL_MS) || (trial_ms > TX_TUNE_MAX_TRIAL_MS))
+    {
+        log_error("trials must be %d to %d ms long", TX_TUNE_MIN_TRIAL_MS, TX_TUNE_MAX_TRIAL_MS);
+        return -EINVAL;
+    }
+
+    *p_result = (struct tx_tune_result) TX_TUNE_RESULT_INITIALIZER;
+
+    stop_sweep_thread();
+
+    status = configure_generator_rate(card, p_rconfig, sample_rate, 
+            sample_rate * TX_TUNE_BANDWIDTH_RATIO);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* the command line threads are kept before the first trial changes them */
+    apply_tx_threads(p_tx_rconfig, sample_rate);
+    g_tx_tuning = true;
+
+    for (b = 0; (b < (sizeof(block_sizes) / sizeof(block_sizes[0]))) && (status == 0); b++)
+    {
+        for (t = 0; (t < (sizeof(threads) / sizeof(threads[0]))) && (status == 0) && 
+                    (g_running != 0); t++)
+        {
+            struct tx_tune_trial *p_trial = &p_result->trials[p_result->num_trials];
+
+            p_trial->block_size = block_sizes[b];
+            p_trial->num_threads = threads[t];
+            status = run_tune_trial(card, p_rconfig, p_tx_rconfig, freq_MHz, trial_ms, p_trial);
+            if (status != 0)
+            {
+                log_error("Error: trial of block size %" PRIu32 " with %u threads failed "
+                        "(status %" PRIi32 ")", p_trial->block_size, p_trial->num_threads, status);
+                break;
+            }
+            if (tune_trial_better(p_trial, p_best) == true)
+            {
+                p_best = p_trial;
+                p_result->best = p_result->num_trials;
+            }
+            p_result->num_trials++;
+        }
+    }
+
+    g_tx_tuning = false;
+    apply_tx_threads(p_tx_rconfig, sample_rate);
+
+    if ((status == 0) && (p_best == NULL))
+    {
+        log_error("Error: no trial transmitted a block");
+        status = -EIO;
+    }
+    if (status != 0)
+    {
+        return status;
+    }
+
+    log_info("%s at %" PRIu32 " samples per second: block size %" PRIu32 ", %u threads", 
+            tx_card_type, sample_rate, p_best->block_size, p_best->num_threads);
+
+    return keep_tx_tune(sample_rate, p_best->block_size, p_best->num_threads);
+}
+
+/*****************************************************************************/
+/** @brief 
+    Convert string representation to multi-tone phase mode constant
+
+*/
+tx_phase_mode_t str2phasemode( const char *str )
+{
+    return \
+        ( 0 == strcasecmp( str, "NEWMAN" ) ) ? tx_phase_newman :
+        ( 0 == strcasecmp( str, "ZERO" ) ) ? tx_phase_zero :
+        ( 0 == strcasecmp( str, "USER" ) ) ? tx_phase_user :
+        tx_phase_end;
+}
+
+/******************************************************************************/
+/** @brief 
+    Convert tx_phase_mode_t constant to string representation
+
+*/
+const char * phasemode_cstr( tx_phase_mode_t mode )
+{
+    return \
+        (mode == tx_phase_newman) ? "NEWMAN" :
+        (mode == tx_phase_zero) ? "ZERO" :
+        (mode == tx_phase_user) ? "USER" :
+        "unknown";
+}
+
+/*****************************************************************************/
+/** @brief 
+    Convert string representation to modulation constant
+
+*/
+tx_mod_type_t str2modtype( const char *str )
+{
+    return \
+        ( 0 == strcasecmp( str, "AM" ) ) ? tx_mod_am :
+        ( 0 == strcasecmp( str, "FM" ) ) ? tx_mod_fm :
+        ( 0 == strcasecmp( str, "BPSK" ) ) ? tx_mod_bpsk :
+        ( 0 == strcasecmp( str, "QPSK" ) ) ? tx_mod_qpsk :
+        ( 0 == strcasecmp( str, "QAM16" ) ) ? tx_mod_qam16 :
+        tx_mod_end;
+}
 
-    if (p_tx_rconfig->num_threads > 1)
-    {
-        // register the callback
-        log_trace("skiq_register_tx_complete_callback");
-        status = skiq_register_tx_complete_callback( card, &tx_complete );
-        if( status != 0 )
-        {
-            log_error("Error: unable to register transmit completion callback"
-                    " (status = %" PRIi32 ")", status);
-            return status;
-        }
-    }
+/******************************************************************************/
+/** @brief 
+    Convert tx_mod_type_t constant to string representation
 
+*/
+const char * modtype_cstr( tx_mod_type_t type )
+{
+    return \
+        (type == tx_mod_am) ? "AM" :
+        (type == tx_mod_fm) ? "FM" :
+        (type == tx_mod_bpsk) ? "BPSK" :
+        (type == tx_mod_qpsk) ? "QPSK" :
+        (type == tx_mod_qam16) ? "QAM16" :
+        "unknown";
+}
 
-    g_tone_thread_parameters.card = card;
-    g_tone_thread_parameters.tone = tone_offset ;
-    g_tone_thread_parameters.sample_rate = p_rconfig->sample_rate;
-    g_tone_thread_parameters.hdl = hdl;
+/*****************************************************************************/
+/** @brief 
+    Convert string representation to digital sweep mode constant
 
-    /* start the tx_tone thread */
-    status = pthread_create( &(g_tone_thread_parameters.tone_thread), 
-              NULL, tx_tone, &g_tone_thread_parameters);
-    if( status != 0 )
-    {
-        g_tone_thread_running = false; // Tell all the threads to terminate
-    }
+*/
+tx_dsweep_mode_t str2dsweepmode( const char *str )
+{
+    return \
+        ( 0 == strcasecmp( str, "STEPPED" ) ) ? tx_dsweep_stepped :
+        ( 0 == strcasecmp( str, "CHIRP" ) ) ? tx_dsweep_chirp :
+        ( 0 == strcasecmp( str, "LIST" ) ) ? tx_dsweep_list :
+        tx_dsweep_end;
+}
 
-    g_tone_thread_running = true;
+/******************************************************************************/
+/** @brief 
+    Convert tx_dsweep_mode_t constant to string representation
 
-    return 0;
+*/
+const char * dsweepmode_cstr( tx_dsweep_mode_t mode )
+{
+    return \
+        (mode == tx_dsweep_stepped) ? "STEPPED" :
+        (mode == tx_dsweep_chirp) ? "CHIRP" :
+        (mode == tx_dsweep_list) ? "LIST" :
+        "unknown";
 }
 
 int32_t stopGen(                                uint8_t card,
@@ -573,16 +4088,136 @@ int32_t stopGen(                                uint8_t card,
             log_error("sweep pthread_join failed with ret %d", ret);
             return ret;
         }
-        if (tone_status != 0 )
+        if (sweep_status != 0 )
         {
-            log_error("sweep_status failed with status %ld", tone_status);
-            return tone_status;
+            log_error("sweep_status failed with status %ld", sweep_status);
+            return sweep_status;
         }
     }
 
     return 0;
 }
 
+/*****************************************************************************/
+/** Sleeps until an absolute time, waking up regularly to see if the sweep 
+ *  was stopped.  Sleeping to a deadline rather than for a duration keeps 
+ *  the time spent between sleeps out of the dwell.
+
+    @param deadline_usec    monotonic time to wake up at
+    @return: void
+*/
+static void sleep_until(uint64_t deadline_usec)
+{
+    uint64_t now = now_usec();
+
+    while ((now < deadline_usec) && (g_sweep_thread_running == true))
+    {
+        uint64_t wake = deadline_usec;
+        struct timespec ts;
+
+        if ((wake - now) > MAX_SLEEP_SLICE_USEC)
+        {
+            wake = now + MAX_SLEEP_SLICE_USEC;
+        }
+        ts.tv_sec = wake / 1000000;
+        ts.tv_nsec = (wake % 1000000) * 1000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        now = now_usec();
+    }
+}
+
+/*****************************************************************************/
+/** Adds a sample to a min / max / total statistic
+
+    @param value        the sample
+    @param p_min        minimum so far
+    @param p_max        maximum so far
+    @param p_total      total so far
+    @param count        number of samples including this one
+    @return: void
+*/
+static void add_step_time(uint32_t value, uint32_t *p_min, uint32_t *p_max, uint64_t *p_total, 
+                          uint32_t count)
+{
+    if ((count == 1) || (value < *p_min))
+    {
+        *p_min = value;
+    }
+    if ((count == 1) || (value > *p_max))
+    {
+        *p_max = value;
+    }
+    *p_total += value;
+}
+
+/*****************************************************************************/
+/** Waits for the TX timestamp to reach a deadline.  It sleeps for all but 
+ *  the last TX_TIMED_POLL_USEC of the wait and polls the timestamp after that.
+
+    @param card         card transmitting
+    @param hdl          its handle
+    @param sample_rate  sample rate in Hz
+    @param deadline     TX timestamp to wait for
+    @param p_timestamp  the TX timestamp when the wait ended
+    @return: status of reading the timestamp
+*/
+static int32_t wait_tx_timestamp(uint8_t card, skiq_tx_hdl_t hdl, uint32_t sample_rate, 
+                                 uint64_t deadline, uint64_t *p_timestamp)
+{
+    int32_t status = 0;
+
+    for (;;)
+    {
+        uint64_t wait_usec;
+
+        status = skiq_read_curr_tx_timestamp(card, hdl, p_timestamp);
+        if ((status != 0) || (*p_timestamp >= deadline) || (g_sweep_thread_running == false))
+        {
+            break;
+        }
+
+        wait_usec = ((deadline - *p_timestamp) * 1000000) / sample_rate;
+        if (wait_usec > TX_TIMED_POLL_USEC)
+        {
+            sleep_until(now_usec() + wait_usec - TX_TIMED_POLL_USEC);
+        }
+    }
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Adds the start error of a timed step to the sweep statistics
+
+    @param error        achieved minus scheduled TX timestamp
+    @return: void
+*/
+static void add_start_error(int64_t error)
+{
+    int32_t value = (error > INT32_MAX) ? INT32_MAX : (error < INT32_MIN) ? INT32_MIN : 
+        (int32_t)error;
+
+    if ((g_sweep_stats.steps == 1) || (value < g_sweep_stats.start_error_min))
+    {
+        g_sweep_stats.start_error_min = value;
+    }
+    if ((g_sweep_stats.steps == 1) || (value > g_sweep_stats.start_error_max))
+    {
+        g_sweep_stats.start_error_max = value;
+    }
+}
+
+/*****************************************************************************/
+/** Sweep thread.  The tone is started once at the first frequency, after 
+ *  that only the TX LO is written each step while the tone keeps streaming.
+ *  The dwell of each step starts when the retune has completed.  A timed 
+ *  sweep schedules the steps on the TX timestamp instead of the system 
+ *  clock, so they follow the sample clock the receiver logs are stamped with.
+
+    @param params       the sweep thread parameters
+    @return: status
+*/
 static void* tx_sweep( void *params)
 {
     int status = 0;
@@ -590,34 +4225,128 @@ static void* tx_sweep( void *params)
     uint64_t step_time_usec = p_sweep_thread_params->step_time_ms * 1000;
     uint32_t stop_freq_MHz = (p_sweep_thread_params->steps * p_sweep_thread_params->freq_step_MHz) + p_sweep_thread_params->start_freq_MHz; 
     uint32_t curr_freq_MHz = p_sweep_thread_params->start_freq_MHz;
+    uint8_t card = p_sweep_thread_params->card;
+    skiq_tx_hdl_t hdl = g_tone_thread_parameters.hdl;
+    uint32_t sample_rate = 0;
+    uint64_t tuned_usec = 0;
+    uint64_t scheduled = 0;
+    uint64_t timestamp = 0;
 
     log_trace("sweepThread");
 
-
     log_debug("stop_freq_MHz %d, g_sweep_thread_running %d", stop_freq_MHz, g_sweep_thread_running);
-    while (g_sweep_thread_running == true)
+
+    /* configure everything and start the tone at the first frequency */
+    status = startCW(card, p_sweep_thread_params->p_rconfig, 
+            p_sweep_thread_params->p_tx_rconfig, curr_freq_MHz,
+            p_sweep_thread_params->span_MHz, p_sweep_thread_params->power_level);
+    if (status != 0)
     {
-        log_info("Running Sweep: curr_freq_MHz %d", curr_freq_MHz);
+        goto done;
+    }
+    tuned_usec = now_usec();
+    g_sweep_stats.last_freq_MHz = curr_freq_MHz;
 
-        status = startCW(p_sweep_thread_params->card, p_sweep_thread_params->p_rconfig, 
-                p_sweep_thread_params->p_tx_rconfig, curr_freq_MHz,
-                p_sweep_thread_params->span_MHz, p_sweep_thread_params->power_level);
+    if (p_sweep_thread_params->timed == true)
+    {
+        sample_rate = p_sweep_thread_params->p_rconfig->sample_rate;
+        status = skiq_read_curr_tx_timestamp(card, hdl, &scheduled);
         if (status != 0)
         {
+            log_error("Error: unable to read the TX timestamp (status %" PRIi32 ")", status);
             goto done;
         }
+        g_sweep_stats.timed = true;
+        g_sweep_stats.start_timestamp = scheduled;
+        g_sweep_stats.step_samples = ((uint64_t)p_sweep_thread_params->step_time_ms * 
+                                      sample_rate) / 1000;
+        g_sweep_stats.step_usec = (float)((g_sweep_stats.step_samples * 1000000.0) / sample_rate);
+    }
+
+    while (g_sweep_thread_running == true)
+    {
+        uint64_t start_usec = 0;
+        uint64_t freq = 0;
+
+        if (p_sweep_thread_params->timed == true)
+        {
+            /* the LO is written early by the average retune, up to half a step */
+            uint64_t lead = 0;
+
+            scheduled += g_sweep_stats.step_samples;
+            if (g_sweep_stats.steps != 0)
+            {
+                lead = ((g_sweep_stats.retune_total_usec / g_sweep_stats.steps) * sample_rate) / 
+                    1000000;
+                lead = (lead < (g_sweep_stats.step_samples / 2)) ? lead : 
+                    (g_sweep_stats.step_samples / 2);
+            }
+
+            status = wait_tx_timestamp(card, hdl, sample_rate, scheduled - lead, &timestamp);
+            if (status != 0)
+            {
+                log_error("Error: unable to read the TX timestamp (status %" PRIi32 ")", status);
+                goto done;
+            }
+        }
+        else
+        {
+            sleep_until(tuned_usec + step_time_usec);
+        }
+        if (g_sweep_thread_running == false)
+        {
+            break;
+        }
 
-        log_debug("usleep time %ld ", step_time_usec);
-        usleep(step_time_usec);
+        if (g_tone_thread_running == false)
+        {
+            log_error("tone stopped during the sweep");
+            status = -1;
+            goto done;
+        }
 
         curr_freq_MHz += p_sweep_thread_params->freq_step_MHz; 
-
         if (curr_freq_MHz > stop_freq_MHz)
         {
            curr_freq_MHz = p_sweep_thread_params->start_freq_MHz;
         }
- 
 
+        log_debug("Running Sweep: curr_freq_MHz %d", curr_freq_MHz);
+
+        freq = ((uint64_t)curr_freq_MHz * 1000000) - TONE_OFFSET_HZ;
+        start_usec = now_usec();
+
+        log_trace("skiq_write_tx_LO_freq");
+        status = skiq_write_tx_LO_freq(card, g_tone_thread_parameters.hdl, freq);
+        if (status != 0)
+        {
+            log_error("Error: unable to tune TX LO to %" PRIu64 " Hz (status %" PRIi32 ")", 
+                    freq, status);
+            goto done;
+        }
+        p_sweep_thread_params->p_tx_rconfig->freq = freq;
+
+        /* the dwell of the last step ends where this retune started */
+        g_sweep_stats.steps++;
+        add_step_time((uint32_t)(start_usec - tuned_usec), &g_sweep_stats.dwell_min_usec,
+                &g_sweep_stats.dwell_max_usec, &g_sweep_stats.dwell_total_usec, g_sweep_stats.steps);
+
+        tuned_usec = now_usec();
+        add_step_time((uint32_t)(tuned_usec - start_usec), &g_sweep_stats.retune_min_usec,
+                &g_sweep_stats.retune_max_usec, &g_sweep_stats.retune_total_usec, g_sweep_stats.steps);
+        g_sweep_stats.last_freq_MHz = curr_freq_MHz;
+
+        if (p_sweep_thread_params->timed == true)
+        {
+            /* the new frequency is out from the end of the retune */
+            status = skiq_read_curr_tx_timestamp(card, hdl, &timestamp);
+            if (status != 0)
+            {
+                log_error("Error: unable to read the TX timestamp (status %" PRIi32 ")", status);
+                goto done;
+            }
+            add_start_error((int64_t)(timestamp - scheduled));
+        }
     }
 
 done:
@@ -625,6 +4354,75 @@ done:
     return (void *)(intptr_t)status;
 }
 
+/*****************************************************************************/
+/** Copies the transmit queue counters of the current or last tone
+
+    @param p_stats      where to copy the counters
+    @return: void
+*/
+void getTxQueueStats(struct tx_queue_stats *p_stats)
+{
+    *p_stats = g_tx_queue_stats;
+
+    /* written from tx_complete() */
+    p_stats->completed = __atomic_load_n(&g_tx_queue_stats.completed, __ATOMIC_RELAXED);
+    p_stats->errors = __atomic_load_n(&g_tx_queue_stats.errors, __ATOMIC_RELAXED);
+    p_stats->depth = __atomic_load_n(&g_tx_queue_stats.depth, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************/
+/** Sets the impairments, the generator thread picks them up at its next block
+
+    @param p_impair     the impairments
+    @param p_backoff_db the reduction of the signal for the noise
+    @return: 0 on success, -EINVAL if out of range
+*/
+int32_t setTxImpairments(const struct tx_impair_config *p_impair, float *p_backoff_db)
+{
+    if ((p_impair->snr_db < -20.0f) || (p_impair->snr_db > 100.0f) || 
+        (p_impair->phase_noise_deg < 0.0f) || (p_impair->phase_noise_deg > 30.0f) ||
+        (fabsf(p_impair->iq_gain_db) > 6.0f) || (fabsf(p_impair->iq_phase_deg) > 45.0f))
+    {
+        log_error("impairments out of range, SNR %.1f dB, phase noise %.2f deg, "
+                "I/Q %.2f dB %.2f deg", p_impair->snr_db, p_impair->phase_noise_deg, 
+                p_impair->iq_gain_db, p_impair->iq_phase_deg);
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&g_impair_mutex);
+    g_impair_config = *p_impair;
+    pthread_mutex_unlock(&g_impair_mutex);
+    __atomic_add_fetch(&g_impair_seq, 1, __ATOMIC_RELAXED);
+
+    *p_backoff_db = (float)(-20 * log10(impair_backoff(p_impair)));
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Copies the impairments
+
+    @param p_impair     where to copy the impairments
+    @return: void
+*/
+void getTxImpairments(struct tx_impair_config *p_impair)
+{
+    pthread_mutex_lock(&g_impair_mutex);
+    *p_impair = g_impair_config;
+    pthread_mutex_unlock(&g_impair_mutex);
+}
+
+/*****************************************************************************/
+/** Copies the timing of the current or last sweep
+
+    @param p_stats      where to copy the statistics
+    @return: void
+*/
+void getSweepStats(struct sweep_stats *p_stats)
+{
+    *p_stats = g_sweep_stats;
+}
+
 
 int32_t startSweep(                             uint8_t card,
                                                 struct radio_config *p_rconfig,
@@ -634,13 +4432,15 @@ int32_t startSweep(                             uint8_t card,
                                                 uint32_t steps,
                                                 uint32_t freq_step_MHz,
                                                 uint32_t step_time_ms,
-                                                uint32_t span_MHz)
+                                                uint32_t span_MHz,
+                                                bool timed)
 {
     log_trace("startSweep");
     int status = 0;
 
-    log_debug("start_freq %d, power_level %d, steps %d, frq_step_MHz %d, step_time_ms %d, span %d", 
-            start_freq_MHz, power_level, steps, freq_step_MHz, step_time_ms, span_MHz); 
+    log_debug("start_freq %d, power_level %d, steps %d, frq_step_MHz %d, step_time_ms %d, span %d%s", 
+            start_freq_MHz, power_level, steps, freq_step_MHz, step_time_ms, span_MHz,
+            timed ? ", timed" : ""); 
 
 
     /* if the server is not running, exit */
@@ -669,10 +4469,12 @@ int32_t startSweep(                             uint8_t card,
     g_sweep_thread_parameters.freq_step_MHz = freq_step_MHz;
     g_sweep_thread_parameters.step_time_ms = step_time_ms;
     g_sweep_thread_parameters.span_MHz = span_MHz;
+    g_sweep_thread_parameters.timed = timed;
+    g_sweep_stats = (struct sweep_stats) SWEEP_STATS_INITIALIZER;
 
     /* start the tx_sweep thread */
-    status = pthread_create( &(g_sweep_thread_parameters.sweep_thread), 
-              NULL, tx_sweep, &g_sweep_thread_parameters);
+    status = rt_thread_create( &(g_sweep_thread_parameters.sweep_thread), 
+              rt_thread_tx, tx_sweep, &g_sweep_thread_parameters);
     if( status != 0 )
     {
         g_sweep_thread_running = false; 
@@ -684,3 +4486,282 @@ int32_t startSweep(                             uint8_t card,
     return status;
 }
 
+/*****************************************************************************/
+/** Frees the blocks of a rendered sweep, the tone thread must be stopped
+
+    @param p_render     the rendered sweep
+    @return: void
+*/
+static void free_sweep_render(struct sweep_render *p_render)
+{
+    if (p_render->p_blocks != NULL)
+    {
+        free_tx_blocks(p_render->p_blocks, p_render->num_blocks);
+    }
+    *p_render = (struct sweep_render) SWEEP_RENDER_INITIALIZER;
+}
+
+/*****************************************************************************/
+/** Plans the blocks of a rendered sweep.  The sweep is repeated until the 
+ *  loop fills MIN_TONE_BLOCKS blocks, and the block size that pads the loop 
+ *  the least is used.  The padding is spread over the steps.
+
+    @param dwell_samples    samples at each frequency
+    @param max_block_size   largest block size to use
+    @param p_render     the sweep, block_size, num_blocks and repeats are set
+    @return: void
+*/
+static void plan_sweep_render(uint64_t dwell_samples, uint32_t max_block_size,
+                              struct sweep_render *p_render)
+{
+    uint64_t sweep = (uint64_t)(p_render->steps + 1) * dwell_samples;
+    uint64_t min_loop = (uint64_t)MIN_TONE_BLOCKS * MIN_TONE_BLOCK_SIZE;
+    uint64_t best_pad = UINT64_MAX;
+    uint64_t loop;
+    uint32_t size;
+
+    p_render->repeats = (sweep < min_loop) ? (uint32_t)ROUND_UP(min_loop, sweep) : 1;
+    loop = sweep * p_render->repeats;
+
+    for (size = max_block_size; size >= MIN_TONE_BLOCK_SIZE; size -= BLOCK_SIZE_STEP)
+    {
+        uint64_t blocks = ROUND_UP(loop, size);
+        uint64_t pad = (blocks * size) - loop;
+
+        if ((blocks >= MIN_TONE_BLOCKS) && (pad < best_pad))
+        {
+            p_render->block_size = size;
+            p_render->num_blocks = (blocks > UINT32_MAX) ? UINT32_MAX : (uint32_t)blocks;
+            best_pad = pad;
+        }
+    }
+
+    log_debug("sweep of %" PRIu32 " steps repeated %" PRIu32 " times in %" PRIu32 
+            " blocks of %" PRIu32 ", %" PRIu64 " samples padding", p_render->steps + 1,
+            p_render->repeats, p_render->num_blocks, p_render->block_size, best_pad);
+}
+
+/*****************************************************************************/
+/** Renders the sweep into its blocks.  Each step holds whole cycles of its 
+ *  tone so it starts and ends at phase 0, which makes the sweep phase 
+ *  continuous through the steps and the loop.  The phase at each block 
+ *  boundary is computed exactly so the rounding of the phase step does not 
+ *  build up over a long step.
+
+    @param p_render     the planned sweep, p_blocks and info are set
+    @param first_offset_hz  offset of the first step from the LO
+    @return: status
+*/
+static int32_t render_sweep(struct sweep_render *p_render, double first_offset_hz)
+{
+    uint32_t num_freqs = p_render->steps + 1;
+    uint32_t total_steps = num_freqs * p_render->repeats;
+    uint64_t loop = (uint64_t)p_render->num_blocks * p_render->block_size;
+    float A = max_amplitude / M_SQRT2;
+    uint64_t start = now_usec();
+    uint64_t pos = 0;
+    uint32_t i;
+    uint32_t j;
+
+    p_render->p_blocks = calloc(p_render->num_blocks, sizeof(skiq_tx_block_t *));
+    if (p_render->p_blocks == NULL)
+    {
+        log_error("unable to allocate the blocks of a rendered sweep");
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < p_render->num_blocks; i++)
+    {
+        p_render->p_blocks[i] = skiq_tx_block_allocate(p_render->block_size);
+        if (p_render->p_blocks[i] == NULL)
+        {
+            log_error("unable to allocate the blocks of a rendered sweep");
+            p_render->num_blocks = i;
+            free_sweep_render(p_render);
+            return -ENOMEM;
+        }
+        rt_lock_buffer(p_render->p_blocks[i],
+                sizeof(skiq_tx_block_t) + (p_render->block_size * sizeof(uint32_t)));
+    }
+
+    for (j = 0; j < total_steps; j++)
+    {
+        uint64_t end = (((uint64_t)(j + 1) * loop) + (total_steps / 2)) / total_steps;
+        uint64_t len = end - pos;
+        double offset = first_offset_hz + 
+            ((double)(j % num_freqs) * p_render->freq_step_MHz * 1000000);
+        int64_t cycles = llround((offset * len) / p_render->sample_rate);
+        uint64_t wrapped = (uint64_t)(((cycles % (int64_t)len) + (int64_t)len) % (int64_t)len);
+        uint32_t phase_inc = (uint32_t)(((wrapped << 32) + (len / 2)) / len);
+        double error = fabs((((double)cycles * p_render->sample_rate) / len) - offset);
+        uint64_t done = 0;
+
+        p_render->info.max_error_hz = fmax(p_render->info.max_error_hz, error);
+
+        while (done < len)
+        {
+            uint32_t block = (uint32_t)((pos + done) / p_render->block_size);
+            uint32_t offset_in_block = (uint32_t)((pos + done) % p_render->block_size);
+            uint64_t left = len - done;
+            uint32_t count = p_render->block_size - offset_in_block;
+            uint64_t fraction = (wrapped * done) % len;
+            uint32_t phase = (uint32_t)((fraction << 32) / len);
+
+            count = (left < count) ? (uint32_t)left : count;
+            nco_tone(&p_render->p_blocks[block]->data[2 * offset_in_block], count, &phase,
+                    phase_inc, A);
+            done += count;
+        }
+        pos = end;
+    }
+
+    p_render->info.num_samples = (uint32_t)loop;
+    p_render->info.block_size = p_render->block_size;
+    p_render->info.num_blocks = p_render->num_blocks;
+    p_render->info.bytes = loop * 2 * sizeof(int16_t);
+    p_render->info.render_usec = (uint32_t)(now_usec() - start);
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Checks if a rendered sweep can be sent again
+
+    @param p_render     the rendered sweep
+    @param p_plan       the sweep to start
+    @return: true if the blocks hold the same sweep
+*/
+static bool same_sweep_render(const struct sweep_render *p_render, 
+                              const struct sweep_render *p_plan)
+{
+    return (p_render->p_blocks != NULL) &&
+           (p_render->start_freq_MHz == p_plan->start_freq_MHz) &&
+           (p_render->steps == p_plan->steps) &&
+           (p_render->freq_step_MHz == p_plan->freq_step_MHz) &&
+           (p_render->step_time_ms == p_plan->step_time_ms) &&
+           (p_render->sample_rate == p_plan->sample_rate) &&
+           (p_render->amplitude == p_plan->amplitude) &&
+           (p_render->block_size == p_plan->block_size) &&
+           (p_render->num_blocks == p_plan->num_blocks);
+}
+
+int32_t startRenderedSweep(                     uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint32_t start_freq_MHz,
+                                                uint32_t power_level,
+                                                uint32_t steps,
+                                                uint32_t freq_step_MHz,
+                                                uint32_t step_time_ms,
+                                                uint32_t span_MHz,
+                                                struct tx_sweep_render_info *p_info)
+{
+    int32_t status = 0;
+    struct sweep_render plan = SWEEP_RENDER_INITIALIZER;
+    uint64_t width_hz = (uint64_t)steps * freq_step_MHz * 1000000;
+    uint64_t half_span = ((uint64_t)span_MHz * 1000000) / 2;
+    uint64_t dwell_samples = 0;
+    uint64_t loop_samples = 0;
+    uint32_t total_steps = 0;
+    uint64_t bytes = 0;
+    bool reused = false;
+
+    log_trace("in startRenderedSweep");
+
+    /* if the server is not running, exit */
+    if (g_running == 0)
+    {
+       return -1; 
+    }
+
+    /* the LO is below the middle of the sweep by the tone offset of startCW() */
+    if (((width_hz / 2) + TONE_OFFSET_HZ) > half_span)
+    {
+        log_error("a rendered sweep %" PRIu64 " MHz wide needs a span of at least %" PRIu64 
+                " MHz", width_hz / 1000000, (width_hz + (2 * TONE_OFFSET_HZ)) / 1000000);
+        return -EINVAL;
+    }
+
+    stop_sweep_thread();
+
+    status = configure_generator_radio(card, p_rconfig, span_MHz);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    plan.start_freq_MHz = start_freq_MHz;
+    plan.steps = steps;
+    plan.freq_step_MHz = freq_step_MHz;
+    plan.step_time_ms = step_time_ms;
+    plan.sample_rate = p_rconfig->sample_rate;
+
+    dwell_samples = (((uint64_t)step_time_ms * p_rconfig->sample_rate) + 500) / 1000;
+    plan_sweep_render(dwell_samples, tuned_block_size(p_rconfig->sample_rate), &plan);
+
+    bytes = (uint64_t)plan.num_blocks * plan.block_size * 2 * sizeof(int16_t);
+    if (bytes > SWEEP_RENDER_BUDGET)
+    {
+        log_error("a rendered sweep of %" PRIu32 " steps of %" PRIu32 " ms needs %" PRIu64 
+                " MB, the budget is %d MB", steps + 1, step_time_ms, bytes >> 20, 
+                SWEEP_RENDER_BUDGET >> 20);
+        return -ENOMEM;
+    }
+    block_size = plan.block_size;
+
+    status = configure_generator_tx(card, p_rconfig, p_tx_rconfig, 
+            ((uint64_t)start_freq_MHz * 1000000) + (width_hz / 2) - TONE_OFFSET_HZ, 
+            power_level, 1);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    /* max_amplitude is known once the radio is configured, and the tone 
+     * thread is stopped so the blocks of the last sweep are free */
+    plan.amplitude = max_amplitude;
+    if (same_sweep_render(&g_sweep_render, &plan) == true)
+    {
+        reused = true;
+    }
+    else
+    {
+        free_sweep_render(&g_sweep_render);
+        status = render_sweep(&plan, (double)TONE_OFFSET_HZ - (width_hz / 2.0));
+        if (status != 0)
+        {
+            return status;
+        }
+        g_sweep_render = plan;
+    }
+    g_sweep_render.info.lo_freq_hz = p_tx_rconfig->freq;
+    *p_info = g_sweep_render.info;
+    p_info->reused = reused;
+
+    log_info("rendered sweep of %" PRIu32 " steps, %" PRIu32 " blocks of %" PRIu32 " (%" PRIu64 
+            " MB of %d MB) %s %" PRIu32 " usec, steps moved up to %.1f Hz", steps + 1, 
+            p_info->num_blocks, p_info->block_size, p_info->bytes >> 20, 
+            SWEEP_RENDER_BUDGET >> 20, reused ? "kept from the last start, rendered in" :
+            "rendered in", p_info->render_usec, p_info->max_error_hz);
+
+    g_tone_thread_parameters.plan = (struct tone_plan) TONE_PLAN_INITIALIZER;
+    g_tone_thread_parameters.plan.tone = 0;
+    g_tone_thread_parameters.plan.block_size = g_sweep_render.block_size;
+    g_tone_thread_parameters.plan.period_blocks = g_sweep_render.num_blocks;
+    g_tone_thread_parameters.plan.num_blocks = g_sweep_render.num_blocks;
+    g_tone_thread_parameters.tone = 0;
+    g_tone_thread_parameters.p_rendered = g_sweep_render.p_blocks;
+
+    /* the steps are in the samples, there are no retunes to time.  The 
+     * padding of the blocks is spread over the steps, so a step is the loop
+     * over the steps rendered in it, within a sample */
+    loop_samples = (uint64_t)g_sweep_render.num_blocks * g_sweep_render.block_size;
+    total_steps = (g_sweep_render.steps + 1) * g_sweep_render.repeats;
+    g_sweep_stats = (struct sweep_stats) SWEEP_STATS_INITIALIZER;
+    g_sweep_stats.step_samples = (loop_samples + (total_steps / 2)) / total_steps;
+    g_sweep_stats.step_usec = (float)((loop_samples * 1000000.0) / 
+            ((double)total_steps * p_rconfig->sample_rate));
+    g_sweep_stats.last_freq_MHz = start_freq_MHz;
+
+    return start_generator_thread(card, p_rconfig->sample_rate, tx_tone);
+}
@@ -17,6 +17,297 @@
 #include "utils_common.h"
 
 
+/* timing of the steps of a sweep in microseconds, and for a timed sweep in 
+ * samples of the TX timestamp */
+struct sweep_stats
+{
+    uint32_t            steps;                  // retunes done
+    uint32_t            retune_min_usec;        // time to write the LO
+    uint32_t            retune_max_usec;
+    uint64_t            retune_total_usec;
+    uint32_t            dwell_min_usec;         // from one retune completing to the next starting
+    uint32_t            dwell_max_usec;
+    uint64_t            dwell_total_usec;
+    uint32_t            last_freq_MHz;          // frequency of the current step
+    bool                timed;                  // steps scheduled on the TX timestamp
+    uint64_t            start_timestamp;        // TX timestamp the first step starts at
+    uint64_t            step_samples;           // scheduled length of a step
+    float               step_usec;              // the same in microseconds
+    int32_t             start_error_min;        // achieved minus scheduled start of a step, samples
+    int32_t             start_error_max;
+    uint32_t            late_blocks;            // timestamped blocks the FPGA found late
+};
+
+#define SWEEP_STATS_INITIALIZER                             \
+{                                                           \
+    .steps                  = 0,                            \
+    .retune_min_usec        = 0,                            \
+    .retune_max_usec        = 0,                            \
+    .retune_total_usec      = 0,                            \
+    .dwell_min_usec         = 0,                            \
+    .dwell_max_usec         = 0,                            \
+    .dwell_total_usec       = 0,                            \
+    .last_freq_MHz          = 0,                            \
+    .timed                  = false,                        \
+    .start_timestamp        = 0,                            \
+    .step_samples           = 0,                            \
+    .step_usec              = 0.0f,                         \
+    .start_error_min        = 0,                            \
+    .start_error_max        = 0,                            \
+    .late_blocks            = 0,                            \
+}                                                           \
+
+/* transmit queue of the running tone or streamed signal */
+struct tx_queue_stats
+{
+    uint64_t            sent;                   // blocks accepted by skiq_transmit()
+    uint64_t            completed;              // async completions
+    uint64_t            queue_full;             // skiq_transmit() found the queue full
+    uint64_t            queue_empty;            // nothing was in flight when a block was sent
+    uint32_t            depth;                  // async blocks in flight now
+    uint32_t            max_depth;
+    uint64_t            depth_total;            // depth at each send, / sent for the average
+    uint32_t            underruns;              // reported by the FPGA since streaming started
+    uint32_t            errors;                 // completions with an error status
+};
+
+#define TX_QUEUE_STATS_INITIALIZER                          \
+{                                                           \
+    .sent                   = 0,                            \
+    .completed              = 0,                            \
+    .queue_full             = 0,                            \
+    .queue_empty            = 0,                            \
+    .depth                  = 0,                            \
+    .max_depth              = 0,                            \
+    .depth_total            = 0,                            \
+    .underruns              = 0,                            \
+    .errors                 = 0,                            \
+}                                                           \
+
+/* maximum number of frequencies in a list mode digital sweep */
+#define MAX_DSWEEP_LIST     32
+
+/* how the tone moves in a digital sweep */
+typedef enum
+{
+    tx_dsweep_stepped,                          // equal steps from start to stop
+    tx_dsweep_chirp,                            // linear ramp from start to stop
+    tx_dsweep_list,                             // hops through list_offset_hz
+    tx_dsweep_end,
+} tx_dsweep_mode_t;
+
+/* digital sweep within the TX bandwidth, offsets are from the center frequency */
+struct tx_dsweep_config
+{
+    tx_dsweep_mode_t    mode;
+    int32_t             start_offset_hz;        // stepped and chirp
+    int32_t             stop_offset_hz;         // stepped and chirp
+    uint32_t            steps;                  // stepped, number of frequencies
+    uint32_t            dwell_usec;             // per frequency, or the whole ramp for chirp
+    uint32_t            num_list;               // list
+    int32_t             list_offset_hz[MAX_DSWEEP_LIST];
+    bool                timed;                  // blocks stamped with the TX timestamp
+};
+
+#define TX_DSWEEP_CONFIG_INITIALIZER                        \
+{                                                           \
+    .mode                   = tx_dsweep_stepped,            \
+    .start_offset_hz        = 0,                            \
+    .stop_offset_hz         = 0,                            \
+    .steps                  = 0,                            \
+    .dwell_usec             = 0,                            \
+    .num_list               = 0,                            \
+    .list_offset_hz         = { 0 },                        \
+    .timed                  = false,                        \
+}                                                           \
+
+/* maximum number of tones of a multi-tone signal */
+#define MAX_MULTITONE_TONES 64
+
+/* how the start phases of a multi-tone signal are chosen */
+typedef enum
+{
+    tx_phase_newman,                            // pi * k^2 / N in frequency order, low crest factor
+    tx_phase_zero,                              // all 0, the worst case crest factor
+    tx_phase_user,                              // phase_deg of each tone
+    tx_phase_end,
+} tx_phase_mode_t;
+
+/* one tone of a multi-tone signal */
+struct tx_tone
+{
+    int32_t             offset_hz;              // from the center frequency
+    float               level_db;               // relative to the other tones
+    float               phase_deg;              // used by tx_phase_user
+};
+
+struct tx_multitone_config
+{
+    tx_phase_mode_t     phase_mode;
+    uint32_t            num_tones;
+    struct tx_tone      tones[MAX_MULTITONE_TONES];
+};
+
+#define TX_MULTITONE_CONFIG_INITIALIZER                     \
+{                                                           \
+    .phase_mode             = tx_phase_newman,              \
+    .num_tones              = 0,                            \
+    .tones                  = { { 0, 0.0f, 0.0f } },        \
+}                                                           \
+
+/* the tones of startDualTone(), phase_deg is the start phase of each */
+struct tx_dual_config
+{
+    struct tx_tone      a1;
+    struct tx_tone      a2;
+};
+
+#define TX_DUAL_CONFIG_INITIALIZER                          \
+{                                                           \
+    .a1                     = { 0, 0.0f, 0.0f },            \
+    .a2                     = { 0, 0.0f, 0.0f },            \
+}                                                           \
+
+/* modulation of startModulated() */
+typedef enum
+{
+    tx_mod_am,                                  // carrier amplitude modulated by a tone
+    tx_mod_fm,                                  // carrier frequency modulated by a tone
+    tx_mod_bpsk,                                // PRBS symbols, RRC shaped
+    tx_mod_qpsk,
+    tx_mod_qam16,
+    tx_mod_end,
+} tx_mod_type_t;
+
+/* a modulated signal centered on the TX frequency */
+struct tx_mod_config
+{
+    tx_mod_type_t       type;
+    uint32_t            symbol_rate;            // PSK / QAM symbols per second
+    uint32_t            sps;                    // PSK / QAM samples per symbol, 2 to 16
+    float               rolloff;                // RRC excess bandwidth, 0.05 to 1
+    uint32_t            prbs_order;             // PRBS 7, 9, 15, 23 or 31 for the symbols
+    uint32_t            tone_hz;                // AM / FM modulating tone
+    float               am_depth;               // AM, 0 to 1
+    uint32_t            fm_deviation_hz;        // FM peak deviation
+};
+
+#define TX_MOD_CONFIG_INITIALIZER                           \
+{                                                           \
+    .type                   = tx_mod_qpsk,                  \
+    .symbol_rate            = 1000000,                      \
+    .sps                    = 4,                            \
+    .rolloff                = 0.35f,                        \
+    .prbs_order             = 15,                           \
+    .tone_hz                = 1000,                         \
+    .am_depth               = 0.5f,                         \
+    .fm_deviation_hz        = 5000,                         \
+}                                                           \
+
+/* the multi-tone period that was generated */
+struct tx_multitone_info
+{
+    double              crest_db;               // peak to average power of the envelope
+    double              max_error_hz;           // largest offset moved to fit the period
+    uint32_t            period;                 // samples in one loop of the signal
+    uint32_t            build_usec;             // time taken to generate the period
+};
+
+#define TX_MULTITONE_INFO_INITIALIZER                       \
+{                                                           \
+    .crest_db               = 0,                            \
+    .max_error_hz           = 0,                            \
+    .period                 = 0,                            \
+    .build_usec             = 0,                            \
+}                                                           \
+
+/* what startRenderedSweep() rendered */
+struct tx_sweep_render_info
+{
+    uint64_t            lo_freq_hz;             // the TX LO, the steps are offsets from it
+    uint32_t            num_samples;            // samples in one loop of the blocks
+    uint32_t            block_size;             // samples per block
+    uint32_t            num_blocks;
+    uint64_t            bytes;                  // memory held by the blocks
+    uint32_t            render_usec;            // time taken to render the blocks
+    double              max_error_hz;           // largest step moved to fit whole cycles
+    bool                reused;                 // the blocks of the last start were kept
+};
+
+#define TX_SWEEP_RENDER_INFO_INITIALIZER                    \
+{                                                           \
+    .lo_freq_hz             = 0,                            \
+    .num_samples            = 0,                            \
+    .block_size             = 0,                            \
+    .num_blocks             = 0,                            \
+    .bytes                  = 0,                            \
+    .render_usec            = 0,                            \
+    .max_error_hz           = 0,                            \
+    .reused                 = false,                        \
+}                                                           \
+
+/* impairments added to the streamed signals, the initializer is none */
+struct tx_impair_config
+{
+    bool                noise;                  // add noise at snr_db
+    float               snr_db;                 // signal to noise, -20 to 100 dB
+    int32_t             freq_offset_hz;         // shifts the signal
+    float               phase_noise_deg;        // rms, 0 to 30 degrees
+    float               iq_gain_db;             // Q relative to I, -6 to 6 dB
+    float               iq_phase_deg;           // Q from 90 degrees to I, -45 to 45
+};
+
+#define TX_IMPAIR_CONFIG_INITIALIZER                        \
+{                                                           \
+    .noise                  = false,                        \
+    .snr_db                 = 30.0f,                        \
+    .freq_offset_hz         = 0,                            \
+    .phase_noise_deg        = 0.0f,                         \
+    .iq_gain_db             = 0.0f,                         \
+    .iq_phase_deg           = 0.0f,                         \
+}                                                           \
+
+/* block sizes times transmit thread counts tried by tuneTx() */
+#define TX_TUNE_MAX_TRIALS  12
+#define TX_TUNE_DEFAULT_TRIAL_MS 500
+
+/* one trial transmission of tuneTx() */
+struct tx_tune_trial
+{
+    uint32_t            block_size;             // words per block
+    uint8_t             num_threads;            // 1 is sync transfer mode
+    uint32_t            underruns;              // during the trial
+    float               cpu_pct;                // of one core, the whole process
+    uint32_t            start_usec;             // start until the first block is accepted
+    uint64_t            sent;                   // blocks accepted by skiq_transmit()
+};
+
+#define TX_TUNE_TRIAL_INITIALIZER                           \
+{                                                           \
+    .block_size             = 0,                            \
+    .num_threads            = 0,                            \
+    .underruns              = 0,                            \
+    .cpu_pct                = 0.0f,                         \
+    .start_usec             = 0,                            \
+    .sent                   = 0,                            \
+}                                                           \
+
+struct tx_tune_result
+{
+    uint32_t            num_trials;
+    uint32_t            best;                   // index of the configuration kept
+    struct tx_tune_trial trials[TX_TUNE_MAX_TRIALS];
+};
+
+#define TX_TUNE_RESULT_INITIALIZER                          \
+{                                                           \
+    .num_trials             = 0,                            \
+    .best                   = 0,                            \
+    .trials                 = { TX_TUNE_TRIAL_INITIALIZER },\
+}                                                           \
+
+
+
 
 /*****************************************************************************/
 /** @brief
@@ -56,15 +347,27 @@ extern int32_t stopGen(                         uint8_t card,
 
 /*****************************************************************************/
 /** @brief
-    Configures 
+    Starts a sweep of the tone that retunes the TX LO each step
 
-    @param[in]      
-    @param[in/out]  
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      start_freq_MHz: frequency of the first step
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      steps:          steps after the first, the sweep then repeats
+    @param[in]      freq_step_MHz:  frequency step
+    @param[in]      step_time_ms:   time at each frequency
+    @param[in]      span_MHz:       span of the tone
+    @param[in]      timed:          schedule the steps on the TX timestamp 
 
-    @return         
+    @return         0 on success, else the pthread_create() error
 
-
-    @note   
+    @note   A timed sweep schedules step n at n * step_time_ms worth of 
+            samples after the TX timestamp of the first step, so the steps 
+            do not drift however long each retune takes.  The LO is written
+            early by the average retune time so the new frequency starts on
+            the schedule, the achieved start is read back from the TX 
+            timestamp and reported by getSweepStats().
 */
 extern int32_t startSweep(                      uint8_t card,
                                                 struct radio_config *p_rconfig,
@@ -74,8 +377,369 @@ extern int32_t startSweep(                      uint8_t card,
                                                 uint32_t steps,
                                                 uint32_t freq_step_MHz,
                                                 uint32_t step_time_ms,
-                                                uint32_t span_MHz);
+                                                uint32_t span_MHz,
+                                                bool timed);
+
+/*****************************************************************************/
+/** @brief
+    Starts the sweep of startSweep() rendered once into transmit blocks at 
+    baseband, the blocks are then looped without retuning the LO
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      start_freq_MHz: frequency of the first step
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      steps:          steps after the first, the sweep then repeats
+    @param[in]      freq_step_MHz:  frequency step
+    @param[in]      step_time_ms:   time at each frequency
+    @param[in]      span_MHz:       span, the sample rate is 20% larger
+    @param[out]     p_info:         what was rendered
+
+    @return         0 on success, -EINVAL if the sweep is wider than the span,
+                    -ENOMEM if it needs more than the render budget
+
+    @note   The LO is tuned once below the middle of the sweep, so steps * 
+            freq_step_MHz plus 2 MHz must fit in the span.  Each step holds
+            whole cycles of its tone, a step is moved by up to half a cycle
+            per dwell to do so, which keeps the phase continuous through 
+            the steps and the loop.  The blocks are sent as they are, like 
+            the tone of startCW(), so the sweep takes no CPU once rendered.
+            The blocks are kept, the same sweep started again is not 
+            rendered again.
+*/
+extern int32_t startRenderedSweep(              uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint32_t start_freq_MHz,
+                                                uint32_t power_level,
+                                                uint32_t steps,
+                                                uint32_t freq_step_MHz,
+                                                uint32_t step_time_ms,
+                                                uint32_t span_MHz,
+                                                struct tx_sweep_render_info *p_info);
+
+
+/*****************************************************************************/
+/** @brief
+    Starts a digital sweep of the tone within the TX bandwidth
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      freq_MHz:       center frequency, the TX LO is tuned here once
+    @param[in]      span_MHz:       span, the sample rate is 20% larger
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      p_dsweep:       the sweep, offsets must be within +/- span / 2
+
+    @return         0 on success, -EINVAL if the sweep is not valid
+
+    @note   The tone is generated as the blocks are transmitted by a phase 
+            continuous NCO, so the LO is never retuned and frequencies change 
+            on a sample boundary.  The dwell resolution is one sample.  A 
+            timed sweep stamps every block with the TX timestamp, the first
+            step starts a little after the call at the timestamp reported by
+            getSweepStats() and step n exactly n dwells later.
+*/
+extern int32_t startDigitalSweep(               uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_dsweep_config *p_dsweep);
+
+/*****************************************************************************/
+/** @brief
+    Plays an IQ file
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      freq_MHz:       center frequency
+    @param[in]      sample_rate:    sample rate of the file in Hz
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      p_path:         path of the file
+    @param[in]      loop:           start again at the end of the file
+    @param[in]      record_block_size:  0 for a file of int16 I/Q samples, or 
+                                    the block size in words of a file of 
+                                    skiq_tx_block_t records (header and data)
+
+    @return         0 on success, -errno if the file can not be opened or mapped,
+                    -EINVAL if it is too short
+
+    @note   The file is mapped, not read into memory, so any size plays without
+            a load delay.  Raw samples are copied into the transmit blocks as 
+            they are sent.  Records are passed to skiq_transmit() in place, 
+            without a copy.  When a file that does not loop has ended, the 
+            transmit stops on its own.
+*/
+extern int32_t startPlayFile(                   uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t sample_rate,
+                                                uint32_t power_level,
+                                                const char *p_path,
+                                                bool loop,
+                                                uint32_t record_block_size);
+
+/*****************************************************************************/
+/** @brief
+    Starts a multi-tone signal, each tone at its own offset, level and phase
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      freq_MHz:       center frequency
+    @param[in]      span_MHz:       span the offsets must be within
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      p_multitone:    the tones
+    @param[out]     p_info:         crest factor and period of the signal
+
+    @return         0 on success, -EINVAL if the tones are not valid, 
+                    -ENOMEM if the period can not be allocated
+
+    @note   One period in which every tone has a whole number of cycles is 
+            generated and looped.  The period is the exact one when it is 
+            short enough, otherwise tones are moved by less than 100 Hz to 
+            fit.  The sum is scaled so its largest I or Q value is 
+            max_amplitude, so a lower crest factor gives more power per tone.
+*/
+extern int32_t startMultiTone(                  uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_multitone_config *p_multitone,
+                                                struct tx_multitone_info *p_info);
+
+/*****************************************************************************/
+/** @brief
+    Starts a modulated signal, AM or FM by a tone, or PRBS symbols shaped by 
+    a root raised cosine filter
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      freq_MHz:       center frequency
+    @param[in]      span_MHz:       span of an AM or FM signal, the limit of 
+                                    the occupied bandwidth of PSK and QAM
+    @param[in]      power_level:    0 (quietest) to 10
+    @param[in]      p_mod:          the modulation
+
+    @return         0 on success, -EINVAL if the modulation is not valid
 
+    @note   The signal is generated as the blocks are transmitted.  PSK and 
+            QAM are sent at symbol_rate * sps samples per second through a 
+            polyphase interpolator, the PRBS restarts with the signal so the 
+            symbols can be compared by a receiver.  The scale keeps the 
+            largest possible filter output within max_amplitude.
+*/
+extern int32_t startModulated(                  uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_mod_config *p_mod);
+
+/*****************************************************************************/
+/** @brief
+    Starts a tone on each of the TX handles A1 and A2 with a fixed phase 
+    between them
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config, its handles and 
+                                    channel mode are switched to A1 and A2 
+                                    until the next generator is started
+    @param[in]      freq_MHz:       center frequency of both channels
+    @param[in]      span_MHz:       span in MHz
+    @param[in]      power_level:    0 (quietest) to 10, of both channels
+    @param[in]      p_dual:         the tone of each channel
+
+    @return         0 on success, -EINVAL if a tone is not valid, -ENOTSUP if
+                    the card does not have two TX channels
+
+    @note   Both channels are generated in one pass into dual channel blocks,
+            A1 followed by A2, and sent on the same sample clock.  Tones of
+            the same offset keep the phase difference a2.phase_deg - 
+            a1.phase_deg at baseband for as long as they run, the phase at 
+            the antennas also has the fixed path difference of the card.
+*/
+extern int32_t startDualTone(                   uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t span_MHz,
+                                                uint32_t power_level,
+                                                const struct tx_dual_config *p_dual);
+
+/*****************************************************************************/
+/** @brief Convert string representation to a modulation
+
+    @param[in] *str: "AM", "FM", "BPSK", "QPSK" or "QAM16" (case insensitive)
+
+    @return    tx_mod_type_t, tx_mod_end if not valid
+*/
+extern tx_mod_type_t str2modtype(               const char *str);
+
+/*****************************************************************************/
+/** @brief Convert a modulation to its string representation
+
+    @param[in] type: tx_mod_type_t
+
+    @return    char*:  string representation, "unknown" if invalid
+*/
+extern const char *modtype_cstr(                tx_mod_type_t type);
+
+/*****************************************************************************/
+/** @brief Convert string representation to a multi-tone phase mode
+
+    @param[in] *str: "NEWMAN", "ZERO" or "USER" (case insensitive)
+
+    @return    tx_phase_mode_t, tx_phase_end if not valid
+*/
+extern tx_phase_mode_t str2phasemode(           const char *str);
+
+/*****************************************************************************/
+/** @brief Convert a multi-tone phase mode to its string representation
+
+    @param[in] mode: tx_phase_mode_t
+
+    @return    char*:  string representation, "unknown" if invalid
+*/
+extern const char *phasemode_cstr(              tx_phase_mode_t mode);
+
+/*****************************************************************************/
+/** @brief Convert string representation to a digital sweep mode
+
+    @param[in] *str: "STEPPED", "CHIRP" or "LIST" (case insensitive)
+
+    @return    tx_dsweep_mode_t, tx_dsweep_end if not valid
+*/
+extern tx_dsweep_mode_t str2dsweepmode(         const char *str);
+
+/*****************************************************************************/
+/** @brief Convert a digital sweep mode to its string representation
+
+    @param[in] mode: tx_dsweep_mode_t
+
+    @return    char*:  string representation, "unknown" if invalid
+*/
+extern const char *dsweepmode_cstr(             tx_dsweep_mode_t mode);
+
+/*****************************************************************************/
+/** @brief
+    Returns the step timing of the current or last sweep
+
+    @param[out]     p_stats:        where to copy the statistics
+
+    @return         void
+
+    @note   The tone keeps streaming through a sweep and only the TX LO is 
+            written each step.  The dwell is timed from the completion of one 
+            retune to the start of the next.  For a timed sweep the start 
+            error is the TX timestamp after each retune minus its schedule,
+            a timed digital sweep changes frequency on the exact sample so 
+            only late blocks, which the FPGA drops, can move its steps.
+*/
+extern void getSweepStats(                      struct sweep_stats *p_stats);
+
+/*****************************************************************************/
+/** @brief
+    Returns the transmit queue counters of the current or last tone
+
+    @param[out]     p_stats:        where to copy the counters
+
+    @return         void
+
+    @note   The depth is only tracked in async mode (more than one transmit 
+            thread), in sync mode skiq_transmit() returns once the block is 
+            sent.  A block sent with nothing in flight means the FPGA was 
+            likely starved, which shows up as underruns.
+*/
+extern void getTxQueueStats(                    struct tx_queue_stats *p_stats);
+
+/*****************************************************************************/
+/** @brief
+    Finds the TX block size and number of transmit threads that stream a 
+    sample rate best on this card and host, and keeps them for the 
+    generators started later
+
+    @param[in]      card:           card to transmit on
+    @param[in/out]  p_rconfig:      the main radio config
+    @param[in/out]  p_tx_rconfig:   the TX radio config
+    @param[in]      freq_MHz:       LO frequency of the trials
+    @param[in]      sample_rate:    sample rate to tune for in Hz
+    @param[in]      trial_ms:       length of each trial transmission
+    @param[out]     p_result:       every trial and the one kept
+
+    @return         0 on success, -EINVAL if trial_ms is out of range, or 
+                    the status of the trial that failed
+
+    @note   Each trial streams a tone at the quietest power level and 
+            measures the underruns, the CPU time of the process and the time
+            to the first block sent.  The configuration with the fewest 
+            underruns, then the least CPU, then the fastest start is kept 
+            for the card type and sample rate and saved to TX_TUNE_FILE.  A
+            generator uses the entry of its card type with the lowest tuned
+            sample rate at or above its own, otherwise the command line 
+            threads and the default block size.
+*/
+extern int32_t tuneTx(                          uint8_t card,
+                                                struct radio_config *p_rconfig,
+                                                struct tx_radio_config *p_tx_rconfig,
+                                                uint64_t freq_MHz,
+                                                uint32_t sample_rate,
+                                                uint32_t trial_ms,
+                                                struct tx_tune_result *p_result);
+
+/*****************************************************************************/
+/** @brief
+    Sets the impairments of the streamed signals, taking effect from the 
+    next block of a running signal
+
+    @param[in]      p_impair:       the impairments
+    @param[out]     p_backoff_db:   how much the signal is reduced to leave
+                                    room for the noise
+
+    @return         0 on success, -EINVAL if an impairment is out of range
+
+    @note   The noise is relative to the average power of the signal over 
+            the last blocks, so the SNR holds for any generator.  The signal
+            is reduced so that it and 4 sigma of the noise fit in full scale.
+            The impairments apply to DSWEEP, PLAYFILE of raw samples, 
+            MULTITONE and MODULATE, which are generated as they are sent, 
+            not to the looped buffers of a CW tone.
+*/
+extern int32_t setTxImpairments(                const struct tx_impair_config *p_impair,
+                                                float *p_backoff_db);
+
+/*****************************************************************************/
+/** @brief
+    Returns the impairments of the streamed signals
+
+    @param[out]     p_impair:       where to copy the impairments
+
+    @return         void
+*/
+extern void getTxImpairments(                   struct tx_impair_config *p_impair);
+
+/*****************************************************************************/
+/** @brief
+    Frees the tone buffers kept for reuse by startCW()
+
+    @return         void
+
+    @note   Generated tone buffers are cached by tone offset, sample rate, 
+            amplitude and block size, up to a fixed memory budget, so 
+            repeated tones and sweep steps start without generating or 
+            allocating anything.  Buffers being transmitted are not freed.
+*/
+extern void clearToneCache(                     void);
 
 extern        void tx_complete( int32_t status, skiq_tx_block_t *p_data, void *p_user );
 
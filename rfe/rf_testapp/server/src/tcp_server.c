@@ -0,0 +1,977 @@
+/**
+ * @file tcp_server.c
+ *
+ * @brief
+ * Event loop of the testapp server, see tcp_server.h.
+ *
+ * The loop thread owns the clients, it accepts, reads, flushes and frees
+ * them.  The complete commands read from a client are queued as a batch to
+ * the worker of the card and the client is busy until the worker hands it
+ * back through the done list and the eventfd, the socket is not read
+ * meanwhile.  A partial command stays in the input buffer of the client
+ * until the rest of it is read.
+ *
+ * The worker only touches the client through tcp_server_send(), which
+ * appends to the output buffer under the lock of the client.  A client that
+ * hangs up while busy is taken out of epoll and freed when its batch is
+ * done, so its socket is not closed, and its number not reused, while a
+ * worker may still send to it.
+ *
+ * A long command streams its output with tcp_server_flush(), which puts
+ * the client on the flush list for the loop to send what it has so far.
+ * The flush and done lists are taken together under one lock and the
+ * flushes handled first, so a client is never freed while on the flush 
+ * list.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+/* accept4() and memrchr() are GNU extensions */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+/***** INCLUDES *****/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#include "sidekiq_api.h"
+#include "tcp_server.h"
+#include "utils_common.h"
+
+/***** DEFINES *****/
+
+/* the loop checks g_running this often, SIGINT may be taken by another thread */
+#define TCP_SERVER_POLL_MS          500
+
+#define TCP_SERVER_MAX_EVENTS       64
+
+/* largest socket number served */
+#define TCP_SERVER_MAX_FDS          65536
+
+/* output buffer an idle client keeps, a larger one is freed once sent */
+#define TCP_SERVER_OUT_SIZE         4096
+
+/***** STRUCTS *****/
+
+struct tcp_client
+{
+    int                 fd;
+    uint8_t             card;
+    char                *p_in;                  // TCP_SERVER_IN_SIZE bytes
+    uint32_t            in_len;                 // a partial command once a batch is taken
+    char                *p_batch;               // commands queued or running on the worker
+    uint32_t            events;                 // registered with epoll
+    bool                busy;                   // the worker has a batch of it
+    bool                closing;                // hung up while busy, freed when done
+    bool                peer_shut;              // a FIN was seen, commands before it still run
+    bool                read_done;              // read to the end, closed once its output is sent
+    bool                flush_queued;           // on the flush list
+
+    pthread_mutex_t     lock;                   // the output, the worker appends to it
+    char                *p_out;
+    uint32_t            out_len;
+    uint32_t            out_sent;
+    uint32_t            out_size;
+    bool                out_overflow;
+
+    struct tcp_client   *p_next;                // in a worker queue or the done list
+    struct tcp_client   *p_next_flush;          // in the flush list
+};
+
+struct tcp_worker
+{
+    pthread_t           thread;
+    bool                started;
+    bool                stop;
+    uint8_t             card;
+    tcp_command_fn      fn;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    struct tcp_client   *p_head;                // clients with a batch, in the order read
+    struct tcp_client   *p_tail;
+};
+
+#define TCP_WORKER_INITIALIZER                              \
+{                                                           \
+    .started                = false,                        \
+    .stop                   = false,                        \
+    .card                   = 0,                            \
+    .fn                     = NULL,                         \
+    .lock                   = PTHREAD_MUTEX_INITIALIZER,    \
+    .cond                   = PTHREAD_COND_INITIALIZER,     \
+    .p_head                 = NULL,                         \
+    .p_tail                 = NULL,                         \
+}                                                           \
+
+/***** GLOBAL DATA *****/
+
+extern volatile sig_atomic_t g_running;
+
+static int g_epoll_fd = -1;
+static int g_wake_fd = -1;
+static uint32_t g_max_fds = 0;
+static uint32_t g_num_clients = 0;
+static uint32_t g_max_out_bytes = TCP_SERVER_MAX_OUT_BYTES;
+
+/* the clients by socket, written by the loop thread only */
+static struct tcp_client **g_clients = NULL;
+
+static struct tcp_worker g_workers[SKIQ_MAX_NUM_CARDS] =
+    INIT_ARRAY(SKIQ_MAX_NUM_CARDS, TCP_WORKER_INITIALIZER);
+
+/* clients whose batch is done, handed back to the loop, and busy clients 
+ * with output to send now */
+static pthread_mutex_t g_done_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tcp_client *g_p_done = NULL;
+static struct tcp_client *g_p_flush = NULL;
+
+
+/*****************************************************************************/
+/** Runs each command of the batch of a client in order, empty lines are
+ *  skipped
+
+    @param p_worker     the worker
+    @param p_client     the client
+    @return: void
+*/
+static void run_batch(struct tcp_worker *p_worker, struct tcp_client *p_client)
+{
+    char *p_command = p_client->p_batch;
+    char *p_end = NULL;
+
+    while ((p_end = strchr(p_command, '\n')) != NULL)
+    {
+        *p_end = '\0';
+        if ((p_end > p_command) && (p_end[-1] == '\r'))
+        {
+            p_end[-1] = '\0';
+        }
+        if (p_command[0] != '\0')
+        {
+            p_worker->fn(p_client->fd, p_command);
+        }
+        p_command = p_end + 1;
+    }
+}
+
+/*****************************************************************************/
+/** Runs the batches of a card in the order they were queued
+
+    @param p_arg    the worker
+    @return: NULL
+*/
+static void *worker_thread(void *p_arg)
+{
+    struct tcp_worker *p_worker = p_arg;
+    struct tcp_client *p_client = NULL;
+    uint64_t one = 1;
+
+    log_trace("in worker_thread");
+
+    for (;;)
+    {
+        pthread_mutex_lock(&p_worker->lock);
+        while ((p_worker->p_head == NULL) && (p_worker->stop == false))
+        {
+            pthread_cond_wait(&p_worker->cond, &p_worker->lock);
+        }
+        if (p_worker->stop == true)
+        {
+            pthread_mutex_unlock(&p_worker->lock);
+            break;
+        }
+        p_client = p_worker->p_head;
+        p_worker->p_head = p_client->p_next;
+        if (p_worker->p_head == NULL)
+        {
+            p_worker->p_tail = NULL;
+        }
+        pthread_mutex_unlock(&p_worker->lock);
+
+        run_batch(p_worker, p_client);
+        free(p_client->p_batch);
+        p_client->p_batch = NULL;
+
+        pthread_mutex_lock(&g_done_lock);
+        p_client->p_next = g_p_done;
+        g_p_done = p_client;
+        pthread_mutex_unlock(&g_done_lock);
+
+        if (write(g_wake_fd, &one, sizeof(one)) < 0)
+        {
+            log_error("unable to wake the server loop (errno %d)", errno);
+        }
+    }
+
+    log_debug("worker of card %" PRIu8 " stopped", p_worker->card);
+
+    return NULL;
+}
+
+/*****************************************************************************/
+/** Queues a batch of commands of a client to the worker of its card, 
+ *  starting the worker the first time
+
+    @param p_client     the client, busy until the batch is done
+    @param p_batch      the commands, each ending with a newline, freed once run
+    @param fn           runs a command
+    @return: status
+*/
+static int32_t queue_batch(struct tcp_client *p_client, char *p_batch, tcp_command_fn fn)
+{
+    struct tcp_worker *p_worker = &g_workers[p_client->card];
+    int32_t status = 0;
+
+    if (p_worker->started == false)
+    {
+        p_worker->card = p_client->card;
+        p_worker->fn = fn;
+        p_worker->stop = false;
+        status = pthread_create(&p_worker->thread, NULL, worker_thread, p_worker);
+        if (status != 0)
+        {
+            log_error("unable to start the worker of card %" PRIu8 " (status %" PRIi32 ")",
+                    p_client->card, status);
+            return -status;
+        }
+        p_worker->started = true;
+    }
+
+    p_client->p_batch = p_batch;
+    p_client->p_next = NULL;
+    p_client->busy = true;
+
+    pthread_mutex_lock(&p_worker->lock);
+    if (p_worker->p_tail == NULL)
+    {
+        p_worker->p_head = p_client;
+    }
+    else
+    {
+        p_worker->p_tail->p_next = p_client;
+    }
+    p_worker->p_tail = p_client;
+    pthread_cond_signal(&p_worker->cond);
+    pthread_mutex_unlock(&p_worker->lock);
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Waits for input while the client is not busy and for room to send while
+ *  it has output, the epoll registration is only changed when these change.
+ *  A FIN is watched until one comes so a long command sees a busy client 
+ *  go, the input before it is still read once the client is not busy.
+
+    @param p_client     the client
+    @return: void
+*/
+static void update_events(struct tcp_client *p_client)
+{
+    struct epoll_event event;
+    uint32_t events = 0;
+
+    if (p_client->peer_shut == false)
+    {
+        events |= EPOLLRDHUP;
+    }
+    if ((p_client->busy == false) && (p_client->read_done == false))
+    {
+        events |= EPOLLIN;
+    }
+    pthread_mutex_lock(&p_client->lock);
+    if (p_client->out_sent < p_client->out_len)
+    {
+        events |= EPOLLOUT;
+    }
+    pthread_mutex_unlock(&p_client->lock);
+
+    if (events != p_client->events)
+    {
+        event.events = events;
+        event.data.fd = p_client->fd;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, p_client->fd, &event) != 0)
+        {
+            log_error("unable to update socket %d (errno %d)", p_client->fd, errno);
+        }
+        p_client->events = events;
+    }
+}
+
+/*****************************************************************************/
+/** Checks if a client that was read to the end has had all of its responses
+
+    @param p_client     the client
+    @return: true if it is to be closed
+*/
+static bool client_finished(struct tcp_client *p_client)
+{
+    bool finished;
+
+    if ((p_client->read_done == false) || (p_client->busy == true))
+    {
+        return false;
+    }
+    pthread_mutex_lock(&p_client->lock);
+    finished = (p_client->out_sent == p_client->out_len);
+    pthread_mutex_unlock(&p_client->lock);
+
+    return finished;
+}
+
+/*****************************************************************************/
+/** Frees a client that is not busy and closes its socket
+
+    @param p_client     the client
+    @return: void
+*/
+static void free_client(struct tcp_client *p_client)
+{
+    g_clients[p_client->fd] = NULL;
+    g_num_clients--;
+
+    if (p_client->closing == false)
+    {
+        epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, p_client->fd, NULL);
+    }
+    close(p_client->fd);
+
+    log_debug("client on socket %d closed, %" PRIu32 " clients", p_client->fd, g_num_clients);
+
+    pthread_mutex_destroy(&p_client->lock);
+    free(p_client->p_batch);
+    free(p_client->p_out);
+    free(p_client->p_in);
+    free(p_client);
+}
+
+/*****************************************************************************/
+/** Closes a client, or only stops watching it if the worker still has its
+ *  batch
+
+    @param p_client     the client
+    @return: void
+*/
+static void close_client(struct tcp_client *p_client)
+{
+    if (p_client->busy == true)
+    {
+        if (p_client->closing == false)
+        {
+            epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, p_client->fd, NULL);
+            __atomic_store_n(&p_client->closing, true, __ATOMIC_RELEASE);
+        }
+    }
+    else
+    {
+        free_client(p_client);
+    }
+}
+
+/*****************************************************************************/
+/** Sends as much of the output of a client as the socket takes
+
+    @param p_client     the client
+    @return: 0, else -errno if the client is to be closed
+*/
+static int32_t flush_client(struct tcp_client *p_client)
+{
+    int32_t status = 0;
+
+    pthread_mutex_lock(&p_client->lock);
+    while (p_client->out_sent < p_client->out_len)
+    {
+        ssize_t len = send(p_client->fd, &p_client->p_out[p_client->out_sent],
+                p_client->out_len - p_client->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (len < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                log_debug("send to socket %d failed (errno %d)", p_client->fd, errno);
+                status = -errno;
+            }
+            break;
+        }
+        p_client->out_sent += (uint32_t)len;
+    }
+
+    if (p_client->out_sent == p_client->out_len)
+    {
+        p_client->out_sent = 0;
+        p_client->out_len = 0;
+        if (p_client->out_size > TCP_SERVER_OUT_SIZE)
+        {
+            free(p_client->p_out);
+            p_client->p_out = NULL;
+            p_client->out_size = 0;
+        }
+    }
+    if (p_client->out_overflow == true)
+    {
+        status = -ENOBUFS;
+    }
+    pthread_mutex_unlock(&p_client->lock);
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Accepts every pending connection, a connection past the most clients
+ *  served is closed at once
+
+    @param listen_sock  the listening socket
+    @param p_config     the server
+    @return: void
+*/
+static void accept_clients(int listen_sock, const struct tcp_server_config *p_config)
+{
+    struct sockaddr_in addr;
+    struct epoll_event event;
+    struct tcp_client *p_client = NULL;
+    socklen_t len;
+    int fd;
+
+    for (;;)
+    {
+        len = sizeof(addr);
+        fd = accept4(listen_sock, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                log_error("accept failed (errno %d)", errno);
+            }
+            break;
+        }
+
+        if ((g_num_clients >= p_config->max_clients) || ((uint32_t)fd >= g_max_fds))
+        {
+            log_warn("%" PRIu32 " clients connected, closing the connection from %s",
+                    g_num_clients, inet_ntoa(addr.sin_addr));
+            close(fd);
+            continue;
+        }
+
+        p_client = calloc(1, sizeof(*p_client));
+        if ((p_client == NULL) ||
+            ((p_client->p_in = malloc(TCP_SERVER_IN_SIZE)) == NULL))
+        {
+            log_error("unable to allocate a client");
+            free(p_client);
+            close(fd);
+            continue;
+        }
+        p_client->fd = fd;
+        p_client->card = p_config->card;
+        p_client->events = EPOLLIN | EPOLLRDHUP;
+        pthread_mutex_init(&p_client->lock, NULL);
+
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            log_error("unable to watch socket %d (errno %d)", fd, errno);
+            pthread_mutex_destroy(&p_client->lock);
+            free(p_client->p_in);
+            free(p_client);
+            close(fd);
+            continue;
+        }
+
+        g_clients[fd] = p_client;
+        g_num_clients++;
+
+        log_debug("Client connected from %s on socket %d, %" PRIu32 " clients",
+                inet_ntoa(addr.sin_addr), fd, g_num_clients);
+    }
+}
+
+/*****************************************************************************/
+/** Reads from a client and queues the complete commands to the worker
+
+    @param p_client     the client, not busy
+    @param fn           runs a command
+    @return: void
+*/
+static void read_client(struct tcp_client *p_client, tcp_command_fn fn)
+{
+    char *p_batch = NULL;
+    char *p_last = NULL;
+    uint32_t batch_len;
+    ssize_t len;
+
+    len = recv(p_client->fd, &p_client->p_in[p_client->in_len],
+            TCP_SERVER_IN_SIZE - p_client->in_len, 0);
+    if (len < 0)
+    {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        {
+            return;
+        }
+        log_debug("receive on socket %d failed (errno %d)", p_client->fd, errno);
+        close_client(p_client);
+        return;
+    }
+    else if (len == 0)
+    {
+        /* this happens when the client disconnects, a partial command is dropped
+         * and the responses not yet sent still go out */
+        log_debug("client disconnected");
+        p_client->read_done = true;
+        if (client_finished(p_client) == true)
+        {
+            close_client(p_client);
+        }
+        else
+        {
+            update_events(p_client);
+        }
+        return;
+    }
+
+    log_debug("cmd rcvd: socket %d, len %zd, %.*s", p_client->fd, len, (int)len,
+            &p_client->p_in[p_client->in_len]);
+    p_client->in_len += (uint32_t)len;
+
+    p_last = memrchr(p_client->p_in, '\n', p_client->in_len);
+    if (p_last == NULL)
+    {
+        if (p_client->in_len >= TCP_SERVER_READ_SIZE)
+        {
+            log_error("command of socket %d is longer than %d bytes, closing it",
+                    p_client->fd, TCP_SERVER_READ_SIZE);
+            close_client(p_client);
+        }
+        return;
+    }
+
+    /* every complete command, the partial one after them stays */
+    batch_len = (uint32_t)(p_last - p_client->p_in) + 1;
+    p_batch = malloc(batch_len + 1);
+    if (p_batch == NULL)
+    {
+        log_error("Could not duplicate command line");
+        close_client(p_client);
+        return;
+    }
+    memcpy(p_batch, p_client->p_in, batch_len);
+    p_batch[batch_len] = '\0';
+
+    p_client->in_len -= batch_len;
+    memmove(p_client->p_in, &p_client->p_in[batch_len], p_client->in_len);
+    if (p_client->in_len >= TCP_SERVER_READ_SIZE)
+    {
+        log_error("command of socket %d is longer than %d bytes, closing it",
+                p_client->fd, TCP_SERVER_READ_SIZE);
+        free(p_batch);
+        close_client(p_client);
+        return;
+    }
+
+    if (queue_batch(p_client, p_batch, fn) != 0)
+    {
+        free(p_batch);
+        close_client(p_client);
+        return;
+    }
+    update_events(p_client);
+}
+
+/*****************************************************************************/
+/** Sends what the busy clients on the flush list have so far, then takes 
+ *  back the clients whose batch is done, sends their responses and frees
+ *  those that hung up meanwhile
+
+    @return: void
+*/
+static void handle_done(void)
+{
+    struct tcp_client *p_client = NULL;
+    struct tcp_client *p_next = NULL;
+    struct tcp_client *p_flush = NULL;
+    uint64_t count;
+
+    if (read(g_wake_fd, &count, sizeof(count)) < 0)
+    {
+        /* EAGAIN, the clients were taken on an earlier wakeup */
+    }
+
+    pthread_mutex_lock(&g_done_lock);
+    p_client = g_p_done;
+    g_p_done = NULL;
+    p_flush = g_p_flush;
+    g_p_flush = NULL;
+    for (p_next = p_flush; p_next != NULL; p_next = p_next->p_next_flush)
+    {
+        p_next->flush_queued = false;
+    }
+    pthread_mutex_unlock(&g_done_lock);
+
+    for (; p_flush != NULL; p_flush = p_next)
+    {
+        p_next = p_flush->p_next_flush;
+        p_flush->p_next_flush = NULL;
+
+        if (p_flush->closing == true)
+        {
+            continue;
+        }
+        if (flush_client(p_flush) != 0)
+        {
+            close_client(p_flush);
+        }
+        else
+        {
+            update_events(p_flush);
+        }
+    }
+
+    for (; p_client != NULL; p_client = p_next)
+    {
+        p_next = p_client->p_next;
+        p_client->p_next = NULL;
+        p_client->busy = false;
+
+        if (p_client->closing == true)
+        {
+            free_client(p_client);
+        }
+        else if ((flush_client(p_client) != 0) || (client_finished(p_client) == true))
+        {
+            close_client(p_client);
+        }
+        else
+        {
+            update_events(p_client);
+        }
+    }
+}
+
+/*****************************************************************************/
+/** Stops the workers and frees every client
+
+    @return: void
+*/
+static void stop_server(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < SKIQ_MAX_NUM_CARDS; i++)
+    {
+        struct tcp_worker *p_worker = &g_workers[i];
+
+        if (p_worker->started == true)
+        {
+            pthread_mutex_lock(&p_worker->lock);
+            p_worker->stop = true;
+            pthread_cond_broadcast(&p_worker->cond);
+            pthread_mutex_unlock(&p_worker->lock);
+
+            pthread_join(p_worker->thread, NULL);
+            p_worker->started = false;
+            p_worker->p_head = NULL;
+            p_worker->p_tail = NULL;
+        }
+    }
+
+    /* nothing runs a command anymore, so every client can go */
+    for (i = 0; i < g_max_fds; i++)
+    {
+        if (g_clients[i] != NULL)
+        {
+            g_clients[i]->busy = false;
+            free_client(g_clients[i]);
+        }
+    }
+    g_p_done = NULL;
+    g_p_flush = NULL;
+}
+
+int32_t tcp_server_run(const struct tcp_server_config *p_config)
+{
+    struct epoll_event events[TCP_SERVER_MAX_EVENTS];
+    struct epoll_event event;
+    struct rlimit limit;
+    int32_t status = 0;
+    int num;
+    int i;
+
+    log_trace("in tcp_server_run");
+
+    if ((p_config->fn == NULL) || (p_config->listen_sock < 0) ||
+        (p_config->card >= SKIQ_MAX_NUM_CARDS))
+    {
+        return -EINVAL;
+    }
+
+    g_max_fds = TCP_SERVER_MAX_FDS;
+    if ((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur < g_max_fds))
+    {
+        g_max_fds = (uint32_t)limit.rlim_cur;
+    }
+    g_max_out_bytes = p_config->max_out_bytes;
+
+    g_clients = calloc(g_max_fds, sizeof(struct tcp_client *));
+    if (g_clients == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    g_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    g_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((g_epoll_fd < 0) || (g_wake_fd < 0))
+    {
+        status = -errno;
+        log_error("unable to create the server loop (errno %d)", errno);
+        goto cleanup;
+    }
+
+    if (fcntl(p_config->listen_sock, F_SETFL,
+              fcntl(p_config->listen_sock, F_GETFL, 0) | O_NONBLOCK) != 0)
+    {
+        status = -errno;
+        log_error("unable to make the listening socket non-blocking (errno %d)", errno);
+        goto cleanup;
+    }
+
+    event.events = EPOLLIN;
+    event.data.fd = p_config->listen_sock;
+    if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, p_config->listen_sock, &event) != 0)
+    {
+        status = -errno;
+        goto cleanup;
+    }
+    event.data.fd = g_wake_fd;
+    if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_wake_fd, &event) != 0)
+    {
+        status = -errno;
+        goto cleanup;
+    }
+
+    log_info("serving up to %" PRIu32 " clients", p_config->max_clients);
+
+    while (g_running)
+    {
+        num = epoll_wait(g_epoll_fd, events, TCP_SERVER_MAX_EVENTS, TCP_SERVER_POLL_MS);
+        if (num < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            status = -errno;
+            log_error("server loop failed (errno %d)", errno);
+            break;
+        }
+
+        for (i = 0; i < num; i++)
+        {
+            int fd = events[i].data.fd;
+            struct tcp_client *p_client = NULL;
+
+            if (fd == p_config->listen_sock)
+            {
+                accept_clients(fd, p_config);
+                continue;
+            }
+            else if (fd == g_wake_fd)
+            {
+                handle_done();
+                continue;
+            }
+
+            /* an earlier event of this batch may have closed it */
+            p_client = g_clients[fd];
+            if ((p_client == NULL) || (p_client->closing == true))
+            {
+                continue;
+            }
+
+            if (events[i].events & EPOLLOUT)
+            {
+                if ((flush_client(p_client) != 0) || (client_finished(p_client) == true))
+                {
+                    close_client(p_client);
+                    continue;
+                }
+                update_events(p_client);
+            }
+
+            if (events[i].events & (EPOLLHUP | EPOLLERR))
+            {
+                /* nothing can be sent to it any more */
+                close_client(p_client);
+                continue;
+            }
+
+            if ((events[i].events & EPOLLRDHUP) && (p_client->peer_shut == false))
+            {
+                /* a FIN, tcp_server_connected() turns false so a long command
+                 * stops, its responses are still sent before the close */
+                __atomic_store_n(&p_client->peer_shut, true, __ATOMIC_RELEASE);
+                update_events(p_client);
+            }
+
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP)) && (p_client->busy == false) &&
+                (p_client->read_done == false))
+            {
+                read_client(p_client, p_config->fn);
+            }
+        }
+    }
+
+    stop_server();
+
+cleanup:
+    if (g_wake_fd >= 0)
+    {
+        close(g_wake_fd);
+        g_wake_fd = -1;
+    }
+    if (g_epoll_fd >= 0)
+    {
+        close(g_epoll_fd);
+        g_epoll_fd = -1;
+    }
+    free(g_clients);
+    g_clients = NULL;
+
+    return status;
+}
+
+int32_t tcp_server_send(int client_sock, const void *p_data, uint32_t len)
+{
+    struct iovec iov = { .iov_base = (void *)p_data, .iov_len = len };
+
+    return tcp_server_sendv(client_sock, &iov, 1);
+}
+
+int32_t tcp_server_sendv(int client_sock, const struct iovec *p_iov, uint32_t count)
+{
+    struct tcp_client *p_client = NULL;
+    uint64_t need;
+    uint32_t i;
+
+    if ((client_sock < 0) || ((uint32_t)client_sock >= g_max_fds) || (g_clients == NULL) ||
+        (g_clients[client_sock] == NULL))
+    {
+        return -ENOTCONN;
+    }
+    p_client = g_clients[client_sock];
+
+    pthread_mutex_lock(&p_client->lock);
+    need = p_client->out_len;
+    for (i = 0; i < count; i++)
+    {
+        need += p_iov[i].iov_len;
+    }
+    if ((p_client->out_overflow == true) || (need > g_max_out_bytes))
+    {
+        if (p_client->out_overflow == false)
+        {
+            log_error("client on socket %d has more than %" PRIu32 " bytes waiting, "
+                    "closing it", client_sock, g_max_out_bytes);
+        }
+        p_client->out_overflow = true;
+        pthread_mutex_unlock(&p_client->lock);
+        return -ENOBUFS;
+    }
+
+    if (need > p_client->out_size)
+    {
+        uint64_t size = (p_client->out_size > 0) ? p_client->out_size : TCP_SERVER_OUT_SIZE;
+        char *p_out = NULL;
+
+        while (size < need)
+        {
+            size *= 2;
+        }
+        size = (size > g_max_out_bytes) ? g_max_out_bytes : size;
+
+        p_out = realloc(p_client->p_out, size);
+        if (p_out == NULL)
+        {
+            pthread_mutex_unlock(&p_client->lock);
+            return -ENOBUFS;
+        }
+        p_client->p_out = p_out;
+        p_client->out_size = (uint32_t)size;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        memcpy(&p_client->p_out[p_client->out_len], p_iov[i].iov_base, p_iov[i].iov_len);
+        p_client->out_len += (uint32_t)p_iov[i].iov_len;
+    }
+    pthread_mutex_unlock(&p_client->lock);
+
+    return 0;
+}
+
+void tcp_server_flush(int client_sock)
+{
+    struct tcp_client *p_client = NULL;
+    uint64_t one = 1;
+    bool wake = false;
+
+    if ((client_sock < 0) || ((uint32_t)client_sock >= g_max_fds) || (g_clients == NULL) ||
+        (g_clients[client_sock] == NULL))
+    {
+        return;
+    }
+    p_client = g_clients[client_sock];
+
+    pthread_mutex_lock(&g_done_lock);
+    if (p_client->flush_queued == false)
+    {
+        p_client->flush_queued = true;
+        p_client->p_next_flush = g_p_flush;
+        g_p_flush = p_client;
+        wake = true;
+    }
+    pthread_mutex_unlock(&g_done_lock);
+
+    if ((wake == true) && (write(g_wake_fd, &one, sizeof(one)) < 0))
+    {
+        log_error("unable to wake the server loop (errno %d)", errno);
+    }
+}
+
+bool tcp_server_connected(int client_sock)
+{
+    if ((client_sock < 0) || ((uint32_t)client_sock >= g_max_fds) || (g_clients == NULL) ||
+        (g_clients[client_sock] == NULL))
+    {
+        return false;
+    }
+
+    return ((__atomic_load_n(&g_clients[client_sock]->closing, __ATOMIC_ACQUIRE) == false) &&
+            (__atomic_load_n(&g_clients[client_sock]->peer_shut, __ATOMIC_ACQUIRE) == false));
+}
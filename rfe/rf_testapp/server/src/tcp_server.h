@@ -0,0 +1,148 @@
+/**
+ * @file tcp_server.h
+ *
+ * @brief
+ * Event loop of the testapp server.  One thread waits on every client
+ * socket with epoll, the sockets are non-blocking and each client has its
+ * own buffers for what it sent and what is to be sent back, so a slow or
+ * idle client never holds up the others.
+ *
+ * A command ends with a newline, a carriage return before it is dropped.
+ * The input of a client is gathered until a newline, so a command split
+ * over several reads or several commands in one read are framed the same.
+ * The commands of one read are a batch, they run in order and their
+ * responses are sent together once the last one is done, so a client may
+ * send a whole sequence without waiting for each response.
+ *
+ * The commands run on a worker thread of the card, one per card, in the
+ * order they arrive.  A client has at most one batch queued or running,
+ * its socket is not read until the responses of the last one are queued.
+ * The threads are the loop and a worker per card whatever the number of
+ * clients, and the memory is the buffers of each client.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+#ifndef __TCP_SERVER_H__
+#define __TCP_SERVER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/* clients served at once, more are accepted and closed */
+#define TCP_SERVER_MAX_CLIENTS      256
+
+/* longest command, long enough for a DSWEEP or MULTITONE list, a client 
+ * sending a longer one is dropped */
+#define TCP_SERVER_READ_SIZE        1024
+
+/* input gathered from a client, several commands sent at once */
+#define TCP_SERVER_IN_SIZE          (16 * 1024)
+
+/* most response bytes waiting for a client, a client that reads no faster
+ * than this is dropped */
+#define TCP_SERVER_MAX_OUT_BYTES    (4 * 1024 * 1024)
+
+/* runs a command on the worker of the card, without its newline, the 
+ * response is passed to tcp_server_send() with the same client_sock */
+typedef int (*tcp_command_fn)(int client_sock, char *p_command);
+
+struct tcp_server_config
+{
+    int                 listen_sock;            // bound and listening
+    uint8_t             card;                   // worker that runs the commands
+    uint32_t            max_clients;
+    uint32_t            max_out_bytes;          // per client
+    tcp_command_fn      fn;
+};
+
+#define TCP_SERVER_CONFIG_INITIALIZER                       \
+{                                                           \
+    .listen_sock            = -1,                           \
+    .card                   = 0,                            \
+    .max_clients            = TCP_SERVER_MAX_CLIENTS,       \
+    .max_out_bytes          = TCP_SERVER_MAX_OUT_BYTES,     \
+    .fn                     = NULL,                         \
+}                                                           \
+
+
+/*****************************************************************************/
+/** @brief
+    Serves the clients of the listening socket until g_running is cleared
+
+    @param[in]      p_config:       the server
+
+    @return         0 once stopped, else -errno if the loop could not be set up
+
+    @note   Called from the main thread, the workers are stopped and the
+            clients closed before it returns.
+*/
+extern int32_t tcp_server_run(                  const struct tcp_server_config *p_config);
+
+/*****************************************************************************/
+/** @brief
+    Queues bytes to a client, from the command that client sent
+
+    @param[in]      client_sock:    passed to the command
+    @param[in]      p_data:         the bytes
+    @param[in]      len:            number of bytes
+
+    @return         0 on success, -ENOBUFS if the client has too much waiting,
+                    -ENOTCONN if client_sock is not a client
+
+    @note   The bytes are sent by the loop once the batch of the command is
+            done.
+*/
+extern int32_t tcp_server_send(                 int client_sock,
+                                                const void *p_data,
+                                                uint32_t len);
+
+/*****************************************************************************/
+/** @brief
+    Queues the pieces of a response to a client as one, like writev()
+
+    @param[in]      client_sock:    passed to the command
+    @param[in]      p_iov:          the pieces, in order
+    @param[in]      count:          number of pieces
+
+    @return         0 on success, -ENOBUFS if the client has too much waiting,
+                    nothing is queued then, -ENOTCONN if client_sock is not a
+                    client
+
+    @note   A header and the data it describes are queued without copying
+            them together first, and the client never gets one without the
+            other.
+*/
+extern int32_t tcp_server_sendv(                int client_sock,
+                                                const struct iovec *p_iov,
+                                                uint32_t count);
+
+/*****************************************************************************/
+/** @brief
+    Sends what is queued to a client without waiting for the end of the 
+    batch, for a command that streams its output
+
+    @param[in]      client_sock:    passed to the command
+
+    @return         void
+*/
+extern void tcp_server_flush(                   int client_sock);
+
+/*****************************************************************************/
+/** @brief
+    Checks if a client is still there, a long command stops once it is not
+
+    @param[in]      client_sock:    passed to the command
+
+    @return         false once the client hung up or was dropped
+
+    @note   A client that shuts down its sending side while its batch runs
+            is taken as gone too, what was queued to it is still sent before
+            it is closed.
+*/
+extern bool tcp_server_connected(               int client_sock);
+
+#endif
@@ -6,8 +6,36 @@
  * It provides basic funtions:
  *      - Start a continuous wave at a specified frequency and power
  *      - Start a sweeping wave over a range of frequency at one power
+ *      - Report the retune and dwell times of the sweep steps
+ *      - Sweep, chirp or hop the tone within the span without retuning the LO
+ *      - Render a sweep within the span once and loop it with no CPU per step
+ *      - Report the depth of the transmit queue and the underruns
+ *      - Play an IQ file, once or looped, straight from a mapping of the file
+ *      - Generate up to 64 tones at once with phases that keep the crest factor low
+ *      - Modulate the carrier with AM, FM or RRC shaped BPSK, QPSK or 16QAM of a PRBS
+ *      - Add noise at a set SNR, frequency offset, phase noise and I/Q imbalance live
+ *      - Transmit a tone on each of A1 and A2 with a fixed phase between them
+ *      - Tune the TX block size and transmit threads for a sample rate by trial
  *      - Stop all siggen transmissions
  *      - Do a peak search over a span, return power and frequency of highest signal
+ *      - Return the spectrum of a span as text, or up to 65536 points as packed binary
+ *      - Select how captures handle dropped blocks and report the capture counters
+ *      - Only capture once the received power crosses a threshold (burst signals)
+ *      - Use a fixed RX gain or autorange it based on clipping in the capture
+ *      - Correct the DC offset and I/Q imbalance of captures in software
+ *      - Capture packed 12 bit samples to reduce the transport bandwidth
+ *      - Run a sequence of tones over frequency and power with a peak search
+ *        and a limit check at each step, streaming a row per step
+ *
+ * The clients are served by one event loop, the commands run in order on a
+ * worker thread of the card (tcp_server.c).  Up to --max-clients can be 
+ * connected at once.  Each command ends with a newline and each response 
+ * ends with one, several commands may be sent without waiting and the 
+ * responses come back in the same order.
+ *
+ * The TX, RX and DSP threads can be pinned to cores (--rt-cpus) and run 
+ * SCHED_FIFO at --priority, with the memory locked (--rt-lock).  The wakeup
+ * latency of the threads is then measured at startup.
  *
  *
  * <pre>
@@ -28,37 +56,114 @@
 #include <signal.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <math.h>
+#include <time.h>
 
 
 #include "siggen.h"
 #include "sigann.h"
 #include "arg_parser.h"
 #include "utils_common.h"
+#include "rt_profile.h"
+#include "tcp_server.h"
 
-#define MAX 80
 #define IP "127.0.0.1"
 #define PORT 10000
 #define SA struct sockaddr
-#define MAX_CLIENT_THREADS 5
 
-/*
-  struct client_thread_params {}
+/* length of the latency test at startup when the real-time profile is used */
+#define RT_LATENCY_MS 200
+
+/* "SPEC", the first bytes of a binary GETDATA spectrum */
+#define GETDATA_MAGIC 0x43455053
+
+/* values of a binary GETDATA spectrum */
+typedef enum
+{
+    getdata_type_f32 = 0,       // float dB
+    getdata_type_i16,           // int16 hundredths of a dB
+    getdata_type_end
+} getdata_type_t;
+
+/* Header of a binary GETDATA spectrum, followed by count values of 
+ * data_type.  Sent in the byte order of the server, little endian on 
+ * every supported host, after a "SUCCESS <bytes>" line with the length of
+ * the header and values.
+ */
+struct getdata_header
+{
+    uint32_t            magic;                  // GETDATA_MAGIC
+    uint16_t            header_bytes;           // sizeof(struct getdata_header)
+    uint16_t            data_type;              // getdata_type_t
+    uint32_t            count;                  // number of values
+    float               scale;                  // dB of one unit of a value
+    double              start_freq_hz;          // low edge of the first value
+    double              bin_width_hz;           // span of each value
+};
+
+#define GETDATA_HEADER_INITIALIZER                          \
+{                                                           \
+    .magic                  = GETDATA_MAGIC,                \
+    .header_bytes           = sizeof(struct getdata_header),\
+    .data_type              = getdata_type_f32,             \
+    .count                  = 0,                            \
+    .scale                  = 1.0f,                         \
+    .start_freq_hz          = 0,                            \
+    .bin_width_hz           = 0,                            \
+}                                                           \
+
+/* most steps of a RUNSEQ, the frequencies times the power levels */
+#define RUNSEQ_MAX_STEPS 65536
+
+/* longest wait of a RUNSEQ before checking the server and the client */
+#define RUNSEQ_WAIT_SLICE_MS 100
+
+/* A test sequence of RUNSEQ.  At each frequency, for each power level, a
+ * tone is started offset from the frequency, left to settle, then the peak
+ * is searched around the frequency and checked against the limits that 
+ * are set.
  */
-struct client_thread_params
+struct run_seq
 {
-  pthread_t         client_thread; // thread responsible for transmitting data
-  int               client_index;
-  int               client_socket;
-  bool              client_completed;
+    int32_t             freq_first;             // center of the first step, MHz
+    int32_t             freq_last;              // included
+    int32_t             freq_step;
+    int32_t             power_first;            // power level of the tone
+    int32_t             power_last;             // included
+    int32_t             power_step;
+    int32_t             offset;                 // of the tone from the center, MHz
+    uint32_t            span;                   // of the tone and the search, MHz
+    uint32_t            settle_ms;              // from the tone to the search
+    uint32_t            off_ms;                 // generator off after a step, 0 to leave it on
+    bool                peak;                   // search the peak, else only step the tone
+    bool                min_is_set;
+    int32_t             min_db;                 // lowest peak power that passes
+    bool                max_is_set;
+    int32_t             max_db;                 // highest peak power that passes
+    bool                tol_is_set;
+    uint32_t            tol_khz;                // furthest peak from the tone that passes
 };
 
-#define CLIENT_THREAD_PARAMS_INITIALIZER                     \
-{                                                            \
-  .client_thread                    = 0,                     \
-  .client_index                     = -1,                    \
-  .client_socket                    = 0,                     \
-  .client_completed                 = true,                     \
-}                         
+#define RUN_SEQ_INITIALIZER                                 \
+{                                                           \
+    .freq_first             = 0,                            \
+    .freq_last              = 0,                            \
+    .freq_step              = 1,                            \
+    .power_first            = 0,                            \
+    .power_last             = 0,                            \
+    .power_step             = 1,                            \
+    .offset                 = 0,                            \
+    .span                   = 20,                           \
+    .settle_ms              = 1000,                         \
+    .off_ms                 = 0,                            \
+    .peak                   = true,                         \
+    .min_is_set             = false,                        \
+    .min_db                 = 0,                            \
+    .max_is_set             = false,                        \
+    .max_db                 = 0,                            \
+    .tol_is_set             = false,                        \
+    .tol_khz                = 0,                            \
+}                                                           \
 
 /***** GLOBAL DATA *****/
 
@@ -70,9 +175,7 @@ volatile sig_atomic_t g_running = 1;
 extern volatile sig_atomic_t g_tone_thread_running;
 extern volatile sig_atomic_t g_sweep_thread_running;
 int signal_num = 0;
-int connfd = 0;
-int server_sock;
-struct sockaddr_in cli;
+int server_sock = -1;
 
 uint8_t card = 0;
 
@@ -80,6 +183,15 @@ char * server_address = IP;
 bool server_address_is_present = false;
 uint32_t tcp_port = PORT;
 bool port_is_present = false;
+uint32_t max_clients = TCP_SERVER_MAX_CLIENTS;
+bool max_clients_is_present = false;
+
+/* the real-time profile of the signal threads */
+char * rt_cpus = "";
+bool rt_cpus_is_present = false;
+bool rt_lock = false;
+uint32_t rt_latency_ms = RT_LATENCY_MS;
+bool rt_latency_is_present = false;
 
 /* There is a separate structure for common radio data, RX, and TX */
 struct radio_config rconfig = RADIO_CONFIG_INITIALIZER;
@@ -132,12 +244,20 @@ int send_response(int client_sock, char * response)
     log_trace("in send_response response is %s", response);
 
 
-    int len = send(client_sock, response, strlen(response), 0);
+    /* queued to the client with its newline, the loop sends the responses
+     * of a batch together */
+    int len = strlen(response);
+    int32_t status = tcp_server_send(client_sock, response, len);
+
+    if (status == 0)
+    {
+        status = tcp_server_send(client_sock, "\n", 1);
+    }
 
     log_info("send response len %d", len);
 
-    if (len < 0)
-        perror("send error:");
+    if (status != 0)
+        log_error("send error: %" PRIi32 "", status);
 
     return 0;
 }
@@ -255,11 +375,16 @@ int process_startSweep(int client_sock, char * cmdline)
     uint32_t freq_step_MHz = 0;
     uint32_t step_time_ms = 0;
     uint32_t span_MHz = 0;
+    bool timed = false;
+    bool rendered = false;
+    struct tx_sweep_render_info info = TX_SWEEP_RENDER_INFO_INITIALIZER;
+    char outline[80];
 
     int32_t status = 0;
 
     log_trace("in process_startSweep" );
 
+    /* STARTSWEEP <start MHz> <power> <steps> <step MHz> <step ms> <span MHz> [TIMED|RENDERED] */
     arg = strtok(NULL, " ");
     if (arg == NULL)
     {
@@ -352,6 +477,27 @@ int process_startSweep(int client_sock, char * cmdline)
         return 1;
     }
 
+    /* steps on the TX timestamp rather than the system clock, or rendered 
+     * once within the span and looped */
+    arg = strtok(NULL, " ");
+    if (arg != NULL)
+    {
+        if( 0 == strcasecmp(arg, "TIMED") )
+        {
+            timed = true;
+        }
+        else if( 0 == strcasecmp(arg, "RENDERED") )
+        {
+            rendered = true;
+        }
+        else
+        {
+            log_error( "processSweep invalid parameter %s ", arg);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+    }
+
 
     if (tx_running == true)
     {
@@ -364,7 +510,15 @@ int process_startSweep(int client_sock, char * cmdline)
         }
     }
 
-    status = startSweep(card, &rconfig, &tx_rconfig, start_freq_MHz, power_level, steps, freq_step_MHz, step_time_ms, span_MHz);
+    if (rendered == true)
+    {
+        status = startRenderedSweep(card, &rconfig, &tx_rconfig, start_freq_MHz, power_level,
+                steps, freq_step_MHz, step_time_ms, span_MHz, &info);
+    }
+    else
+    {
+        status = startSweep(card, &rconfig, &tx_rconfig, start_freq_MHz, power_level, steps, freq_step_MHz, step_time_ms, span_MHz, timed);
+    }
 
     if (status != 0)
     {
@@ -375,318 +529,1949 @@ int process_startSweep(int client_sock, char * cmdline)
 
     tx_running = true;
 
-    send_response(client_sock, "SUCCESS");
+    if (rendered == true)
+    {
+        /* bytes, render usec, largest step offset error Hz, 1 if kept from the last start */
+        sprintf(outline, "SUCCESS %" PRIu64 " %" PRIu32 " %.1f %d", info.bytes, info.render_usec,
+                info.max_error_hz, info.reused ? 1 : 0);
+        send_response(client_sock, outline);
+    }
+    else
+    {
+        send_response(client_sock, "SUCCESS");
+    }
 
     return status;
 }
 
-int process_peakSearch(int client_sock, char * cmdline)
+int process_digitalSweep(int client_sock, char * cmdline)
 {
+    /* freq span power mode, then up to 4 mode parameters or a dwell and a list */
+    char * args[5 + MAX_DSWEEP_LIST];
     char * arg = NULL;
+    uint32_t num_args = 0;
     uint32_t freq = 0;
     uint32_t span = 0;
+    uint32_t power_level = 0;
+    uint32_t i;
+    struct tx_dsweep_config dsweep = TX_DSWEEP_CONFIG_INITIALIZER;
     int32_t status = 0;
 
-    log_trace("in process_peakSearch ");
+    log_trace("in process_digitalSweep ");
 
-    arg = strtok(NULL, " ");
-    if (arg == NULL)
+    /* DSWEEP <freq MHz> <span MHz> <power> STEPPED <start kHz> <stop kHz> <steps> <dwell usec>
+     * DSWEEP <freq MHz> <span MHz> <power> CHIRP <start kHz> <stop kHz> <sweep usec>
+     * DSWEEP <freq MHz> <span MHz> <power> LIST <dwell usec> <kHz> [kHz ...]
+     * each optionally followed by TIMED */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
     {
-        log_error( "not enough command arguments for peakSearch ");
-        send_response(client_sock, "FAILURE");
-        return 1;
+        args[num_args++] = arg;
     }
-    freq = atoi(arg);
-    if (freq <= 0 || freq > 6000)
+
+    /* blocks stamped with the TX timestamp */
+    if ((num_args > 0) && (0 == strcasecmp(args[num_args - 1], "TIMED")))
     {
-        log_error( "peakSearch invalid freq parameter freq %d ", freq);
-        send_response(client_sock, "FAILURE");
-        return 1;
+        dsweep.timed = true;
+        num_args--;
     }
 
-    arg = strtok(NULL, " ");
-    if (arg == NULL)
+    if (num_args < 6)
     {
-        log_error( "not enough command arguments for peakSearch ");
+        log_error( "not enough command arguments for digitalSweep ");
         send_response(client_sock, "FAILURE");
         return 1;
     }
 
-    span = atoi(arg);
-    if (span <= 0 || span > 60)
+    freq = atoi(args[0]);
+    span = atoi(args[1]);
+    power_level = atoi(args[2]);
+    dsweep.mode = str2dsweepmode(args[3]);
+    if (freq <= 0 || freq > 6000 || span <= 0 || span > 60 || power_level > 9)
     {
-        log_error( "peakSearch invalid span parameter span %d ", span);
+        log_error( "digitalSweep invalid parameter freq %d span %d power_level %d ", 
+                freq, span, power_level);
         send_response(client_sock, "FAILURE");
         return 1;
     }
 
-    uint64_t peak_freq = 0;
-    int32_t peak_power = -300;
+    switch (dsweep.mode)
+    {
+        case tx_dsweep_stepped:
+        case tx_dsweep_chirp:
+            if (num_args != ((dsweep.mode == tx_dsweep_stepped) ? 8 : 7))
+            {
+                log_error( "wrong number of arguments for a %s sweep ", 
+                        dsweepmode_cstr(dsweep.mode));
+                send_response(client_sock, "FAILURE");
+                return 1;
+            }
+            dsweep.start_offset_hz = atoi(args[4]) * 1000;
+            dsweep.stop_offset_hz = atoi(args[5]) * 1000;
+            if (dsweep.mode == tx_dsweep_stepped)
+            {
+                dsweep.steps = atoi(args[6]);
+                dsweep.dwell_usec = atoi(args[7]);
+            }
+            else
+            {
+                dsweep.dwell_usec = atoi(args[6]);
+            }
+            break;
 
-    /* determine if we are already transmitting, then be careful about changing span */
+        case tx_dsweep_list:
+            dsweep.dwell_usec = atoi(args[4]);
+            dsweep.num_list = num_args - 5;
+            for (i = 0; i < dsweep.num_list; i++)
+            {
+                dsweep.list_offset_hz[i] = atoi(args[5 + i]) * 1000;
+            }
+            break;
 
-    status = peakSearch(card, &rconfig, &rx_rconfig, freq, span, &peak_freq, &peak_power);
-    if (status != 0)
+        default:
+            log_error( "digitalSweep invalid mode %s ", args[3]);
+            send_response(client_sock, "FAILURE");
+            return 1;
+    }
+
+    if (tx_running == true)
     {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
+    }
 
+    status = startDigitalSweep(card, &rconfig, &tx_rconfig, freq, span, power_level, &dsweep);
+    if (status != 0)
+    {
         send_response(client_sock, "FAILURE");
         return status;
     }
 
+    tx_running = true;
 
-
-    log_debug("peak freq %lu, peak power %d", peak_freq, peak_power);
-
-    char outline[90];
-    sprintf(outline,"SUCCESS %" PRIu64 " %" PRIi32 "", peak_freq, peak_power);
-    send_response(client_sock, outline);
+    send_response(client_sock, "SUCCESS");
 
     return status;
 }
-int process_getData(int client_sock, char * cmdline)
+
+int process_playFile(int client_sock, char * cmdline)
 {
     char * arg = NULL;
+    char * p_path = NULL;
     uint32_t freq = 0;
-    uint32_t span = 0;
+    uint32_t sample_rate = 0;
+    uint32_t power_level = 0;
+    uint32_t record_block_size = 0;
+    bool loop = true;
     int32_t status = 0;
 
-    log_trace("in process_getData ");
+    log_trace("in process_playFile ");
 
+    /* PLAYFILE <freq MHz> <sample rate Hz> <power> <path> [LOOP|ONCE] [record block size] */
     arg = strtok(NULL, " ");
-    if (arg == NULL)
+    if (arg != NULL)
     {
-        log_error( "not enough command arguments for getData ");
-        send_response(client_sock, "FAILURE");
-        return 1;
+        freq = atoi(arg);
+        arg = strtok(NULL, " ");
     }
-    freq = atoi(arg);
-    if (freq <= 0 || freq > 6000)
+    if (arg != NULL)
     {
-        log_error( "getData invalid freq parameter freq %d ", freq);
+        sample_rate = strtoul(arg, NULL, 10);
+        arg = strtok(NULL, " ");
+    }
+    if (arg != NULL)
+    {
+        power_level = atoi(arg);
+        p_path = strtok(NULL, " ");
+    }
+    if (p_path == NULL)
+    {
+        log_error( "not enough command arguments for playFile ");
         send_response(client_sock, "FAILURE");
         return 1;
     }
 
     arg = strtok(NULL, " ");
-    if (arg == NULL)
+    if (arg != NULL)
     {
-        log_error( "not enough command arguments for getData ");
-        send_response(client_sock, "FAILURE");
-        return 1;
+        if( 0 == strcasecmp(arg, "ONCE") )
+        {
+            loop = false;
+        }
+        else if( 0 != strcasecmp(arg, "LOOP") )
+        {
+            log_error( "playFile invalid parameter %s, expected LOOP or ONCE ", arg);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+
+        arg = strtok(NULL, " ");
+        if (arg != NULL)
+        {
+            record_block_size = atoi(arg);
+        }
     }
 
-    span = atoi(arg);
-    if (span <= 0 || span > 60)
+    if (freq <= 0 || freq > 6000 || sample_rate == 0 || power_level > 9)
     {
-        log_error( "getData invalid span parameter span %d ", span);
+        log_error( "playFile invalid parameter freq %d sample_rate %d power_level %d ", 
+                freq, sample_rate, power_level);
         send_response(client_sock, "FAILURE");
         return 1;
     }
 
-#define MAXLEN  100000
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
+    }
 
-    /* determine if we are already transmitting, then be careful about changing span */
-    double freq_array[SWEEPPOINTS];
-    double power_array[SWEEPPOINTS];
-    char freq_str[MAXLEN] = INIT_ARRAY(MAXLEN, 0);
-    char power_str[MAXLEN] = INIT_ARRAY(MAXLEN, 0);
-    char tmp_str[100] = INIT_ARRAY(100, 0);
-    
-    status = getData(card, &rconfig, &rx_rconfig, freq, span, freq_array, power_array);
+    status = startPlayFile(card, &rconfig, &tx_rconfig, freq, sample_rate, power_level, 
+            p_path, loop, record_block_size);
     if (status != 0)
     {
         send_response(client_sock, "FAILURE");
         return status;
     }
 
-    for(int i=0; i < SWEEPPOINTS; i++)
-    {
-        sprintf(tmp_str, " %f", freq_array[i]);
-        strcat(freq_str, tmp_str);
-        sprintf(tmp_str, " %3.1f", power_array[i]);
-        strcat(power_str, tmp_str);
-    }
+    tx_running = true;
 
-    char outline[MAXLEN * 2 + 10];
-    sprintf(outline,"SUCCESS %s %s ", freq_str, power_str );
-    send_response(client_sock, outline);
+    send_response(client_sock, "SUCCESS");
 
     return status;
 }
 
-int process_setDebug(int client_sock, char * cmdline)
+/*****************************************************************************/
+/** Parses a tone of MULTITONE or DUALTONE, <kHz>[:<dB>[:<deg>]]
+
+    @param arg          the argument
+    @param p_tone       the tone
+    @return: true if valid
+*/
+static bool parse_tone(const char *arg, struct tx_tone *p_tone)
+{
+    char *p_end = NULL;
+
+    p_tone->offset_hz = (int32_t)lround(strtod(arg, &p_end) * 1000);
+    if (p_end == arg)
+    {
+        return false;
+    }
+    if (*p_end == ':')
+    {
+        arg = p_end + 1;
+        p_tone->level_db = strtof(arg, &p_end);
+        if (p_end == arg)
+        {
+            return false;
+        }
+    }
+    if (*p_end == ':')
+    {
+        arg = p_end + 1;
+        p_tone->phase_deg = strtof(arg, &p_end);
+        if (p_end == arg)
+        {
+            return false;
+        }
+    }
+
+    return (*p_end == '\0');
+}
+
+int process_multiTone(int client_sock, char * cmdline)
 {
+    /* freq span power phase mode, then the tones or a comb */
+    char * args[4 + MAX_MULTITONE_TONES];
     char * arg = NULL;
-    int32_t status = 0;
     char outline[100];
+    uint32_t num_args = 0;
+    uint32_t freq = 0;
+    uint32_t span = 0;
+    uint32_t power_level = 0;
+    uint32_t i;
+    struct tx_multitone_config multitone = TX_MULTITONE_CONFIG_INITIALIZER;
+    struct tx_multitone_info info = TX_MULTITONE_INFO_INITIALIZER;
+    int32_t status = 0;
 
-    log_trace("in process_setDebug ");
+    log_trace("in process_multiTone ");
 
-    arg = strtok(NULL, " ");
-    if (arg == NULL)
+    /* MULTITONE <freq MHz> <span MHz> <power> <NEWMAN|ZERO|USER> <kHz>[:<dB>[:<deg>]] [...]
+     * MULTITONE <freq MHz> <span MHz> <power> <NEWMAN|ZERO> COMB <tones> <spacing kHz> */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
     {
-        log_error( "not enough command arguments for getData ");
+        args[num_args++] = arg;
+    }
+
+    if (num_args < 5)
+    {
+        log_error( "not enough command arguments for multiTone ");
         send_response(client_sock, "FAILURE");
         return 1;
     }
 
-    if( 0 == strcasecmp(arg, "TRACE") )
+    freq = atoi(args[0]);
+    span = atoi(args[1]);
+    power_level = atoi(args[2]);
+    multitone.phase_mode = str2phasemode(args[3]);
+    if (freq <= 0 || freq > 6000 || span <= 0 || span > 60 || power_level > 9 ||
+        multitone.phase_mode == tx_phase_end)
     {
-        log_set_level(LLOG_TRACE, false, false);
-
+        log_error( "multiTone invalid parameter freq %d span %d power_level %d phases %s ", 
+                freq, span, power_level, args[3]);
+        send_response(client_sock, "FAILURE");
+        return 1;
     }
-    else if( 0 == strcasecmp(arg, "DEBUG") )
-    {
-        log_set_level(LLOG_DEBUG, false, false);
 
-    }
-    else if( 0 == strcasecmp(arg, "INFO") )
+    if( 0 == strcasecmp(args[4], "COMB") )
     {
-        log_set_level(LLOG_INFO, false, false);
+        double spacing = 0;
 
-    }
-    else if( 0 == strcasecmp(arg, "INFO") )
-    {
-        log_set_level(LLOG_INFO, false, false);
+        if (num_args != 7)
+        {
+            log_error( "wrong number of arguments for a comb ");
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+        multitone.num_tones = atoi(args[5]);
+        spacing = atof(args[6]) * 1000;
+        if ((multitone.num_tones == 0) || (multitone.num_tones > MAX_MULTITONE_TONES))
+        {
+            log_error( "multiTone invalid number of tones %s ", args[5]);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
 
+        /* centered on the frequency */
+        for (i = 0; i < multitone.num_tones; i++)
+        {
+            multitone.tones[i].offset_hz = 
+                (int32_t)lround((i - ((multitone.num_tones - 1) / 2.0)) * spacing);
+        }
     }
-    else if( 0 == strcasecmp(arg, "WARN") )
+    else
     {
-        log_set_level(LLOG_WARN, false, false);
-
+        multitone.num_tones = num_args - 4;
+        for (i = 0; i < multitone.num_tones; i++)
+        {
+            if (parse_tone(args[4 + i], &multitone.tones[i]) == false)
+            {
+                log_error( "multiTone invalid tone %s ", args[4 + i]);
+                send_response(client_sock, "FAILURE");
+                return 1;
+            }
+        }
     }
-    else if( 0 == strcasecmp(arg, "ERROR") )
-    {
-        log_set_level(LLOG_ERROR, false, false);
 
-    }
-    else if( 0 == strcasecmp(arg, "FATAL") )
+    if (tx_running == true)
     {
-        log_set_level(LLOG_FATAL, false, false);
-
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
     }
-    else
+
+    status = startMultiTone(card, &rconfig, &tx_rconfig, freq, span, power_level, &multitone,
+            &info);
+    if (status != 0)
     {
-        sprintf(outline, "FAILURE");
-        send_response(client_sock, outline);
-        return 0; 
+        send_response(client_sock, "FAILURE");
+        return status;
     }
 
-    sprintf(outline, "SUCCESS");
+    tx_running = true;
+
+    /* crest factor dB, period samples, largest tone offset error Hz */
+    sprintf(outline, "SUCCESS %.2f %" PRIu32 " %.1f", info.crest_db, info.period, 
+            info.max_error_hz);
     send_response(client_sock, outline);
 
     return status;
 }
 
-int process_command(int client_sock)
+int process_modulate(int client_sock, char * cmdline)
 {
-    char buff[MAX];
-    char *cmd_str = NULL; 
-    char *cmd = NULL;
-    int32_t len = 0;
-
-    log_trace("in process_command ");
-
-
-    bzero(buff, MAX);
+    /* freq span power modulation, then up to 4 parameters of the modulation */
+    char * args[8];
+    char * arg = NULL;
+    uint32_t num_args = 0;
+    uint32_t freq = 0;
+    uint32_t span = 0;
+    uint32_t power_level = 0;
+    struct tx_mod_config mod = TX_MOD_CONFIG_INITIALIZER;
+    int32_t status = 0;
 
-    log_info("waiting for command...");
+    log_trace("in process_modulate ");
 
-    // read the message from client and copy it in buffer
-    len = recv(client_sock, buff, sizeof(buff), 0);
+    /* MODULATE <freq MHz> <span MHz> <power> AM <tone Hz> <depth %>
+     * MODULATE <freq MHz> <span MHz> <power> FM <tone Hz> <deviation Hz>
+     * MODULATE <freq MHz> <span MHz> <power> <BPSK|QPSK|QAM16> <symbol rate> 
+     *                                              [<sps> [<rolloff> [<PRBS order>]]] */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
+    {
+        args[num_args++] = arg;
+    }
 
-    if (len < 0)
+    if (num_args < 5)
     {
-        perror("received  failed");
+        log_error( "not enough command arguments for modulate ");
+        send_response(client_sock, "FAILURE");
         return 1;
     }
-    else if (len == 0)
+
+    freq = atoi(args[0]);
+    span = atoi(args[1]);
+    power_level = atoi(args[2]);
+    mod.type = str2modtype(args[3]);
+    if (freq <= 0 || freq > 6000 || span <= 0 || span > 60 || power_level > 9 ||
+        mod.type == tx_mod_end)
     {
-        /* this happens when the client disconnects, so indicate we are done */
-        log_debug("client disconnected");
+        log_error( "modulate invalid parameter freq %d span %d power_level %d modulation %s ", 
+                freq, span, power_level, args[3]);
+        send_response(client_sock, "FAILURE");
         return 1;
     }
-    else
-    {
-        // print buffer which contains the client contents
-        log_debug("cmd rcvd: socket %d, len %d, %s", client_sock, len, buff);
-
-        cmd_str = strdup(buff);
 
-
-        if (cmd_str == NULL)
+    if ((mod.type == tx_mod_am) || (mod.type == tx_mod_fm))
+    {
+        if (num_args != 6)
         {
-            log_error( "Could not duplicate command line");
+            log_error( "%s needs a tone and a %s ", args[3], 
+                    (mod.type == tx_mod_am) ? "depth" : "deviation");
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+        mod.tone_hz = atoi(args[4]);
+        if (mod.type == tx_mod_am)
+        {
+            mod.am_depth = atof(args[5]) / 100;
         }
         else
         {
-            cmd = strtok(cmd_str, " ");
-
-            if( 0 == strcasecmp(cmd, "STARTCW") )
+            mod.fm_deviation_hz = atoi(args[5]);
+        }
+    }
+    else
+    {
+        mod.symbol_rate = atoi(args[4]);
+        if (num_args > 5)
+        {
+            mod.sps = atoi(args[5]);
+        }
+        if (num_args > 6)
+        {
+            mod.rolloff = atof(args[6]);
+        }
+        if (num_args > 7)
+        {
+            mod.prbs_order = atoi(args[7]);
+        }
+    }
+
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
+    }
+
+    status = startModulated(card, &rconfig, &tx_rconfig, freq, span, power_level, &mod);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    tx_running = true;
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_dualTone(int client_sock, char * cmdline)
+{
+    /* freq span power, then the tone of A1 and of A2 */
+    char * args[5];
+    char * arg = NULL;
+    uint32_t num_args = 0;
+    uint32_t freq = 0;
+    uint32_t span = 0;
+    uint32_t power_level = 0;
+    struct tx_dual_config dual = TX_DUAL_CONFIG_INITIALIZER;
+    int32_t status = 0;
+
+    log_trace("in process_dualTone ");
+
+    /* DUALTONE <freq MHz> <span MHz> <power> <A1 kHz>[:<dB>[:<deg>]] <A2 kHz>[:<dB>[:<deg>]] */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
+    {
+        args[num_args++] = arg;
+    }
+
+    if (num_args != 5)
+    {
+        log_error( "wrong number of command arguments for dualTone ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    freq = atoi(args[0]);
+    span = atoi(args[1]);
+    power_level = atoi(args[2]);
+    if (freq <= 0 || freq > 6000 || span <= 0 || span > 60 || power_level > 9)
+    {
+        log_error( "dualTone invalid parameter freq %d span %d power_level %d ", 
+                freq, span, power_level);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    if ((parse_tone(args[3], &dual.a1) == false) || (parse_tone(args[4], &dual.a2) == false))
+    {
+        log_error( "dualTone invalid tone %s or %s ", args[3], args[4]);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
+    }
+
+    status = startDualTone(card, &rconfig, &tx_rconfig, freq, span, power_level, &dual);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    tx_running = true;
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_impair(int client_sock, char * cmdline)
+{
+    /* SNR, then up to 4 more impairments */
+    char * args[5];
+    char * arg = NULL;
+    char outline[100];
+    uint32_t num_args = 0;
+    struct tx_impair_config impair = TX_IMPAIR_CONFIG_INITIALIZER;
+    float backoff_db = 0;
+    int32_t status = 0;
+
+    log_trace("in process_impair ");
+
+    /* IMPAIR
+     * IMPAIR OFF
+     * IMPAIR <SNR dB|OFF> [<freq offset Hz> [<phase noise deg rms> [<IQ gain dB> 
+     *                                                              [<IQ phase deg>]]]] */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
+    {
+        args[num_args++] = arg;
+    }
+
+    if (num_args == 0)
+    {
+        getTxImpairments(&impair);
+        if (impair.noise == true)
+        {
+            sprintf(outline, "SUCCESS %.1f", impair.snr_db);
+        }
+        else
+        {
+            sprintf(outline, "SUCCESS OFF");
+        }
+        sprintf(&outline[strlen(outline)], " %" PRIi32 " %.2f %.2f %.2f", impair.freq_offset_hz,
+                impair.phase_noise_deg, impair.iq_gain_db, impair.iq_phase_deg);
+        send_response(client_sock, outline);
+        return 0;
+    }
+
+    if( 0 != strcasecmp(args[0], "OFF") )
+    {
+        impair.noise = true;
+        impair.snr_db = atof(args[0]);
+    }
+    if (num_args > 1)
+    {
+        impair.freq_offset_hz = atoi(args[1]);
+    }
+    if (num_args > 2)
+    {
+        impair.phase_noise_deg = atof(args[2]);
+    }
+    if (num_args > 3)
+    {
+        impair.iq_gain_db = atof(args[3]);
+    }
+    if (num_args > 4)
+    {
+        impair.iq_phase_deg = atof(args[4]);
+    }
+
+    /* takes effect on the running signal, no need to restart it */
+    status = setTxImpairments(&impair, &backoff_db);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    /* how much the signal is reduced to leave room for the noise, dB */
+    sprintf(outline, "SUCCESS %.2f", backoff_db);
+    send_response(client_sock, outline);
+
+    return status;
+}
+
+int process_peakSearch(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    uint32_t freq = 0;
+    uint32_t span = 0;
+    int32_t status = 0;
+
+    log_trace("in process_peakSearch ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for peakSearch ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+    freq = atoi(arg);
+    if (freq <= 0 || freq > 6000)
+    {
+        log_error( "peakSearch invalid freq parameter freq %d ", freq);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for peakSearch ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    span = atoi(arg);
+    if (span <= 0 || span > 60)
+    {
+        log_error( "peakSearch invalid span parameter span %d ", span);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    uint64_t peak_freq = 0;
+    int32_t peak_power = -300;
+
+    /* determine if we are already transmitting, then be careful about changing span */
+
+    status = peakSearch(card, &rconfig, &rx_rconfig, freq, span, &peak_freq, &peak_power);
+    if (status == -ETIMEDOUT)
+    {
+        /* the energy trigger never fired, so there is no peak to report */
+        send_response(client_sock, "NOTRIGGER");
+        return 0;
+    }
+    else if (status != 0)
+    {
+
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+
+
+    log_debug("peak freq %lu, peak power %d", peak_freq, peak_power);
+
+    char outline[90];
+    sprintf(outline,"SUCCESS %" PRIu64 " %" PRIi32 "", peak_freq, peak_power);
+    send_response(client_sock, outline);
+
+    return status;
+}
+/*****************************************************************************/
+/** Sends a spectrum as text, the frequencies in MHz then the powers in dB
+
+    @param client_sock  the client
+    @param num_points   points of the spectrum
+    @param freq_array   the frequencies
+    @param power_array  the powers
+    @return: status
+*/
+static int32_t send_spectrum_text(int client_sock, uint32_t num_points, 
+                                  const double *freq_array, const double *power_array)
+{
+    /* a frequency and a power are each well within this */
+    size_t size = 16 + (num_points * 64);
+    char *p_outline = malloc(size);
+    size_t pos = 0;
+    uint32_t i;
+
+    if (p_outline == NULL)
+    {
+        send_response(client_sock, "FAILURE");
+        return -ENOMEM;
+    }
+
+    /* each value is written at the end of the last, not appended with strcat() */
+    pos += snprintf(&p_outline[pos], size - pos, "SUCCESS");
+    for (i = 0; i < num_points; i++)
+    {
+        pos += snprintf(&p_outline[pos], size - pos, " %f", freq_array[i]);
+    }
+    for (i = 0; i < num_points; i++)
+    {
+        pos += snprintf(&p_outline[pos], size - pos, " %3.1f", power_array[i]);
+    }
+
+    send_response(client_sock, p_outline);
+    free(p_outline);
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Sends a spectrum as a getdata_header and packed values, after a line with
+ *  their length.  The frequencies are those of the bins, the header gives 
+ *  them from the span of the capture.
+
+    @param client_sock  the client
+    @param data_type    the values to send
+    @param num_points   points of the spectrum
+    @param power_array  the powers in dB
+    @return: status
+*/
+static int32_t send_spectrum(int client_sock, getdata_type_t data_type, uint32_t num_points,
+                             const double *power_array)
+{
+    struct getdata_header header = GETDATA_HEADER_INITIALIZER;
+    size_t value_bytes = (data_type == getdata_type_i16) ? sizeof(int16_t) : sizeof(float);
+    void *p_values = malloc(num_points * value_bytes);
+    char outline[40];
+    struct iovec iov[3];
+    int32_t status = 0;
+    uint32_t i;
+
+    if (p_values == NULL)
+    {
+        send_response(client_sock, "FAILURE");
+        return -ENOMEM;
+    }
+
+    header.data_type = data_type;
+    header.count = num_points;
+    header.start_freq_hz = (double)rx_rconfig.freq - (rconfig.bandwidth / 2.0);
+    header.bin_width_hz = (double)rconfig.bandwidth / num_points;
+
+    if (data_type == getdata_type_i16)
+    {
+        int16_t *p_i16 = p_values;
+
+        header.scale = 0.01f;
+        for (i = 0; i < num_points; i++)
+        {
+            long value = lrint(power_array[i] * 100);
+
+            p_i16[i] = (value > INT16_MAX) ? INT16_MAX : (value < INT16_MIN) ? INT16_MIN : value;
+        }
+    }
+    else
+    {
+        float *p_f32 = p_values;
+
+        for (i = 0; i < num_points; i++)
+        {
+            p_f32[i] = (float)power_array[i];
+        }
+    }
+
+    snprintf(outline, sizeof(outline), "SUCCESS %zu\n", sizeof(header) + (num_points * value_bytes));
+    iov[0].iov_base = outline;
+    iov[0].iov_len = strlen(outline);
+    iov[1].iov_base = &header;
+    iov[1].iov_len = sizeof(header);
+    iov[2].iov_base = p_values;
+    iov[2].iov_len = num_points * value_bytes;
+
+    status = tcp_server_sendv(client_sock, iov, 3);
+    if (status != 0)
+    {
+        log_error("send error: %" PRIi32 "", status);
+    }
+    free(p_values);
+
+    return status;
+}
+
+int process_getData(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    uint32_t freq = 0;
+    uint32_t span = 0;
+    int32_t status = 0;
+    bool binary = false;
+    getdata_type_t data_type = getdata_type_f32;
+    uint32_t num_points = SWEEPPOINTS;
+    double *freq_array = NULL;
+    double *power_array = NULL;
+
+    log_trace("in process_getData ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for getData ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+    freq = atoi(arg);
+    if (freq <= 0 || freq > 6000)
+    {
+        log_error( "getData invalid freq parameter freq %d ", freq);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for getData ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    span = atoi(arg);
+    if (span <= 0 || span > 60)
+    {
+        log_error( "getData invalid span parameter span %d ", span);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* BINARY [F32|I16] [points] sends a header and packed dB values */
+    arg = strtok(NULL, " ");
+    if (arg != NULL)
+    {
+        if (0 != strcasecmp(arg, "BINARY"))
+        {
+            log_error( "getData invalid parameter %s ", arg);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+        binary = true;
+
+        arg = strtok(NULL, " ");
+        if ((arg != NULL) && (0 == strcasecmp(arg, "I16")))
+        {
+            data_type = getdata_type_i16;
+        }
+        else if ((arg != NULL) && (0 != strcasecmp(arg, "F32")))
+        {
+            log_error( "getData invalid data type %s ", arg);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+
+        arg = (arg != NULL) ? strtok(NULL, " ") : NULL;
+        if (arg != NULL)
+        {
+            num_points = strtoul(arg, NULL, 10);
+            if ((num_points == 0) || (num_points > MAX_SWEEPPOINTS) ||
+                ((num_points & (num_points - 1)) != 0))
+            {
+                log_error( "getData invalid points %s, a power of 2 up to %d ", arg,
+                        MAX_SWEEPPOINTS);
+                send_response(client_sock, "FAILURE");
+                return 1;
+            }
+        }
+    }
+
+    freq_array = malloc(num_points * sizeof(double));
+    power_array = malloc(num_points * sizeof(double));
+    if ((freq_array == NULL) || (power_array == NULL))
+    {
+        log_error( "getData unable to allocate %" PRIu32 " points ", num_points);
+        send_response(client_sock, "FAILURE");
+        status = -ENOMEM;
+        goto cleanup;
+    }
+
+    /* determine if we are already transmitting, then be careful about changing span */
+    status = getData(card, &rconfig, &rx_rconfig, freq, span, num_points, freq_array,
+            power_array);
+    if (status == -ETIMEDOUT)
+    {
+        send_response(client_sock, "NOTRIGGER");
+        status = 0;
+        goto cleanup;
+    }
+    else if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        goto cleanup;
+    }
+
+    if (binary == true)
+    {
+        status = send_spectrum(client_sock, data_type, num_points, power_array);
+    }
+    else
+    {
+        status = send_spectrum_text(client_sock, num_points, freq_array, power_array);
+    }
+
+cleanup:
+    free(freq_array);
+    free(power_array);
+
+    return status;
+}
+
+/*****************************************************************************/
+/** Parses a number of RUNSEQ, the whole value has to be the number
+
+    @param arg          the value after the '='
+    @param min          the smallest value allowed
+    @param max          the largest value allowed
+    @param p_value      the number
+    @return: true if valid
+*/
+static bool parse_number(const char *arg, int32_t min, int32_t max, int32_t *p_value)
+{
+    char *p_end = NULL;
+    long value = strtol(arg, &p_end, 10);
+
+    if ((p_end == arg) || (*p_end != '\0') || (value < min) || (value > max))
+    {
+        return false;
+    }
+    *p_value = (int32_t)value;
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Parses a range of RUNSEQ, <first>[:<last>[:<step>]], the step is 1 when
+ *  it is not given
+
+    @param arg          the value after the '='
+    @param min          the smallest value allowed
+    @param max          the largest value allowed, and the largest step
+    @param p_first      the first value
+    @param p_last       the last value, included
+    @param p_step       the step
+    @return: true if valid, first and last within min and max, first not above
+             last and step from 1 to max
+*/
+static bool parse_range(const char *arg, int32_t min, int32_t max, int32_t *p_first, 
+                        int32_t *p_last, int32_t *p_step)
+{
+    char *p_end = NULL;
+    long first = 0;
+    long last = 0;
+    long step = 1;
+
+    first = strtol(arg, &p_end, 10);
+    if (p_end == arg)
+    {
+        return false;
+    }
+    last = first;
+    if (*p_end == ':')
+    {
+        arg = p_end + 1;
+        last = strtol(arg, &p_end, 10);
+        if (p_end == arg)
+        {
+            return false;
+        }
+    }
+    if (*p_end == ':')
+    {
+        arg = p_end + 1;
+        step = strtol(arg, &p_end, 10);
+        if (p_end == arg)
+        {
+            return false;
+        }
+    }
+
+    /* strtol() saturates, so a value too large for a long is out of range too */
+    if ((*p_end != '\0') || (first < min) || (last > max) || (first > last) ||
+        (step < 1) || (step > max))
+    {
+        return false;
+    }
+    *p_first = (int32_t)first;
+    *p_last = (int32_t)last;
+    *p_step = (int32_t)step;
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Waits during a RUNSEQ, in slices so a stop of the server or a client
+ *  that hung up ends the sequence without waiting out a long settle time
+
+    @param client_sock  the client of the sequence
+    @param msec         the time to wait
+    @return: true if the sequence is to go on
+*/
+static bool run_seq_wait(int client_sock, uint32_t msec)
+{
+    uint32_t slice;
+
+    while ((g_running != 0) && (tcp_server_connected(client_sock) == true))
+    {
+        if (msec == 0)
+        {
+            return true;
+        }
+        slice = (msec < RUNSEQ_WAIT_SLICE_MS) ? msec : RUNSEQ_WAIT_SLICE_MS;
+        usleep(slice * 1000);
+        msec -= slice;
+    }
+
+    return false;
+}
+
+/*****************************************************************************/
+/** Runs one step of a RUNSEQ, the tone at a frequency and power, then the
+ *  peak search around the center and the check against the limits
+
+    @param client_sock  the client of the sequence
+    @param p_seq        the sequence
+    @param step         the number of the step, from 0
+    @param freq         center of the step in MHz, the tone is offset from it
+    @param power_level  power of the tone
+    @param p_passed     set to whether the step met the limits
+    @return: 0 on success, 1 if the sequence was stopped, else the error
+*/
+static int32_t run_seq_step(int client_sock, const struct run_seq *p_seq, uint32_t step,
+        int32_t freq, int32_t power_level, bool *p_passed)
+{
+    char outline[120];
+    uint64_t peak_freq = 0;
+    int32_t peak_power = -300;
+    int32_t tx_freq = freq + p_seq->offset;
+    int32_t status = 0;
+
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            return status;
+        }
+        tx_running = false;
+    }
+
+    status = startCW(card, &rconfig, &tx_rconfig, tx_freq, p_seq->span, power_level);
+    if (status != 0)
+    {
+        log_error( "runSeq unable to start the tone at %" PRIi32 " MHz ", tx_freq);
+        return status;
+    }
+    tx_running = true;
+
+    if (run_seq_wait(client_sock, p_seq->settle_ms) == false)
+    {
+        return 1;
+    }
+
+    *p_passed = true;
+    if (p_seq->peak == false)
+    {
+        sprintf(outline, "ROW %" PRIu32 " %" PRIi32 " %" PRIi32 " DONE", step, tx_freq,
+                power_level);
+    }
+    else
+    {
+        status = peakSearch(card, &rconfig, &rx_rconfig, freq, p_seq->span, &peak_freq,
+                &peak_power);
+        if (status == -ETIMEDOUT)
+        {
+            /* no energy at the tone is a failed step, not a failed sequence */
+            *p_passed = false;
+            sprintf(outline, "ROW %" PRIu32 " %" PRIi32 " %" PRIi32 " NOTRIGGER FAIL", step,
+                    tx_freq, power_level);
+        }
+        else if (status != 0)
+        {
+            return status;
+        }
+        else
+        {
+            if (((p_seq->min_is_set == true) && (peak_power < p_seq->min_db)) ||
+                ((p_seq->max_is_set == true) && (peak_power > p_seq->max_db)) ||
+                ((p_seq->tol_is_set == true) &&
+                 (llabs((int64_t)peak_freq - (int64_t)tx_freq * 1000000) > 
+                  (int64_t)p_seq->tol_khz * 1000)))
+            {
+                *p_passed = false;
+            }
+            sprintf(outline, "ROW %" PRIu32 " %" PRIi32 " %" PRIi32 " %" PRIu64 " %" PRIi32 " %s",
+                    step, tx_freq, power_level, peak_freq, peak_power,
+                    (*p_passed == true) ? "PASS" : "FAIL");
+        }
+        status = 0;
+    }
+
+    /* the row goes out now, not with the end of the sequence */
+    send_response(client_sock, outline);
+    tcp_server_flush(client_sock);
+
+    if (p_seq->off_ms > 0)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            return status;
+        }
+        tx_running = false;
+
+        if (run_seq_wait(client_sock, p_seq->off_ms) == false)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int process_runSeq(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    char * value = NULL;
+    char outline[100];
+    struct run_seq seq = RUN_SEQ_INITIALIZER;
+    struct timespec start_time;
+    struct timespec end_time;
+    uint64_t num_steps = 0;
+    uint32_t step = 0;
+    uint32_t failed = 0;
+    int32_t freq;
+    int32_t power_level;
+    int32_t number = 0;
+    int32_t step_status = 0;
+    int32_t status = 0;
+    bool freq_is_present = false;
+    bool passed = true;
+
+    log_trace("in process_runSeq ");
+
+    /* RUNSEQ FREQ=<first>:<last>:<step> [POWER=<first>:<last>:<step>] [OFFSET=<MHz>]
+     *        [SPAN=<MHz>] [SETTLE=<ms>] [OFF=<ms>] [PEAK=ON|OFF] [MIN=<dB>] [MAX=<dB>]
+     *        [TOL=<kHz>] */
+    while ((arg = strtok(NULL, " ")) != NULL)
+    {
+        value = strchr(arg, '=');
+        if (value == NULL)
+        {
+            log_error( "runSeq invalid parameter %s ", arg);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+        *value++ = '\0';
+
+        if (0 == strcasecmp(arg, "FREQ"))
+        {
+            freq_is_present = parse_range(value, 1, 6000, &seq.freq_first, &seq.freq_last,
+                    &seq.freq_step);
+            if (freq_is_present == false)
+            {
+                break;
+            }
+        }
+        else if (0 == strcasecmp(arg, "POWER"))
+        {
+            if (parse_range(value, 0, 9, &seq.power_first, &seq.power_last,
+                        &seq.power_step) == false)
+            {
+                break;
+            }
+        }
+        else if (0 == strcasecmp(arg, "OFFSET"))
+        {
+            if (parse_number(value, -6000, 6000, &number) == false)
+            {
+                break;
+            }
+            seq.offset = number;
+        }
+        else if (0 == strcasecmp(arg, "SPAN"))
+        {
+            if (parse_number(value, 0, INT32_MAX, &number) == false)
+            {
+                break;
+            }
+            seq.span = number;
+        }
+        else if (0 == strcasecmp(arg, "SETTLE"))
+        {
+            if (parse_number(value, 0, INT32_MAX, &number) == false)
             {
-                process_startCW(client_sock, cmd_str);
+                break;
             }
-            else if( 0 == strcasecmp(cmd, "STOPGEN") )
+            seq.settle_ms = number;
+        }
+        else if (0 == strcasecmp(arg, "OFF"))
+        {
+            if (parse_number(value, 0, INT32_MAX, &number) == false)
             {
-                process_stopGen(client_sock, cmd_str);
+                break;
             }
-            else if( 0 == strcasecmp(cmd, "STARTSWEEP") )
+            seq.off_ms = number;
+        }
+        else if (0 == strcasecmp(arg, "PEAK"))
+        {
+            if (0 == strcasecmp(value, "ON"))
             {
-                process_startSweep(client_sock, cmd_str);
+                seq.peak = true;
             }
-            else if( 0 == strcasecmp(cmd, "PEAKSEARCH") )
+            else if (0 == strcasecmp(value, "OFF"))
             {
-                process_peakSearch(client_sock, cmd_str);
+                seq.peak = false;
             }
-            else if( 0 == strcasecmp(cmd, "GETDATA") )
+            else
             {
-                process_getData(client_sock, cmd_str);
+                break;
             }
-            else if( 0 == strcasecmp(cmd, "SETDEBUG") )
+        }
+        else if (0 == strcasecmp(arg, "MIN"))
+        {
+            if (parse_number(value, INT32_MIN, INT32_MAX, &seq.min_db) == false)
             {
-                process_setDebug(client_sock, cmd_str);
+                break;
             }
-            else
+            seq.min_is_set = true;
+        }
+        else if (0 == strcasecmp(arg, "MAX"))
+        {
+            if (parse_number(value, INT32_MIN, INT32_MAX, &seq.max_db) == false)
+            {
+                break;
+            }
+            seq.max_is_set = true;
+        }
+        else if (0 == strcasecmp(arg, "TOL"))
+        {
+            if (parse_number(value, 0, INT32_MAX, &number) == false)
+            {
+                break;
+            }
+            seq.tol_khz = number;
+            seq.tol_is_set = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (arg != NULL)
+    {
+        log_error( "runSeq invalid parameter %s=%s ", arg, value);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+    if (freq_is_present == false)
+    {
+        log_error( "not enough command arguments for runSeq ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* every tone is checked before the first step, the centers and the power
+     * levels were checked as they were parsed */
+    if (((seq.freq_first + seq.offset) <= 0) || ((seq.freq_last + seq.offset) > 6000))
+    {
+        log_error( "runSeq invalid freq %" PRIi32 " to %" PRIi32 " offset %" PRIi32 " ",
+                seq.freq_first, seq.freq_last, seq.offset);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+    if (seq.span <= 0 || seq.span > 60)
+    {
+        log_error( "runSeq invalid span parameter span %d ", seq.span);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    num_steps = (uint64_t)((seq.freq_last - seq.freq_first) / seq.freq_step + 1) *
+        (uint64_t)((seq.power_last - seq.power_first) / seq.power_step + 1);
+    if (num_steps > RUNSEQ_MAX_STEPS)
+    {
+        log_error( "runSeq has %" PRIu64 " steps, at most %d ", num_steps, RUNSEQ_MAX_STEPS);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    log_info("runSeq of %" PRIu64 " steps", num_steps);
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    /* the last value is compared before a step is added, so the sum never 
+     * goes past it */
+    freq = seq.freq_first;
+    while (step_status == 0)
+    {
+        power_level = seq.power_first;
+        while (step_status == 0)
+        {
+            step_status = run_seq_step(client_sock, &seq, step, freq, power_level, &passed);
+            if ((step_status == 0) && (passed == false))
+            {
+                failed++;
+            }
+            step++;
+
+            if ((seq.power_last - power_level) < seq.power_step)
+            {
+                break;
+            }
+            power_level += seq.power_step;
+        }
+
+        if ((seq.freq_last - freq) < seq.freq_step)
+        {
+            break;
+        }
+        freq += seq.freq_step;
+    }
+
+    /* the generator is left off whether the sequence ended or was stopped */
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        tx_running = false;
+    }
+
+    if ((step_status != 0) || (status != 0))
+    {
+        log_error( "runSeq stopped at step %" PRIu32 " (status %" PRIi32 ") ", step - 1,
+                (step_status != 0) ? step_status : status);
+        send_response(client_sock, "FAILURE");
+        return (step_status != 0) ? step_status : status;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    /* the rows, the steps that failed and how long the sequence took */
+    sprintf(outline, "SUCCESS %" PRIu32 " %" PRIu32 " %" PRIu64 "", step, failed,
+            (uint64_t)((end_time.tv_sec - start_time.tv_sec) * 1000 +
+                       (end_time.tv_nsec - start_time.tv_nsec) / 1000000));
+    send_response(client_sock, outline);
+
+    return 0;
+}
+
+int process_setGapPolicy(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    rx_gap_policy_t policy = rx_gap_policy_end;
+    int32_t status = 0;
+
+    log_trace("in process_setGapPolicy ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for setGapPolicy ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    policy = str2gappolicy(arg);
+    status = setGapPolicy(policy);
+    if (status != 0)
+    {
+        log_error( "setGapPolicy invalid policy %s ", arg);
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_setTrigger(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    int32_t threshold_dbfs = -40;
+    uint32_t pretrigger_samples = 4096;
+    uint32_t timeout_ms = 1000;
+    bool enabled = true;
+    int32_t status = 0;
+
+    log_trace("in process_setTrigger ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for setTrigger ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* SETTRIGGER OFF or SETTRIGGER <threshold dBFS> [pretrigger samples] [timeout ms] */
+    if( 0 == strcasecmp(arg, "OFF") )
+    {
+        enabled = false;
+    }
+    else
+    {
+        threshold_dbfs = atoi(arg);
+
+        arg = strtok(NULL, " ");
+        if (arg != NULL)
+        {
+            pretrigger_samples = atoi(arg);
+
+            arg = strtok(NULL, " ");
+            if (arg != NULL)
             {
-                log_error( "invalid command %s ", cmd);
+                timeout_ms = atoi(arg);
             }
-        
         }
+    }
+
+    status = setTrigger(enabled, threshold_dbfs, pretrigger_samples, timeout_ms);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_setGain(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    int32_t status = 0;
+    rx_gain_range_mode_t mode = rx_gain_range_fixed;
+    int32_t gain = 0;
+
+    log_trace("in process_setGain ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for setGain ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* SETGAIN AUTORANGE or SETGAIN <gain index> */
+    if( 0 == strcasecmp(arg, "AUTORANGE") )
+    {
+        mode = str2gainmode(arg);
+    }
+    else
+    {
+        gain = atoi(arg);
+        if (gain < 0 || gain > UINT8_MAX)
+        {
+            log_error( "setGain invalid gain parameter gain %d ", gain);
+            send_response(client_sock, "FAILURE");
+            return 1;
+        }
+    }
+
+    status = setGainMode(mode, (uint8_t)gain);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_sweepStats(int client_sock, char * cmdline)
+{
+    struct sweep_stats stats;
+    char outline[200];
+    uint32_t retune_avg = 0;
+    uint32_t dwell_avg = 0;
+
+    log_trace("in process_sweepStats ");
+
+    getSweepStats(&stats);
+    if (stats.steps != 0)
+    {
+        retune_avg = (uint32_t)(stats.retune_total_usec / stats.steps);
+        dwell_avg = (uint32_t)(stats.dwell_total_usec / stats.steps);
+    }
+
+    sprintf(outline, "SUCCESS %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 
+            " %" PRIu32 " %" PRIu32 " %" PRIu32 "", stats.steps, 
+            stats.retune_min_usec, retune_avg, stats.retune_max_usec,
+            stats.dwell_min_usec, dwell_avg, stats.dwell_max_usec, stats.last_freq_MHz);
+
+    /* timed, start timestamp, step samples and usec, start error min / max samples, late blocks */
+    sprintf(&outline[strlen(outline)], " %d %" PRIu64 " %" PRIu64 " %.3f %" PRIi32 " %" PRIi32 
+            " %" PRIu32 "", stats.timed ? 1 : 0, stats.start_timestamp, stats.step_samples,
+            stats.step_usec, stats.start_error_min, stats.start_error_max, stats.late_blocks);
+    send_response(client_sock, outline);
+
+    return 0;
+}
+
+int process_txStats(int client_sock, char * cmdline)
+{
+    struct tx_queue_stats stats;
+    char outline[200];
+    uint32_t depth_avg = 0;
+
+    log_trace("in process_txStats ");
+
+    getTxQueueStats(&stats);
+    if (stats.sent != 0)
+    {
+        depth_avg = (uint32_t)(stats.depth_total / stats.sent);
+    }
+
+    sprintf(outline, "SUCCESS %" PRIu64 " %" PRIu64 " %" PRIu32 " %" PRIu32 " %" PRIu32 
+            " %" PRIu64 " %" PRIu64 " %" PRIu32 " %" PRIu32 "", stats.sent, stats.completed,
+            stats.depth, depth_avg, stats.max_depth, stats.queue_full, stats.queue_empty,
+            stats.underruns, stats.errors);
+    send_response(client_sock, outline);
+
+    return 0;
+}
+
+int process_txTune(int client_sock, char * cmdline)
+{
+    char * args[3];
+    char * arg = NULL;
+    char outline[40 + (TX_TUNE_MAX_TRIALS * 48)];
+    uint32_t len = 0;
+    uint32_t num_args = 0;
+    uint32_t freq = 0;
+    uint32_t sample_rate = 0;
+    uint32_t trial_ms = TX_TUNE_DEFAULT_TRIAL_MS;
+    struct tx_tune_result result = TX_TUNE_RESULT_INITIALIZER;
+    uint32_t i;
+    int32_t status = 0;
+
+    log_trace("in process_txTune ");
+
+    /* TXTUNE <freq MHz> <sample rate Hz> [<trial ms>] */
+    while ((num_args < (sizeof(args) / sizeof(args[0]))) && 
+           ((arg = strtok(NULL, " ")) != NULL))
+    {
+        args[num_args++] = arg;
+    }
+
+    if (num_args < 2)
+    {
+        log_error( "not enough command arguments for txTune ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    freq = atoi(args[0]);
+    sample_rate = strtoul(args[1], NULL, 10);
+    if (num_args > 2)
+    {
+        trial_ms = atoi(args[2]);
+    }
+    if (freq <= 0 || freq > 6000 || sample_rate < 1000000 || sample_rate > 250000000)
+    {
+        log_error( "txTune invalid parameter freq %d sample rate %" PRIu32 " ", freq, 
+                sample_rate);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* the trials use the transmitter */
+    if (tx_running == true)
+    {
+        status = stopGen(card, &rconfig, &tx_rconfig);
+        if (status != 0)
+        {
+            send_response(client_sock, "FAILURE");
+            return status;
+        }
+        tx_running = false;
+    }
+
+    status = tuneTx(card, &rconfig, &tx_rconfig, freq, sample_rate, trial_ms, &result);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    /* the kept block size and threads, then 
+     * <block size>:<threads>:<underruns>:<CPU %>:<start usec> of each trial */
+    len = sprintf(outline, "SUCCESS %" PRIu32 " %u", result.trials[result.best].block_size,
+            result.trials[result.best].num_threads);
+    for (i = 0; i < result.num_trials; i++)
+    {
+        const struct tx_tune_trial *p_trial = &result.trials[i];
+
+        len += snprintf(&outline[len], sizeof(outline) - len, " %" PRIu32 ":%u:%" PRIu32 
+                ":%.1f:%" PRIu32, p_trial->block_size, p_trial->num_threads, p_trial->underruns,
+                p_trial->cpu_pct, p_trial->start_usec);
+    }
+    send_response(client_sock, outline);
+
+    return status;
+}
+
+int process_setIqCorr(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    int32_t status = 0;
+    bool enabled = false;
+
+    log_trace("in process_setIqCorr ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for setIqCorr ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    /* SETIQCORR ON or SETIQCORR OFF */
+    if( 0 == strcasecmp(arg, "ON") )
+    {
+        enabled = true;
+    }
+    else if( 0 != strcasecmp(arg, "OFF") )
+    {
+        log_error( "setIqCorr invalid parameter %s ", arg);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    status = setIqCorrection(enabled);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
+    }
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_setPacked(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    int32_t status = 0;
+    bool enabled = false;
+
+    log_trace("in process_setPacked ");
+
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
+    {
+        log_error( "not enough command arguments for setPacked ");
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
 
+    /* SETPACKED ON or SETPACKED OFF */
+    if( 0 == strcasecmp(arg, "ON") )
+    {
+        enabled = true;
+    }
+    else if( 0 != strcasecmp(arg, "OFF") )
+    {
+        log_error( "setPacked invalid parameter %s ", arg);
+        send_response(client_sock, "FAILURE");
+        return 1;
+    }
+
+    status = setPackedMode(enabled);
+    if (status != 0)
+    {
+        send_response(client_sock, "FAILURE");
+        return status;
     }
+
+    send_response(client_sock, "SUCCESS");
+
+    return status;
+}
+
+int process_iqCorr(int client_sock, char * cmdline)
+{
+    struct iq_correction corr;
+    char outline[200];
+
+    log_trace("in process_iqCorr ");
+
+    getIqCorrection(&corr);
+
+    sprintf(outline, "SUCCESS %f %f %f %f", corr.dc_i, corr.dc_q, corr.gain_qq, corr.cross_qi);
+    send_response(client_sock, outline);
+
     return 0;
-} 
+}
 
-int wait_connection(int connfd)
+int process_captureStats(int client_sock, char * cmdline)
 {
-    uint32_t len = 0;
-    int client_sock = 0;
+    struct rx_capture_stats stats;
+    char outline[200];
+
+    log_trace("in process_captureStats ");
+
+    getCaptureStats(&stats);
+
+    sprintf(outline, "SUCCESS %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 
+            " %" PRIu64 " %" PRIu64 " %" PRIu32 " %" PRIu8 " %" PRIu32 "", 
+            stats.blocks_received, stats.blocks_dropped, stats.gaps, stats.overruns, 
+            stats.restarts, stats.first_rf_timestamp, stats.last_rf_timestamp,
+            stats.clipped_samples, stats.gain, stats.autorange_iterations);
+    send_response(client_sock, outline);
+
+    return 0;
+}
 
-    log_trace("wait_connection ");
-    len = sizeof(cli);
-    log_info("waiting for client to connect");
+int process_setDebug(int client_sock, char * cmdline)
+{
+    char * arg = NULL;
+    int32_t status = 0;
+    char outline[100];
 
+    log_trace("in process_setDebug ");
 
-    client_sock = accept(server_sock, (struct sockaddr*)&cli, &len);
-    if (client_sock < 0) 
+    arg = strtok(NULL, " ");
+    if (arg == NULL)
     {
-        perror("accept failed");
+        log_error( "not enough command arguments for getData ");
+        send_response(client_sock, "FAILURE");
         return 1;
     }
-    else if (len == 0)
+
+    if( 0 == strcasecmp(arg, "TRACE") )
+    {
+        log_set_level(LLOG_TRACE, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "DEBUG") )
+    {
+        log_set_level(LLOG_DEBUG, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "INFO") )
+    {
+        log_set_level(LLOG_INFO, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "INFO") )
+    {
+        log_set_level(LLOG_INFO, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "WARN") )
+    {
+        log_set_level(LLOG_WARN, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "ERROR") )
+    {
+        log_set_level(LLOG_ERROR, false, false);
+
+    }
+    else if( 0 == strcasecmp(arg, "FATAL") )
     {
-        log_debug(" Received 0 len ");
-        g_running = 0;
-        return  1;
+        log_set_level(LLOG_FATAL, false, false);
+
     }
     else
     {
-        log_debug("Client connected ");
+        sprintf(outline, "FAILURE");
+        send_response(client_sock, outline);
+        return 0; 
     }
 
-    return client_sock;
+    sprintf(outline, "SUCCESS");
+    send_response(client_sock, outline);
+
+    return status;
 }
 
+/*****************************************************************************/
+/** Runs a command of a client, on the worker thread of the card
+
+      @param[in]  client_sock:  the client, passed to send_response()
+      @param[in]  buff:         the command as received
+
+      @return int:    0
+ */
+int process_command(int client_sock, char *buff)
+{
+    char *cmd_str = NULL; 
+    char *cmd = NULL;
+
+    log_trace("in process_command ");
+
+    cmd_str = strdup(buff);
+
+
+    if (cmd_str == NULL)
+    {
+        log_error( "Could not duplicate command line");
+    }
+    else
+    {
+        cmd = strtok(cmd_str, " ");
+
+        if( cmd == NULL )
+        {
+            log_error( "empty command ");
+            send_response(client_sock, "FAILURE");
+        }
+        else if( 0 == strcasecmp(cmd, "STARTCW") )
+        {
+            process_startCW(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "STOPGEN") )
+        {
+            process_stopGen(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "STARTSWEEP") )
+        {
+            process_startSweep(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "DSWEEP") )
+        {
+            process_digitalSweep(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "PLAYFILE") )
+        {
+            process_playFile(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "MULTITONE") )
+        {
+            process_multiTone(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "MODULATE") )
+        {
+            process_modulate(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "IMPAIR") )
+        {
+            process_impair(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "DUALTONE") )
+        {
+            process_dualTone(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "PEAKSEARCH") )
+        {
+            process_peakSearch(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "GETDATA") )
+        {
+            process_getData(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETDEBUG") )
+        {
+            process_setDebug(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETGAPPOLICY") )
+        {
+            process_setGapPolicy(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETTRIGGER") )
+        {
+            process_setTrigger(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETGAIN") )
+        {
+            process_setGain(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SWEEPSTATS") )
+        {
+            process_sweepStats(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "TXSTATS") )
+        {
+            process_txStats(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "TXTUNE") )
+        {
+            process_txTune(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETIQCORR") )
+        {
+            process_setIqCorr(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "SETPACKED") )
+        {
+            process_setPacked(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "IQCORR") )
+        {
+            process_iqCorr(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "CAPTURESTATS") )
+        {
+            process_captureStats(client_sock, cmd_str);
+        }
+        else if( 0 == strcasecmp(cmd, "RUNSEQ") )
+        {
+            process_runSeq(client_sock, cmd_str);
+        }
+        else
+        {
+            /* answered so a client waiting for each response stays in step */
+            log_error( "invalid command %s ", cmd);
+            send_response(client_sock, "FAILURE");
+        }
+    
+    }
+
+    free(cmd_str);
+    return 0;
+} 
+
 int setup_socket(void)
 {
     log_trace("setup_socket ");
@@ -721,11 +2506,6 @@ int setup_socket(void)
        log_debug("setsockopt successful ");
    }
 
-    struct timeval tv;
-    tv.tv_sec = 3 * 3600; // 3 minutes
-    tv.tv_usec = 0;
-    setsockopt(server_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
-
     bzero(&servaddr, sizeof(servaddr));
 
     // assign IP, PORT
@@ -745,8 +2525,8 @@ int setup_socket(void)
         log_info("Bound to address %s, port number: %d ", server_address, tcp_port);
     }
 
-    // Now server is ready to listen and verification
-    if ((listen(server_sock, 5)) != 0) 
+    // Now server is ready to listen and verification, a whole test rig may connect at once
+    if ((listen(server_sock, SOMAXCONN)) != 0) 
     {
         perror("listen error");
         exit(1);
@@ -758,52 +2538,71 @@ int setup_socket(void)
 
 
     
-    return connfd;
+    return server_sock;
 
 }
 
 /*****************************************************************************/
-/** 
+/** This is called every time a log is received.  We want to put the port
+ *  number before every log.  So we can tell which server is logging.
 
-*/
+      @param[in]  ev:     The structure containing all the log info
 
-static void* client_thread( void *params)
+ */
+void log_callback(log_Event *ev)
 {
-    int status = 0;
-   
-    log_trace("client_thread");
-    struct client_thread_params *thread_params = params;
-    thread_params->client_completed = false;
+    fprintf(ev->udata, "[%d] ", tcp_port);
 
-    while (g_running == true && status == 0)  
-    {
-        status = process_command(thread_params->client_socket);
-    }
+    /* now call the logging function to actually print out the log */
+    stderr_callback(ev);
 
-    log_debug("leaving thread");
+}
 
-    thread_params->client_completed = true;
-    return (void *)(intptr_t)status;
 
-}
 
 /*****************************************************************************/
-/** This is called every time a log is received.  We want to put the port
- *  number before every log.  So we can tell which server is logging.
+/** Sets up the real-time profile from the command line.  --priority is the 
+ *  SCHED_FIFO priority of the TX and RX threads, the DSP thread runs one 
+ *  below so the threads it feeds preempt it.  Without --rt-cpus, --priority
+ *  or --rt-lock the threads run as they always have.
 
-      @param[in]  ev:     The structure containing all the log info
+      @param[in]  p_cmd_line_args:  the common command line arguments
 
+      @return int32_t:    status
  */
-void log_callback(log_Event *ev)
+static int32_t init_rt_profile(struct cmd_line_args *p_cmd_line_args)
 {
-    fprintf(ev->udata, "[%d] ", tcp_port);
+    struct rt_profile profile = RT_PROFILE_INITIALIZER;
+    int32_t priority = p_cmd_line_args->thread_priority;
+    int32_t status = 0;
 
-    /* now call the logging function to actually print out the log */
-    stderr_callback(ev);
+    if (rt_cpus_is_present == true)
+    {
+        status = rt_profile_parse_cpus(rt_cpus, &profile);
+        if (status != 0)
+        {
+            log_error("Error: invalid rt-cpus \"%s\", expected TX,RX,DSP cores", rt_cpus);
+            return status;
+        }
+    }
 
-}
+    if ((p_cmd_line_args->priority_is_present == true) && (priority > 0))
+    {
+        profile.priority[rt_thread_tx] = priority;
+        profile.priority[rt_thread_rx] = priority;
+        profile.priority[rt_thread_dsp] = (priority > 1) ? (priority - 1) : 1;
+    }
+    profile.lock_memory = rt_lock;
 
+    if ((rt_cpus_is_present == false) && (profile.priority[rt_thread_tx] == RT_PRIORITY_NONE) &&
+        (rt_lock == false))
+    {
+        return 0;
+    }
+    profile.latency_ms = rt_latency_ms;
 
+    return rt_profile_init(&profile);
+}
 
 /*****************************************************************************/
 /** This is the main function 
@@ -821,9 +2620,7 @@ int main( int argc, char *argv[])
     struct cmd_line_selector g_cmd_line_selector;
     uint32_t num_args = 0;
     int32_t status = 0;
-    int client_sock = 0;
-    struct client_thread_params client_thread_array[MAX_CLIENT_THREADS] = INIT_ARRAY(5, CLIENT_THREAD_PARAMS_INITIALIZER);
-    int index = 0;
+    struct tcp_server_config server = TCP_SERVER_CONFIG_INITIALIZER;
 
 
     status = log_add_callback(&log_callback, stderr, LLOG_INFO); 
@@ -885,6 +2682,54 @@ int main( int argc, char *argv[])
         new_arg.p_is_set    = &port_is_present;  //give the address where you want the flag
 
         add_app_specific_args(args, &new_arg, &num_args);
+
+        new_arg.p_long_flag     = "max-clients" ;
+        new_arg.short_flag      = 0;
+        new_arg.p_info          = "Most clients connected at once, more are closed";
+        new_arg.p_label         = 0;
+        new_arg.p_var           = &max_clients;
+        new_arg.type            = UINT32_VAR_TYPE;
+
+        new_arg.required    = false;
+        new_arg.p_is_set    = &max_clients_is_present;
+
+        add_app_specific_args(args, &new_arg, &num_args);
+
+        new_arg.p_long_flag     = "rt-cpus" ;
+        new_arg.short_flag      = 0;
+        new_arg.p_info          = "Pin the TX, RX and DSP threads to cores, as TX,RX,DSP";
+        new_arg.p_label         = "TX,RX,DSP";
+        new_arg.p_var           = &rt_cpus;
+        new_arg.type            = STRING_VAR_TYPE;
+
+        new_arg.required    = false;
+        new_arg.p_is_set    = &rt_cpus_is_present;
+
+        add_app_specific_args(args, &new_arg, &num_args);
+
+        new_arg.p_long_flag     = "rt-lock" ;
+        new_arg.short_flag      = 0;
+        new_arg.p_info          = "Lock the memory and the sample buffers of the server";
+        new_arg.p_label         = NULL;
+        new_arg.p_var           = &rt_lock;
+        new_arg.type            = BOOL_VAR_TYPE;
+
+        new_arg.required    = false;
+        new_arg.p_is_set    = NULL;
+
+        add_app_specific_args(args, &new_arg, &num_args);
+
+        new_arg.p_long_flag     = "rt-latency" ;
+        new_arg.short_flag      = 0;
+        new_arg.p_info          = "Length in ms of the startup latency test of the threads, 0 for none";
+        new_arg.p_label         = "ms";
+        new_arg.p_var           = &rt_latency_ms;
+        new_arg.type            = UINT32_VAR_TYPE;
+
+        new_arg.required    = false;
+        new_arg.p_is_set    = &rt_latency_is_present;
+
+        add_app_specific_args(args, &new_arg, &num_args);
     }
 
     /* add the defaults to the long help string */
@@ -947,64 +2792,37 @@ int main( int argc, char *argv[])
         goto exit;
     }
 
-    while (g_running == true)
+    /* after the radio init so the memory it maps is locked as well */
+    status = init_rt_profile(&g_cmd_line_args);
+    if (status != 0)
     {
-        int slot = 0;
-        client_sock = 0;
-
-        /* get our IP address up and listening */
-        connfd = setup_socket();
-
-        while (g_running == true)
-        {
-            /* wait for a new connection */
-            client_sock = wait_connection(connfd);
-
-            index = -1;
-
-            /* see if any threads have exited */
-            for (slot = 0; slot < MAX_CLIENT_THREADS; slot++)
-            {
-                if (client_thread_array[slot].client_index != -1)
-                {
-                    /* see if it has completed */
-                    /* if not busy then it has exited and done */
-                    if (client_thread_array[slot].client_completed == true)
-                    {
-                        log_debug("found a completed slot %d", slot);
-                        client_thread_array[slot].client_index = -1;
-                    }
-                }
-                else
-                {
-                    /* this is an empty slot so use this index */
-                    index = slot;
-                }
-            }
+        goto exit;
+    }
 
-            if (index == -1)
-            {
-                log_error("thread array is full");
-            }
-            else
-            {
-                log_debug("thread_array index is %d", index);
-                client_thread_array[index].client_index = index;
-                client_thread_array[index].client_socket = client_sock;
+    /* get our IP address up and listening, then serve the clients until SIGINT */
+    server.listen_sock = setup_socket();
+    server.card = card;
+    server.max_clients = max_clients;
+    server.fn = process_command;
 
-                status = pthread_create( &(client_thread_array[index].client_thread),
-                  NULL, client_thread, &client_thread_array[index]);
-            }
-        }
+    status = tcp_server_run(&server);
+    if (status != 0)
+    {
+        log_error( "Error: server loop failed, status %" PRIi32 "  ", status);
     }
 
 exit:
     /* done so exit */
+    clearToneCache();
+
     if (rconfig.skiq_initialized == true) {
         skiq_exit();
     }
 
-    close(connfd);
+    if (server_sock >= 0)
+    {
+        close(server_sock);
+    }
 
     return status;
 }
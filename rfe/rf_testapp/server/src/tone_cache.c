@@ -0,0 +1,226 @@
+/**
+ * @file tone_cache.c
+ *
+ * @brief
+ * Cache of generated tone buffers, see tone_cache.h.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+/***** INCLUDES *****/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "tone_cache.h"
+
+
+/*****************************************************************************/
+/** Compares two keys
+
+    @param p_a          a key
+    @param p_b          another key
+    @return: true if the keys are the same tone
+*/
+static bool same_key(const struct tone_cache_key *p_a, const struct tone_cache_key *p_b)
+{
+    return ((p_a->tone_offset == p_b->tone_offset) &&
+            (p_a->sample_rate == p_b->sample_rate) &&
+            (p_a->amplitude == p_b->amplitude) &&
+            (p_a->block_size == p_b->block_size));
+}
+
+/*****************************************************************************/
+/** Frees the least recently used entry that is not in use.  The mutex must 
+ *  be held.
+
+    @param p_cache      the cache
+    @return: true if an entry was freed
+*/
+static bool evict_entry(struct tone_cache *p_cache)
+{
+    struct tone_cache_entry *p_lru = NULL;
+    int i;
+
+    for (i = 0; i < TONE_CACHE_ENTRIES; i++)
+    {
+        struct tone_cache_entry *p_entry = &p_cache->entries[i];
+
+        if ((p_entry->valid == true) && (p_entry->in_use == false) &&
+            ((p_lru == NULL) || (p_entry->last_used < p_lru->last_used)))
+        {
+            p_lru = p_entry;
+        }
+    }
+
+    if (p_lru == NULL)
+    {
+        return false;
+    }
+
+    p_cache->free_fn(p_lru->p_blocks, p_lru->num_blocks);
+    p_cache->bytes -= p_lru->bytes;
+    p_lru->valid = false;
+    p_lru->p_blocks = NULL;
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Returns a free entry.  The mutex must be held.
+
+    @param p_cache      the cache
+    @return: the entry or NULL if every entry is valid
+*/
+static struct tone_cache_entry *free_entry(struct tone_cache *p_cache)
+{
+    int i;
+
+    for (i = 0; i < TONE_CACHE_ENTRIES; i++)
+    {
+        if (p_cache->entries[i].valid == false)
+        {
+            return &p_cache->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+/** Looks up the blocks generated for a key and marks them in use
+
+    @param p_cache      the cache
+    @param p_key        the tone wanted
+    @param pp_blocks    set to the cached blocks
+    @param p_num_blocks set to the number of cached blocks
+    @return: true on a hit
+*/
+bool tone_cache_get(struct tone_cache *p_cache, const struct tone_cache_key *p_key,
+                    void **pp_blocks, uint32_t *p_num_blocks)
+{
+    bool hit = false;
+    int i;
+
+    pthread_mutex_lock(&p_cache->mutex);
+    for (i = 0; (i < TONE_CACHE_ENTRIES) && (hit == false); i++)
+    {
+        struct tone_cache_entry *p_entry = &p_cache->entries[i];
+
+        if ((p_entry->valid == true) && (p_entry->in_use == false) &&
+            (same_key(&p_entry->key, p_key) == true))
+        {
+            p_entry->in_use = true;
+            p_entry->last_used = ++p_cache->age;
+            *pp_blocks = p_entry->p_blocks;
+            *p_num_blocks = p_entry->num_blocks;
+            hit = true;
+        }
+    }
+    pthread_mutex_unlock(&p_cache->mutex);
+
+    return hit;
+}
+
+/*****************************************************************************/
+/** Adds newly generated blocks to the cache, in use
+
+    @param p_cache      the cache
+    @param p_key        the tone generated
+    @param p_blocks     the blocks
+    @param num_blocks   number of blocks
+    @param bytes        memory held by the blocks
+    @return: true if cached
+*/
+bool tone_cache_put(struct tone_cache *p_cache, const struct tone_cache_key *p_key,
+                    void *p_blocks, uint32_t num_blocks, uint64_t bytes)
+{
+    struct tone_cache_entry *p_entry = NULL;
+
+    if (bytes > p_cache->budget)
+    {
+        /* never fits */
+        return false;
+    }
+
+    pthread_mutex_lock(&p_cache->mutex);
+
+    /* make room within the budget */
+    while ((p_cache->bytes + bytes) > p_cache->budget)
+    {
+        if (evict_entry(p_cache) == false)
+        {
+            break;
+        }
+    }
+
+    p_entry = free_entry(p_cache);
+    if ((p_entry == NULL) && (evict_entry(p_cache) == true))
+    {
+        p_entry = free_entry(p_cache);
+    }
+
+    if ((p_entry != NULL) && ((p_cache->bytes + bytes) <= p_cache->budget))
+    {
+        p_entry->valid = true;
+        p_entry->in_use = true;
+        p_entry->key = *p_key;
+        p_entry->num_blocks = num_blocks;
+        p_entry->bytes = bytes;
+        p_entry->last_used = ++p_cache->age;
+        p_entry->p_blocks = p_blocks;
+        p_cache->bytes += bytes;
+    }
+    else
+    {
+        p_entry = NULL;
+    }
+
+    pthread_mutex_unlock(&p_cache->mutex);
+
+    return (p_entry != NULL);
+}
+
+/*****************************************************************************/
+/** Ends the use of cached blocks
+
+    @param p_cache      the cache
+    @param p_blocks     the blocks
+    @return: true if the blocks are cached, false if the caller frees them
+*/
+bool tone_cache_release(struct tone_cache *p_cache, void *p_blocks)
+{
+    bool cached = false;
+    int i;
+
+    pthread_mutex_lock(&p_cache->mutex);
+    for (i = 0; (i < TONE_CACHE_ENTRIES) && (cached == false); i++)
+    {
+        if ((p_cache->entries[i].valid == true) && (p_cache->entries[i].p_blocks == p_blocks))
+        {
+            p_cache->entries[i].in_use = false;
+            cached = true;
+        }
+    }
+    pthread_mutex_unlock(&p_cache->mutex);
+
+    return cached;
+}
+
+/*****************************************************************************/
+/** Frees every entry that is not in use
+
+    @param p_cache      the cache
+    @return: void
+*/
+void tone_cache_clear(struct tone_cache *p_cache)
+{
+    pthread_mutex_lock(&p_cache->mutex);
+    while (evict_entry(p_cache) == true)
+    {
+    }
+    pthread_mutex_unlock(&p_cache->mutex);
+}
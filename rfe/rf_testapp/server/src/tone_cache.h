@@ -0,0 +1,139 @@
+/**
+ * @file tone_cache.h
+ *
+ * @brief
+ * Cache of generated tone buffers, so a tone that was transmitted before is
+ * not generated again.  An entry is found by everything the generation
+ * depends on and holds the blocks together with their count, which is what
+ * must be transmitted on a hit whatever the caller planned.
+ *
+ * An entry being transmitted is in use and is never evicted.  Entries that
+ * are not in use are freed least recently used first to stay in the budget.
+ * The blocks are opaque here, they are freed with the function given to the
+ * cache.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+#ifndef __TONE_CACHE_H__
+#define __TONE_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define TONE_CACHE_ENTRIES  16
+
+/* frees the blocks of an entry that is evicted or cleared */
+typedef void (*tone_cache_free_fn_t)(void *p_blocks, uint32_t num_blocks);
+
+/* everything the generated blocks depend on */
+struct tone_cache_key
+{
+    uint32_t            tone_offset;            // requested tone offset, Hz
+    uint32_t            sample_rate;
+    uint32_t            amplitude;
+    uint32_t            block_size;
+};
+
+struct tone_cache_entry
+{
+    bool                valid;
+    bool                in_use;                 // being transmitted
+    struct tone_cache_key key;
+    uint32_t            num_blocks;
+    uint64_t            bytes;                  // memory held by the blocks
+    uint32_t            last_used;              // age for least recently used eviction
+    void                *p_blocks;
+};
+
+struct tone_cache
+{
+    pthread_mutex_t     mutex;
+    uint64_t            budget;                 // most bytes held by the entries
+    tone_cache_free_fn_t free_fn;
+    uint64_t            bytes;
+    uint32_t            age;
+    struct tone_cache_entry entries[TONE_CACHE_ENTRIES];
+};
+
+#define TONE_CACHE_KEY_INITIALIZER                          \
+{                                                           \
+    .tone_offset            = 0,                            \
+    .sample_rate            = 0,                            \
+    .amplitude              = 0,                            \
+    .block_size             = 0,                            \
+}                                                           \
+
+#define TONE_CACHE_INITIALIZER(_budget, _free_fn)           \
+{                                                           \
+    .mutex                  = PTHREAD_MUTEX_INITIALIZER,    \
+    .budget                 = (_budget),                    \
+    .free_fn                = (_free_fn),                   \
+    .bytes                  = 0,                            \
+    .age                    = 0,                            \
+}                                                           \
+
+
+/*****************************************************************************/
+/** @brief
+    Looks up the blocks generated for a key and marks them in use
+
+    @param[in/out]  p_cache:        the cache
+    @param[in]      p_key:          the tone wanted
+    @param[out]     pp_blocks:      the cached blocks
+    @param[out]     p_num_blocks:   number of cached blocks, to be transmitted
+                                    in place of any planned count
+
+    @return         true on a hit, false if the tone must be generated
+*/
+extern bool tone_cache_get(                     struct tone_cache *p_cache,
+                                                const struct tone_cache_key *p_key,
+                                                void **pp_blocks,
+                                                uint32_t *p_num_blocks);
+
+/*****************************************************************************/
+/** @brief
+    Adds newly generated blocks to the cache, in use, evicting entries not in
+    use to make room
+
+    @param[in/out]  p_cache:        the cache
+    @param[in]      p_key:          the tone generated
+    @param[in]      p_blocks:       the blocks
+    @param[in]      num_blocks:     number of blocks
+    @param[in]      bytes:          memory held by the blocks
+
+    @return         true if cached, false if the caller still owns the blocks
+*/
+extern bool tone_cache_put(                     struct tone_cache *p_cache,
+                                                const struct tone_cache_key *p_key,
+                                                void *p_blocks,
+                                                uint32_t num_blocks,
+                                                uint64_t bytes);
+
+/*****************************************************************************/
+/** @brief
+    Ends the use of blocks from tone_cache_get() or tone_cache_put()
+
+    @param[in/out]  p_cache:        the cache
+    @param[in]      p_blocks:       the blocks
+
+    @return         true if the blocks are cached, false if the caller must
+                    free them
+*/
+extern bool tone_cache_release(                 struct tone_cache *p_cache,
+                                                void *p_blocks);
+
+/*****************************************************************************/
+/** @brief
+    Frees every entry that is not in use
+
+    @param[in/out]  p_cache:        the cache
+
+    @return         void
+*/
+extern void tone_cache_clear(                   struct tone_cache *p_cache);
+
+#endif
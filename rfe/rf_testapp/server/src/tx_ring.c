@@ -0,0 +1,194 @@
+/**
+ * @file tx_ring.c
+ *
+ * @brief
+ * Lock-free ring of transmit block indices, see tx_ring.h.
+ *
+ * A producer reserves a slot by advancing head and then publishes the index
+ * in the slot, so the consumer sees slots filled in reservation order and
+ * stops at the first one not yet published.  Slots hold index + 1 so that 0
+ * marks an empty slot.  The consumer clears the slot before advancing tail.
+ *
+ * tx_event is a futex on the sequence number.  The waiter counts itself in
+ * waiters before the futex checks the sequence, the signaller increments the
+ * sequence before reading waiters, so either the signaller sees the waiter
+ * and wakes it or the futex sees the new sequence and does not sleep.
+ *
+ * The gcc __atomic builtins are used rather than stdatomic.h so the older
+ * ARM toolchains still build this.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+/***** INCLUDES *****/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "tx_ring.h"
+
+
+/*****************************************************************************/
+/** Allocates an empty ring
+
+    @param p_ring       the ring
+    @param size         number of slots, a power of 2
+    @return: status
+*/
+int32_t tx_ring_init(struct tx_ring *p_ring, uint32_t size)
+{
+    if ((size == 0) || ((size & (size - 1)) != 0))
+    {
+        return -EINVAL;
+    }
+
+    p_ring->p_slots = calloc(size, sizeof(uint32_t));
+    if (p_ring->p_slots == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    p_ring->size = size;
+    p_ring->mask = size - 1;
+    p_ring->head = 0;
+    p_ring->tail = 0;
+
+    return 0;
+}
+
+/*****************************************************************************/
+/** Frees the slots of a ring
+
+    @param p_ring       the ring
+    @return: void
+*/
+void tx_ring_free(struct tx_ring *p_ring)
+{
+    free(p_ring->p_slots);
+    p_ring->p_slots = NULL;
+    p_ring->size = 0;
+    p_ring->mask = 0;
+}
+
+/*****************************************************************************/
+/** Adds an index to the ring
+
+    @param p_ring       the ring
+    @param index        block index
+    @return: void
+*/
+void tx_ring_push(struct tx_ring *p_ring, uint32_t index)
+{
+    uint32_t pos = __atomic_fetch_add(&p_ring->head, 1, __ATOMIC_RELAXED);
+
+    /* the fill of the block happens before the index is seen */
+    __atomic_store_n(&p_ring->p_slots[pos & p_ring->mask], index + 1, __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************/
+/** Removes the oldest index
+
+    @param p_ring       the ring
+    @param p_index      the block index
+    @return: true if an index was removed
+*/
+bool tx_ring_pop(struct tx_ring *p_ring, uint32_t *p_index)
+{
+    uint32_t *p_slot = &p_ring->p_slots[p_ring->tail & p_ring->mask];
+    uint32_t value = __atomic_load_n(p_slot, __ATOMIC_ACQUIRE);
+
+    if (value == 0)
+    {
+        return false;
+    }
+
+    *p_index = value - 1;
+
+    /* the slot is free for the push that wraps around to it */
+    __atomic_store_n(p_slot, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&p_ring->tail, p_ring->tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/*****************************************************************************/
+/** Checks if the next pop would succeed
+
+    @param p_ring       the ring
+    @return: true if there is nothing to pop
+*/
+bool tx_ring_empty(struct tx_ring *p_ring)
+{
+    return (__atomic_load_n(&p_ring->p_slots[p_ring->tail & p_ring->mask],
+                __ATOMIC_ACQUIRE) == 0);
+}
+
+/*****************************************************************************/
+/** Number of indices in the ring
+
+    @param p_ring       the ring
+    @return: number of pushes not yet popped
+*/
+uint32_t tx_ring_count(struct tx_ring *p_ring)
+{
+    return __atomic_load_n(&p_ring->head, __ATOMIC_RELAXED) -
+        __atomic_load_n(&p_ring->tail, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************/
+/** Takes the sequence of an event
+
+    @param p_event      the event
+    @return: the sequence to pass to tx_event_wait()
+*/
+uint32_t tx_event_prepare(struct tx_event *p_event)
+{
+    return __atomic_load_n(&p_event->seq, __ATOMIC_SEQ_CST);
+}
+
+/*****************************************************************************/
+/** Sleeps until the event is signalled or the timeout expires
+
+    @param p_event      the event
+    @param seq          from tx_event_prepare()
+    @param timeout_usec longest time to sleep
+    @return: void
+*/
+void tx_event_wait(struct tx_event *p_event, uint32_t seq, uint32_t timeout_usec)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = timeout_usec / 1000000;
+    timeout.tv_nsec = (timeout_usec % 1000000) * 1000;
+
+    __atomic_add_fetch(&p_event->waiters, 1, __ATOMIC_SEQ_CST);
+
+    /* returns at once if the sequence has already moved on */
+    syscall(SYS_futex, &p_event->seq, FUTEX_WAIT_PRIVATE, seq, &timeout, NULL, 0);
+
+    __atomic_sub_fetch(&p_event->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/*****************************************************************************/
+/** Wakes every thread waiting on the event
+
+    @param p_event      the event
+    @return: void
+*/
+void tx_event_signal(struct tx_event *p_event)
+{
+    __atomic_add_fetch(&p_event->seq, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&p_event->waiters, __ATOMIC_SEQ_CST) != 0)
+    {
+        syscall(SYS_futex, &p_event->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
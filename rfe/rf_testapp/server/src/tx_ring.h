@@ -0,0 +1,188 @@
+/**
+ * @file tx_ring.h
+ *
+ * @brief
+ * Lock-free ring of transmit block indices used by the streaming generator.
+ * One ring carries filled blocks from the generator thread to the transmit
+ * thread, a second one carries the sent blocks back to the generator.
+ *
+ * Only one thread may pop from a ring.  Pushes may come from several
+ * threads, the completion callback of an async transmit is not always
+ * called from the same thread.  A ring must be at least as large as the
+ * number of blocks in circulation, a push never finds it full.
+ *
+ * A tx_event lets a thread sleep until a ring may have changed without a
+ * mutex on the signalling side.  The signal is an atomic increment, the
+ * kernel is only entered when a thread is actually waiting.
+ *
+ * <pre>
+ * Copyright 2014-2022 Epiq Solutions, All Rights Reserved
+ * </pre>
+ */
+
+#ifndef __TX_RING_H__
+#define __TX_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* keeps the indices written by each side on their own cache line */
+#define TX_RING_CACHE_LINE  64
+
+struct tx_ring
+{
+    uint32_t            *p_slots;               // index + 1, 0 when empty
+    uint32_t            size;                   // power of 2
+    uint32_t            mask;                   // size - 1
+
+    /* next slot to push, advanced by every producer */
+    uint32_t            head __attribute__((aligned(TX_RING_CACHE_LINE)));
+
+    /* next slot to pop, advanced by the consumer only */
+    uint32_t            tail __attribute__((aligned(TX_RING_CACHE_LINE)));
+};
+
+/* wakes threads waiting for a ring, see tx_event_wait() */
+struct tx_event
+{
+    uint32_t            seq;                    // incremented by every signal
+    uint32_t            waiters;                // threads in tx_event_wait()
+};
+
+#define TX_EVENT_INITIALIZER                                \
+{                                                           \
+    .seq                    = 0,                            \
+    .waiters                = 0,                            \
+}                                                           \
+
+#define TX_RING_INITIALIZER                                 \
+{                                                           \
+    .p_slots                = NULL,                         \
+    .size                   = 0,                            \
+    .mask                   = 0,                            \
+    .head                   = 0,                            \
+    .tail                   = 0,                            \
+}                                                           \
+
+
+/*****************************************************************************/
+/** @brief
+    Allocates an empty ring
+
+    @param[out]     p_ring:         the ring
+    @param[in]      size:           number of slots, a power of 2
+
+    @return         0 on success, -EINVAL if size is not a power of 2,
+                    -ENOMEM if the slots could not be allocated
+*/
+extern int32_t tx_ring_init(                    struct tx_ring *p_ring,
+                                                uint32_t size);
+
+/*****************************************************************************/
+/** @brief
+    Frees the slots of a ring
+
+    @param[in/out]  p_ring:         the ring
+
+    @return         void
+*/
+extern void tx_ring_free(                       struct tx_ring *p_ring);
+
+/*****************************************************************************/
+/** @brief
+    Adds an index to the ring, safe from any thread
+
+    @param[in/out]  p_ring:         the ring
+    @param[in]      index:          block index, less than UINT32_MAX
+
+    @return         void
+
+    @note   The ring must have room, which it always does when it is at least
+            as large as the number of blocks passed through it.
+*/
+extern void tx_ring_push(                       struct tx_ring *p_ring,
+                                                uint32_t index);
+
+/*****************************************************************************/
+/** @brief
+    Removes the oldest index, from the consumer thread only
+
+    @param[in/out]  p_ring:         the ring
+    @param[out]     p_index:        the block index
+
+    @return         true if an index was removed, false if the ring is empty
+*/
+extern bool tx_ring_pop(                        struct tx_ring *p_ring,
+                                                uint32_t *p_index);
+
+/*****************************************************************************/
+/** @brief
+    Checks if the next pop would succeed, from the consumer thread only
+
+    @param[in]      p_ring:         the ring
+
+    @return         true if there is nothing to pop
+*/
+extern bool tx_ring_empty(                      struct tx_ring *p_ring);
+
+/*****************************************************************************/
+/** @brief
+    Number of indices in the ring, approximate while it is being used
+
+    @param[in]      p_ring:         the ring
+
+    @return         number of pushes not yet popped
+*/
+extern uint32_t tx_ring_count(                  struct tx_ring *p_ring);
+
+/*****************************************************************************/
+/** @brief
+    Takes the sequence of an event before checking what is waited for
+
+    @param[in]      p_event:        the event
+
+    @return         the sequence to pass to tx_event_wait()
+
+    @note   A thread waits with:
+            @code
+            for (;;)
+            {
+                uint32_t seq = tx_event_prepare(&event);
+                if (condition)
+                {
+                    break;
+                }
+                tx_event_wait(&event, seq, timeout);
+            }
+            @endcode
+            A signal after the sequence was taken makes the wait return at 
+            once, so no wakeup is lost between the check and the wait.
+*/
+extern uint32_t tx_event_prepare(               struct tx_event *p_event);
+
+/*****************************************************************************/
+/** @brief
+    Sleeps until the event is signalled after tx_event_prepare() or the 
+    timeout expires
+
+    @param[in/out]  p_event:        the event
+    @param[in]      seq:            from tx_event_prepare()
+    @param[in]      timeout_usec:   longest time to sleep
+
+    @return         void, the caller checks its condition again
+*/
+extern void tx_event_wait(                      struct tx_event *p_event,
+                                                uint32_t seq,
+                                                uint32_t timeout_usec);
+
+/*****************************************************************************/
+/** @brief
+    Wakes every thread waiting on the event, safe from any thread
+
+    @param[in/out]  p_event:        the event
+
+    @return         void
+*/
+extern void tx_event_signal(                    struct tx_event *p_event);
+
+#endif
@@ -2413,6 +2413,26 @@ int32_t configure_radio( uint8_t card, struct radio_config *p_rconfig )
                 log_info("card %" PRIu8 " configured for packed data mode", card);
             }
         }
+        else
+        {
+            /* the mode stays set until it is written, put the card back to 
+               un-packed if an earlier configuration packed it */
+            bool packed = false;
+
+            log_trace("skiq_read_iq_pack_mode");
+            if( (skiq_read_iq_pack_mode(card, &packed) == 0) && (packed == true) )
+            {
+                log_trace("skiq_write_iq_pack_mode");
+                status = skiq_write_iq_pack_mode(card, false);
+                if ( status != 0 )
+                {
+                    log_error("Card %" PRIu8 " unable to clear the packed mode (status %" PRIi32 ")",
+                            card, status);
+                    return status;
+                }
+                log_info("card %" PRIu8 " configured for un-packed data mode", card);
+            }
+        }
     }
 
     /* configure the 1PPS source */ 
@@ -0,0 +1,247 @@
+/**
+ * @file val_impair.c
+ *
+ * @brief
+ * Validates the impairment kernels in dsp_kernels.c.  The values of 
+ * gauss_fill() are checked for the moments and the tails of a normal 
+ * distribution and for correlation between neighbours, iq_impair() is 
+ * compared to the same impairments in double precision, and the chain the
+ * generator runs on every block is timed against the fastest TX sample rate
+ * of the cards.  The time is only reported unless --bench is given, then 
+ * the best of BENCH_RUNS runs has to reach the rate.
+ *
+ * build:
+ *  gcc -O2 -I../rfe/rf_testapp/server/src val_impair.c \
+ *      ../rfe/rf_testapp/server/src/dsp_kernels.c -lm -o val_impair
+ *
+ * usage: val_impair [--bench]
+ *
+ * returns 0 if every test passes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "dsp_kernels.h"
+
+#define BLOCK_SIZE          65532
+#define NUM_VALUES          (1u << 22)
+
+/* as in siggen.c */
+#define IMPAIR_CHUNK        1024
+#define PHASE_NOISE_STEP    16
+
+/* noise, imbalance, rotation and the power of every block must leave part
+ * of a core for the signal itself */
+#define MAX_TX_SAMPLE_RATE  61440000.0
+#define MIN_HEADROOM        1.25
+
+/* runs timed with --bench, the best one counts so a busy host does not fail */
+#define BENCH_RUNS          5
+
+float values[NUM_VALUES];
+int16_t iq[2 * BLOCK_SIZE];
+int16_t ref[2 * BLOCK_SIZE];
+float noise[2 * BLOCK_SIZE];
+uint32_t phases[BLOCK_SIZE];
+
+static double elapsed_ms(struct timespec *p_start, struct timespec *p_end)
+{
+    return ((p_end->tv_sec - p_start->tv_sec) * 1000.0) +
+        ((p_end->tv_nsec - p_start->tv_nsec) / 1000000.0);
+}
+
+/*****************************************************************************/
+/** @brief Checks mean, variance, kurtosis, the fraction beyond 3 sigma and 
+ *  the correlation of neighbouring values.  The odd count leaves a 
+ *  remainder for the scalar loop.
+ *
+    @return: true if they are within the sampling error of a normal distribution
+*/
+static bool check_gauss(void)
+{
+    struct gauss_rng rng = GAUSS_RNG_INITIALIZER;
+    float sigma = 3.0f;
+    double sum = 0, sum2 = 0, sum4 = 0, corr = 0;
+    double mean, var, kurt, tail;
+    uint64_t beyond = 0;
+    bool pass;
+    uint32_t i;
+
+    gauss_rng_seed(&rng, 12345);
+    gauss_fill(values, NUM_VALUES - 5, sigma, &rng);
+
+    for (i = 0; i < NUM_VALUES - 5; i++)
+    {
+        double x = values[i] / sigma;
+
+        sum += x;
+        sum2 += x * x;
+        sum4 += x * x * x * x;
+        beyond += (fabs(x) > 3.0);
+        if (i > 0)
+        {
+            corr += x * (values[i - 1] / sigma);
+        }
+    }
+    mean = sum / (NUM_VALUES - 5);
+    var = sum2 / (NUM_VALUES - 5);
+    kurt = sum4 / (NUM_VALUES - 5) / (var * var);
+    tail = (double)beyond / (NUM_VALUES - 5);
+    corr /= (NUM_VALUES - 6);
+
+    /* several standard errors of 4M values */
+    pass = (fabs(mean) < 0.003) && (fabs(var - 1) < 0.005) && (fabs(kurt - 3) < 0.03) && 
+        (fabs(tail - 0.0026998) < 0.0002) && (fabs(corr) < 0.003);
+    printf("gaussian: mean %.4f var %.4f kurtosis %.3f beyond 3 sigma %.5f corr %.4f  %s\n", 
+            mean, var, kurt, tail, corr, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Impairs a random block and compares it to double precision, 
+ *  uneven lengths check the remainder loop
+ *
+    @return: true if every value is within rounding
+*/
+static bool check_impair(void)
+{
+    struct iq_correction imbalance = IQ_CORRECTION_INITIALIZER;
+    struct gauss_rng rng = GAUSS_RNG_INITIALIZER;
+    uint32_t num = BLOCK_SIZE - 3;
+    float gain = 0.7f;
+    double max_err = 0;
+    bool pass;
+    uint32_t i;
+
+    imbalance.gain_qq = 1.05f;
+    imbalance.cross_qi = 0.03f;
+    imbalance.dc_i = 12.0f;
+    imbalance.dc_q = -7.0f;
+
+    srand(2);
+    for (i = 0; i < 2 * BLOCK_SIZE; i++)
+    {
+        iq[i] = (int16_t)((rand() % 20000) - 10000);
+    }
+    for (i = 0; i < BLOCK_SIZE; i++)
+    {
+        phases[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    }
+    gauss_rng_seed(&rng, 1);
+    gauss_fill(noise, 2 * BLOCK_SIZE, 100.0f, &rng);
+    memcpy(ref, iq, sizeof(iq));
+
+    iq_impair(iq, num, gain, &imbalance, phases, noise);
+
+    for (i = 0; i < num; i++)
+    {
+        double re = ref[2 * i] - imbalance.dc_i;
+        double im = ref[2 * i + 1] - imbalance.dc_q;
+        double theta = (phases[i] / 4294967296.0) * 2 * M_PI;
+        double t;
+
+        im = ((im * imbalance.gain_qq) + (re * imbalance.cross_qi)) * gain;
+        re = re * gain;
+        t = (re * cos(theta)) - (im * sin(theta));
+        im = (re * sin(theta)) + (im * cos(theta)) + noise[2 * i + 1];
+        re = t + noise[2 * i];
+
+        max_err = fmax(max_err, fabs(iq[2 * i] - re));
+        max_err = fmax(max_err, fabs(iq[2 * i + 1] - im));
+    }
+
+    pass = (max_err <= 1.0) && (memcmp(&iq[2 * num], &ref[2 * num], 6 * sizeof(int16_t)) == 0);
+    printf("impairments against double precision: max err %.3f  %s\n", max_err, 
+            pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Times the chain impair_block() in siggen.c runs for a block with 
+ *  every impairment on.
+ *
+    @return: samples per second
+*/
+static double time_impair(void)
+{
+    struct iq_correction imbalance = IQ_CORRECTION_INITIALIZER;
+    struct gauss_rng rng = GAUSS_RNG_INITIALIZER;
+    struct timespec start, end;
+    uint32_t reps = 100;
+    uint32_t phase = 0;
+    uint32_t pn_phase = 0;
+    float pn = 0;
+    uint32_t r, pos, i;
+
+    gauss_rng_seed(&rng, 3);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < reps; r++)
+    {
+        uint64_t power = iq_power_sum(iq, BLOCK_SIZE);
+
+        for (pos = 0; pos < BLOCK_SIZE; pos += IMPAIR_CHUNK)
+        {
+            uint32_t count = ((BLOCK_SIZE - pos) < IMPAIR_CHUNK) ? (BLOCK_SIZE - pos) : IMPAIR_CHUNK;
+
+            gauss_fill(noise, 2 * count, (float)sqrt((double)power / BLOCK_SIZE) * 0.1f, &rng);
+            gauss_fill(values, (count / PHASE_NOISE_STEP) + 1, 0.01f, &rng);
+            for (i = 0; i < count; i += PHASE_NOISE_STEP)
+            {
+                uint32_t start = pn_phase;
+                uint32_t step;
+                uint32_t k;
+
+                pn = (0.99f * pn) + values[i / PHASE_NOISE_STEP];
+                pn_phase = (uint32_t)(int64_t)llrintf(pn * 683565275.6f);
+                step = 12345678 + (uint32_t)((int32_t)(pn_phase - start) / PHASE_NOISE_STEP);
+                start += phase;
+                for (k = 0; (k < PHASE_NOISE_STEP) && ((i + k) < count); k++)
+                {
+                    phases[i + k] = start + (k * step);
+                }
+                phase += PHASE_NOISE_STEP * 12345678;
+            }
+            iq_impair(&iq[2 * pos], count, 0.9f, &imbalance, phases, noise);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)reps * BLOCK_SIZE / (elapsed_ms(&start, &end) / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    bool bench = ((argc > 1) && (strcmp(argv[1], "--bench") == 0));
+    double rate = 0;
+    bool pass = true;
+    uint32_t run;
+
+    pass = check_gauss() && pass;
+    pass = check_impair() && pass;
+
+    for (run = 0; run < (bench ? BENCH_RUNS : 1); run++)
+    {
+        double run_rate = time_impair();
+
+        rate = (run_rate > rate) ? run_rate : rate;
+    }
+    printf("all impairments (%s): %.1f Msps%s\n", dsp_kernels_cstr(), rate / 1000000,
+           (rate < (MAX_TX_SAMPLE_RATE * MIN_HEADROOM)) ? "  below the target" : "");
+    if (bench && (rate < (MAX_TX_SAMPLE_RATE * MIN_HEADROOM)))
+    {
+        pass = false;
+    }
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file val_modulator.c
+ *
+ * @brief
+ * Validates the modulator kernels in dsp_kernels.c.  fir_interp() is compared
+ * to the polyphase sum in double precision for every interpolation factor the
+ * modulator in siggen.c allows, nco_phase_iq() to cos() and sin() of the
+ * given phases, and the interpolator is timed against the fastest TX sample 
+ * rate of the cards.  The time is only reported unless --bench is given, 
+ * then the best of BENCH_RUNS runs has to reach the rate.
+ *
+ * build:
+ *  gcc -O2 -I../rfe/rf_testapp/server/src val_modulator.c \
+ *      ../rfe/rf_testapp/server/src/dsp_kernels.c -lm -o val_modulator
+ *
+ * usage: val_modulator [--bench]
+ *
+ * returns 0 if every test passes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "dsp_kernels.h"
+
+/* as in siggen.c */
+#define RRC_SPAN_SYMBOLS    12
+#define MAX_MOD_SPS         16
+#define MOD_CHUNK_SYMBOLS   256
+
+/* the interpolator is most of the work of the modulator, it has to leave
+ * part of a core for the symbol mapping and the int16 conversion */
+#define MAX_TX_SAMPLE_RATE  61440000.0
+#define MIN_HEADROOM        1.25
+
+/* runs timed with --bench, the best one counts so a busy host does not fail */
+#define BENCH_RUNS          5
+
+#define NUM_PHASES          65532
+
+float x[2 * (RRC_SPAN_SYMBOLS - 1 + MOD_CHUNK_SYMBOLS)];
+float coef[RRC_SPAN_SYMBOLS * MAX_MOD_SPS];
+float out[2 * MOD_CHUNK_SYMBOLS * MAX_MOD_SPS];
+uint32_t phases[NUM_PHASES];
+int16_t iq[2 * NUM_PHASES];
+
+static double elapsed_ms(struct timespec *p_start, struct timespec *p_end)
+{
+    return ((p_end->tv_sec - p_start->tv_sec) * 1000.0) +
+        ((p_end->tv_nsec - p_start->tv_nsec) / 1000000.0);
+}
+
+/*****************************************************************************/
+/** @brief Interpolates random symbols by sps and compares every output to 
+ *  the sum in double precision, odd factors check the scalar phase
+ *
+ *  @param[in] sps          interpolation factor
+ *
+    @return: true if the error is within float rounding
+*/
+static bool check_interp(uint32_t sps)
+{
+    double max_err = 0;
+    bool pass;
+    uint32_t n, p, j;
+
+    fir_interp(out, x, MOD_CHUNK_SYMBOLS, coef, RRC_SPAN_SYMBOLS, sps);
+
+    for (n = 0; n < MOD_CHUNK_SYMBOLS; n++)
+    {
+        for (p = 0; p < sps; p++)
+        {
+            double acc_i = 0;
+            double acc_q = 0;
+
+            for (j = 0; j < RRC_SPAN_SYMBOLS; j++)
+            {
+                acc_i += (double)coef[j * sps + p] * x[2 * (n + j)];
+                acc_q += (double)coef[j * sps + p] * x[2 * (n + j) + 1];
+            }
+            max_err = fmax(max_err, fabs(acc_i - out[2 * (n * sps + p)]));
+            max_err = fmax(max_err, fabs(acc_q - out[2 * (n * sps + p) + 1]));
+        }
+    }
+
+    pass = (max_err < 1e-5);
+    if (pass == false)
+    {
+        printf("  sps %2" PRIu32 ": max err %.3g  FAILED\n", sps, max_err);
+    }
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Compares nco_phase_iq() to the ideal I/Q of random phases
+ *
+    @return: true if every sample is within an LSB
+*/
+static bool check_phase_iq(void)
+{
+    float amplitude = 8191.0f;
+    double max_err = 0;
+    bool pass;
+    uint32_t i;
+
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        phases[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    }
+    nco_phase_iq(iq, phases, NUM_PHASES - 3, amplitude);
+
+    for (i = 0; i < NUM_PHASES - 3; i++)
+    {
+        double theta = (phases[i] / 4294967296.0) * 2 * M_PI;
+
+        max_err = fmax(max_err, fabs(iq[2 * i] - (amplitude * cos(theta))));
+        max_err = fmax(max_err, fabs(iq[2 * i + 1] - (amplitude * sin(theta))));
+    }
+
+    pass = (max_err <= 1.0);
+    printf("phase to I/Q: max err %.3f  %s\n", max_err, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+int main(int argc, char *argv[])
+{
+    struct timespec start, end;
+    bool pass = true;
+    bool bench = ((argc > 1) && (strcmp(argv[1], "--bench") == 0));
+    uint32_t sps, i, run;
+
+    srand(1);
+    for (i = 0; i < sizeof(x) / sizeof(x[0]); i++)
+    {
+        x[i] = ((float)rand() / RAND_MAX) - 0.5f;
+    }
+    for (i = 0; i < sizeof(coef) / sizeof(coef[0]); i++)
+    {
+        coef[i] = ((float)rand() / RAND_MAX) - 0.5f;
+    }
+
+    for (sps = 2; sps <= MAX_MOD_SPS; sps++)
+    {
+        pass = check_interp(sps) && pass;
+    }
+    printf("interpolation by 2 to %d: %s\n", MAX_MOD_SPS, pass ? "ok" : "FAILED");
+
+    pass = check_phase_iq() && pass;
+
+    for (sps = 2; sps <= MAX_MOD_SPS; sps++)
+    {
+        uint32_t reps = 2000;
+        double rate = 0;
+
+        for (run = 0; run < (bench ? BENCH_RUNS : 1); run++)
+        {
+            double run_rate;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < reps; i++)
+            {
+                fir_interp(out, x, MOD_CHUNK_SYMBOLS, coef, RRC_SPAN_SYMBOLS, sps);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            run_rate = (double)reps * MOD_CHUNK_SYMBOLS * sps / (elapsed_ms(&start, &end) / 1000);
+            rate = (run_rate > rate) ? run_rate : rate;
+        }
+        printf("sps %2" PRIu32 " (%s): %7.1f Msps%s\n", sps, dsp_kernels_cstr(), rate / 1000000,
+               (rate < (MAX_TX_SAMPLE_RATE * MIN_HEADROOM)) ? "  below the target" : "");
+
+        if (bench && (rate < (MAX_TX_SAMPLE_RATE * MIN_HEADROOM)))
+        {
+            pass = false;
+        }
+    }
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}
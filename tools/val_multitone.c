@@ -0,0 +1,239 @@
+/**
+ * @file val_multitone.c
+ *
+ * @brief
+ * Validates the multi-tone kernels in dsp_kernels.c.  nco_tone_add() is
+ * compared to nco_tone(), iq_float_range() and iq_float_to_int16() to plain
+ * loops, and a comb is summed the way build_multitone() in siggen.c does it
+ * to compare the crest factor of Newman and zero phases and to time the
+ * build of a full period with many tones.
+ *
+ * build:
+ *  gcc -O2 -I../rfe/rf_testapp/server/src val_multitone.c \
+ *      ../rfe/rf_testapp/server/src/dsp_kernels.c -lm -o val_multitone
+ *
+ * returns 0 if every test passes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "dsp_kernels.h"
+
+#define BLOCK_SIZE          65532
+
+/* as in siggen.c */
+#define MULTITONE_MAX_PERIOD (1u << 20)
+#define MULTITONE_CHUNK      1024
+
+/* a comb of this many tones must have a crest factor below the limit with
+ * Newman phases, and close to 10 * log10(N) with zero phases */
+#define COMB_TONES          48
+#define MAX_NEWMAN_CREST_DB 4.0
+
+/* the longest build of a full period of 64 tones */
+#define MAX_BUILD_MS        250.0
+
+int16_t iq[2 * BLOCK_SIZE];
+float acc[2 * BLOCK_SIZE];
+
+static double elapsed_ms(struct timespec *p_start, struct timespec *p_end)
+{
+    return ((p_end->tv_sec - p_start->tv_sec) * 1000.0) +
+        ((p_end->tv_nsec - p_start->tv_nsec) / 1000000.0);
+}
+
+/*****************************************************************************/
+/** @brief Adds two tones to a float buffer and compares them to the int16
+ *  tones of nco_tone(), uneven lengths check the remainder loop
+ *
+    @return: true if every value is within rounding
+*/
+static bool check_tone_add(void)
+{
+    static int16_t iq2[2 * BLOCK_SIZE];
+    uint32_t inc1 = nco_phase_inc(1234567.0, 20000000.0);
+    uint32_t inc2 = nco_phase_inc(-7654321.0, 20000000.0);
+    uint32_t num = BLOCK_SIZE - 3;
+    uint32_t phase = 0x1000;
+    double max_err = 0;
+    bool pass;
+    uint32_t i;
+
+    memset(acc, 0, sizeof(acc));
+    nco_tone_add(acc, num, &phase, inc1, 3000.0f);
+    phase = 0x2000;
+    nco_tone_add(acc, num, &phase, inc2, 2000.0f);
+
+    phase = 0x1000;
+    nco_tone(iq, num, &phase, inc1, 3000.0f);
+    phase = 0x2000;
+    nco_tone(iq2, num, &phase, inc2, 2000.0f);
+
+    for (i = 0; i < 2 * num; i++)
+    {
+        max_err = fmax(max_err, fabs(acc[i] - (iq[i] + iq2[i])));
+    }
+
+    /* each int16 tone is rounded by up to half an LSB */
+    pass = (max_err <= 1.0) && (phase == 0x2000 + num * inc2);
+    printf("tone add against nco_tone: max err %.3f  %s\n", max_err, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Compares iq_float_range() and iq_float_to_int16() to plain loops
+ *
+    @return: true if they match
+*/
+static bool check_range_convert(void)
+{
+    struct iq_float_range range = IQ_FLOAT_RANGE_INITIALIZER;
+    uint32_t num = 1001;
+    float max_abs = 0;
+    float max_power = 0;
+    double sum = 0;
+    bool pass = true;
+    uint32_t i;
+
+    srand(1);
+    for (i = 0; i < 2 * num; i++)
+    {
+        acc[i] = ((float)rand() / RAND_MAX - 0.5f) * 100.0f;
+        max_abs = fmaxf(max_abs, fabsf(acc[i]));
+    }
+    acc[777] = -60.0f;
+    max_abs = 60.0f;
+    for (i = 0; i < num; i++)
+    {
+        float p = acc[2 * i] * acc[2 * i] + acc[2 * i + 1] * acc[2 * i + 1];
+
+        max_power = fmaxf(max_power, p);
+        sum += p;
+    }
+
+    iq_float_range(acc, num, &range);
+    if ((range.max_abs != max_abs) || (range.max_power != max_power) ||
+        (fabs(range.power_sum - sum) > (sum * 1e-5)) || (range.count != num))
+    {
+        printf("  range %f %f %f, expected %f %f %f\n", range.max_abs, range.max_power,
+                range.power_sum, max_abs, max_power, sum);
+        pass = false;
+    }
+
+    /* 60 is scaled past full scale and must saturate */
+    iq_float_to_int16(iq, acc, num, 600.0f);
+    for (i = 0; i < 2 * num; i++)
+    {
+        long val = lrintf(acc[i] * 600.0f);
+
+        val = (val > INT16_MAX) ? INT16_MAX : (val < INT16_MIN) ? INT16_MIN : val;
+        if (iq[i] != val)
+        {
+            printf("  value %" PRIu32 " converted to %d, expected %ld\n", i, iq[i], val);
+            pass = false;
+            break;
+        }
+    }
+
+    printf("float range and conversion: %s\n", pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Sums a comb of tones over a period the way build_multitone() does
+ *
+ *  @param[in] num_tones    tones in the comb, one cycle apart
+ *  @param[in] period       samples in the period
+ *  @param[in] newman       Newman phases, otherwise all 0
+ *  @param[out] p_ms        time taken
+ *
+    @return: crest factor in dB
+*/
+static double build_comb(uint32_t num_tones, uint32_t period, bool newman, double *p_ms)
+{
+    struct iq_float_range range = IQ_FLOAT_RANGE_INITIALIZER;
+    struct timespec start, end;
+    float *p_sum = malloc((size_t)period * 2 * sizeof(float));
+    int16_t *p_iq = malloc((size_t)period * 2 * sizeof(int16_t));
+    uint32_t pos, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (pos = 0; pos < period; pos += MULTITONE_CHUNK)
+    {
+        uint32_t count = ((period - pos) < MULTITONE_CHUNK) ? (period - pos) : MULTITONE_CHUNK;
+        float *p_chunk = &p_sum[2 * pos];
+
+        memset(p_chunk, 0, count * 2 * sizeof(float));
+        for (i = 0; i < num_tones; i++)
+        {
+            /* centered comb, 37 cycles apart */
+            int64_t c = ((int64_t)i - (num_tones / 2)) * 37;
+            uint32_t cycles = (uint32_t)((c < 0) ? (c + period) : c);
+            uint32_t inc = (uint32_t)((((uint64_t)cycles << 32) + (period / 2)) / period);
+            uint64_t fraction = ((uint64_t)cycles * pos) % period;
+            uint64_t k2 = ((uint64_t)i * i) % (2 * num_tones);
+            uint32_t phase = newman ? (uint32_t)((k2 << 32) / (2 * num_tones)) : 0;
+
+            phase += (uint32_t)((fraction << 32) / period);
+            nco_tone_add(p_chunk, count, &phase, inc, 1.0f);
+        }
+        iq_float_range(p_chunk, count, &range);
+    }
+    iq_float_to_int16(p_iq, p_sum, period, 8191.0f / range.max_abs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *p_ms = elapsed_ms(&start, &end);
+    free(p_sum);
+    free(p_iq);
+
+    return 10 * log10(range.max_power / (range.power_sum / range.count));
+}
+
+int main(int argc, char *argv[])
+{
+    bool pass = true;
+    double newman, zero, ms;
+    uint32_t tones[] = { 8, 16, 64 };
+    uint32_t periods[] = { 307200, MULTITONE_MAX_PERIOD };
+    uint32_t t, p;
+
+    pass = check_tone_add() && pass;
+    pass = check_range_convert() && pass;
+
+    newman = build_comb(COMB_TONES, 307200, true, &ms);
+    zero = build_comb(COMB_TONES, 307200, false, &ms);
+    printf("%d tone comb crest factor: newman %.2f dB, zero %.2f dB (10log10(N) = %.2f)\n",
+            COMB_TONES, newman, zero, 10 * log10(COMB_TONES));
+    if ((newman > MAX_NEWMAN_CREST_DB) || (fabs(zero - 10 * log10(COMB_TONES)) > 0.1))
+    {
+        printf("  crest factor out of range\n");
+        pass = false;
+    }
+
+    for (p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+    {
+        for (t = 0; t < sizeof(tones) / sizeof(tones[0]); t++)
+        {
+            newman = build_comb(tones[t], periods[p], true, &ms);
+            printf("%2" PRIu32 " tones, period %7" PRIu32 " (%s): %7.2f ms, crest %.2f dB\n",
+                    tones[t], periods[p], dsp_kernels_cstr(), ms, newman);
+            if (ms > MAX_BUILD_MS)
+            {
+                pass = false;
+            }
+        }
+    }
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file val_nco.c
+ *
+ * @brief
+ * Validates the NCO tone kernel in dsp_kernels.c against cos() and sin() in
+ * double precision and compares its speed to the per sample libm loop that
+ * init_tx_buffer() used to run.
+ *
+ * build:
+ *  gcc -O2 -I../rfe/rf_testapp/server/src val_nco.c \
+ *      ../rfe/rf_testapp/server/src/dsp_kernels.c -lm -o val_nco
+ *
+ * returns 0 if every test is within the error bounds
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "dsp_kernels.h"
+
+/* one tx block and the number of blocks generated by the old init_tx_buffer() */
+#define BLOCK_SIZE          65532
+#define NUM_BLOCKS          50
+
+/* error bounds */
+#define MAX_SAMPLE_ERROR    1.0         // LSB, I or Q
+#define MAX_AMPLITUDE_ERROR 1.0         // LSB, magnitude of I/Q
+#define MAX_PHASE_ERROR     1.0         // LSB, phase error in radians times the amplitude
+
+int16_t iq[2 * BLOCK_SIZE];
+
+static double elapsed_ms(struct timespec *p_start, struct timespec *p_end)
+{
+    return ((p_end->tv_sec - p_start->tv_sec) * 1000.0) +
+        ((p_end->tv_nsec - p_start->tv_nsec) / 1000000.0);
+}
+
+/*****************************************************************************/
+/** @brief Generates a tone and compares every sample to the ideal one
+ *
+ *  @param[in] freq         tone frequency in Hz
+ *  @param[in] sample_rate  sample rate in Hz
+ *  @param[in] amplitude    peak amplitude
+ *
+    @return: true if the errors are within the bounds
+*/
+static bool check_tone(double freq, double sample_rate, float amplitude)
+{
+    uint32_t phase_inc = nco_phase_inc(freq, sample_rate);
+    uint32_t phase = 0x12345678;
+    uint32_t start_phase = phase;
+    double max_sample_err = 0;
+    double max_amp_err = 0;
+    double max_phase_err = 0;
+    bool pass = true;
+    uint32_t i;
+
+    nco_tone(iq, BLOCK_SIZE, &phase, phase_inc, amplitude);
+
+    for (i = 0; i < BLOCK_SIZE; i++)
+    {
+        uint32_t p = start_phase + (i * phase_inc);
+        double theta = (p / 4294967296.0) * 2 * M_PI;
+        double re = amplitude * cos(theta);
+        double im = amplitude * sin(theta);
+        double err;
+
+        err = fmax(fabs(iq[2 * i] - re), fabs(iq[2 * i + 1] - im));
+        max_sample_err = fmax(max_sample_err, err);
+
+        err = fabs(hypot(iq[2 * i], iq[2 * i + 1]) - amplitude);
+        max_amp_err = fmax(max_amp_err, err);
+
+        err = fabs(remainder(atan2(iq[2 * i + 1], iq[2 * i]) - theta, 2 * M_PI));
+        max_phase_err = fmax(max_phase_err, err);
+    }
+
+    /* the phase must carry on from the last sample */
+    if (phase != start_phase + (BLOCK_SIZE * phase_inc))
+    {
+        printf("  phase not continued, %" PRIu32 "\n", phase);
+        pass = false;
+    }
+
+    if ((max_sample_err > MAX_SAMPLE_ERROR) || (max_amp_err > MAX_AMPLITUDE_ERROR) ||
+        ((max_phase_err * amplitude) > MAX_PHASE_ERROR))
+    {
+        pass = false;
+    }
+
+    printf("freq %12.1f rate %11.1f amp %8.1f: sample err %.3f, amplitude err %.3f, "
+            "phase err %.2e  %s\n", freq, sample_rate, amplitude, max_sample_err, max_amp_err,
+            max_phase_err, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Generates the same tone in one call and in uneven pieces, the
+ *  results must be identical
+ *
+    @return: true if they match
+*/
+static bool check_continuity(void)
+{
+    static int16_t pieces[2 * BLOCK_SIZE];
+    uint32_t phase_inc = nco_phase_inc(-1234567.0, 20000000.0);
+    uint32_t phase = 0;
+    uint32_t sizes[] = { 1, 3, 4, 5, 7, 16, 17, 1000, 1023 };
+    uint32_t done = 0;
+    uint32_t i = 0;
+    bool pass;
+
+    nco_tone(iq, BLOCK_SIZE, &phase, phase_inc, 10000.0f);
+
+    phase = 0;
+    while (done < BLOCK_SIZE)
+    {
+        uint32_t count = sizes[i++ % (sizeof(sizes) / sizeof(sizes[0]))];
+
+        if (count > (BLOCK_SIZE - done))
+        {
+            count = BLOCK_SIZE - done;
+        }
+        nco_tone(&pieces[2 * done], count, &phase, phase_inc, 10000.0f);
+        done += count;
+    }
+
+    pass = (memcmp(iq, pieces, sizeof(pieces)) == 0);
+    printf("continuity across calls: %s\n", pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/*****************************************************************************/
+/** @brief Times the NCO and the libm loop for the old buffer size
+ *
+    @return: void
+*/
+static void benchmark(void)
+{
+    struct timespec start, end;
+    uint32_t phase_inc = nco_phase_inc(1000000.0, 24000000.0);
+    uint32_t phase = 0;
+    float nu = 2 * M_PI * 1000000.0f / 24000000.0f;
+    float A = 8191 / M_SQRT2;
+    uint32_t sample_ctr = 0;
+    uint32_t i, j;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NUM_BLOCKS; i++)
+    {
+        nco_tone(iq, BLOCK_SIZE, &phase, phase_inc, A);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("nco (%s): %d blocks in %.2f ms\n", dsp_kernels_cstr(), NUM_BLOCKS,
+            elapsed_ms(&start, &end));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NUM_BLOCKS; i++)
+    {
+        for (j = 0; j < BLOCK_SIZE; j++)
+        {
+            iq[2 * j] = (int16_t)(cos(nu * ((1.0 * sample_ctr) )) * A);
+            iq[2 * j + 1] = (int16_t)(sin(nu * ((1.0 * sample_ctr) )) * A);
+            sample_ctr++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("cos/sin:    %d blocks in %.2f ms\n", NUM_BLOCKS, elapsed_ms(&start, &end));
+}
+
+int main(int argc, char *argv[])
+{
+    double freqs[] = { 1000000.0, -1000000.0, 1.0, 333333.3, 9999999.0, -7654321.0 };
+    float amps[] = { 8191 / M_SQRT2, 2047, 32767, 100 };
+    bool pass = true;
+    uint32_t f, a;
+
+    for (f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++)
+    {
+        for (a = 0; a < sizeof(amps) / sizeof(amps[0]); a++)
+        {
+            pass = check_tone(freqs[f], 20000000.0, amps[a]) && pass;
+        }
+    }
+    pass = check_tone(1000000.0, 491520000.0, 8191 / M_SQRT2) && pass;
+
+    pass = check_continuity() && pass;
+
+    benchmark();
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}
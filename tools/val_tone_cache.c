@@ -0,0 +1,213 @@
+/**
+ * @file val_tone_cache.c
+ *
+ * @brief
+ * Validates the tone buffer cache in tone_cache.c the way tx_tone() uses it.
+ * A hit must give back the blocks and the block count that were cached, the
+ * transmit loop walks that many blocks even when the plan of the new tone
+ * asks for another count.  Entries in use must never be evicted, the others
+ * are evicted least recently used first to stay in the budget, and every
+ * eviction must free the blocks with the count they were cached with.
+ *
+ * build:
+ *  gcc -O2 -pthread -I../rfe/rf_testapp/server/src val_tone_cache.c \
+ *      ../rfe/rf_testapp/server/src/tone_cache.c -o val_tone_cache
+ *
+ * returns 0 if every hit, eviction and free was as expected
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "tone_cache.h"
+
+#define BLOCK_BYTES         1024
+#define BUDGET              (4 * 8 * BLOCK_BYTES)
+
+/* the "transmit blocks" of a tone, the count is kept to check the frees */
+struct test_blocks
+{
+    uint32_t            num_blocks;
+    uint32_t            *p_samples;             // one per block
+};
+
+uint32_t g_frees = 0;
+uint32_t g_bad_frees = 0;
+
+static void free_blocks(void *p_blocks, uint32_t num_blocks)
+{
+    struct test_blocks *p_test = p_blocks;
+
+    if (num_blocks != p_test->num_blocks)
+    {
+        printf("  freed with %" PRIu32 " blocks, %" PRIu32 " were cached\n",
+                num_blocks, p_test->num_blocks);
+        g_bad_frees++;
+    }
+    g_frees++;
+    free(p_test->p_samples);
+    free(p_test);
+}
+
+static struct test_blocks *new_blocks(uint32_t num_blocks, uint32_t tone)
+{
+    struct test_blocks *p_test = calloc(1, sizeof(*p_test));
+    uint32_t i;
+
+    p_test->num_blocks = num_blocks;
+    p_test->p_samples = calloc(num_blocks, sizeof(uint32_t));
+    for (i = 0; i < num_blocks; i++)
+    {
+        p_test->p_samples[i] = tone;
+    }
+
+    return p_test;
+}
+
+static struct tone_cache_key make_key(uint32_t tone, uint32_t sample_rate)
+{
+    struct tone_cache_key key = TONE_CACHE_KEY_INITIALIZER;
+
+    key.tone_offset = tone;
+    key.sample_rate = sample_rate;
+    key.amplitude = 2047;
+    key.block_size = BLOCK_BYTES / 4;
+
+    return key;
+}
+
+/* walks the blocks like the transmit loop, false if a block is past the end
+ * or holds another tone */
+static bool transmit(struct test_blocks *p_test, uint32_t num_blocks, uint32_t tone)
+{
+    uint32_t i;
+
+    if (num_blocks != p_test->num_blocks)
+    {
+        return false;
+    }
+    for (i = 0; i < num_blocks; i++)
+    {
+        if (p_test->p_samples[i] != tone)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* a hit returns the cached count whatever the plan of the caller */
+static bool check_hit(void)
+{
+    struct tone_cache cache = TONE_CACHE_INITIALIZER(BUDGET, free_blocks);
+    struct tone_cache_key key = make_key(1000, 10000000);
+    struct tone_cache_key other = make_key(1000, 20000000);
+    struct test_blocks *p_blocks = new_blocks(7, 1000);
+    void *p_got = NULL;
+    uint32_t num_blocks = 5;    // the plan of the second tone
+    bool pass = true;
+
+    pass = tone_cache_put(&cache, &key, p_blocks, 7, 7 * BLOCK_BYTES) && pass;
+    /* in use, so not found again */
+    pass = (tone_cache_get(&cache, &key, &p_got, &num_blocks) == false) && pass;
+    pass = tone_cache_release(&cache, p_blocks) && pass;
+
+    pass = (tone_cache_get(&cache, &other, &p_got, &num_blocks) == false) && pass;
+    pass = tone_cache_get(&cache, &key, &p_got, &num_blocks) && pass;
+    pass = (p_got == p_blocks) && (num_blocks == 7) && pass;
+    pass = transmit(p_got, num_blocks, 1000) && pass;
+    pass = tone_cache_release(&cache, p_got) && pass;
+
+    tone_cache_clear(&cache);
+    pass = (g_frees == 1) && (cache.bytes == 0) && pass;
+
+    printf("hit: %" PRIu32 " blocks from the cache for a plan of 5, %" PRIu32 " freed: %s\n",
+            num_blocks, g_frees, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+/* entries in use stay, the least recently used of the others goes first */
+static bool check_evict(void)
+{
+    struct tone_cache cache = TONE_CACHE_INITIALIZER(BUDGET, free_blocks);
+    struct tone_cache_key keys[4];
+    struct test_blocks *p_blocks[4];
+    struct tone_cache_key new_key = make_key(500, 10000000);
+    struct test_blocks *p_big = NULL;
+    void *p_got = NULL;
+    uint32_t num_blocks = 0;
+    uint32_t frees = g_frees;
+    bool pass = true;
+    uint32_t i;
+
+    /* fills the budget exactly, the blocks of each tone are a different count */
+    for (i = 0; i < 4; i++)
+    {
+        keys[i] = make_key(100 * (i + 1), 10000000);
+        p_blocks[i] = new_blocks(8 - i, 100 * (i + 1));
+        pass = tone_cache_put(&cache, &keys[i], p_blocks[i], 8 - i, 8 * BLOCK_BYTES) && pass;
+    }
+
+    /* every entry is in use, nothing can make room */
+    p_big = new_blocks(8, 500);
+    if (tone_cache_put(&cache, &keys[0], p_big, 8, 8 * BLOCK_BYTES) == true)
+    {
+        printf("  cached with every entry in use\n");
+        pass = false;
+    }
+    pass = (tone_cache_release(&cache, p_big) == false) && pass;
+    pass = (g_frees == frees) && pass;
+
+    /* released in the order 2, 0, 3, 1, then 2 and 3 are used again */
+    pass = tone_cache_release(&cache, p_blocks[2]) && pass;
+    pass = tone_cache_release(&cache, p_blocks[0]) && pass;
+    pass = tone_cache_release(&cache, p_blocks[3]) && pass;
+    pass = tone_cache_release(&cache, p_blocks[1]) && pass;
+    pass = tone_cache_get(&cache, &keys[2], &p_got, &num_blocks) && (num_blocks == 6) && pass;
+    pass = tone_cache_release(&cache, p_got) && pass;
+    pass = tone_cache_get(&cache, &keys[3], &p_got, &num_blocks) && (num_blocks == 5) && pass;
+    pass = tone_cache_release(&cache, p_got) && pass;
+
+    /* the least recently used, tone 0, makes room */
+    pass = tone_cache_put(&cache, &new_key, p_big, 8, 8 * BLOCK_BYTES) && pass;
+    pass = (g_frees == frees + 1) && pass;
+    pass = (tone_cache_get(&cache, &keys[0], &p_got, &num_blocks) == false) && pass;
+    pass = tone_cache_get(&cache, &keys[1], &p_got, &num_blocks) && (num_blocks == 7) && pass;
+    pass = transmit(p_got, num_blocks, 200) && pass;
+
+    /* tone 1 and the new tone are in use and survive the clear */
+    tone_cache_clear(&cache);
+    pass = (g_frees == frees + 3) && (cache.bytes == 16 * BLOCK_BYTES) && pass;
+    pass = tone_cache_release(&cache, p_got) && pass;
+    pass = tone_cache_release(&cache, p_big) && pass;
+    tone_cache_clear(&cache);
+    pass = (g_frees == frees + 5) && (cache.bytes == 0) && pass;
+
+    /* larger than the budget, left to the caller */
+    new_key = make_key(600, 10000000);
+    p_big = new_blocks(40, 600);
+    pass = (tone_cache_put(&cache, &new_key, p_big, 40, 40 * BLOCK_BYTES) == false) && pass;
+    free_blocks(p_big, 40);
+
+    printf("evict: %" PRIu32 " freed: %s\n", g_frees - frees, pass ? "ok" : "FAILED");
+
+    return pass;
+}
+
+int main(void)
+{
+    bool pass = true;
+
+    pass = check_hit() && pass;
+    pass = check_evict() && pass;
+    pass = (g_bad_frees == 0) && pass;
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}
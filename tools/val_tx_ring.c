@@ -0,0 +1,215 @@
+/**
+ * @file val_tx_ring.c
+ *
+ * @brief
+ * Validates the transmit block ring in tx_ring.c the way the streaming
+ * generator uses it.  A generator thread takes blocks from a free ring,
+ * stamps them with a sequence number and pushes them to a filled ring.  A
+ * transmit thread pops them, checks the sequence and hands them to several
+ * completion threads, which push them back to the free ring in any order.
+ * The generator and transmit threads sleep on tx_events, a wait that runs
+ * into its timeout would be a lost wakeup.
+ *
+ * build:
+ *  gcc -O2 -pthread -I../rfe/rf_testapp/server/src val_tx_ring.c \
+ *      ../rfe/rf_testapp/server/src/tx_ring.c -o val_tx_ring
+ *
+ * returns 0 if every block arrived once and in order with no lost wakeups
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "tx_ring.h"
+
+#define NUM_BLOCKS          16
+#define NUM_COMPLETERS      4
+#define NUM_TRANSFERS       1000000
+
+/* far longer than any wakeup takes */
+#define WAIT_TIMEOUT_USEC   1000000
+
+struct tx_ring g_free = TX_RING_INITIALIZER;
+struct tx_ring g_filled = TX_RING_INITIALIZER;
+struct tx_ring g_complete[NUM_COMPLETERS];
+struct tx_event g_space_event = TX_EVENT_INITIALIZER;
+struct tx_event g_filled_event = TX_EVENT_INITIALIZER;
+
+/* the "sample data" of each block */
+volatile uint64_t g_block_seq[NUM_BLOCKS];
+bool g_done = false;
+uint64_t g_errors = 0;
+uint64_t g_waits = 0;
+uint64_t g_timeouts = 0;
+
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* waits for a ring to have something to pop, counting waits that timed out */
+static void wait_for(struct tx_ring *p_ring, struct tx_event *p_event)
+{
+    for (;;)
+    {
+        uint32_t seq = tx_event_prepare(p_event);
+        uint64_t start;
+
+        if (tx_ring_empty(p_ring) == false)
+        {
+            break;
+        }
+
+        start = now_usec();
+        tx_event_wait(p_event, seq, WAIT_TIMEOUT_USEC);
+        __atomic_add_fetch(&g_waits, 1, __ATOMIC_RELAXED);
+        if ((now_usec() - start) >= WAIT_TIMEOUT_USEC)
+        {
+            __atomic_add_fetch(&g_timeouts, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void *generator(void *params)
+{
+    uint64_t seq = 0;
+    uint32_t index;
+
+    while (seq < NUM_TRANSFERS)
+    {
+        if (tx_ring_pop(&g_free, &index) == false)
+        {
+            wait_for(&g_free, &g_space_event);
+            continue;
+        }
+        g_block_seq[index] = seq++;
+        tx_ring_push(&g_filled, index);
+        tx_event_signal(&g_filled_event);
+    }
+
+    return NULL;
+}
+
+static void *transmitter(void *params)
+{
+    uint64_t expected = 0;
+    uint32_t index;
+
+    while (expected < NUM_TRANSFERS)
+    {
+        if (tx_ring_pop(&g_filled, &index) == false)
+        {
+            wait_for(&g_filled, &g_filled_event);
+            continue;
+        }
+        if (g_block_seq[index] != expected)
+        {
+            if (g_errors++ < 10)
+            {
+                printf("  block %" PRIu32 " has sequence %" PRIu64 ", expected %" PRIu64 "\n",
+                        index, g_block_seq[index], expected);
+            }
+        }
+        expected++;
+
+        /* spread the completions over the other threads */
+        tx_ring_push(&g_complete[expected % NUM_COMPLETERS], index);
+    }
+
+    return NULL;
+}
+
+/* returns blocks to the free ring, several of these push at once */
+static void *completer(void *params)
+{
+    struct tx_ring *p_ring = params;
+    uint32_t index;
+
+    while ((__atomic_load_n(&g_done, __ATOMIC_ACQUIRE) == false) ||
+           (tx_ring_empty(p_ring) == false))
+    {
+        if (tx_ring_pop(p_ring, &index) == false)
+        {
+            sched_yield();
+            continue;
+        }
+        tx_ring_push(&g_free, index);
+        tx_event_signal(&g_space_event);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t gen, tx, comp[NUM_COMPLETERS];
+    uint32_t index;
+    uint32_t count = 0;
+    bool seen[NUM_BLOCKS] = { false };
+    bool pass = true;
+    uint32_t i;
+
+    if ((tx_ring_init(&g_free, NUM_BLOCKS) != 0) || (tx_ring_init(&g_filled, NUM_BLOCKS) != 0))
+    {
+        printf("unable to allocate the rings\n");
+        return 1;
+    }
+    if (tx_ring_init(&g_free, NUM_BLOCKS - 1) == 0)
+    {
+        printf("size that is not a power of 2 accepted\n");
+        pass = false;
+    }
+
+    for (i = 0; i < NUM_BLOCKS; i++)
+    {
+        tx_ring_push(&g_free, i);
+    }
+    for (i = 0; i < NUM_COMPLETERS; i++)
+    {
+        tx_ring_init(&g_complete[i], NUM_BLOCKS);
+        pthread_create(&comp[i], NULL, completer, &g_complete[i]);
+    }
+    pthread_create(&tx, NULL, transmitter, NULL);
+    pthread_create(&gen, NULL, generator, NULL);
+
+    pthread_join(gen, NULL);
+    pthread_join(tx, NULL);
+    __atomic_store_n(&g_done, true, __ATOMIC_RELEASE);
+    for (i = 0; i < NUM_COMPLETERS; i++)
+    {
+        pthread_join(comp[i], NULL);
+    }
+
+    /* every block must be back in the free ring exactly once */
+    while (tx_ring_pop(&g_free, &index) == true)
+    {
+        if ((index >= NUM_BLOCKS) || (seen[index] == true))
+        {
+            printf("  block %" PRIu32 " returned twice or out of range\n", index);
+            pass = false;
+        }
+        else
+        {
+            seen[index] = true;
+        }
+        count++;
+    }
+
+    printf("%d transfers, %" PRIu64 " out of order, %" PRIu32 " of %d blocks returned\n",
+            NUM_TRANSFERS, g_errors, count, NUM_BLOCKS);
+    printf("%" PRIu64 " waits, %" PRIu64 " timed out\n", g_waits, g_timeouts);
+    pass = pass && (g_errors == 0) && (count == NUM_BLOCKS) && (g_timeouts == 0);
+
+    printf("%s\n", pass ? "PASSED" : "FAILED");
+
+    return pass ? 0 : 1;
+}